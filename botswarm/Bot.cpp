@@ -0,0 +1,564 @@
+/**
+ * @file    Bot.cpp
+ * @brief   One simulated client in the bot swarm, which joins the server and drives like a player would.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "Bot.h"
+#include "RakNetStatistics.h"
+#include "StringCompressor.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define BOT_TEAM            0       // NO_TEAM, so the server picks the team.
+#define BOT_CAR_TYPES       3       // CAR_COUNT. Each bot picks one at random.
+
+// Buttons bots hold for a while before picking again. Mostly driving forwards, like real players.
+static const unsigned char BOT_BUTTONS[] =
+{
+    INPUT_FORWARD,
+    INPUT_FORWARD,
+    INPUT_FORWARD | INPUT_LEFT,
+    INPUT_FORWARD | INPUT_RIGHT,
+    INPUT_FORWARD | INPUT_LEFT  | INPUT_HANDBRAKE,
+    INPUT_BACK    | INPUT_LEFT,
+    INPUT_BACK    | INPUT_RIGHT,
+};
+
+Bot *Bot::mReceiving = NULL;
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Counts a latency.
+/// @param  ms  The latency, in milliseconds.
+void LatencyHistogram::add (double ms)
+{
+    int bucket = ms < 0 ? 0 : (int) ms;
+    if (bucket > LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS;
+
+    mBuckets[bucket]++;
+    mCount++;
+    if (ms > mMax)
+        mMax = ms;
+}
+
+
+/// @brief  Counts every latency counted by another histogram.
+void LatencyHistogram::add (const LatencyHistogram &other)
+{
+    for (int i = 0; i <= LATENCY_BUCKETS; i++)
+        mBuckets[i] += other.mBuckets[i];
+    mCount += other.mCount;
+    if (other.mMax > mMax)
+        mMax = other.mMax;
+}
+
+
+/// @brief  Forgets every latency.
+void LatencyHistogram::clear (void)
+{
+    for (int i = 0; i <= LATENCY_BUCKETS; i++)
+        mBuckets[i] = 0;
+    mCount = 0;
+    mMax   = 0;
+}
+
+
+/// @brief  Finds the latency which a percentage of the latencies were no longer than.
+/// @param  percent  The percentage, from 0 to 100.
+/// @return The latency (ms), to the millisecond, or 0 if nothing has been counted.
+double LatencyHistogram::getPercentile (double percent) const
+{
+    if (mCount == 0)
+        return 0;
+
+    double target = mCount * percent / 100.0;
+    int counted = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        counted += mBuckets[i];
+        if (counted >= target)
+            return i + 1 < mMax ? i + 1 : mMax;
+    }
+    return mMax;
+}
+
+
+/// @brief  Constructor.
+/// @param  index  The bot's number, used in its nickname.
+Bot::Bot (int index)
+  : mIndex(index),
+    mRak(NULL),
+    mRPC(NULL),
+    mState(BOT_CONNECTING),
+    mStateTime(0),
+    mTick(0),
+    mNextTickTime(0),
+    mNextSendTime(0),
+    mNextSteerTime(0),
+    mButtons(0),
+    mNumCommands(0),
+    mLastSequence(0),
+    mHasSnapshot(false),
+    mFrameSequence(0),
+    mFrameStarted(false),
+    mFrameValid(false),
+    mPartsReceived(0),
+    mLastPart(-1),
+    mClockOffset(0),
+    mClockSynchronised(false),
+    mInGameTime(0),
+    mBytesSent(0),
+    mBytesReceived(0),
+    mFramesDecoded(0),
+    mFramesBroken(0)
+{
+}
+
+
+/// @brief  Deconstructor, closing the bot's connection straight away. Call stop() a little beforehand
+///         to let the server know it is going.
+Bot::~Bot (void)
+{
+    if (mRak)
+    {
+        mRak->Shutdown(0);
+        mRak->DetachPlugin(mRPC);
+        RakNet::RakPeerInterface::DestroyInstance(mRak);
+        RakNet::RPC4::DestroyInstance(mRPC);
+    }
+}
+
+
+/// @brief  Starts connecting to the server.
+/// @param  host      The server's address.
+/// @param  port      The server's port.
+/// @param  password  The server's password, or NULL.
+/// @return False if the connection couldn't be started.
+bool Bot::start (const char *host, unsigned short port, const char *password)
+{
+    mRak = RakNet::RakPeerInterface::GetInstance();
+    mRPC = RakNet::RPC4::GetInstance();
+    mRak->AttachPlugin(mRPC);
+
+    mRPC->RegisterSlot("GameJoin",          GameJoin,           0);
+    mRPC->RegisterSlot("PlayerTeamSelect",  PlayerTeamSelect,   0);
+    mRPC->RegisterSlot("PlayerSpawn",       PlayerSpawn,        0);
+    mRPC->RegisterSlot("GameSync",          GameSync,           0);
+
+    setState(BOT_CONNECTING);
+
+    RakNet::SocketDescriptor socketDescriptor;
+    if (mRak->Startup(1, &socketDescriptor, 1) != RakNet::RAKNET_STARTED ||
+        mRak->Connect(host, port, password, password == NULL ? 0 : (int) strlen(password)) != RakNet::CONNECTION_ATTEMPT_STARTED)
+    {
+        setState(BOT_FAILED);
+        return false;
+    }
+    mRak->SetOccasionalPing(true);
+
+    return true;
+}
+
+
+/// @brief  Receives from the server, and sends it input while the bot is in the game.
+/// @param  timeNow    The time (from RakNet::GetTimeUS()).
+/// @param  latencies  Counts the latency of each snapshot frame received.
+void Bot::update (RakNet::TimeUS timeNow, LatencyHistogram &latencies)
+{
+    if (mRak == NULL || mState == BOT_FAILED)
+        return;
+
+    // RPCs are called from inside Receive(), and need to know which bot they are for.
+    mReceiving = this;
+    RakNet::Packet *pkt;
+    for (pkt = mRak->Receive(); pkt; mRak->DeallocatePacket(pkt), pkt = mRak->Receive())
+    {
+        unsigned char packetid;
+        if ((unsigned char) pkt->data[0] == ID_TIMESTAMP)
+            packetid = (unsigned char) pkt->data[sizeof(unsigned char) + sizeof(RakNet::TimeMS)];
+        else
+            packetid = (unsigned char) pkt->data[0];
+
+        switch (packetid)
+        {
+            case ID_CONNECTION_REQUEST_ACCEPTED:
+            {
+                mServerGUID    = pkt->guid;
+                mServerAddress = pkt->systemAddress;
+
+                char nickname[32];
+                sprintf(nickname, "Bot%d", mIndex);
+                RakNet::BitStream bsSend;
+                RakNet::StringCompressor().EncodeString(nickname, 128, &bsSend);
+                mRPC->Signal("PlayerJoin", &bsSend, HIGH_PRIORITY, RELIABLE_ORDERED, 0, mServerGUID, false, false);
+                setState(BOT_JOINING);
+                break;
+            }
+
+            case ID_CONNECTION_ATTEMPT_FAILED:
+            case ID_ALREADY_CONNECTED:
+            case ID_NO_FREE_INCOMING_CONNECTIONS:
+            case ID_INVALID_PASSWORD:
+            case ID_CONNECTION_BANNED:
+            case ID_DISCONNECTION_NOTIFICATION:
+            case ID_CONNECTION_LOST:
+                setState(BOT_FAILED);
+                break;
+
+            case ID_PLAYER_SNAPSHOT:
+                readSnapshot(pkt, timeNow, latencies);
+                break;
+
+            default:
+                break;
+        }
+    }
+    mReceiving = NULL;
+
+    if (mState == BOT_FAILED)
+        return;
+
+    // A bot which can't get into the game (say the server is full of AI players) would only skew the results.
+    if (mState != BOT_IN_GAME && timeNow - mStateTime > BOT_CONNECT_TIMEOUT_MS * 1000ull)
+    {
+        stop();
+        setState(BOT_FAILED);
+        return;
+    }
+
+    if (mState != BOT_IN_GAME)
+        return;
+
+    makeInputCommands(timeNow);
+    if (timeNow >= mNextSendTime)
+    {
+        sendInput(timeNow);
+        mNextSendTime += UPDATE_INTERVAL * 1000;
+        if (mNextSendTime < timeNow)
+            mNextSendTime = timeNow + UPDATE_INTERVAL * 1000;
+    }
+}
+
+
+/// @brief  Leaves the server.
+void Bot::stop (void)
+{
+    if (mRak && mState != BOT_CONNECTING && mState != BOT_FAILED)
+        mRak->CloseConnection(mServerGUID, true, 0, HIGH_PRIORITY);
+}
+
+
+/// @brief  Gets the traffic to and from the server, including RakNet's own headers and acknowledgements.
+/// @param  bytesSent      Set to the bytes sent since this was last called.
+/// @param  bytesReceived  Set to the bytes received since this was last called.
+void Bot::takeTraffic (uint64_t &bytesSent, uint64_t &bytesReceived)
+{
+    bytesSent = bytesReceived = 0;
+
+    RakNet::RakNetStatistics statistics;
+    if (mRak == NULL || mRak->GetStatistics(mServerAddress, &statistics) == NULL)
+        return;
+
+    bytesSent      = statistics.runningTotal[RakNet::ACTUAL_BYTES_SENT]     - mBytesSent;
+    bytesReceived  = statistics.runningTotal[RakNet::ACTUAL_BYTES_RECEIVED] - mBytesReceived;
+    mBytesSent     = statistics.runningTotal[RakNet::ACTUAL_BYTES_SENT];
+    mBytesReceived = statistics.runningTotal[RakNet::ACTUAL_BYTES_RECEIVED];
+}
+
+
+/// @brief  Gets the snapshot frames received.
+/// @param  framesDecoded  Set to the frames read in full since this was last called.
+/// @param  framesBroken   Set to the frames which couldn't be read since this was last called.
+void Bot::takeFrames (int &framesDecoded, int &framesBroken)
+{
+    framesDecoded  = mFramesDecoded;
+    framesBroken   = mFramesBroken;
+    mFramesDecoded = 0;
+    mFramesBroken  = 0;
+}
+
+
+/// @brief  Moves the bot on to a new state.
+void Bot::setState (BotState state)
+{
+    mState     = state;
+    mStateTime = RakNet::GetTimeUS();
+}
+
+
+/// @brief  Makes an input command for each tick which has passed, as the client does once per tick.
+/// @param  timeNow  The time.
+void Bot::makeInputCommands (RakNet::TimeUS timeNow)
+{
+    int ticks = 0;
+    while (timeNow >= mNextTickTime)
+    {
+        // Like the client, time is dropped rather than running too many ticks at once.
+        if (++ticks > SIMULATION_MAX_TICKS)
+        {
+            mNextTickTime = timeNow + (RakNet::TimeUS) (SIMULATION_TICK_MS * 1000);
+            break;
+        }
+        mNextTickTime += (RakNet::TimeUS) (SIMULATION_TICK_MS * 1000);
+
+        if (timeNow >= mNextSteerTime)
+        {
+            mButtons       = BOT_BUTTONS[rand() % (sizeof(BOT_BUTTONS) / sizeof(BOT_BUTTONS[0]))];
+            mNextSteerTime = timeNow + (BOT_STEER_MIN_MS + rand() % (BOT_STEER_MAX_MS - BOT_STEER_MIN_MS)) * 1000ull;
+        }
+
+        mTick++;
+        for (int i = INPUT_REDUNDANCY - 1; i > 0; i--)
+            mRecentCommands[i] = mRecentCommands[i - 1];
+        mRecentCommands[0].tick    = (unsigned short) mTick;
+        mRecentCommands[0].buttons = mButtons;
+        if (mNumCommands < INPUT_REDUNDANCY)
+            mNumCommands++;
+    }
+}
+
+
+/// @brief  Sends the recent input commands, acknowledging the latest snapshot frame, as the client does.
+/// @param  timeNow  The time.
+void Bot::sendInput (RakNet::TimeUS timeNow)
+{
+    if (mNumCommands == 0)
+        return;
+
+    RakNet::BitStream bitSend;
+    bitSend.Write((unsigned char) ID_PLAYER_INPUT);
+    InputCommandCodec::write(&bitSend, mRecentCommands, mNumCommands);
+
+    bitSend.Write(mHasSnapshot);
+    if (mHasSnapshot)
+        bitSend.Write(mLastSequence);
+
+    // The tick the bot would be drawing other cars at, so the server does the same lag compensation.
+    double viewTick = (timeNow / 1000.0 - mClockOffset - INTERPOLATION_DELAY_MS) / SIMULATION_TICK_MS;
+    bool hasViewTick = mClockSynchronised && viewTick > 0;
+    bitSend.Write(hasViewTick);
+    if (hasViewTick)
+    {
+        unsigned int wholeTick = (unsigned int) viewTick;
+        bitSend.Write(wholeTick);
+        bitSend.Write((unsigned char) ((viewTick - wholeTick) * 256));
+    }
+
+    mRak->Send(&bitSend, HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, mServerGUID, false);
+}
+
+
+/// @brief  Reads part of a snapshot frame, exactly as the client does, so baselines are kept and the
+///         frame can be acknowledged. The cars themselves are thrown away.
+/// @param  pkt        The packet.
+/// @param  timeNow    When it was received.
+/// @param  latencies  Counts the latency of the frame, if this is the first part of it to arrive.
+void Bot::readSnapshot (RakNet::Packet *pkt, RakNet::TimeUS timeNow, LatencyHistogram &latencies)
+{
+    unsigned char packetid;
+    unsigned short sequence;
+    unsigned int frameTick;
+    unsigned char part;
+    bool hasInputAck;
+    unsigned short inputAck = 0;
+
+    RakNet::BitStream bitStream(pkt->data, pkt->length, false);
+    bitStream.Read(packetid);
+    bitStream.Read(sequence);
+    bitStream.Read(frameTick);
+    bitStream.Read(part);
+    bitStream.Read(hasInputAck);
+    if (hasInputAck)
+        bitStream.Read(inputAck);
+
+    if (mHasSnapshot && !SnapshotCodec::sequenceGreaterThan(sequence, mLastSequence))
+        return;
+
+    if (!mFrameStarted || mFrameSequence != sequence)
+    {
+        if (mFrameStarted && !mFrameValid)
+            mFramesBroken++;
+
+        mSnapshotHistory.beginFrame(sequence);
+        mFrameSequence = sequence;
+        mFrameStarted  = true;
+        mFrameValid    = true;
+        mPartsReceived = 0;
+        mLastPart      = -1;
+
+        // The quickest a frame has ever arrived is taken to have been half the lowest ping, so every other
+        // frame's latency is that plus however much later it arrived.
+        double offset = timeNow / 1000.0 - frameTick * SIMULATION_TICK_MS;
+        if (!mClockSynchronised || offset < mClockOffset)
+        {
+            mClockOffset       = offset;
+            mClockSynchronised = true;
+        }
+        int lowestPing = mRak->GetLowestPing(mServerGUID);
+        if (mState == BOT_IN_GAME && timeNow - mInGameTime > BOT_LATENCY_WARMUP_MS * 1000ull && lowestPing >= 0)
+            latencies.add(offset - mClockOffset + lowestPing / 2.0);
+    }
+
+    bool bComplete = true;
+    bool bMorePlayers;
+    while (bitStream.Read(bMorePlayers) && bMorePlayers)
+    {
+        RakNet::RakNetGUID playerid;
+        QuantizedCarState playerState;
+        bool hasBaseline;
+        bitStream.Read(playerid);
+        bitStream.Read(hasBaseline);
+
+        const QuantizedCarState *baseline = NULL;
+        if (hasBaseline)
+        {
+            unsigned int baselineAge = 0;
+            bitStream.ReadBitsFromIntegerRange(baselineAge, 0u, SNAPSHOT_HISTORY_SIZE - 1u, SNAPSHOT_BASELINE_BITS);
+            if (baselineAge != 0)
+                baseline = mSnapshotHistory.find((unsigned short) (sequence - baselineAge), playerid);
+            if (baseline == NULL)
+            {
+                bComplete = false;
+                break;
+            }
+        }
+
+        if (!SnapshotCodec::read(&bitStream, playerState, baseline))
+        {
+            bComplete = false;
+            break;
+        }
+        mSnapshotHistory.store(sequence, playerid, playerState);
+
+        bool hasHP;
+        int newHP = 0;
+        bitStream.Read(hasHP);
+        if (hasHP)
+            bitStream.Read(newHP);
+
+        bool isAlive;
+        bitStream.Read(isAlive);
+    }
+
+    bool bLastPart;
+    if (!bComplete || !bitStream.Read(bLastPart))
+    {
+        mFrameValid = false;
+        return;
+    }
+
+    mPartsReceived++;
+    if (bLastPart)
+        mLastPart = part;
+
+    if (mFrameValid && mPartsReceived == mLastPart + 1)
+    {
+        mLastSequence = sequence;
+        mHasSnapshot  = true;
+        mFrameStarted = false;
+        mFramesDecoded++;
+    }
+}
+
+
+/// @brief  Asks for a car of a random type.
+void Bot::requestSpawn (void)
+{
+    RakNet::BitStream bsSend;
+    bsSend.Write((int) (rand() % BOT_CAR_TYPES));
+    mRPC->Signal("PlayerSpawn", &bsSend, HIGH_PRIORITY, RELIABLE_ORDERED, 0, mServerGUID, false, false);
+    setState(BOT_SPAWNING);
+}
+
+
+void Bot::GameJoin (RakNet::BitStream *bitStream, RakNet::Packet *pkt)
+{
+    Bot *bot = mReceiving;
+    int gm, aid;
+    char szNickname[128];
+    bitStream->Read(gm);
+    bitStream->Read(aid);
+    RakNet::StringCompressor().DecodeString(szNickname, 128, bitStream);
+
+    // Without the arena's collision mesh, the bot takes the snapshot bounds from the server.
+    SnapshotCodec::readArenaBounds(bitStream);
+
+    bot->mHasSnapshot       = false;
+    bot->mFrameStarted      = false;
+    bot->mClockSynchronised = false;
+    bot->mNumCommands       = 0;
+    bot->mSnapshotHistory.clear();
+
+    RakNet::BitStream bsSend;
+    bsSend.Write((int) BOT_TEAM);
+    bot->mRPC->Signal("PlayerTeamSelect", &bsSend, HIGH_PRIORITY, RELIABLE_ORDERED, 0, bot->mServerGUID, false, false);
+    bot->setState(BOT_TEAM_SELECT);
+}
+
+void Bot::PlayerTeamSelect (RakNet::BitStream *bitStream, RakNet::Packet *pkt)
+{
+    Bot *bot = mReceiving;
+    RakNet::RakNetGUID playerid;
+    int teamID;
+    bool bResult;
+    bitStream->Read(playerid);
+    bitStream->Read(teamID);
+    bitStream->Read(bResult);
+
+    if (playerid != bot->mRak->GetMyGUID() || bot->mState != BOT_TEAM_SELECT)
+        return;
+
+    if (bResult)
+        bot->requestSpawn();
+    else
+        bot->setState(BOT_FAILED);
+}
+
+void Bot::PlayerSpawn (RakNet::BitStream *bitStream, RakNet::Packet *pkt)
+{
+    Bot *bot = mReceiving;
+    unsigned char packetid;
+    RakNet::RakNetGUID playerid;
+    int iCarType;
+    bitStream->Read(packetid);
+    bitStream->Read(playerid);
+    bitStream->Read(iCarType);
+
+    if (playerid != bot->mRak->GetMyGUID())
+        return;
+
+    if (packetid == ID_SPAWN_SUCCESS && bot->mState != BOT_IN_GAME)
+    {
+        RakNet::TimeUS timeNow = RakNet::GetTimeUS();
+        bot->setState(BOT_IN_GAME);
+        bot->mInGameTime    = timeNow;
+        bot->mNextTickTime  = timeNow;
+        bot->mNextSendTime  = timeNow;
+        bot->mNextSteerTime = timeNow;
+    }
+    else if (packetid == ID_SPAWN_NO_TEAM)
+    {
+        RakNet::BitStream bsSend;
+        bsSend.Write((int) BOT_TEAM);
+        bot->mRPC->Signal("PlayerTeamSelect", &bsSend, HIGH_PRIORITY, RELIABLE_ORDERED, 0, bot->mServerGUID, false, false);
+        bot->setState(BOT_TEAM_SELECT);
+    }
+}
+
+void Bot::GameSync (RakNet::BitStream *bitStream, RakNet::Packet *pkt)
+{
+    Bot *bot = mReceiving;
+    int newGameMode, newArenaID, nextArenaID;
+    bitStream->Read(newGameMode);
+    bitStream->Read(newArenaID);
+    bitStream->Read(nextArenaID);
+    SnapshotCodec::readArenaBounds(bitStream);
+
+    // Every car is taken away at the end of a round, so the bots pick new ones, as players do.
+    if (bot->mState == BOT_IN_GAME || bot->mState == BOT_SPAWNING)
+        bot->requestSpawn();
+}
@@ -0,0 +1,234 @@
+/**
+ * @file    BotSwarm.cpp
+ * @brief   Loads a server with many bots at once, and reports how it copes.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "BotSwarm.h"
+#include "RakSleep.h"
+
+
+/*-------------------- STATIC DEFINITIONS --------------------*/
+volatile bool BotSwarm::mInterrupted = false;
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  settings  What to load the server with.
+BotSwarm::BotSwarm (const BotSwarmSettings &settings)
+  : mSettings(settings),
+    mMonitor(NULL),
+    mStartTime(0),
+    mLastReportTime(0),
+    mNextPingTime(0),
+    mHasServerInfo(false),
+    mServerPing(0),
+    mBytesSent(0),
+    mBytesReceived(0),
+    mFramesDecoded(0),
+    mFramesBroken(0),
+    mPeakLoopTime(0),
+    mTotalDownPerClient(0),
+    mTotalUpPerClient(0),
+    mTotalReportSeconds(0),
+    mTotalTickMicroseconds(0),
+    mTotalTicksPerSecond(0),
+    mServerInfoCount(0),
+    mPeakFrameMicroseconds(0),
+    mTotalFramesDecoded(0),
+    mTotalFramesBroken(0)
+{
+    memset(&mServerInfo, 0, sizeof(SERVER_INFO_DATA));
+}
+
+
+/// @brief  Deconstructor, disconnecting any bots which are still connected.
+BotSwarm::~BotSwarm (void)
+{
+    for (size_t i = 0; i < mBots.size(); i++)
+        mBots[i]->stop();
+    if (!mBots.empty())
+        RakSleep(BOTSWARM_STOP_WAIT_MS);
+
+    for (size_t i = 0; i < mBots.size(); i++)
+        delete mBots[i];
+    mBots.clear();
+
+    if (mMonitor)
+    {
+        mMonitor->Shutdown(0);
+        RakNet::RakPeerInterface::DestroyInstance(mMonitor);
+    }
+}
+
+
+/// @brief  Starts the bots, and updates them until the time is up or the swarm is interrupted.
+void BotSwarm::run (void)
+{
+    RakNet::SocketDescriptor socketDescriptor;
+    mMonitor = RakNet::RakPeerInterface::GetInstance();
+    mMonitor->Startup(1, &socketDescriptor, 1);
+
+    mStartTime      = RakNet::GetTimeUS();
+    mLastReportTime = mStartTime;
+    mNextPingTime   = RakNet::GetTimeMS();
+
+    printf("Loading %s:%d with %d bots", mSettings.host, mSettings.port, mSettings.bots);
+    if (mSettings.botsPerSecond > 0)
+        printf(", joining at %.1f a second", mSettings.botsPerSecond);
+    printf(".\n");
+
+    while (!mInterrupted)
+    {
+        RakNet::TimeUS timeNow = RakNet::GetTimeUS();
+        double secondsRun = (timeNow - mStartTime) / 1000000.0;
+        if (mSettings.seconds > 0 && secondsRun >= mSettings.seconds)
+            break;
+
+        // Bots join gradually, as a flood of connections at once isn't what's being measured.
+        int botsDue = mSettings.bots;
+        if (mSettings.botsPerSecond > 0 && secondsRun * mSettings.botsPerSecond + 1 < botsDue)
+            botsDue = (int) (secondsRun * mSettings.botsPerSecond) + 1;
+        while ((int) mBots.size() < botsDue)
+        {
+            Bot *bot = new Bot((int) mBots.size());
+            bot->start(mSettings.host, mSettings.port, mSettings.password);
+            mBots.push_back(bot);
+        }
+
+        for (size_t i = 0; i < mBots.size(); i++)
+            mBots[i]->update(timeNow, mLatencies);
+
+        pingServer();
+
+        RakNet::TimeUS loopTime = RakNet::GetTimeUS() - timeNow;
+        if (loopTime > mPeakLoopTime)
+            mPeakLoopTime = loopTime;
+
+        if (timeNow - mLastReportTime >= mSettings.reportSeconds * 1000000ull)
+            report(timeNow, false);
+
+        RakSleep(1);
+    }
+
+    report(RakNet::GetTimeUS(), true);
+}
+
+
+/// @brief  Pings the server once every BOTSWARM_PING_INTERVAL, and reads its replies.
+void BotSwarm::pingServer (void)
+{
+    RakNet::TimeMS timeNowMS = RakNet::GetTimeMS();
+    if (RakNet::GreaterThan(timeNowMS, mNextPingTime))
+    {
+        mMonitor->Ping(mSettings.host, mSettings.port, false);
+        mNextPingTime = timeNowMS + BOTSWARM_PING_INTERVAL;
+    }
+
+    RakNet::Packet *pkt;
+    for (pkt = mMonitor->Receive(); pkt; mMonitor->DeallocatePacket(pkt), pkt = mMonitor->Receive())
+    {
+        if ((unsigned char) pkt->data[0] != ID_UNCONNECTED_PONG)
+            continue;
+
+        RakNet::TimeMS time;
+        SERVER_INFO_DATA serverInfo;
+        RakNet::BitStream bsIn(pkt->data, pkt->length, false);
+        bsIn.IgnoreBytes(1);
+        bsIn.Read(time);
+        if (!bsIn.Read((char*) &serverInfo, sizeof(SERVER_INFO_DATA)))
+            continue;
+
+        mServerInfo    = serverInfo;
+        mHasServerInfo = true;
+        mServerPing    = RakNet::GetTimeMS() - time;
+
+        mTotalTicksPerSecond   += serverInfo.ticksPerSecond;
+        mTotalTickMicroseconds += serverInfo.tickMicroseconds;
+        mServerInfoCount++;
+        if (serverInfo.peakFrameMicroseconds > mPeakFrameMicroseconds)
+            mPeakFrameMicroseconds = serverInfo.peakFrameMicroseconds;
+    }
+}
+
+
+/// @brief  Prints what has happened since the last report, or over the whole run.
+/// @param  timeNow  The time.
+/// @param  final    Whether this is the last report, summing up the whole run.
+void BotSwarm::report (RakNet::TimeUS timeNow, bool final)
+{
+    int inGame = 0, joining = 0, failed = 0;
+    for (size_t i = 0; i < mBots.size(); i++)
+    {
+        uint64_t sent, received;
+        int decoded, broken;
+        mBots[i]->takeTraffic(sent, received);
+        mBots[i]->takeFrames(decoded, broken);
+        mBytesSent     += sent;
+        mBytesReceived += received;
+        mFramesDecoded += decoded;
+        mFramesBroken  += broken;
+
+        if (mBots[i]->getState() == BOT_IN_GAME)
+            inGame++;
+        else if (mBots[i]->getState() == BOT_FAILED)
+            failed++;
+        else
+            joining++;
+    }
+
+    // Bandwidth is shared between the bots in the game, which use nearly all of it.
+    double seconds = (timeNow - mLastReportTime) / 1000000.0;
+    double downPerClient = 0, upPerClient = 0;
+    if (inGame > 0 && seconds > 0)
+    {
+        downPerClient = mBytesReceived / (double) inGame / seconds;
+        upPerClient   = mBytesSent     / (double) inGame / seconds;
+    }
+    mTotalDownPerClient += downPerClient * seconds;
+    mTotalUpPerClient   += upPerClient   * seconds;
+    mTotalReportSeconds += seconds;
+    mTotalLatencies.add(mLatencies);
+    mTotalFramesDecoded += mFramesDecoded;
+    mTotalFramesBroken  += mFramesBroken;
+
+    double secondsRun = (timeNow - mStartTime) / 1000000.0;
+    if (!final)
+    {
+        printf("[%5.0fs] Bots: %d in the game, %d joining, %d failed.\n", secondsRun, inGame, joining, failed);
+        if (mHasServerInfo)
+            printf("         Server: %d players, %.1f ticks/s, %.1fus per tick (peak frame %.1fus), ping %ums.\n",
+                mServerInfo.players, mServerInfo.ticksPerSecond, mServerInfo.tickMicroseconds, mServerInfo.peakFrameMicroseconds, mServerPing);
+        else
+            printf("         Server: no reply to pings.\n");
+        printf("         Per client: %.2f kB/s down, %.2f kB/s up.\n", downPerClient / 1024, upPerClient / 1024);
+        printf("         Snapshot latency: p50 %.0fms, p90 %.0fms, p99 %.0fms, max %.1fms (%d frames, %d broken).\n",
+            mLatencies.getPercentile(50), mLatencies.getPercentile(90), mLatencies.getPercentile(99), mLatencies.getMax(),
+            mFramesDecoded, mFramesBroken);
+        printf("         Swarm: peak loop %.2fms.\n", mPeakLoopTime / 1000.0);
+    }
+    else
+    {
+        printf("Finished after %.0fs. Bots: %d in the game, %d failed.\n", secondsRun, inGame, failed);
+        if (mServerInfoCount > 0)
+            printf("  Server: %.1f ticks/s, %.1fus per tick on average (peak frame %.1fus).\n",
+                mTotalTicksPerSecond / mServerInfoCount, mTotalTickMicroseconds / mServerInfoCount, mPeakFrameMicroseconds);
+        if (mTotalReportSeconds > 0)
+            printf("  Per client: %.2f kB/s down, %.2f kB/s up on average.\n",
+                mTotalDownPerClient / mTotalReportSeconds / 1024, mTotalUpPerClient / mTotalReportSeconds / 1024);
+        printf("  Snapshot latency: p50 %.0fms, p90 %.0fms, p99 %.0fms, p99.9 %.0fms, max %.1fms (%d frames, %d broken).\n",
+            mTotalLatencies.getPercentile(50), mTotalLatencies.getPercentile(90), mTotalLatencies.getPercentile(99),
+            mTotalLatencies.getPercentile(99.9), mTotalLatencies.getMax(), mTotalFramesDecoded, mTotalFramesBroken);
+    }
+    fflush(stdout);
+
+    mLastReportTime = timeNow;
+    mLatencies.clear();
+    mBytesSent     = 0;
+    mBytesReceived = 0;
+    mFramesDecoded = 0;
+    mFramesBroken  = 0;
+    mPeakLoopTime  = 0;
+}
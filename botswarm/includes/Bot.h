@@ -0,0 +1,170 @@
+/**
+ * @file    Bot.h
+ * @brief   One simulated client in the bot swarm, which joins the server and drives like a player would.
+ */
+#ifndef BOT_H
+#define BOT_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SnapshotCodec.h"
+#include "InputCommand.h"
+#include "SimulationClock.h"
+#include "BitStream.h"
+#include "GetTime.h"
+#include "MessageIdentifiers.h"
+#include "RakNetTypes.h"
+#include "RakPeerInterface.h"
+#include "RPC4Plugin.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+// As in the client's NetworkCore.h and SnapshotBuffer.h.
+#define SERVER_PORT                 55010
+#define UPDATE_INTERVAL             20
+#define INTERPOLATION_DELAY_MS      100.0
+
+#define BOT_CONNECT_TIMEOUT_MS      10000       // How long a bot waits to get into the game before giving up.
+#define BOT_STEER_MIN_MS            300         // Shortest time a bot holds the same buttons.
+#define BOT_STEER_MAX_MS            2000        // Longest time a bot holds the same buttons.
+#define BOT_LATENCY_WARMUP_MS       2000        // Time in the game before a bot's clock is trusted to measure latency.
+#define LATENCY_BUCKETS             1000        // Latencies are counted to the millisecond, up to this.
+
+// The packet IDs and server info, as in the client's NetworkCore.h.
+enum
+{
+	ID_PLAYER_SNAPSHOT = ID_USER_PACKET_ENUM,
+	ID_PLAYER_INPUT,
+    ID_PLAYER_DAMAGE,
+    ID_SPAWN_SUCCESS,
+    ID_SPAWN_NO_TEAM,
+    ID_SPAWN_GAME_INACTIVE,
+    ID_SPAWN_WAIT_NEXT_GAME,
+};
+
+struct SERVER_INFO_DATA
+{
+    unsigned int publicSeed;
+    int curMap;
+    int players;
+    float ticksPerSecond;
+    float tickMicroseconds;
+    float peakFrameMicroseconds;
+};
+
+/// @brief  How far a bot has got into the game.
+enum BotState
+{
+    BOT_CONNECTING,     // Waiting for the connection to be accepted.
+    BOT_JOINING,        // Sent PlayerJoin, waiting for GameJoin.
+    BOT_TEAM_SELECT,    // Sent PlayerTeamSelect, waiting to be put on a team.
+    BOT_SPAWNING,       // Sent PlayerSpawn, waiting for a car.
+    BOT_IN_GAME,        // Driving.
+    BOT_FAILED,         // Refused, timed out or disconnected.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Counts snapshot latencies to the millisecond, so percentiles can be found without keeping
+ *          every sample.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram (void) { clear(); }
+
+    void   add (double ms);
+    void   add (const LatencyHistogram &other);
+    void   clear (void);
+    double getPercentile (double percent) const;
+
+    /// @brief  Gets the number of latencies counted.
+    int    getCount (void) const { return mCount; }
+    /// @brief  Gets the longest latency counted (ms).
+    double getMax (void) const { return mMax; }
+
+private:
+    int    mBuckets[LATENCY_BUCKETS + 1];   ///< The last bucket counts everything longer than LATENCY_BUCKETS ms.
+    int    mCount;
+    double mMax;
+};
+
+
+/**
+ *  @brief  A lightweight client with its own connection to the server. It goes through the same
+ *          PlayerJoin, PlayerTeamSelect and PlayerSpawn handshake as the game, then sends input commands
+ *          at the game's rate while decoding and acknowledging every snapshot, so the server does exactly
+ *          the work a real player causes. It has no physics, graphics or sound.
+ *
+ *          update() must be called often (at least once every UPDATE_INTERVAL) from the swarm's thread.
+ */
+class Bot
+{
+public:
+    Bot (int index);
+    ~Bot (void);
+
+    bool start (const char *host, unsigned short port, const char *password);
+    void update (RakNet::TimeUS timeNow, LatencyHistogram &latencies);
+    void stop (void);
+
+    void takeTraffic (uint64_t &bytesSent, uint64_t &bytesReceived);
+    void takeFrames (int &framesDecoded, int &framesBroken);
+
+    /// @brief  Gets how far the bot has got into the game.
+    BotState getState (void) const { return mState; }
+
+private:
+    void setState (BotState state);
+    void makeInputCommands (RakNet::TimeUS timeNow);
+    void sendInput (RakNet::TimeUS timeNow);
+    void readSnapshot (RakNet::Packet *pkt, RakNet::TimeUS timeNow, LatencyHistogram &latencies);
+    void requestSpawn (void);
+
+    // RPC Calls
+    static void GameJoin (RakNet::BitStream *bitStream, RakNet::Packet *pkt);
+    static void PlayerTeamSelect (RakNet::BitStream *bitStream, RakNet::Packet *pkt);
+    static void PlayerSpawn (RakNet::BitStream *bitStream, RakNet::Packet *pkt);
+    static void GameSync (RakNet::BitStream *bitStream, RakNet::Packet *pkt);
+
+    static Bot *mReceiving;     ///< The bot whose packets are being received, for the RPC calls.
+
+    int                         mIndex;
+    RakNet::RakPeerInterface   *mRak;
+    RakNet::RPC4               *mRPC;
+    RakNet::RakNetGUID          mServerGUID;
+    RakNet::SystemAddress       mServerAddress;
+    BotState                    mState;
+    RakNet::TimeUS              mStateTime;     ///< When the bot got to its current state.
+
+    // Input
+    unsigned int                mTick;          ///< The bot's own simulation tick, as a client numbers its input commands.
+    RakNet::TimeUS              mNextTickTime;
+    RakNet::TimeUS              mNextSendTime;
+    RakNet::TimeUS              mNextSteerTime;
+    unsigned char               mButtons;
+    InputCommand                mRecentCommands[INPUT_REDUNDANCY];  ///< Newest first, resent in every input packet.
+    int                         mNumCommands;
+
+    // Snapshots
+    SnapshotHistory             mSnapshotHistory;
+    unsigned short              mLastSequence;  ///< The newest frame read in full, which is acknowledged.
+    bool                        mHasSnapshot;
+    unsigned short              mFrameSequence; ///< The frame whose parts are arriving.
+    bool                        mFrameStarted;
+    bool                        mFrameValid;
+    int                         mPartsReceived;
+    int                         mLastPart;
+    double                      mClockOffset;   ///< The least a frame has taken to arrive, local ms minus server ms.
+    bool                        mClockSynchronised;
+    RakNet::TimeUS              mInGameTime;
+
+    // Stats, since they were last taken
+    uint64_t                    mBytesSent;
+    uint64_t                    mBytesReceived;
+    int                         mFramesDecoded;
+    int                         mFramesBroken;
+};
+
+#endif // #ifndef BOT_H
@@ -0,0 +1,91 @@
+/**
+ * @file    BotSwarm.h
+ * @brief   Loads a server with many bots at once, and reports how it copes.
+ */
+#ifndef BOTSWARM_H
+#define BOTSWARM_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "Bot.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define BOTSWARM_PING_INTERVAL      1000        // How often the server is pinged for its tick time (ms).
+#define BOTSWARM_STOP_WAIT_MS       500         // How long bots are given to tell the server they are leaving.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  What to load the server with.
+struct BotSwarmSettings
+{
+    const char    *host;
+    unsigned short port;
+    const char    *password;            // NULL if the server has none.
+    int            bots;
+    float          botsPerSecond;       // How quickly bots join. 0 joins them all at once.
+    int            seconds;             // How long to run for. 0 runs until interrupted.
+    int            reportSeconds;       // How often to report.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Runs a swarm of bots against one server on a single thread (each bot's connection has its own
+ *          RakNet threads), reporting every few seconds and again at the end:
+ *              - The server's tick time and tick rate, from the info it returns to unconnected pings.
+ *              - The bandwidth each bot uses, including RakNet's own overheads.
+ *              - Percentiles of the latency of the snapshot frames the bots receive.
+ *              - How long the swarm's own loop takes. If this approaches UPDATE_INTERVAL the bots are
+ *                falling behind, and the results say more about this machine than the server.
+ */
+class BotSwarm
+{
+public:
+    BotSwarm (const BotSwarmSettings &settings);
+    ~BotSwarm (void);
+
+    void run (void);
+
+    /// @brief  Stops run() at the end of its current loop. Safe to call from a signal handler.
+    static void interrupt (void) { mInterrupted = true; }
+
+private:
+    void pingServer (void);
+    void report (RakNet::TimeUS timeNow, bool final);
+
+    static volatile bool        mInterrupted;
+
+    BotSwarmSettings            mSettings;
+    std::vector<Bot*>           mBots;
+    RakNet::RakPeerInterface   *mMonitor;       ///< Pings the server for its info, without joining it.
+    RakNet::TimeUS              mStartTime;
+    RakNet::TimeUS              mLastReportTime;
+    RakNet::TimeMS              mNextPingTime;
+
+    // Since the last report
+    SERVER_INFO_DATA            mServerInfo;    ///< The latest info from the server.
+    bool                        mHasServerInfo;
+    RakNet::TimeMS              mServerPing;
+    LatencyHistogram            mLatencies;
+    uint64_t                    mBytesSent;
+    uint64_t                    mBytesReceived;
+    int                         mFramesDecoded;
+    int                         mFramesBroken;
+    RakNet::TimeUS              mPeakLoopTime;
+
+    // Over the whole run
+    LatencyHistogram            mTotalLatencies;
+    double                      mTotalDownPerClient;    ///< Bytes received by each bot in the game, summed over the reports.
+    double                      mTotalUpPerClient;
+    double                      mTotalReportSeconds;
+    double                      mTotalTickMicroseconds; ///< Summed over the server info received.
+    double                      mTotalTicksPerSecond;
+    int                         mServerInfoCount;
+    float                       mPeakFrameMicroseconds;
+    int                         mTotalFramesDecoded;
+    int                         mTotalFramesBroken;
+};
+
+#endif // #ifndef BOTSWARM_H
@@ -0,0 +1,22 @@
+/**
+ * @file	stdafx.h
+ * @brief 	Centralizes headers for the bot swarm. It only needs Bullet's LinearMath (for the snapshot codec)
+ *          and RakNet, so it can be built on a machine without Ogre, CEGUI or OIS.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LinearMath/btScalar.h"
+#include "LinearMath/btVector3.h"
+#include "LinearMath/btQuaternion.h"
+
+#define COLLISION_DOMAIN_BOTSWARM
+
+#ifndef _WIN32
+    // This would save debugging time ;)
+    #define OutputDebugString printf
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file    main.cpp
+ * @brief   Entry point for the bot swarm, a load test which connects many simulated clients to a server.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "BotSwarm.h"
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Stops the swarm on Ctrl+C, so it still reports and disconnects its bots.
+static void onInterrupt (int signal)
+{
+    BotSwarm::interrupt();
+}
+
+
+/// @brief  Prints how to run the swarm.
+static void printUsage (const char *program)
+{
+    printf("Usage: %s [options]\n", program);
+    printf("  -h host      Server to load (default 127.0.0.1).\n");
+    printf("  -p port      Server's port (default %d).\n", SERVER_PORT);
+    printf("  -w password  Server's password.\n");
+    printf("  -n bots      Bots to connect (default 50).\n");
+    printf("  -r rate      Bots joining a second, 0 for all at once (default 10).\n");
+    printf("  -t seconds   How long to run for, 0 until interrupted (default 60).\n");
+    printf("  -i seconds   How often to report (default 5).\n");
+}
+
+
+/// @brief  Reads the options and runs the swarm.
+int main (int argc, char *argv[])
+{
+    BotSwarmSettings settings;
+    settings.host          = "127.0.0.1";
+    settings.port          = SERVER_PORT;
+    settings.password      = NULL;
+    settings.bots          = 50;
+    settings.botsPerSecond = 10;
+    settings.seconds       = 60;
+    settings.reportSeconds = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        const char *value = argv[++i];
+        switch (argv[i - 1][1])
+        {
+            case 'h': settings.host          = value;                          break;
+            case 'p': settings.port          = (unsigned short) atoi(value);   break;
+            case 'w': settings.password      = value;                          break;
+            case 'n': settings.bots          = atoi(value);                    break;
+            case 'r': settings.botsPerSecond = (float) atof(value);            break;
+            case 't': settings.seconds       = atoi(value);                    break;
+            case 'i': settings.reportSeconds = atoi(value);                    break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (settings.bots < 1 || settings.reportSeconds < 1)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    srand((unsigned int) time(NULL));
+    signal(SIGINT, onInterrupt);
+
+    BotSwarm swarm(settings);
+    swarm.run();
+
+    return 0;
+}
@@ -13,6 +13,7 @@
 #include "SimpleCoupeCar.h"
 #include "SmallCar.h"
 #include "TruckCar.h"
+#include "CarPool.h"
 
 #define NEWCAM 1
 
@@ -27,7 +28,6 @@ Player::Player (bool isAI)
     mIsVIP(false), 
     mTeam(NO_TEAM),
     mCarSnapshot(NULL),
-    mSnapshots(NULL),
     mCar(NULL),
     mIsAI(isAI),
     roundScore(0)
@@ -98,10 +98,18 @@ Player::Player (bool isAI)
 
 /// @brief   Deconstructor.
 Player::~Player (void)
+{
+    delCar();
+}
+
+
+/// @brief  Gives the player's car back to the CarPool.
+void Player::delCar (void)
 {
     if( mCar )
     {
-        delete( mCar );
+        //mCar->mBodyNode->detachAllObjects();
+        GameCore::mPhysicsCore->mCarPool->releaseCar( mCar );
         mCar = NULL;
     }
 }
@@ -125,21 +133,20 @@ void Player::createPlayer (CarType carType, TeamID tid, ArenaID aid)
     if( mCar )
         delCar();
 
+    mSnapshotBuffer.clear();
+    mPrediction.clear();
     mCarType = carType;
 
     switch (carType) {
         case CAR_BANGER:
-            mCar = (Car*) new SimpleCoupeCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
             rearDamageBoundary = -2.1f;
             frontDamageBoundary = 1.6f;
             break;
         case CAR_SMALL:
-            mCar = (Car*) new SmallCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
             rearDamageBoundary = -1.4f;
             frontDamageBoundary = 0.8f;
             break;
         case CAR_TRUCK:
-            mCar = (Car*) new TruckCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
             rearDamageBoundary = -2.15f;
             frontDamageBoundary = 1.3f;
             break;
@@ -147,6 +154,7 @@ void Player::createPlayer (CarType carType, TeamID tid, ArenaID aid)
             throw Ogre::Exception::ERR_INVALIDPARAMS;
             break;
     }
+    mCar = GameCore::mPhysicsCore->mCarPool->takeCar(carType, tid, aid);
     
     bool isLocalPlayer = this == GameCore::mPlayerPool->getLocalPlayer();
     
@@ -295,15 +303,7 @@ void Player::angleTest(void) {
 #ifdef PARTICLE_EFFECT_SHRAPNEL
             GameCore::mClientGraphics->generateShrapnel(hitPoint, tid, shrapnelCount, shrapnelMaxSpeed, shrapnelPlaneOffset);
 #endif
-            {
-                // 300 is a little louder than 400 :P (not perfect yet as it will need tuning with the final fps)
-                float intensity = damage / 350.f;
-                intensity = intensity < 0 ? 0 : ( intensity > 1 ? 1 : intensity );
-
-                if (causedByPlayer && causedByPlayer->getCar())
-                    causedByPlayer->getCar()->triggerCrashSoundAt(hitPoint, intensity);
-            }
-
+            // The crash sound is played once for the whole group of cars by PlayerCollisions::frameEventEnd().
             break;
 
         case 3:
@@ -311,15 +311,6 @@ void Player::angleTest(void) {
 #ifdef PARTICLE_EFFECT_SHRAPNEL
             GameCore::mClientGraphics->generateShrapnel(hitPoint, tid, shrapnelCount, shrapnelMaxSpeed, shrapnelPlaneOffset);
 #endif
-            {
-                // 300 is a little louder than 400 :P (not perfect yet as it will need tuning with the final fps)
-                float intensity = damage / 230.f;
-                intensity = intensity < 0 ? 0 : ( intensity > 1 ? 1 : intensity );
-
-                if (causedByPlayer && causedByPlayer->getCar())
-                    causedByPlayer->getCar()->triggerCrashSoundAt(hitPoint, intensity);
-            }
-
             break;
 
         default:
@@ -659,6 +650,7 @@ void Player::killPlayer()
     GameCore::mClientGraphics->generateExplosion(mCar->mBodyNode->getPosition());
 #endif
     mCar->loadDestroyedModel();
+    mCar->wreck();
 
     // Blast the stuff out of the car (renders it completely undriveable but since this
     // should only be called on dead cars thats not such a problem).
@@ -15,6 +15,8 @@
 #include "TruckCar.h"
 #include "SmallCar.h"
 #include "InputState.h"
+#include "SnapshotBuffer.h"
+#include "LocalPrediction.h"
 
 
 // Uncomment this definition to colour people's nameplates based on their team.
@@ -153,15 +155,7 @@ public:
     void updateGlobalGraphics (Ogre::Real secondsSinceLastFrame);
 	float getCameraYaw (void);
     Car* getCar (void);
-    void delCar()
-    {
-        if( mCar )
-        {
-            //mCar->mBodyNode->detachAllObjects();
-            delete mCar;
-            mCar = NULL;
-        }
-    }
+    void delCar();
 #if _WIN32
     void collisionTickCallback(Ogre::Vector3 &hitPoint, Ogre::Real damage, unsigned int damageSection, int crashType, Player *causedByPlayer);
 #else
@@ -203,7 +197,8 @@ public:
 	RakNet::RakNetGUID getPlayerGUID();
 	void setPlayerGUID(RakNet::RakNetGUID playerGUID);
 
-	CarSnapshot *mSnapshots;
+	SnapshotBuffer mSnapshotBuffer;     // Snapshots received from the server, oldest first.
+	LocalPrediction mPrediction;        // Moves made by the local car which the server hasn't confirmed yet.
 
 	void pushBackNewPowerupBoard(PowerupBoardType type, float fadeOutInSeconds);
 	void addToScore(int amount);
@@ -42,6 +42,12 @@
 
 #define COLLISION_DOMAIN_CLIENT
 
+// Define COLLISION_DOMAIN_BULLET_NO_PROFILE (here or on the compiler command line) only when linking against a
+// Bullet which was itself built with BT_NO_PROFILE. Bullet's profiler isn't thread safe, and whether it is
+// compiled in is decided by how the Bullet libraries were built, which the game can't see from its own
+// headers, so this is what allows ParallelSolver (physics.cfg) to solve on more than one thread.
+//#define COLLISION_DOMAIN_BULLET_NO_PROFILE
+
 // Windows specific include
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 	#include "BulletCollision\NarrowPhaseCollision\btGjkConvexCast.h"
@@ -12,7 +12,6 @@
 #include <sys/resource.h>
 #endif
 
-#define PHYSICS_FPS 60
 //char g_GraphicalLevel = 0; // 0 = low, 1 = medium, 2 = high
 
 /*-------------------- METHOD DEFINITIONS --------------------*/
@@ -393,8 +392,6 @@ void ClientGraphics::createFrameListener (void)
 /// @return Whether the application should continue (i.e.\ false will force a shut down).
 bool ClientGraphics::frameRenderingQueued (const Ogre::FrameEvent& evt)
 {
-    static const float physicsTimeStep = 1.0f / (float) PHYSICS_FPS;
-
     // Check for exit conditions.
     if (mWindow->isClosed())
         return false;
@@ -452,16 +449,38 @@ bool ClientGraphics::frameRenderingQueued (const Ogre::FrameEvent& evt)
             GameCore::mPlayerPool->frameEvent(evt.timeSinceLastFrame);
             if (GameCore::mPlayerPool->getLocalPlayer()->getCar() != NULL)
             {
-                    
-                GameCore::mPlayerPool->getLocalPlayer()->processControlsFrameEvent(inputSnapshot, evt.timeSinceLastFrame);
+                // Correct our predicted position with anything the server has sent, then carry on predicting
+                GameCore::mPlayerPool->getLocalPlayer()->mPrediction.reconcile(GameCore::mPlayerPool->getLocalPlayer());
             }
         }
 
         GameCore::mPowerupPool->frameEvent(evt.timeSinceLastFrame);
 
         //-PHYSICS-STEP--------------------------------------------------------------------
-        // Minimum of 30 FPS (maxSubsteps=2) before physics becomes wrong
-        GameCore::mPhysicsCore->stepSimulation(evt.timeSinceLastFrame, 3, physicsTimeStep);
+        // Our car is simulated in the same whole ticks as the server, one input command per tick, so
+        // the server gets the same result from the same input. Below 20 FPS the simulation slows down.
+        int ticks = GameCore::mSimulationClock->advance(evt.timeSinceLastFrame);
+        for (int i = 0; i < ticks; i++)
+        {
+            GameCore::mSimulationClock->step();
+
+            Player *localPlayer = GameCore::mPlayerPool->getLocalPlayer();
+            bool predicting = NetworkCore::bConnected && localPlayer->getCar() != NULL;
+            unsigned char buttons = 0;
+            if (predicting)
+            {
+                buttons = NetworkCore::makeInputCommand(inputSnapshot, GameCore::mSimulationClock->getTick());
+                InputState input = InputCommandCodec::toInputState(buttons);
+                localPlayer->processControlsFrameEvent(&input, SIMULATION_TICK_SECONDS);
+            }
+
+            GameCore::mPhysicsCore->stepSimulation(SIMULATION_TICK_SECONDS, 1, SIMULATION_TICK_SECONDS);
+
+            // Remember the move in case the server disagrees with it
+            if (predicting && localPlayer->getCar() != NULL)
+                localPlayer->mPrediction.addMove((unsigned short) GameCore::mSimulationClock->getTick(), buttons,
+                    BtOgre::Convert::toBullet(localPlayer->getCar()->GetPos()));
+        }
         //-PHYSICS-STEP--------------------------------------------------------------------
 
         //Draw info items
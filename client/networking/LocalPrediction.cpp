@@ -0,0 +1,92 @@
+/**
+ * @file    LocalPrediction.cpp
+ * @brief   Keeps the local car responsive by moving it as soon as keys are pressed, then squaring it up
+            with the server's authoritative snapshots as they arrive.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "LocalPrediction.h"
+#include "GameCore.h"
+#include "Player.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  bs  The buffer size.
+LocalPrediction::LocalPrediction (uint8_t bs) : CircularBuffer<PredictedMove>(bs), mServerInput(0), mPending(false)
+{
+}
+
+
+/// @brief  Records a tick of movement. Called after the tick's physics step.
+/// @param  tick      The tick.
+/// @param  buttons   The input command applied to the car this tick.
+/// @param  position  Where the car is now.
+void LocalPrediction::addMove (unsigned short tick, unsigned char buttons, const btVector3 &position)
+{
+    PredictedMove move;
+    move.tick     = tick;
+    move.buttons  = buttons;
+    move.position = position;
+    add(move);
+}
+
+
+/// @brief  Stores a snapshot of the local car from the server, to be reconciled on the next frame.
+/// @param  state          The car's state.
+/// @param  inputTick  The latest input command the server had used when it took the snapshot.
+void LocalPrediction::serverUpdate (const QuantizedCarState &state, unsigned short inputTick)
+{
+    SnapshotCodec::dequantize(state, mServerState);
+    mServerInput = inputTick;
+    mPending = true;
+}
+
+
+/// @brief  Checks the latest server snapshot against what was predicted, and corrects the car if the
+///         prediction was wrong.
+/// @param  player  The local player.
+void LocalPrediction::reconcile (Player *player)
+{
+    if (!mPending || player->getCar() == NULL)
+        return;
+    mPending = false;
+
+    // Drop the moves the server has already processed, keeping the last one to compare against.
+    bool haveAcked = false;
+    PredictedMove acked;
+    while (!isEmpty() && !SnapshotCodec::sequenceGreaterThan(get(0)->tick, mServerInput))
+    {
+        acked = *get(0);
+        haveAcked = true;
+        remove();
+    }
+
+    if (haveAcked && acked.position.distance2(mServerState.mPosition) < PREDICTION_TOLERANCE * PREDICTION_TOLERANCE)
+        return;
+
+    // The prediction was wrong, so start again from the server's state and replay everything since.
+    player->getCar()->restoreSnapshot(&mServerState);
+
+    uint8_t size = getSize();
+    for (uint8_t i = 0; i < size; i++)
+    {
+        PredictedMove *move = get(i);
+        InputState input = InputCommandCodec::toInputState(move->buttons);
+
+        player->processControlsFrameEvent(&input, SIMULATION_TICK_SECONDS);
+        GameCore::mPhysicsCore->replaySimulation(player->getCar()->getVehicle(), SIMULATION_TICK_SECONDS, 1, SIMULATION_TICK_SECONDS);
+
+        move->position = BtOgre::Convert::toBullet(player->getCar()->GetPos());
+    }
+}
+
+
+/// @brief  Forgets every move and any pending server state.
+void LocalPrediction::clear (void)
+{
+    head = tail = 0;
+    mPending = false;
+}
@@ -20,6 +20,14 @@ RakNet::RakPeerInterface* NetworkCore::m_pRak;
 RakNet::RPC4* NetworkCore::m_RPC;
 bool NetworkCore::bConnected = false;
 RakNet::TimeMS NetworkCore::timeLastUpdate = 0;
+SnapshotHistory NetworkCore::mSnapshotHistory;
+unsigned short NetworkCore::lastSnapshotSequence = 0;
+bool NetworkCore::bHasSnapshot = false;
+SNAPSHOT_FRAME_PROGRESS NetworkCore::snapshotProgress;
+unsigned char NetworkCore::latchedButtons = 0;
+InputCommand NetworkCore::recentCommands[INPUT_REDUNDANCY];
+int NetworkCore::numCommands = 0;
+ServerClock NetworkCore::mServerClock;
 
 /// @brief  Constructor, initialising all resources.
 NetworkCore::NetworkCore () : m_szHost( NULL )
@@ -92,29 +100,41 @@ void NetworkCore::frameEvent(InputState *inputSnapshot)
     // Called once every frame (each time controls are sampled)
     // Do with this data as you wish - bundle them off in a little packet of joy to the server
 
+	// Buttons are latched until the next input command is made (see makeInputCommand), so a tap
+	// between two ticks still reaches the server.
+	if( bConnected && GameCore::mPlayerPool->getLocalPlayer()->getCar() )
+		latchedButtons |= InputCommandCodec::toButtons( inputSnapshot );
+
 	// Send our input
 	RakNet::TimeMS timeNow = RakNet::GetTimeMS();
 	if( RakNet::GreaterThan( timeNow, timeLastUpdate + UPDATE_INTERVAL ) )
 	{
 		// If we're not connected, don't do anything here
-		if( bConnected && GameCore::mPlayerPool->getLocalPlayer()->getCar() )
+		if( bConnected && GameCore::mPlayerPool->getLocalPlayer()->getCar() && numCommands > 0 )
 		{
-			// Bools are written as 1 bit by raknet :D
-
-			// Create a player input struct to send to server
-			PLAYER_INPUT_DATA playerInput;
-			playerInput.backPressed = inputSnapshot->isBack();
-			playerInput.frwdPressed = inputSnapshot->isForward();
-			playerInput.leftPressed = inputSnapshot->isLeft();
-			playerInput.rghtPressed = inputSnapshot->isRight();
-            playerInput.hndbPressed = inputSnapshot->isHandbrake();
-
 			// Push the data onto a bitstream
 			RakNet::BitStream bitSend;
 			unsigned char packetid = ID_PLAYER_INPUT;
 
+			// Every recent command is sent, so losing a packet loses no input
 			bitSend.Write( packetid );
-			bitSend.Write( (char*)&playerInput, sizeof( PLAYER_INPUT_DATA ) );
+			InputCommandCodec::write( &bitSend, recentCommands, numCommands );
+
+			// Acknowledge the latest snapshot frame so the server can delta encode against it
+			bitSend.Write( bHasSnapshot );
+			if( bHasSnapshot )
+				bitSend.Write( lastSnapshotSequence );
+
+			// Tell the server when we're seeing other cars, for lag compensation
+			double viewTick = getInterpolationTime() / SIMULATION_TICK_MS;
+			bool hasViewTick = mServerClock.isSynchronised() && viewTick > 0;
+			bitSend.Write( hasViewTick );
+			if( hasViewTick )
+			{
+				unsigned int wholeTick = (unsigned int) viewTick;
+				bitSend.Write( wholeTick );
+				bitSend.Write( (unsigned char) ( ( viewTick - wholeTick ) * 256 ) );
+			}
 
 			// Send to server
 			m_pRak->Send( &bitSend, HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, serverGUID, false );
@@ -211,7 +231,7 @@ void NetworkCore::frameEvent(InputState *inputSnapshot)
 	}
 }
 
-/// @brief Process a new snapshot of a player. Could be remote or local player
+/// @brief Process part of a new snapshot frame, containing the state of some or all of the cars
 /// @params Packet containing the snapshot data
 void NetworkCore::ProcessPlayerState( RakNet::Packet *pkt )
 {
@@ -219,48 +239,170 @@ void NetworkCore::ProcessPlayerState( RakNet::Packet *pkt )
 	// smoothly "rewind and replay" previous physics frames
 
 	unsigned char bPacketID;
-	PLAYER_SYNC_DATA playerState;
+	unsigned short sequence;
+	unsigned int frameTick;
+	unsigned char part;
+	bool hasInputAck;
+	unsigned short inputAck = 0;
 
 	RakNet::BitStream bitStream( pkt->data, pkt->length, false );
 
 	bitStream.Read( bPacketID );
-	RakNet::RakNetGUID playerid;
-	bitStream.Read( playerid );
-	bitStream.Read( (char*)&playerState, sizeof( PLAYER_SYNC_DATA ) );
+	bitStream.Read( sequence );
+	bitStream.Read( frameTick );
+	bitStream.Read( part );
+	bitStream.Read( hasInputAck );
+	if( hasInputAck )
+		bitStream.Read( inputAck );
+
+	// Ignore anything older than what we already have
+	if( bHasSnapshot && !SnapshotCodec::sequenceGreaterThan( sequence, lastSnapshotSequence ) )
+		return;
 
-	Player *pUpdate;
+	// Large frames are split into parts which can each be read on their own. The first
+	// part of a new frame to arrive starts it off in the history. The server only sends us
+	// the cars most relevant to us, so a frame won't necessarily have every car in it
+	if( !snapshotProgress.started || snapshotProgress.sequence != sequence )
+	{
+		mSnapshotHistory.beginFrame( sequence );
+		snapshotProgress.sequence      = sequence;
+		snapshotProgress.started       = true;
+		snapshotProgress.valid         = true;
+		snapshotProgress.partsReceived = 0;
+		snapshotProgress.lastPart      = -1;
+
+		// Keep track of which tick the server is on
+		mServerClock.sample( frameTick );
+	}
 
-	if( playerid == GameCore::mPlayerPool->getLocalPlayerID() )
-		pUpdate = GameCore::mPlayerPool->getLocalPlayer();
-	else
-		pUpdate = GameCore::mPlayerPool->getPlayer( playerid );
+	bool bComplete = true;
+	bool bMorePlayers;
+	while( bitStream.Read( bMorePlayers ) && bMorePlayers )
+	{
+		RakNet::RakNetGUID playerid;
+		QuantizedCarState playerState;
+		bool hasBaseline;
+		bitStream.Read( playerid );
+		bitStream.Read( hasBaseline );
+
+		// Each car is encoded against the last frame we acknowledged which had that car in it. If we
+		// no longer have it (which shouldn't happen) the car can't be read, and neither can the rest
+		const QuantizedCarState *baseline = NULL;
+		if( hasBaseline )
+		{
+			unsigned int baselineAge = 0;
+			bitStream.ReadBitsFromIntegerRange( baselineAge, 0u, SNAPSHOT_HISTORY_SIZE - 1u, SNAPSHOT_BASELINE_BITS );
+			if( baselineAge != 0 )
+				baseline = mSnapshotHistory.find( (unsigned short) (sequence - baselineAge), playerid );
+			if( baseline == NULL )
+			{
+				bComplete = false;
+				break;
+			}
+		}
+
+		if( !SnapshotCodec::read( &bitStream, playerState, baseline ) )
+		{
+			bComplete = false;
+			break;
+		}
+
+		// Remember the state (even for players we don't know about yet) so it can be used as a baseline
+		mSnapshotHistory.store( sequence, playerid, playerState );
+
+		bool hasHP;
+		int newHP = 0;
+		bitStream.Read( hasHP );
+		if( hasHP )
+			bitStream.Read( newHP );
+
+		bool isAlive;
+		bitStream.Read( isAlive );
+
+		Player *pUpdate;
+
+		if( playerid == GameCore::mPlayerPool->getLocalPlayerID() )
+			pUpdate = GameCore::mPlayerPool->getLocalPlayer();
+		else
+			pUpdate = GameCore::mPlayerPool->getPlayer( playerid );
+
+		if( pUpdate == NULL )
+			continue;
+
+		// Our own car is predicted, so its snapshots are checked against the prediction instead
+		if( pUpdate == GameCore::mPlayerPool->getLocalPlayer() )
+		{
+			if( hasInputAck )
+				pUpdate->mPrediction.serverUpdate( playerState, inputAck );
+		}
+		else
+		{
+			pUpdate->mSnapshotBuffer.add( frameTick * SIMULATION_TICK_MS, playerState );
+		}
+
+		if( hasHP )
+			pUpdate->serverSaysHealthChangedTo( (float) newHP );
+
+		if( !isAlive )
+		{
+			if( pUpdate->getCar() )
+			{
+				pUpdate->getCar()->loadDestroyedModel();
+				pUpdate->getCar()->wreck();
+			}
+		}
+	}
 
-	if( pUpdate == NULL )
+	bool bLastPart;
+	if( !bComplete || !bitStream.Read( bLastPart ) )
+	{
+		snapshotProgress.valid = false;
 		return;
+	}
 
-	CarSnapshot *carSnapshot = new CarSnapshot( playerState.vPosition, playerState.qRotation, 
-		playerState.vAngVel, playerState.vLinVel, playerState.fWheelPos );
+	snapshotProgress.partsReceived ++;
+	if( bLastPart )
+		snapshotProgress.lastPart = part;
 
-	if( pUpdate->mSnapshots != NULL )
-		delete( pUpdate->mSnapshots );
+	// Only acknowledge frames we managed to read all of, otherwise the server could
+	// delta encode against a car we never got
+	if( snapshotProgress.valid && snapshotProgress.partsReceived == snapshotProgress.lastPart + 1 )
+	{
+		lastSnapshotSequence = sequence;
+		bHasSnapshot = true;
+	}
+}
 
-	pUpdate->mSnapshots = carSnapshot;
-    bool hasHP; bitStream.Read( hasHP );
-    if( hasHP )
-    {
-        int newHP;
-        bitStream.Read( newHP );
-        pUpdate->serverSaysHealthChangedTo( (float) newHP );
-    }
+/// @brief  Gets the server time remote cars should be drawn at. This is a little behind the newest
+///         frame so that there is usually a snapshot either side of it to interpolate between.
+/// @return The server time in ms.
+double NetworkCore::getInterpolationTime()
+{
+	return mServerClock.getServerTime() - INTERPOLATION_DELAY_MS;
+}
 
-    bool isAlive;
-    bitStream.Read( isAlive );
-    if( !isAlive )
-    {
-        if( pUpdate->getCar() )
-            pUpdate->getCar()->loadDestroyedModel();
-    }
+/// @brief  Makes the input command for a simulation tick from the buttons held (or tapped) since the
+///         last one. Called once per tick while we have a car, before it is simulated.
+/// @param  inputSnapshot  The latest user keypresses.
+/// @param  tick           The tick being simulated.
+/// @return The buttons in the command, which are what should be applied to our car this tick.
+unsigned char NetworkCore::makeInputCommand( InputState *inputSnapshot, unsigned int tick )
+{
+	unsigned char buttons = latchedButtons | InputCommandCodec::toButtons( inputSnapshot );
+	latchedButtons = 0;
 
+	// Only consecutive commands can be sent together
+	if( numCommands > 0 && recentCommands[0].tick != (unsigned short) ( tick - 1 ) )
+		numCommands = 0;
+
+	for( int i = INPUT_REDUNDANCY - 1; i > 0; i-- )
+		recentCommands[i] = recentCommands[i - 1];
+	recentCommands[0].tick    = (unsigned short) tick;
+	recentCommands[0].buttons = buttons;
+	if( numCommands < INPUT_REDUNDANCY )
+		numCommands++;
+
+	return buttons;
 }
 
 void NetworkCore::setNicknameChange( const char *newNickname )
@@ -308,6 +450,12 @@ void NetworkCore::GameJoin( RakNet::BitStream *bitStream, RakNet::Packet *pkt )
 	log( "GameJoin : local playerid %s", m_pRak->GetMyGUID().ToString() );
 	bConnected = true;
 	timeLastUpdate = 0;
+	bHasSnapshot = false;
+	mServerClock.reset();
+	numCommands = 0;
+	latchedButtons = 0;
+	snapshotProgress.started = false;
+	mSnapshotHistory.clear();
 
     // Set the gameplay parameters.
     GameCore::mGameplay->setGameMode( gm );
@@ -601,11 +749,15 @@ void NetworkCore::GameSync( RakNet::BitStream *bitStream, RakNet::Packet *pkt )
     ArenaID newArenaID;
     bitStream->Read(newArenaID);
 
+    ArenaID nextArenaID;
+    bitStream->Read(nextArenaID);
+
     //Set the game to this
     GameCore::mGameplay->setGameMode(newGameMode);
     GameCore::mClientGraphics->unloadArena( GameCore::mGameplay->getArenaID() );
     GameCore::mGameplay->setArenaID(newArenaID);
     GameCore::mClientGraphics->loadArena( GameCore::mGameplay->getArenaID() );
+    GameCore::mClientGraphics->prefetchArena( nextArenaID );
 
     GameCore::mPlayerPool->getLocalPlayer()->setPlayerState( PLAYER_STATE_SPAWN_SEL );
 
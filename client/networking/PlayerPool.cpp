@@ -3,8 +3,8 @@
 #include "PlayerPool.h"
 #include "Player.h"
 #include "GameCore.h"
-
-#define BASIC_INTERP 1
+#include "CarPool.h"
+#include "NetworkCore.h"
 
 PlayerPool::PlayerPool() : mLocalPlayer(0)
 {
@@ -211,55 +211,16 @@ void PlayerPool::frameEvent( const float timeSinceLastFrame )
 
 void PlayerPool::processPlayer( Player *pPlayer )
 {
-	if( pPlayer->mSnapshots != NULL && pPlayer->getCar() != NULL )
-	{
-#if BASIC_INTERP
-
-        CarSnapshot *currentSnap = pPlayer->getCar()->getCarSnapshot();
-        CarSnapshot *restoreSnap = NULL;
-
-        btScalar dist = currentSnap->mPosition.distance( pPlayer->mSnapshots->mPosition );
-
-        if( dist > 3.00f )
-        {
-            restoreSnap = (CarSnapshot*)malloc( sizeof( CarSnapshot ) );
-            memcpy( restoreSnap, pPlayer->mSnapshots, sizeof( CarSnapshot ) );
-        }
-        else if( dist > 0.20f )
-        {          
-            btVector3 interpPos = pPlayer->mSnapshots->mPosition.lerp( currentSnap->mPosition, 0.9f );
-            btQuaternion interpRot = pPlayer->mSnapshots->mRotation.slerp( currentSnap->mRotation, 0.9f );
-
-            //btVector3 interpLin = pPlayer->mSnapshots->mLinearVelocity.lerp( currentSnap->mLinearVelocity, 0.9 );
-            //btVector3 interpAng = pPlayer->mSnapshots->mAngularVelocity.lerp( currentSnap->mAngularVelocity, 0.9 );
-                
-            //restoreSnap = new CarSnapshot( interpPos, interpRot, interpAng, interpLin, currentSnap->mWheelPosition );
-
-            restoreSnap = new CarSnapshot( 
-                interpPos, 
-                interpRot, 
-                pPlayer->mSnapshots->mAngularVelocity,
-                pPlayer->mSnapshots->mLinearVelocity, 
-                pPlayer->mSnapshots->mWheelPosition );
-        }
+    if( pPlayer->getCar() == NULL )
+        return;
 
-        if( restoreSnap != NULL )
-        {
-	        pPlayer->getCar()->restoreSnapshot( restoreSnap );
-
-            delete( restoreSnap );
-            restoreSnap = NULL;
-        }
-
-        delete( currentSnap );
-        currentSnap = NULL;
-
-#else
-
-        pPlayer->getCar()->restoreSnapshot( pPlayer->mSnapshots );
-#endif
-        delete( pPlayer->mSnapshots );
-        pPlayer->mSnapshots = NULL;
+    // Remote cars are drawn a little in the past, interpolating between the snapshots either side.
+    // Our own car is predicted instead (see LocalPrediction)
+    if( pPlayer != mLocalPlayer )
+    {
+        CarSnapshot interpSnap;
+        if( pPlayer->mSnapshotBuffer.sample( NetworkCore::getInterpolationTime(), interpSnap ) )
+            pPlayer->getCar()->restoreSnapshot( &interpSnap );
     }
 
 	 // improve the judderyness of the crown, it could still be better though
@@ -280,6 +241,9 @@ void PlayerPool::roundEnd()
         //mPlayers[i]->setPlayerState( PLAYER_STATE_SPAWN_SEL );
 	}
 
+    // Every car is gone, so the parts which fell off them can go too (before their cloned entities are).
+    GameCore::mPhysicsCore->mCarPool->releaseDebris();
+
     while (Car::mClonedEntities->size() > 0)
     {
         Entity *e = Car::mClonedEntities->front();
@@ -0,0 +1,65 @@
+/**
+ * @file    ServerClock.cpp
+ * @brief   Estimates which tick the server is on from the ticks stamped on its snapshots.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "ServerClock.h"
+#include "GetTime.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+ServerClock::ServerClock (void)
+{
+    reset();
+}
+
+
+/// @brief  Updates the estimate with a newly arrived snapshot.
+/// @param  serverTick  The tick the snapshot was taken on.
+void ServerClock::sample (unsigned int serverTick)
+{
+    double offset = RakNet::GetTimeUS() * 0.001 - serverTick * SIMULATION_TICK_MS;
+
+    if (!mSynchronised || offset < mOffset)
+    {
+        mOffset = offset;
+        mLateSamples = 0;
+    }
+    else if (offset - mOffset > SERVER_CLOCK_RESYNC_MS)
+    {
+        // One late snapshot is just lag, but a run of them means the server's timeline has moved.
+        if (++mLateSamples > 10)
+        {
+            mOffset = offset;
+            mLateSamples = 0;
+        }
+    }
+    else
+    {
+        mOffset += (offset - mOffset) * SERVER_CLOCK_DRIFT_RATE;
+        mLateSamples = 0;
+    }
+
+    mSynchronised = true;
+}
+
+
+/// @brief  Forgets the estimate, e.g. when joining a new server.
+void ServerClock::reset (void)
+{
+    mOffset       = 0;
+    mSynchronised = false;
+    mLateSamples  = 0;
+}
+
+
+/// @brief  Gets the estimated time on the server's clock right now.
+/// @return The time (ms), where tick n is at n * SIMULATION_TICK_MS.
+double ServerClock::getServerTime (void) const
+{
+    return RakNet::GetTimeUS() * 0.001 - mOffset;
+}
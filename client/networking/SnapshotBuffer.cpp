@@ -0,0 +1,115 @@
+/**
+ * @file    SnapshotBuffer.cpp
+ * @brief   A history of the snapshots received for a car, used to draw remote cars slightly in the past.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SnapshotBuffer.h"
+#include <algorithm>
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  bs  The buffer size.
+SnapshotBuffer::SnapshotBuffer (uint8_t bs) : CircularBuffer<TimedCarSnapshot>(bs)
+{
+}
+
+
+/// @brief  Adds a snapshot to the buffer, overwriting the oldest if the buffer is full. Snapshots which
+///         are no newer than the newest one already stored are ignored.
+/// @param  time   The server time the snapshot was taken at.
+/// @param  state  The car's state at that time.
+void SnapshotBuffer::add (double time, const QuantizedCarState &state)
+{
+    if (!isEmpty() && time <= get(getSize() - 1)->time)
+        return;
+
+    TimedCarSnapshot entry;
+    entry.time = time;
+    SnapshotCodec::dequantize(state, entry.snapshot);
+    CircularBuffer<TimedCarSnapshot>::add(entry);
+}
+
+
+/// @brief  Works out where the car was at the given time. Snapshots older than the pair either side of
+///         the time are dropped, so the time given should never go backwards.
+/// @param  time    The server time to sample at.
+/// @param  result  Filled with the state of the car.
+/// @return False if there are no snapshots to sample from.
+bool SnapshotBuffer::sample (double time, CarSnapshot &result)
+{
+    if (isEmpty())
+        return false;
+
+    while (getSize() >= 2 && get(1)->time <= time)
+        remove();
+
+    const TimedCarSnapshot *from = get(0);
+
+    // Before the first snapshot there's nothing to do but wait at it.
+    if (time <= from->time)
+    {
+        result = from->snapshot;
+        return true;
+    }
+
+    // After the last snapshot carry the car on along its velocity, but not too far.
+    if (getSize() == 1)
+    {
+        float t = (float) (std::min(time - from->time, EXTRAPOLATION_LIMIT_MS) * 0.001);
+        const btVector3 &angularVelocity = from->snapshot.mAngularVelocity;
+
+        result = from->snapshot;
+        result.mPosition += from->snapshot.mLinearVelocity * t;
+
+        btScalar angularSpeed = angularVelocity.length();
+        if (angularSpeed > SIMD_EPSILON)
+        {
+            btQuaternion spin(angularVelocity / angularSpeed, angularSpeed * t);
+            result.mRotation = (spin * result.mRotation).normalized();
+        }
+        return true;
+    }
+
+    const TimedCarSnapshot *to = get(1);
+    const CarSnapshot &a = from->snapshot;
+    const CarSnapshot &b = to->snapshot;
+
+    if (a.mPosition.distance2(b.mPosition) > INTERPOLATION_SNAP_DISTANCE * INTERPOLATION_SNAP_DISTANCE)
+    {
+        result = a;
+        return true;
+    }
+
+    float dt = (float) ((to->time - from->time) * 0.001);
+    float s  = (float) ((time - from->time) / (to->time - from->time));
+    float s2 = s * s;
+    float s3 = s2 * s;
+
+    // Cubic Hermite basis functions and their derivatives.
+    float h00 =  2.0f * s3 - 3.0f * s2 + 1.0f;
+    float h10 =         s3 - 2.0f * s2 + s;
+    float h01 = -2.0f * s3 + 3.0f * s2;
+    float h11 =         s3 -        s2;
+    float d00 =  6.0f * s2 - 6.0f * s;
+    float d10 =  3.0f * s2 - 4.0f * s + 1.0f;
+    float d01 = -6.0f * s2 + 6.0f * s;
+    float d11 =  3.0f * s2 - 2.0f * s;
+
+    result.mPosition        = a.mPosition * h00 + a.mLinearVelocity * (h10 * dt) + b.mPosition * h01 + b.mLinearVelocity * (h11 * dt);
+    result.mLinearVelocity  = (a.mPosition * d00 + b.mPosition * d01) / dt + a.mLinearVelocity * d10 + b.mLinearVelocity * d11;
+    result.mRotation        = a.mRotation.slerp(b.mRotation, s);
+    result.mAngularVelocity = a.mAngularVelocity.lerp(b.mAngularVelocity, s);
+    result.mWheelPosition   = a.mWheelPosition + (b.mWheelPosition - a.mWheelPosition) * s;
+    return true;
+}
+
+
+/// @brief  Throws away every snapshot.
+void SnapshotBuffer::clear (void)
+{
+    head = tail = 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file    LocalPrediction.h
+ * @brief   Keeps the local car responsive by moving it as soon as keys are pressed, then squaring it up
+            with the server's authoritative snapshots as they arrive.
+ */
+#ifndef LOCALPREDICTION_H
+#define LOCALPREDICTION_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "CircularBuffer.h"
+#include "CarSnapshot.h"
+#include "SnapshotCodec.h"
+#include "InputCommand.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define PREDICTION_BUFFER_SIZE  128     // Ticks remembered (one less than this can be stored). Must cover a round trip.
+#define PREDICTION_TOLERANCE    0.05f   // How far (metres) a prediction can be from the server before it is corrected.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  One simulation tick of the local car's movement.
+struct PredictedMove
+{
+    unsigned short tick;        // The tick, which is also the tick of the input command sent for it.
+    unsigned char  buttons;     // The INPUT_BUTTON flags applied.
+    btVector3      position;    // Where the move left the car.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+class Player;
+
+/**
+ *  @brief  Remembers each tick of input applied to the local car which the server hasn't processed yet.
+ *
+ *          Each input command sent to the server has a tick number, and the server's snapshots say
+ *          the latest one it has used. When a snapshot arrives the moves it covers are dropped. If
+ *          the car ended up where the server says it should be, nothing needs to be done. Otherwise the
+ *          car is put back where the server has it and the remaining moves are replayed on top.
+ */
+class LocalPrediction : public CircularBuffer<PredictedMove>
+{
+public:
+    LocalPrediction (uint8_t bs = PREDICTION_BUFFER_SIZE);
+
+    void addMove (unsigned short tick, unsigned char buttons, const btVector3 &position);
+    void serverUpdate (const QuantizedCarState &state, unsigned short inputTick);
+    void reconcile (Player *player);
+    void clear (void);
+
+private:
+    CarSnapshot    mServerState;    ///< The newest state of the car received from the server.
+    unsigned short mServerInput;    ///< The latest input command the server had used for mServerState.
+    bool           mPending;        ///< Whether mServerState hasn't been reconciled yet.
+};
+
+#endif // #ifndef LOCALPREDICTION_H
@@ -20,6 +20,9 @@
 #include "Team.h"
 #include "Car.h"
 #include "SceneSetup.h"
+#include "SnapshotCodec.h"
+#include "InputCommand.h"
+#include "ServerClock.h"
 
 // RakNet includes
 #include "BitStream.h"
@@ -54,19 +57,25 @@ enum
     ID_SPAWN_WAIT_NEXT_GAME,
 };
 
+// Returned to unconnected pings, so how the server is coping can be watched from outside (see the bot swarm)
 struct SERVER_INFO_DATA
 {
     unsigned int publicSeed;
     int curMap;
+    int players;                    // Clients connected.
+    float ticksPerSecond;           // Ticks simulated over the last second. Below SIMULATION_TICK_RATE the server is falling behind.
+    float tickMicroseconds;         // Average time taken per tick over the last second, including the networking.
+    float peakFrameMicroseconds;    // Longest time taken by one frame's update over the last second.
 };
 
-struct PLAYER_INPUT_DATA
+// Tracks the parts of the snapshot frame currently being received
+struct SNAPSHOT_FRAME_PROGRESS
 {
-    bool frwdPressed;
-    bool backPressed;
-    bool leftPressed;
-    bool rghtPressed;
-    bool hndbPressed;
+    unsigned short sequence;
+    bool           started;
+    bool           valid;           // false if any part of the frame couldn't be decoded
+    int            partsReceived;
+    int            lastPart;        // index of the final part, or -1 if it hasn't arrived yet
 };
 
 struct PLAYER_SYNC_DATA
@@ -91,6 +100,15 @@ private:
 
     static RakNet::TimeMS timeLastUpdate;
 
+    static SnapshotHistory mSnapshotHistory;
+    static unsigned short  lastSnapshotSequence;
+    static bool            bHasSnapshot;
+    static SNAPSHOT_FRAME_PROGRESS snapshotProgress;
+    static unsigned char   latchedButtons;      // Buttons held at any point since the last command was made
+    static InputCommand    recentCommands[INPUT_REDUNDANCY];    // Newest first, resent in every input packet
+    static int             numCommands;
+    static ServerClock     mServerClock;
+
 public:
     NetworkCore();
     ~NetworkCore (void);
@@ -105,6 +123,8 @@ public:
 
     void frameEvent(InputState *inputSnapshot);
     void ProcessPlayerState( RakNet::Packet *pkt );
+    static double getInterpolationTime();
+    static unsigned char makeInputCommand( InputState *inputSnapshot, unsigned int tick );
 
     void sendTeamSelect( TeamID t );
     void sendSpawnRequest( CarType iCarType );
@@ -0,0 +1,47 @@
+/**
+ * @file    ServerClock.h
+ * @brief   Estimates which tick the server is on from the ticks stamped on its snapshots.
+ */
+#ifndef SERVERCLOCK_H
+#define SERVERCLOCK_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SimulationClock.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define SERVER_CLOCK_DRIFT_RATE     0.01    // How quickly the estimate follows snapshots which arrive later than the quickest.
+#define SERVER_CLOCK_RESYNC_MS      250.0   // How far behind the estimate a snapshot must arrive before it is assumed the server stalled.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Keeps the offset between the local clock and the server's tick timeline.
+ *
+ *          Each snapshot is stamped with the tick it was taken on. The quickest a snapshot has ever
+ *          arrived gives the offset, as delays only ever make them late. Later snapshots gradually pull
+ *          the estimate back so it follows drift between the two clocks, but not jitter. If snapshots
+ *          keep arriving far later than expected (the server dropped ticks) the estimate is started again.
+ */
+class ServerClock
+{
+public:
+    ServerClock (void);
+
+    void   sample (unsigned int serverTick);
+    void   reset (void);
+
+    double getServerTime (void) const;
+    double getServerTick (void) const { return getServerTime() / SIMULATION_TICK_MS; }
+
+    /// @brief  Gets whether any snapshots have been sampled.
+    bool   isSynchronised (void) const { return mSynchronised; }
+
+private:
+    double mOffset;             ///< Local time minus server time (ms).
+    bool   mSynchronised;
+    int    mLateSamples;        ///< Consecutive snapshots which arrived more than SERVER_CLOCK_RESYNC_MS late.
+};
+
+#endif // #ifndef SERVERCLOCK_H
@@ -0,0 +1,48 @@
+/**
+ * @file    SnapshotBuffer.h
+ * @brief   A history of the snapshots received for a car, used to draw remote cars slightly in the past
+            so there is always a snapshot either side of the moment being drawn.
+ */
+#ifndef SNAPSHOTBUFFER_H
+#define SNAPSHOTBUFFER_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "CircularBuffer.h"
+#include "CarSnapshot.h"
+#include "SnapshotCodec.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define SNAPSHOT_BUFFER_SIZE       32       // Snapshots kept per car (one less than this can be stored).
+#define INTERPOLATION_DELAY_MS     100.0    // How far behind the latest server frame remote cars are drawn.
+#define EXTRAPOLATION_LIMIT_MS     200.0    // Furthest a car will be carried on past its newest snapshot if packets are late.
+#define INTERPOLATION_SNAP_DISTANCE 10.0f   // Cars which move further than this (metres) between snapshots have respawned, so aren't interpolated.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  A snapshot along with the server time (ms) it was taken at.
+struct TimedCarSnapshot
+{
+    double      time;
+    CarSnapshot snapshot;
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Stores the snapshots of a car in the order they were taken and samples them at any time in
+ *          between. Positions are Hermite interpolated using the velocities at either end, so the car
+ *          follows a smooth curve rather than cornering at each snapshot.
+ */
+class SnapshotBuffer : public CircularBuffer<TimedCarSnapshot>
+{
+public:
+    SnapshotBuffer (uint8_t bs = SNAPSHOT_BUFFER_SIZE);
+
+    void add (double time, const QuantizedCarState &state);
+    bool sample (double time, CarSnapshot &result);
+    void clear (void);
+};
+
+#endif // #ifndef SNAPSHOTBUFFER_H
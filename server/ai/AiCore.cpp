@@ -1,11 +1,31 @@
 
 #include "AiCore.h"
 #include "GameCore.h"
+#include "GetTime.h"
 #include <sstream>
 
 using namespace std;
 using namespace Ogre;
 
+/// @brief  Adds a tick's value to a running average, taken over the first ticks until there are enough.
+static void addToAverage(double &average, double value, int samples)
+{
+	average += (value - average) / samples;
+}
+
+AiCore::AiCore()
+{
+	srand(time(NULL));
+	mTimeSinceLastFrame = 0;
+	mSecondsSinceStart = 0;
+	mTick = 0;
+	mDecisionTicks = AI_DECISION_TICKS;
+	mDecisionBudget = AI_DECISION_BUDGET_US;
+	mDecisionCursor = 0;
+	mStatsTicks = 0;
+	memset(&mStats, 0, sizeof(AiStats));
+}
+
 void AiCore::createNewAiAgent()
 {
 	int flags = 0;
@@ -28,24 +48,122 @@ void AiCore::createNewAiAgent(int flags, level diff)
 
 }
 
+/// @brief  Thinks for one AI player. Run on the task pool.
+void AiCore::thinkTask(void *context, int index)
+{
+	AiCore *aiCore = (AiCore*) context;
+	aiCore->mAiPlayers[index].FindWalls(aiCore->mFeelers);
+	aiCore->mAiPlayers[index].Think(aiCore->mTimeSinceLastFrame, aiCore->mSecondsSinceStart);
+}
+
+/// @brief  Gives AI players their turns to make decisions. Each tick a different bucket of AI players gets
+///         its turn, so each decides once every mDecisionTicks ticks, and any whose target has gone decide
+///         too. Once the tick's budget is spent the rest wait until the next tick, where they go first.
+/// @param  decisions  Set to the number of AI players which decided.
+/// @param  deferred   Set to the number of AI players left waiting.
+void AiCore::decide(int &decisions, int &deferred)
+{
+	int numAgents = (int) mAiPlayers.size();
+	decisions = deferred = 0;
+	if(numAgents == 0)
+		return;
+
+	for(int i = mTick % mDecisionTicks;i < numAgents;i += mDecisionTicks)
+		mAiPlayers[i].requestDecision();
+
+	RakNet::TimeUS startTime = RakNet::GetTimeUS();
+	int firstDeferred = -1;
+	for(int n = 0;n < numAgents;n++)
+	{
+		int i = (mDecisionCursor + n) % numAgents;
+		if(!mAiPlayers[i].isDecisionDue())
+			continue;
+
+		// At least one decision is made each tick, however long it takes, so nobody waits forever.
+		if(decisions > 0 && RakNet::GetTimeUS() - startTime > (RakNet::TimeUS) mDecisionBudget)
+		{
+			if(firstDeferred < 0)
+				firstDeferred = i;
+			deferred++;
+			continue;
+		}
+
+		mAiPlayers[i].Decide();
+		decisions++;
+	}
+
+	if(firstDeferred >= 0)
+		mDecisionCursor = firstDeferred;
+}
+
 void AiCore::frameEvent(double timeSinceLastFrame)
 {
 	//check if the game has started
 	//if(GameCore::mGameplay->mGameActive == false)
 	//	return;
 
+	// Nothing moves while the AI players think, so they all see the same world and can think at
+	// once. What they decide is only carried out afterwards, one at a time, as that changes the cars
+	// and may spawn players.
+	RakNet::TimeUS startTime = RakNet::GetTimeUS();
+	mTimeSinceLastFrame = timeSinceLastFrame;
+	mSecondsSinceStart = (unsigned int) (time(NULL) - GameCore::mGameplay->startTime);
+
+	// Fields leading to the powerups are kept ready for whoever goes for them.
+	mNavPlanner.update();
+	std::vector<Powerup*> powerups = GameCore::mPowerupPool->getPowerups();
+	for(size_t j = 0;j < powerups.size();j++)
+		mNavPlanner.request(BtOgre::Convert::toBullet(powerups[j]->getPosition()));
+
+	// Every AI player's feelers are cast in one batch, so the broadphase is only searched once however
+	// many AI players there are.
 	std::vector<AiPlayer>::iterator i;
+	mFeelers.clear();
+	for(i = mAiPlayers.begin();i != mAiPlayers.end();i++)
+		i->CreateFeelers(mFeelers);
+	GameCore::mPhysicsCore->castRays(mFeelers);
+	RakNet::TimeUS senseTime = RakNet::GetTimeUS();
+
+	// Choosing targets costs more than steering towards them, so only a few AI players do it each tick.
+	int decisions, deferred;
+	decide(decisions, deferred);
+	RakNet::TimeUS decideTime = RakNet::GetTimeUS();
+
+	GameCore::mTaskPool->parallelFor((int) mAiPlayers.size(), &AiCore::thinkTask, this);
+	RakNet::TimeUS thinkTime = RakNet::GetTimeUS();
 
-	//#pragma omp parallel num_threads(2)
-	{
 	for(i = mAiPlayers.begin();i != mAiPlayers.end();i++)
-	{
-		//#pragma omp single nowait
-		{
-		i->Update(timeSinceLastFrame);
-		}
-	}
-	}
+		i->Act(timeSinceLastFrame);
+	RakNet::TimeUS endTime = RakNet::GetTimeUS();
+
+	mTick++;
+	int samples = mStatsTicks < AI_STATS_TICKS ? ++mStatsTicks : AI_STATS_TICKS;
+	double total = (double) (endTime - startTime);
+	mStats.agents = (int) mAiPlayers.size();
+	addToAverage(mStats.decisionsPerTick,   decisions, samples);
+	addToAverage(mStats.deferredPerTick,    deferred, samples);
+	addToAverage(mStats.senseMicroseconds,  (double) (senseTime - startTime), samples);
+	addToAverage(mStats.decideMicroseconds, (double) (decideTime - senseTime), samples);
+	addToAverage(mStats.thinkMicroseconds,  (double) (thinkTime - decideTime), samples);
+	addToAverage(mStats.actMicroseconds,    (double) (endTime - thinkTime), samples);
+	addToAverage(mStats.totalMicroseconds,  total, samples);
+	if(total > mStats.peakMicroseconds)
+		mStats.peakMicroseconds = total;
+}
+
+/// @brief  Builds the navigation grid over a newly loaded arena.
+/// @param  arenaBody  The arena's body, already in the world.
+void AiCore::loadArena(btRigidBody *arenaBody)
+{
+	btVector3 aabbMin, aabbMax;
+	arenaBody->getCollisionShape()->getAabb(arenaBody->getWorldTransform(), aabbMin, aabbMax);
+	mNavPlanner.loadArena(GameCore::mPhysicsCore->getWorld(), aabbMin, aabbMax);
+}
+
+/// @brief  Throws away the navigation grid before its arena is unloaded.
+void AiCore::unloadArena()
+{
+	mNavPlanner.unloadArena();
 }
 
 void AiCore::playerQuit(Player *pPlayer)
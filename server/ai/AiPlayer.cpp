@@ -7,6 +7,7 @@
 #include "AiPlayer.h"
 #include "GameCore.h"
 #include "Gameplay.h"
+#include "RayBatch.h"
 
 //constructor
 AiPlayer::AiPlayer(string name, Ogre::Vector3 startPos, Ogre::SceneManager* sceneManager, int flags, level diff)
@@ -30,8 +31,12 @@ AiPlayer::AiPlayer(string name, Ogre::Vector3 startPos, Ogre::SceneManager* scen
 	mSteeringBehaviour = new SteeringBehaviour(mPlayer);
 	
 	mSteeringBehaviour->WanderOn();
+	mSteeringBehaviour->WallAvoidanceOn();
+	mSteeringBehaviour->ObstacleOn();
 
-	mFeelerDectionLength = 40.0;
+	mFeelerDectionLength = 20.0;
+	mFeelers.resize(FEELER_COUNT);
+	mFirstFeeler = mNumFeelers = 0;
 	direction = turn = 0;
 	targetDistance = 1000000.0;
 
@@ -40,6 +45,8 @@ AiPlayer::AiPlayer(string name, Ogre::Vector3 startPos, Ogre::SceneManager* scen
     oldPosition = Vector3(0.0f);
     stuckMode = 0;
     timeInChangeOver = 0;
+    memset(&mControls, 0, sizeof(AiControls));
+    mDecisionDue = true;
 }
 
 void AiPlayer::Spawn()
@@ -57,15 +64,41 @@ void AiPlayer::Spawn()
 	GameCore::mNetworkCore->PlayerSpawn(&bsCarType, mPacket);
 }
 
-void AiPlayer::CreateFeelers()
+/// @brief  Adds this tick's feelers (one straight ahead, and a shorter one either side) to the batch cast
+///         for every AI player. They reach further the faster the car is going.
+/// @param  batch  The batch to add them to.
+void AiPlayer::CreateFeelers(RayBatch &batch)
 {
-	double range = mFeelerDectionLength + (mPlayer->getCar()->getCarMph()/mPlayer->getCar()->getMaxSpeed()) * mFeelerDectionLength;
-	double theta = mPlayer->getCar()->GetHeading().getYaw().valueRadians();
-	Ogre::Vector3 heading = Ogre::Vector3(cos(theta), 0, sin(theta));
+	mNumFeelers = 0;
+
+	if( mPlayer->getPlayerState() == PLAYER_STATE_TEAM_SEL || mPlayer->getPlayerState() == PLAYER_STATE_SPAWN_SEL )
+		return;
+
+	Car *car = mPlayer->getCar();
+	if( !car || !mPlayer->getAlive() )
+		return;
+
+	//the car's forward axis, flattened onto the ground
+	Ogre::Vector3 heading = GetHeading() * Ogre::Vector3::UNIT_Z;
+	heading.y = 0;
+	if(heading.normalise() < 0.01)
+		return;
+
+	double range = mFeelerDectionLength + (car->getCarMph()/car->getMaxSpeed()) * mFeelerDectionLength;
+	Ogre::Quaternion spread(Ogre::Radian(QuarterPi), Ogre::Vector3::UNIT_Y);
+	Ogre::Vector3 directions[FEELER_COUNT] = { heading, spread * heading, spread.Inverse() * heading };
+	double lengths[FEELER_COUNT] = { range, range/2.0, range/2.0 };
 	Ogre::Vector3 pos = GetPos();
-	mFeelers[0] = pos + range * heading;
-	mFeelers[1] = pos + range/2.0f * heading.crossProduct( heading.perpendicular());
-	mFeelers[2] = pos + range/2.0f * heading.crossProduct(-heading.perpendicular());
+	const btCollisionObject *chassis = car->getVehicle()->getRigidBody();
+
+	mFirstFeeler = batch.getNumRays();
+	for(int i = 0; i < FEELER_COUNT; i++)
+	{
+		Ogre::Vector3 start = pos + directions[i] * FEELER_START;
+		mFeelers[i] = start + directions[i] * lengths[i];
+		batch.add(BtOgre::Convert::toBullet(start), BtOgre::Convert::toBullet(mFeelers[i]), COL_ARENA | COL_CAR, chassis);
+	}
+	mNumFeelers = FEELER_COUNT;
 }
 
 void AiPlayer::isStuck(float timeSinceLastFrame)
@@ -81,25 +114,106 @@ void AiPlayer::isStuck(float timeSinceLastFrame)
 
 }
 
-void AiPlayer::updateStuckDetection()
+/// @param  secondsSinceStart  How long the round has been going, worked out once a tick by AiCore.
+void AiPlayer::updateStuckDetection(unsigned int secondsSinceStart)
 {
     float currentSpeed = mPlayer->getCar()->getCarMph();
-    unsigned int timeSinceStart = (time(NULL) - GameCore::mGameplay->startTime);
 
-    if( currentSpeed < 3.0f && timeSinceStart > 5)
+    if( currentSpeed < 3.0f && secondsSinceStart > 5)
     {
         timeSinceNotableChange++;
     }
 }
 
-void AiPlayer::Update(double timeSinceLastFrame)
+/// @brief  Makes the decisions which cost too much to make every tick (who to chase, and whether to go for
+///         a powerup). AiCore gives each AI player a turn every few ticks, or sooner if Think() finds its
+///         target has gone (see AiCore::frameEvent). Must be called on the main thread.
+void AiPlayer::Decide()
 {
+    mDecisionDue = false;
+
+    if( mPlayer->getPlayerState() == PLAYER_STATE_TEAM_SEL || mPlayer->getPlayerState() == PLAYER_STATE_SPAWN_SEL )
+        return;
+
+    if( GameCore::mGameplay->mGameActive == false )
+        return;
+
+    if( !mPlayer->getCar() || !mPlayer->getAlive() )
+        return;
+
+	//choose who to chase if we aren't chasing anyone
+	if(mSteeringBehaviour->On(seek))
+	{	
+		if(mSteeringBehaviour->GetSeekTarget() == NULL || mSteeringBehaviour->GetSeekTarget()->getAlive() == false)
+		{
+			//get a random player from the nearest few on other teams (or anyone else in free for all)
+			bool enemiesOnly = GameCore::mGameplay->getGameMode() != FFA_MODE;
+			mSteeringBehaviour->SetSeekTarget(GameCore::mPlayerPool->getRandomNearPlayer(mPlayer, enemiesOnly));
+		}
+	}
+
+
+    //REMOVED BY ASH ON 11/05/12, works it seems but not great for gameplay
+    /*
+	//get out health our run away if someone is chasing us
+	if(mPlayer->getHP() < 100 && difficulty >= normal)
+	{
+		//set flee target as closest person on opposite team
+		Player* fleePlayer;
+		fleePlayer = GameCore::mPlayerPool->getClosestPlayer(mPlayer);
+		mSteeringBehaviour->FleeOn();
+		mSteeringBehaviour->SeekOff();
+		mSteeringBehaviour->SetFleeTarget(fleePlayer);
+	}
+    */
+
+	if(difficulty == hard)
+	{
+		if(mSteeringBehaviour->On(flee))
+		{
+			//see if a powerup is nearer to us than flee target
+			Ogre::Vector3 powerupPos = GameCore::mPowerupPool->getNearestPowerUp(GetPos());
+			if(mSteeringBehaviour->GetFleeTarget() && powerupPos.distance(GetPos()) < mSteeringBehaviour->GetFleeTarget()->getCar()->GetPos().distance(GetPos()))
+			{
+				mSteeringBehaviour->PowerupOn();
+				mSteeringBehaviour->SetPowerupTarget(powerupPos);
+			}
+		}
+		else if(mSteeringBehaviour->On(seek))
+		{
+			//see if were in vip mode
+			if(GameCore::mGameplay->getGameMode() == VIP_MODE)
+			{
+				//see if the enemy vip is near
+				Player* enemyVIP = GameCore::mPlayerPool->getEnemyVip(mPlayer->getTeam());
+
+
+			}
+		}
+
+	}
+
+	//ask for a way round the arena to wherever we're heading
+	NavPlanner *planner = GameCore::mAiCore->getNavPlanner();
+	int field = -1;
+	if(mSteeringBehaviour->On(powerup))
+		field = planner->request(BtOgre::Convert::toBullet(mSteeringBehaviour->GetPowerup()));
+	else if(mSteeringBehaviour->On(seek) && mSteeringBehaviour->GetSeekTarget() && mSteeringBehaviour->GetSeekTarget()->getCar())
+		field = planner->request(BtOgre::Convert::toBullet(mSteeringBehaviour->GetSeekTarget()->getCar()->GetPos()));
+	mSteeringBehaviour->SetNavField(field);
+}
+
+/// @brief  Steers and drives towards the target chosen by Decide() for this tick. Only reads the world and
+///         this AI player's own state, so every AI player can think at once (see AiCore::frameEvent). What
+///         it decides is carried out by Act().
+/// @param  timeSinceLastFrame  The length of the tick.
+/// @param  secondsSinceStart   How long the round has been going.
+void AiPlayer::Think(double timeSinceLastFrame, unsigned int secondsSinceStart)
+{
+    memset(&mControls, 0, sizeof(AiControls));
 
     if( mPlayer->getPlayerState() == PLAYER_STATE_TEAM_SEL || mPlayer->getPlayerState() == PLAYER_STATE_SPAWN_SEL )
-    {
-        Spawn();
         return;
-    }
 
     if( GameCore::mGameplay->mGameActive == false )
         return;
@@ -118,24 +232,18 @@ void AiPlayer::Update(double timeSinceLastFrame)
 
 	if(mPlayer->getAlive())
 	{
-		float currentSpeed = mPlayer->getCar()->getCarMph();
-		unsigned int timeSinceStart = (time(NULL) - GameCore::mGameplay->startTime);
-
         if(this->stuckMode == 1)
         {
             // Go Backwards
-            mPlayer->getCar()->accelInputTick(false,true,false,timeSinceLastFrame);
-            mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+            setAccel(false,true,false);
+            setSteer(true, false);
             timeInStuckMode++;
 
-            StringStream tmpSS2;
-            tmpSS2 << "Clamp: " << timeInStuckMode << " " << (TIME_BEFORE_UNSTUCK/timeSinceLastFrame) << "\n";
-            //OutputDebugString(tmpSS2.str().c_str());
             if(timeInStuckMode > (TIME_BEFORE_UNSTUCK/timeSinceLastFrame))
             {
                 this->timeInStuckMode = false;
                 timeInStuckMode = 0;
-                mPlayer->getCar()->accelInputTick(true,false,false,timeSinceLastFrame);
+                setAccel(true,false,false);
 
                 stuckMode = 2;
             }
@@ -153,7 +261,7 @@ void AiPlayer::Update(double timeSinceLastFrame)
         else
         {
             //This is stuck stuff
-            updateStuckDetection(); // Update the stuck detection stuff
+            updateStuckDetection(secondsSinceStart); // Update the stuck detection stuff
             isStuck(timeSinceLastFrame);
         }
         
@@ -181,18 +289,18 @@ void AiPlayer::Update(double timeSinceLastFrame)
 						//if the distance is very close, just break
 						if(pos.distance(tempPos) <= 5.0 && mPlayer->getCar()->getCarMph() > 20.0)
 						{
-							mPlayer->getCar()->accelInputTick(false, false, true, timeSinceLastFrame);
+							setAccel(false, false, true);
 							return;
 						}
 
 						if(pos.distance(tempPos) <= 15.0)
 						{
 							//steer out of the way (random direction) and slow down
-							mPlayer->getCar()->accelInputTick(true, false, false, timeSinceLastFrame);
+							setAccel(true, false, false);
 							if(RandBool())
-								mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+								setSteer(false, true);
 							else
-								mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+								setSteer(true, false);
 							return;
 						}
 					}
@@ -202,67 +310,17 @@ void AiPlayer::Update(double timeSinceLastFrame)
 		}*/
 
 
-		//check if we need to set a target
+		//the target has gone, so a new one is needed now rather than when this AI player's turn to decide comes round
 		if(mSteeringBehaviour->On(seek))
-		{	
-			if(mSteeringBehaviour->GetSeekTarget() == NULL || mSteeringBehaviour->GetSeekTarget()->getAlive() == false)
-			{
-				//get a random player on other team
-				Player* seekPlayer;
-				do{
-					seekPlayer = GameCore::mPlayerPool->getRandomPlayer();
-				}while(mPlayer->getTeam() == seekPlayer->getTeam() && GameCore::mGameplay->getGameMode() != FFA_MODE);
-
-				mSteeringBehaviour->SetSeekTarget(seekPlayer);
-			}
-		}
-
-
-        //REMOVED BY ASH ON 11/05/12, works it seems but not great for gameplay
-        /*
-		//get out health our run away if someone is chasing us
-		if(mPlayer->getHP() < 100 && difficulty >= normal)
-		{
-			//set flee target as closest person on opposite team
-			Player* fleePlayer;
-			fleePlayer = GameCore::mPlayerPool->getClosestPlayer(mPlayer);
-			mSteeringBehaviour->FleeOn();
-			mSteeringBehaviour->SeekOff();
-			mSteeringBehaviour->SetFleeTarget(fleePlayer);
-		}
-        */
-
-		if(difficulty == hard)
 		{
-			if(mSteeringBehaviour->On(flee))
-			{
-				//see if a powerup is nearer to us than flee target
-				Ogre::Vector3 powerupPos = GameCore::mPowerupPool->getNearestPowerUp(GetPos());
-				if(mSteeringBehaviour->GetFleeTarget() && powerupPos.distance(GetPos()) < mSteeringBehaviour->GetFleeTarget()->getCar()->GetPos().distance(GetPos()))
-				{
-					mSteeringBehaviour->PowerupOn();
-					mSteeringBehaviour->SetPowerupTarget(powerupPos);
-				}
-			}
-			else if(mSteeringBehaviour->On(seek))
-			{
-				//see if were in vip mode
-				if(GameCore::mGameplay->getGameMode() == VIP_MODE)
-				{
-					//see if the enemy vip is near
-					Player* enemyVIP = GameCore::mPlayerPool->getEnemyVip(mPlayer->getTeam());
-
-
-				}
-			}
-
+			if(mSteeringBehaviour->GetSeekTarget() == NULL || mSteeringBehaviour->GetSeekTarget()->getAlive() == false)
+				mDecisionDue = true;
 		}
 
-
 		if(distance > 10)
-			mPlayer->getCar()->accelInputTick(true, false, false, timeSinceLastFrame);
+			setAccel(true, false, false);
 		else
-			mPlayer->getCar()->accelInputTick(false, false, false, timeSinceLastFrame);
+			setAccel(false, false, false);
 
 		double angle = sin((pos.x-targetPos.x) / (pos.z - targetPos.z));
 
@@ -276,12 +334,12 @@ void AiPlayer::Update(double timeSinceLastFrame)
 				if(fabs(theta-angle) < 0.03)
 					return;
 				else if(theta > angle)
-					mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+					setSteer(true, false);
 				else
-					mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+					setSteer(false, true);
 			}
 			else
-				mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+				setSteer(false, true);
 
 			return;
 		}
@@ -296,12 +354,12 @@ void AiPlayer::Update(double timeSinceLastFrame)
 				if(fabs(theta-angle) < 0.03)
 					return;
 				else if(theta < angle)
-					mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+					setSteer(true, false);
 				else
-					mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+					setSteer(false, true);
 			}
 			else
-				mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+				setSteer(true, false);
 
 			return;
 
@@ -313,12 +371,12 @@ void AiPlayer::Update(double timeSinceLastFrame)
 				if(fabs(theta - angle) < 0.03)
 					return;
 				else if(angle > theta)
-					mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+					setSteer(true, false);
 				else
-					mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+					setSteer(false, true);
 			}
 			else
-				mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+				setSteer(true, false);
 
 			return;
 
@@ -332,18 +390,55 @@ void AiPlayer::Update(double timeSinceLastFrame)
 			if(fabs(theta-angle) < 0.03)
 				return;
 			else if(angle > theta)
-				mPlayer->getCar()->steerInputTick(true, false, timeSinceLastFrame);
+				setSteer(true, false);
 			else
-				mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+				setSteer(false, true);
 		}
 		else
-			mPlayer->getCar()->steerInputTick(false, true, timeSinceLastFrame);
+			setSteer(false, true);
 	}
     else
     {
-        mPlayer->getCar()->steerInputTick(false, false, timeSinceLastFrame);
-        mPlayer->getCar()->accelInputTick(false, false, false, timeSinceLastFrame);
+        setSteer(false, false);
+        setAccel(false, false, false);
+    }
+}
+
+/// @brief  Carries out what was decided by Think(), or spawns if waiting to. Must be called on the main thread.
+/// @param  timeSinceLastFrame  The length of the tick.
+void AiPlayer::Act(double timeSinceLastFrame)
+{
+    if( mPlayer->getPlayerState() == PLAYER_STATE_TEAM_SEL || mPlayer->getPlayerState() == PLAYER_STATE_SPAWN_SEL )
+    {
+        Spawn();
+        return;
     }
+
+    Car *car = mPlayer->getCar();
+    if( car == NULL )
+        return;
+
+    if( mControls.accel )
+        car->accelInputTick(mControls.forward, mControls.back, mControls.hand, timeSinceLastFrame);
+    if( mControls.steer )
+        car->steerInputTick(mControls.left, mControls.right, timeSinceLastFrame);
+}
+
+/// @brief  Decides on the car's throttle and brakes for this tick.
+void AiPlayer::setAccel(bool isForward, bool isBack, bool isHand)
+{
+    mControls.accel   = true;
+    mControls.forward = isForward;
+    mControls.back    = isBack;
+    mControls.hand    = isHand;
+}
+
+/// @brief  Decides on the car's steering for this tick.
+void AiPlayer::setSteer(bool isLeft, bool isRight)
+{
+    mControls.steer = true;
+    mControls.left  = isLeft;
+    mControls.right = isRight;
 }
 
 Ogre::Vector3 AiPlayer::GetPos()
@@ -356,48 +451,60 @@ Ogre::Quaternion AiPlayer::GetHeading()
 	return mPlayer->getCar()->GetHeading();
 }
 
-/*Ogre::Vector3 AiPlayer::FindWalls()
+/// @brief  Looks at what this AI player's feelers hit (they are cast for every AI player at once, see
+///         AiCore::frameEvent) and hands the nearest wall and the nearest car in the way to the steering behaviour.
+///         Only reads the batch and the world, so can be run alongside the other AI players.
+/// @param  batch  The feelers, after being cast.
+void AiPlayer::FindWalls(const RayBatch &batch)
 {
-	double DistToThisIP    = 0.0;
-	double DistToClosestIP = MaxDouble;
-	Ogre::Vector3 point, ClosestPoint;
-	point = ClosestPoint = Vector3::ZERO;
-	String entName;
-	Entity *wallEnt;
-	SceneNode *feeler = NULL;
-
-	//create the three feelers are cast infront of the vehicle to detect walls
-	CreateFeelers();
-	
-	for(int i = 0; i < mFeelers.size(); i++)
-	{
-		Ogre::Vector3 heading = Vector3::ZERO;
-		heading = (mFeelers[i]+GetPos()).normalisedCopy();
+	FeelerContact wall, obstacle;
+	wall.found = obstacle.found = false;
+	double wallOvershoot = 0.0, obstacleOvershoot = 0.0;
+
+	//the car being chased is driven at, not around
+	const btCollisionObject *target = NULL;
+	Player *seekTarget = mSteeringBehaviour->GetSeekTarget();
+	if(seekTarget && seekTarget->getCar())
+		target = seekTarget->getCar()->getVehicle()->getRigidBody();
 
-		if(mCollision->RaycastFromPoint(mFeelers[i], heading, wall_type, point, entName))
+	for(int i = 0; i < mNumFeelers; i++)
+	{
+		const RayBatchHit &hit = batch.getHit(mFirstFeeler + i);
+		if(hit.object == NULL || hit.object == target)
+			continue;
+
+		//ramps and the floor aren't walls
+		if(fabs(hit.normal.y()) > FEELER_MAX_WALL_SLOPE)
+			continue;
+
+		FeelerContact contact;
+		contact.found  = true;
+		contact.feeler = mFeelers[i];
+		contact.hit    = BtOgre::Convert::toOgre(hit.point);
+		contact.normal = Vector3(hit.normal.x(), 0, hit.normal.z()).normalisedCopy();
+		double overshoot = contact.feeler.distance(contact.hit);
+
+		if(hit.object->getBroadphaseHandle()->m_collisionFilterGroup & COL_ARENA)
 		{
-			DistToThisIP = mFeelers[i].distance(point);
-			
-			if(DistToThisIP < DistToClosestIP)
+			if(overshoot > wallOvershoot)
 			{
-				DistToClosestIP = DistToThisIP;
-
-				if(DistToClosestIP < mFeelerDectionLength)
-				{
-					wallEnt = GameCore::mSceneMgr->getEntity(entName);
-					mWallHitPosition = point;
-					mWallNormal = wallEnt->;
-					mFeelerPos = mFeelers[i];
-				}	
-				
-				ClosestPoint = point;
+				wall = contact;
+				wallOvershoot = overshoot;
 			}
 		}
+		else if(overshoot > obstacleOvershoot)
+		{
+			obstacle = contact;
+			obstacleOvershoot = overshoot;
+		}
 	}
 
-	if(DistToClosestIP  < mFeelerDectionLength)
-		return ClosestPoint;
-	else 
-		return Vector3::ZERO;
-
-}*/
+	mSteeringBehaviour->SetWallContact(wall);
+	mSteeringBehaviour->SetObstacleContact(obstacle);
+	if(wall.found)
+	{
+		mWallHitPosition = wall.hit;
+		mWallNormal      = wall.normal;
+		mFeelerPosition  = wall.feeler;
+	}
+}
@@ -0,0 +1,293 @@
+/**
+ * @file    NavGrid.cpp
+ * @brief   A grid of where cars can drive in the arena, and flow fields across it leading to goals.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "NavGrid.h"
+#include "GameCore.h"
+#include "RayBatch.h"
+#include <queue>
+#include <functional>
+
+
+/*-------------------- STATIC DEFINITIONS --------------------*/
+// The straight directions come first, then the diagonals.
+const int   NavGrid::DIRECTION_X[NUM_DIRECTIONS]      = { 1, -1,  0,  0,  1,  1, -1, -1 };
+const int   NavGrid::DIRECTION_Z[NUM_DIRECTIONS]      = { 0,  0,  1, -1,  1, -1,  1, -1 };
+const float NavGrid::DIRECTION_LENGTH[NUM_DIRECTIONS] = { 1, 1, 1, 1, 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+const int   NavGrid::OPPOSITE[NUM_DIRECTIONS]         = { 1, 0, 3, 2, 7, 6, 5, 4 };
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+NavGrid::NavGrid (void)
+  : mCellSize(NAV_CELL_SIZE),
+    mMinX(0),
+    mMinZ(0),
+    mCellsX(0),
+    mCellsZ(0),
+    mNumDrivable(0)
+{
+}
+
+
+/// @brief  Builds the grid over an arena. The arena must be in the world, and nothing may be stepping it.
+/// @param  world    The world.
+/// @param  aabbMin  The minimum corner of the arena's collision mesh.
+/// @param  aabbMax  The maximum corner.
+void NavGrid::build (btCollisionWorld *world, const btVector3 &aabbMin, const btVector3 &aabbMax)
+{
+    clear();
+
+    mMinX = aabbMin.x();
+    mMinZ = aabbMin.z();
+    mCellSize = NAV_CELL_SIZE;
+    for (;;)
+    {
+        mCellsX = (int) ((aabbMax.x() - aabbMin.x()) / mCellSize) + 1;
+        mCellsZ = (int) ((aabbMax.z() - aabbMin.z()) / mCellSize) + 1;
+        if (mCellsX * mCellsZ <= NAV_MAX_CELLS)
+            break;
+        mCellSize *= 2;
+    }
+
+    // Every cell's ray is cast in one batch, from above the arena to below it.
+    int numCells = mCellsX * mCellsZ;
+    RayBatch batch;
+    for (int cell = 0; cell < numCells; cell++)
+    {
+        btVector3 centre = getCellCentre(cell);
+        batch.add(btVector3(centre.x(), aabbMax.y() + 1, centre.z()), btVector3(centre.x(), aabbMin.y() - 1, centre.z()), COL_ARENA);
+    }
+    batch.cast(world);
+
+    mHeights.resize(numCells);
+    mDrivable.resize(numCells);
+    mNearWall.assign(numCells, 0);
+    for (int cell = 0; cell < numCells; cell++)
+    {
+        const RayBatchHit &hit = batch.getHit(cell);
+        mHeights[cell]  = hit.point.y();
+        mDrivable[cell] = hit.object != NULL && hit.normal.y() >= NAV_MIN_GROUND_NORMAL_Y;
+        if (mDrivable[cell])
+            mNumDrivable++;
+    }
+
+    for (int cell = 0; cell < numCells; cell++)
+    {
+        if (!mDrivable[cell])
+            continue;
+        for (int direction = 0; direction < 4; direction++)
+            if (step(cell, direction) < 0)
+                mNearWall[cell] = 1;
+    }
+}
+
+
+/// @brief  Empties the grid.
+void NavGrid::clear (void)
+{
+    mCellsX = mCellsZ = 0;
+    mNumDrivable = 0;
+    mHeights.clear();
+    mDrivable.clear();
+    mNearWall.clear();
+}
+
+
+/// @brief  Gets the cell a position is over.
+/// @return The cell, or -1 if the position is off the grid.
+int NavGrid::getCell (const btVector3 &position) const
+{
+    int x = (int) floorf((position.x() - mMinX) / mCellSize);
+    int z = (int) floorf((position.z() - mMinZ) / mCellSize);
+    if (x < 0 || x >= mCellsX || z < 0 || z >= mCellsZ)
+        return -1;
+    return z * mCellsX + x;
+}
+
+
+/// @brief  Gets the centre of a cell, on the ground (once the grid has been built).
+btVector3 NavGrid::getCellCentre (int cell) const
+{
+    int x = cell % mCellsX;
+    int z = cell / mCellsX;
+    btScalar y = cell < (int) mHeights.size() ? mHeights[cell] : 0;
+    return btVector3(mMinX + (x + 0.5f) * mCellSize, y, mMinZ + (z + 0.5f) * mCellSize);
+}
+
+
+/// @brief  Gets the cell next to a cell in a direction, whether or not it can be driven to.
+/// @return The cell, or -1 if it would be off the grid.
+int NavGrid::getNeighbour (int cell, int direction) const
+{
+    int x = cell % mCellsX + DIRECTION_X[direction];
+    int z = cell / mCellsX + DIRECTION_Z[direction];
+    if (x < 0 || x >= mCellsX || z < 0 || z >= mCellsZ)
+        return -1;
+    return z * mCellsX + x;
+}
+
+
+/// @brief  Gets the cell a car can drive to from a cell in a direction.
+/// @return The cell, or -1 if a car can't drive that way.
+int NavGrid::step (int cell, int direction) const
+{
+    int neighbour = getNeighbour(cell, direction);
+    if (neighbour < 0 || !mDrivable[cell] || !mDrivable[neighbour])
+        return -1;
+
+    float maxRise = NAV_MAX_STEP * DIRECTION_LENGTH[direction] * (mCellSize / NAV_CELL_SIZE);
+    if (fabsf(mHeights[neighbour] - mHeights[cell]) > maxRise)
+        return -1;
+
+    if (direction >= 4)
+    {
+        int alongX = DIRECTION_X[direction] > 0 ? 0 : 1;
+        int alongZ = DIRECTION_Z[direction] > 0 ? 2 : 3;
+        if (step(cell, alongX) < 0 || step(cell, alongZ) < 0)
+            return -1;
+    }
+
+    return neighbour;
+}
+
+
+/// @brief  Finds the drivable cell nearest a position, looking at the cells in squares around it.
+/// @param  position  The position.
+/// @param  radius    The furthest square to look in (in cells).
+/// @return The cell, or -1 if there were none in range.
+int NavGrid::findDrivableCell (const btVector3 &position, int radius) const
+{
+    int cellX = (int) floorf((position.x() - mMinX) / mCellSize);
+    int cellZ = (int) floorf((position.z() - mMinZ) / mCellSize);
+
+    int best = -1;
+    btScalar bestDistance2 = SIMD_INFINITY;
+    for (int ring = 0; ring <= radius && best < 0; ring++)
+    {
+        for (int z = cellZ - ring; z <= cellZ + ring; z++)
+        {
+            for (int x = cellX - ring; x <= cellX + ring; x++)
+            {
+                if (x != cellX - ring && x != cellX + ring && z != cellZ - ring && z != cellZ + ring)
+                    continue;
+                if (x < 0 || x >= mCellsX || z < 0 || z >= mCellsZ || !mDrivable[z * mCellsX + x])
+                    continue;
+
+                btVector3 offset = getCellCentre(z * mCellsX + x) - position;
+                offset.setY(0);
+                if (offset.length2() < bestDistance2)
+                {
+                    bestDistance2 = offset.length2();
+                    best          = z * mCellsX + x;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+
+/// @brief  Constructor.
+FlowField::FlowField (void) : mGoal(0, 0, 0), mGoalCell(-1)
+{
+}
+
+
+/// @brief  Finds the shortest way to a goal from every cell, spreading out from the goal (Dijkstra's algorithm).
+///         Only reads the grid, so can be run on another thread while the grid isn't being built.
+/// @param  grid  The grid.
+/// @param  goal  Where to lead to.
+void FlowField::compute (const NavGrid &grid, const btVector3 &goal)
+{
+    typedef std::pair<float, int> OpenCell;
+
+    int numCells = grid.getNumCells();
+    mGoal = goal;
+    mDistances.assign(numCells, NAV_UNREACHABLE);
+    mNext.assign(numCells, -1);
+    mGoalCell = numCells > 0 ? grid.findDrivableCell(goal, NAV_GOAL_SEARCH_CELLS) : -1;
+    if (mGoalCell < 0)
+        return;
+
+    std::priority_queue< OpenCell, std::vector<OpenCell>, std::greater<OpenCell> > open;
+    mDistances[mGoalCell] = 0;
+    open.push(OpenCell(0.0f, mGoalCell));
+    while (!open.empty())
+    {
+        OpenCell current = open.top();
+        open.pop();
+        if (current.first > mDistances[current.second])
+            continue;
+
+        // Look at the cells which can be driven from to this one.
+        for (int direction = 0; direction < NavGrid::NUM_DIRECTIONS; direction++)
+        {
+            int from = grid.step(current.second, direction);
+            if (from < 0)
+                continue;
+
+            float cost = NavGrid::DIRECTION_LENGTH[direction] * grid.getCellSize();
+            if (grid.isNearWall(from))
+                cost *= NAV_WALL_COST;
+
+            float distance = current.first + cost;
+            if (distance < mDistances[from])
+            {
+                mDistances[from] = distance;
+                mNext[from]      = (signed char) NavGrid::OPPOSITE[direction];
+                open.push(OpenCell(distance, from));
+            }
+        }
+    }
+}
+
+
+/// @brief  Finds where a car should head for to follow the field to its goal. Only reads the field, so
+///         any number of cars can use it at once.
+/// @param  grid       The grid the field was computed on.
+/// @param  position   Where the car is.
+/// @param  lookahead  How many cells along the way to look. Further smooths the path, but cuts corners.
+/// @param  waypoint   Set to where to head for (the goal itself, if it is within the lookahead).
+/// @return False if there is no way to the goal from the position.
+bool FlowField::getWaypoint (const NavGrid &grid, const btVector3 &position, int lookahead, btVector3 &waypoint) const
+{
+    int cell = grid.getCell(position);
+    if (cell < 0 || mGoalCell < 0 || (int) mNext.size() != grid.getNumCells())
+        return false;
+
+    // A car scraping along a wall may be just off the drivable cells, so it heads back onto the nearest.
+    if (mDistances[cell] == NAV_UNREACHABLE)
+    {
+        float bestDistance = NAV_UNREACHABLE;
+        int   best         = -1;
+        for (int direction = 0; direction < NavGrid::NUM_DIRECTIONS; direction++)
+        {
+            int neighbour = grid.getNeighbour(cell, direction);
+            if (neighbour >= 0 && mDistances[neighbour] < bestDistance)
+            {
+                bestDistance = mDistances[neighbour];
+                best         = neighbour;
+            }
+        }
+        if (best < 0)
+            return false;
+        cell = best;
+        lookahead--;
+    }
+
+    for (int i = 0; i < lookahead && cell != mGoalCell; i++)
+        cell = grid.getNeighbour(cell, mNext[cell]);
+
+    if (cell == mGoalCell)
+        waypoint = mGoal;
+    else
+        waypoint = grid.getCellCentre(cell);
+    waypoint.setY(position.y());
+    return true;
+}
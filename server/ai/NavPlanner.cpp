@@ -0,0 +1,358 @@
+/**
+ * @file    NavPlanner.cpp
+ * @brief   Keeps flow fields leading to where the AI players are heading, computing them in the background.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "NavPlanner.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Gets the square of the distance between two points across the ground, ignoring height.
+static btScalar groundDistance2 (const btVector3 &a, const btVector3 &b)
+{
+    btScalar x = a.x() - b.x();
+    btScalar z = a.z() - b.z();
+    return x * x + z * z;
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor, starting the planner's thread.
+NavPlanner::NavPlanner (void)
+  : mTick(0),
+    mComputed(0),
+    mComputeMicroseconds(0),
+    mBusy(false),
+    mStopping(false),
+    mRunning(false)
+{
+    for (int i = 0; i < NAV_MAX_FIELDS; i++)
+    {
+        mSlots[i].field      = NULL;
+        mSlots[i].goal       = btVector3(0, 0, 0);
+        mSlots[i].pending    = false;
+        mSlots[i].lastUsed   = 0;
+        mSlots[i].generation = 0;
+    }
+
+    // Without the thread, fields are computed one a tick by update() instead.
+    mJobEvent.InitEvent();
+    mRunning = true;
+    if (RakNet::RakThread::Create(&NavPlanner::plannerThread, this) != 0)
+        mRunning = false;
+}
+
+
+/// @brief  Deconstructor, stopping the thread.
+NavPlanner::~NavPlanner (void)
+{
+    unloadArena();
+
+    mStopping = true;
+    while (mRunning)
+    {
+        mJobEvent.SetEvent();
+        RakSleep(1);
+    }
+    mJobEvent.CloseEvent();
+
+    for (size_t i = 0; i < mSpare.size(); i++)
+        delete mSpare[i];
+}
+
+
+/// @brief  Builds the grid over a newly loaded arena. The arena must be in the world, and nothing may be stepping it.
+/// @param  world    The world.
+/// @param  aabbMin  The minimum corner of the arena's collision mesh.
+/// @param  aabbMax  The maximum corner.
+void NavPlanner::loadArena (btCollisionWorld *world, const btVector3 &aabbMin, const btVector3 &aabbMax)
+{
+    unloadArena();
+    mGrid.build(world, aabbMin, aabbMax);
+}
+
+
+/// @brief  Throws away the grid and every field, waiting for the thread to finish with them.
+void NavPlanner::unloadArena (void)
+{
+    finish();
+
+    for (int i = 0; i < NAV_MAX_FIELDS; i++)
+    {
+        if (mSlots[i].field)
+            mSpare.push_back(mSlots[i].field);
+        mSlots[i].field   = NULL;
+        mSlots[i].pending = false;
+        mSlots[i].generation++;
+    }
+
+    mGrid.clear();
+    mComputed            = 0;
+    mComputeMicroseconds = 0;
+}
+
+
+/// @brief  Swaps in the fields the thread has finished. Must be called on the main thread, at the start
+///         of a tick, before any AI player thinks.
+void NavPlanner::update (void)
+{
+    mTick++;
+
+    std::vector<Job> done;
+    mMutex.Lock();
+    done.swap(mDone);
+    mMutex.Unlock();
+
+    std::vector<FlowField*> unused;
+    for (size_t i = 0; i < done.size(); i++)
+    {
+        Slot &slot = mSlots[done[i].slot];
+        if (slot.pending && slot.generation == done[i].generation)
+        {
+            if (slot.field)
+                unused.push_back(slot.field);
+            slot.field   = done[i].field;
+            slot.pending = false;
+        }
+        else
+        {
+            unused.push_back(done[i].field);
+        }
+    }
+
+    if (!unused.empty())
+    {
+        mMutex.Lock();
+        mSpare.insert(mSpare.end(), unused.begin(), unused.end());
+        mMutex.Unlock();
+    }
+
+    // Results are picked up on the next tick, as if the thread had computed them.
+    if (!mRunning)
+    {
+        Job job;
+        bool queued = false;
+        mMutex.Lock();
+        if (!mJobs.empty())
+        {
+            job = mJobs.front();
+            mJobs.pop_front();
+            queued = true;
+        }
+        mMutex.Unlock();
+
+        if (queued)
+        {
+            job.field = takeSpare();
+            job.field->compute(mGrid, job.goal);
+            mComputed++;
+            mDone.push_back(job);
+        }
+    }
+}
+
+
+/// @brief  Finds a field leading to a goal, or starts computing one. Must be called on the main thread.
+/// @param  goal  Where to lead to.
+/// @return The field, to be passed to steer(), or -1 if there's no grid or every field is in use. A new
+///         field won't be ready to steer with for at least a tick.
+int NavPlanner::request (const btVector3 &goal)
+{
+    if (mGrid.getNumCells() == 0)
+        return -1;
+
+    int nearest = -1;
+    btScalar nearestDistance2 = NAV_REUSE_DISTANCE * NAV_REUSE_DISTANCE;
+    int empty  = -1;
+    int oldest = -1;
+    for (int i = 0; i < NAV_MAX_FIELDS; i++)
+    {
+        const Slot &slot = mSlots[i];
+        if (!slot.field && !slot.pending)
+        {
+            if (empty < 0)
+                empty = i;
+            continue;
+        }
+
+        btScalar distance2 = groundDistance2(slot.goal, goal);
+        if (distance2 <= nearestDistance2)
+        {
+            nearest          = i;
+            nearestDistance2 = distance2;
+        }
+
+        // A field still being computed, or already asked for this tick, is never replaced.
+        if (!slot.pending && slot.lastUsed != mTick && (oldest < 0 || slot.lastUsed < mSlots[oldest].lastUsed))
+            oldest = i;
+    }
+
+    if (nearest >= 0)
+    {
+        mSlots[nearest].lastUsed = mTick;
+        return nearest;
+    }
+
+    int replace = empty >= 0 ? empty : oldest;
+    if (replace < 0)
+        return -1;
+
+    Slot &slot      = mSlots[replace];
+    slot.goal       = goal;
+    slot.pending    = true;
+    slot.lastUsed   = mTick;
+    slot.generation++;
+
+    Job job;
+    job.slot       = replace;
+    job.generation = slot.generation;
+    job.goal       = goal;
+    job.field      = NULL;
+    mMutex.Lock();
+    mJobs.push_back(job);
+    mMutex.Unlock();
+    mJobEvent.SetEvent();
+
+    return replace;
+}
+
+
+/// @brief  Finds where a car should head for to get to its goal. Only reads the fields, so any number of
+///         AI players can steer at once, but not while update() or request() are running.
+/// @param  field     The field from request().
+/// @param  position  Where the car is.
+/// @param  goal      Where it is going. This may have moved a little since the field was requested.
+/// @param  waypoint  Set to where to head for.
+/// @return False if the car should drive straight at its goal: it is nearly there, the field isn't ready
+///         (or has since been given to another goal), or there's no way there from where the car is.
+bool NavPlanner::steer (int field, const btVector3 &position, const btVector3 &goal, btVector3 &waypoint) const
+{
+    if (field < 0 || field >= NAV_MAX_FIELDS)
+        return false;
+
+    const FlowField *flow = mSlots[field].field;
+    if (flow == NULL)
+        return false;
+
+    if (groundDistance2(position, goal) < NAV_DIRECT_DISTANCE * NAV_DIRECT_DISTANCE)
+        return false;
+
+    // A moving goal is followed with its old field until it has gone far enough for a new one to be asked for.
+    if (groundDistance2(flow->getGoal(), goal) > 4 * NAV_REUSE_DISTANCE * NAV_REUSE_DISTANCE)
+        return false;
+
+    return flow->getWaypoint(mGrid, position, NAV_LOOKAHEAD_CELLS, waypoint);
+}
+
+
+/// @brief  Gets what the planner has done.
+/// @param  stats  Filled with the stats.
+void NavPlanner::getStats (NavPlannerStats &stats)
+{
+    stats.cells         = mGrid.getNumCells();
+    stats.drivableCells = mGrid.getNumDrivable();
+    stats.fields        = 0;
+    stats.pending       = 0;
+    for (int i = 0; i < NAV_MAX_FIELDS; i++)
+    {
+        if (mSlots[i].field)
+            stats.fields++;
+        if (mSlots[i].pending)
+            stats.pending++;
+    }
+
+    mMutex.Lock();
+    stats.computed            = mComputed;
+    stats.computeMicroseconds = mComputeMicroseconds;
+    mMutex.Unlock();
+}
+
+
+/// @brief  Throws away the jobs still queued and waits for the thread to finish the one it is computing,
+///         so the grid can be changed.
+void NavPlanner::finish (void)
+{
+    for (;;)
+    {
+        mMutex.Lock();
+        mJobs.clear();
+        bool busy = mBusy;
+        mMutex.Unlock();
+
+        if (!busy)
+            break;
+        RakSleep(1);
+    }
+
+    // Anything it finished is for the old grid.
+    mMutex.Lock();
+    for (size_t i = 0; i < mDone.size(); i++)
+        mSpare.push_back(mDone[i].field);
+    mDone.clear();
+    mMutex.Unlock();
+}
+
+
+/// @brief  Takes a field to compute into, reusing an old one if there is one. Must be called with mMutex unlocked.
+FlowField* NavPlanner::takeSpare (void)
+{
+    FlowField *field = NULL;
+    mMutex.Lock();
+    if (!mSpare.empty())
+    {
+        field = mSpare.back();
+        mSpare.pop_back();
+    }
+    mMutex.Unlock();
+
+    return field ? field : new FlowField();
+}
+
+
+/// @brief  The planner's thread, computing fields as they are asked for until the planner is destroyed.
+RAK_THREAD_DECLARATION(NavPlanner::plannerThread)
+{
+    NavPlanner *planner = (NavPlanner*) arguments;
+
+    while (!planner->mStopping)
+    {
+        Job job;
+        bool queued = false;
+        planner->mMutex.Lock();
+        if (!planner->mJobs.empty())
+        {
+            job = planner->mJobs.front();
+            planner->mJobs.pop_front();
+            planner->mBusy = true;
+            queued = true;
+        }
+        planner->mMutex.Unlock();
+
+        if (!queued)
+        {
+            planner->mJobEvent.WaitOnEvent(NAV_IDLE_WAIT_MS);
+            continue;
+        }
+
+        RakNet::TimeUS startTime = RakNet::GetTimeUS();
+        job.field = planner->takeSpare();
+        job.field->compute(planner->mGrid, job.goal);
+        double time = (double) (RakNet::GetTimeUS() - startTime);
+
+        planner->mMutex.Lock();
+        planner->mDone.push_back(job);
+        planner->mComputed++;
+        planner->mComputeMicroseconds += (time - planner->mComputeMicroseconds) / planner->mComputed;
+        planner->mBusy = false;
+        planner->mMutex.Unlock();
+    }
+
+    planner->mRunning = false;
+    return 0;
+}
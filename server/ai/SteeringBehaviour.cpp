@@ -1,6 +1,7 @@
 
 
 #include "SteeringBehaviour.h"
+#include "GameCore.h"
 
 using namespace Ogre;
 using namespace std;
@@ -15,8 +16,8 @@ SteeringBehaviour::SteeringBehaviour(Player* agent) : mAiPlayer(agent)
     mWeightPursuit           = 1.0;
     mWeightEvade             = 0.01;
     mWeightWander            = 0.1;
-    mWeightObstacleAvoidance = 10.0;
-    mWeightWallAvoidance     = 10.0;
+    mWeightObstacleAvoidance = 1.0;
+    mWeightWallAvoidance     = 2.0;
     mWeightSteering          = 200;
     mWanderDistance = 2.0;
     mWanderJitter   = 40.0;
@@ -24,6 +25,9 @@ SteeringBehaviour::SteeringBehaviour(Player* agent) : mAiPlayer(agent)
     mTargetPlayer1 = NULL;
     mTargetPlayer2 = NULL;
     mWanderTarget = Vector3::ZERO;
+    mWall.found     = false;
+    mObstacle.found = false;
+    mNavField = -1;
 }
 
 Vector3 SteeringBehaviour::Calculate(void)
@@ -50,18 +54,6 @@ Vector3 SteeringBehaviour::CalculatePrioritized(void)
 {
 	  Vector3 force = Vector3::ZERO;
 
-	  /*if(On(obstacle_avoidance))
-	  {
-		force = ObstacleAvoidance(mAiPlayer->ObstacleFound()) * mWeightObstacleAvoidance;
-		if(!AccumulateForce(mSteeringForce, force))
-			return mSteeringForce;
-	  }*/
-
-	  /*if(On(wall_avoidance))
-	  {
-		force += WallAvoidance(mAiPlayer->Feeler(), mAiPlayer->WallHitPosition(), mAiPlayer->WallNormal()) * mWeightWallAvoidance;
-	  }*/
-
 	  if(On(flee))
 	  {
           if(GetFleeTarget())
@@ -95,11 +87,28 @@ Vector3 SteeringBehaviour::CalculatePrioritized(void)
 		force += Wander() * mWeightWander;
 	  }
 
+	  //the target is pushed away from anything the feelers ran into, so the car turns before it hits
+	  if(On(obstacle_avoidance) && mObstacle.found)
+	  {
+		force += WallAvoidance(mObstacle.feeler, mObstacle.hit, mObstacle.normal) * mWeightObstacleAvoidance;
+	  }
+
+	  if(On(wall_avoidance) && mWall.found)
+	  {
+		force += WallAvoidance(mWall.feeler, mWall.hit, mWall.normal) * mWeightWallAvoidance;
+	  }
+
 	  return force;
 }
 
 Vector3 SteeringBehaviour::Seek(Vector3 TargetPos)
 {
+	//follow the arena's flow field round anything in the way, until the target is close
+	btVector3 waypoint;
+	btVector3 pos = BtOgre::Convert::toBullet(mAiPlayer->getCar()->GetPos());
+	if(GameCore::mAiCore->getNavPlanner()->steer(mNavField, pos, BtOgre::Convert::toBullet(TargetPos), waypoint))
+		return BtOgre::Convert::toOgre(waypoint);
+
     return TargetPos;
 }
 
@@ -4,17 +4,37 @@
 #include <iostream>
 #include <vector>
 #include "AiPlayer.h"
+#include "RayBatch.h"
+#include "NavPlanner.h"
 
 using namespace Ogre;
 using namespace std;
 
+#define AI_DECISION_TICKS		10		// Every AI player gets a turn to make its decisions once in this many ticks
+#define AI_DECISION_BUDGET_US	500		// Most time spent on decisions in a tick (us). Turns left over wait for the next tick
+#define AI_STATS_TICKS			500		// Ticks the AI's costs are averaged over
+
 enum level;
 class AiPlayer;
 
+/// @brief  What the AI costs per tick, averaged over the last AI_STATS_TICKS ticks.
+struct AiStats
+{
+	int    agents;
+	double decisionsPerTick;	// AI players which made their decisions
+	double deferredPerTick;		// AI players whose decisions waited for the next tick, as the budget had run out
+	double senseMicroseconds;	// Casting every AI player's feelers
+	double decideMicroseconds;
+	double thinkMicroseconds;	// Every AI player thinking, in parallel
+	double actMicroseconds;
+	double totalMicroseconds;
+	double peakMicroseconds;	// Longest a single tick took since resetPeak()
+};
+
 class AiCore
 {
 public:
-	AiCore() { srand(time(NULL)); };
+	AiCore();
 	~AiCore() {};
 	void createNewAiAgent();
 	void createNewAiAgent(int flags, level diff);
@@ -22,11 +42,33 @@ public:
 	void frameEvent(double timeSinceLastFrame);
     void playerQuit(Player *pPlayer);
 	AiPlayer* getPlayer(string name);
+	void setDecisionTicks(int ticks) { mDecisionTicks = ticks > 0 ? ticks : 1; }
+	int getDecisionTicks() { return mDecisionTicks; }
+	void setDecisionBudget(int microseconds) { mDecisionBudget = microseconds; }
+	int getDecisionBudget() { return mDecisionBudget; }
+	const AiStats& getStats() { return mStats; }
+	void resetPeak() { mStats.peakMicroseconds = 0; }
+	void loadArena(btRigidBody *arenaBody);
+	void unloadArena();
+	NavPlanner* getNavPlanner() { return &mNavPlanner; }
 
 
 private:
+	static void thinkTask(void *context, int index);
+	void decide(int &decisions, int &deferred);
+
 	int numAgents;
 	std::vector<AiPlayer> mAiPlayers;
+	RayBatch mFeelers;	// Every AI player's feelers, cast together each tick
+	NavPlanner mNavPlanner;
+	double mTimeSinceLastFrame;
+	unsigned int mSecondsSinceStart;
+	unsigned int mTick;
+	int mDecisionTicks;
+	int mDecisionBudget;
+	int mDecisionCursor;	// Where the next tick's decisions start, so AI players left waiting go first
+	int mStatsTicks;
+	AiStats mStats;
 };
 
 #endif
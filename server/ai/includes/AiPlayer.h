@@ -11,11 +11,15 @@ using namespace Ogre;
 
 class SteeringBehaviour;
 class Player;
+class RayBatch;
 enum CarType;
 
 #define NOTABLE_CHANGE_RATIO 7.0f
 #define TIME_BEFORE_STUCK 3
 #define TIME_BEFORE_UNSTUCK 3
+#define FEELER_COUNT 3
+#define FEELER_START 3.0f			// How far in front of the car the feelers start, so they miss its own doors
+#define FEELER_MAX_WALL_SLOPE 0.7f	// Steepest a surface's normal can point up and still be a wall rather than the ground
 
 enum level
 {
@@ -24,6 +28,14 @@ enum level
 	hard
 };
 
+/// @brief  The controls an AI player has decided on for a tick. They are held back until every AI
+///         player has decided, so deciding never changes anything another AI player can see.
+struct AiControls
+{
+	bool accel, forward, back, hand;	// Whether to call accelInputTick(), and with what.
+	bool steer, left, right;			// Whether to call steerInputTick(), and with what.
+};
+
 class AiPlayer
 {
 public:
@@ -32,7 +44,11 @@ public:
 	~AiPlayer() {};
 
     void Spawn();
-	void Update(double timeSinceLastFrame);
+	void CreateFeelers(RayBatch &batch);
+	void FindWalls(const RayBatch &batch);
+	void Decide();
+	void Think(double timeSinceLastFrame, unsigned int secondsSinceStart);
+	void Act(double timeSinceLastFrame);
 	Vector3 GetFleeTarget() { return mFleeTarget; };
 	Vector3 GetSeekTarget() { return mSeekTarget; };
 	Vector3 GetPos();
@@ -45,6 +61,8 @@ public:
     Vector3 getWallNormal(void)const{return mWallNormal;}
     std::vector<Vector3> getFeelersPosition(void)const{ return mFeelers;}
     SteeringBehaviour* getSteeringBehaviour(){return mSteeringBehaviour;}
+	bool isDecisionDue() const { return mDecisionDue; }
+	void requestDecision() { mDecisionDue = true; }
 
 private:
 	string mName;
@@ -64,17 +82,20 @@ private:
 	CarType mCarType;
 	double mTolerance;
 	std::vector<Vector3> mFeelers;
-	void CreateFeelers();
-    Vector3 FindWalls();
+	int mFirstFeeler, mNumFeelers;	// Where this AI player's feelers are in the batch
 	double mFeelerDectionLength;
 	int turn, direction;
 	double targetDistance;
 	level difficulty;
+	AiControls mControls;
+	bool mDecisionDue;	// Set when Decide() should be called as soon as there is time
+	void setAccel(bool isForward, bool isBack, bool isHand);
+	void setSteer(bool isLeft, bool isRight);
 
 
     //Stuck detection
     void isStuck(float timeSinceLastFrame);
-    void updateStuckDetection();
+    void updateStuckDetection(unsigned int secondsSinceStart);
     Vector3 oldPosition;
     int timeSinceNotableChange; // This is the number of cycles since a notable change in positino
     int stuckMode;//0 = No, 1 = Go back, 2= Go Back to normal
@@ -0,0 +1,104 @@
+/**
+ * @file    NavGrid.h
+ * @brief   A grid of where cars can drive in the arena, and flow fields across it leading to goals.
+ */
+#ifndef NAVGRID_H
+#define NAVGRID_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <vector>
+#include <cfloat>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define NAV_CELL_SIZE           2.0f        // Width of a cell (m). About the width of a car.
+#define NAV_MAX_CELLS           65536       // Most cells the arena is split into. Cells are widened to fit.
+#define NAV_MIN_GROUND_NORMAL_Y 0.7f        // Steepest ground a car can drive up (the up component of its normal).
+#define NAV_MAX_STEP            0.75f       // Most the ground can rise or fall between neighbouring cells and still be driven over (m).
+#define NAV_WALL_COST           3.0f        // How much more a cell beside a wall or drop costs to cross, so paths keep off them.
+#define NAV_GOAL_SEARCH_CELLS   3           // How far from a goal off the drivable cells (e.g. a powerup by a wall) to look for one on them.
+#define NAV_UNREACHABLE         FLT_MAX     // The distance of a cell with no way to the goal.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Splits the ground (x and z) across the arena into cells, finding the height of the ground in
+ *          each by casting a ray straight down through its centre into the arena's collision mesh.
+ *
+ *          A cell can be driven on if the ground there isn't too steep. Cars can drive between
+ *          neighbouring cells if the ground doesn't rise or fall too far between them, so the top of a
+ *          wall (flat, but far above the floor beside it) is never reached. Diagonal moves also need
+ *          both of the cells beside them to be drivable, so paths don't cut the corners of walls.
+ */
+class NavGrid
+{
+public:
+    NavGrid (void);
+
+    void build (btCollisionWorld *world, const btVector3 &aabbMin, const btVector3 &aabbMax);
+    void clear (void);
+
+    int       getCell (const btVector3 &position) const;
+    btVector3 getCellCentre (int cell) const;
+    int       getNeighbour (int cell, int direction) const;
+    int       step (int cell, int direction) const;
+    int       findDrivableCell (const btVector3 &position, int radius) const;
+
+    /// @brief  Gets the number of cells, or 0 if the grid hasn't been built.
+    int  getNumCells (void) const { return (int) mHeights.size(); }
+    /// @brief  Gets the width of the cells, which may be wider than NAV_CELL_SIZE in a large arena.
+    float getCellSize (void) const { return mCellSize; }
+    /// @brief  Gets whether a cell can be driven on at all.
+    bool isDrivable (int cell) const { return mDrivable[cell] != 0; }
+    /// @brief  Gets whether a cell has a wall or a drop beside it.
+    bool isNearWall (int cell) const { return mNearWall[cell] != 0; }
+    /// @brief  Gets the number of cells which can be driven on.
+    int  getNumDrivable (void) const { return mNumDrivable; }
+
+    static const int   NUM_DIRECTIONS = 8;
+    static const int   DIRECTION_X[NUM_DIRECTIONS];
+    static const int   DIRECTION_Z[NUM_DIRECTIONS];
+    static const float DIRECTION_LENGTH[NUM_DIRECTIONS];    ///< In cells.
+    static const int   OPPOSITE[NUM_DIRECTIONS];
+
+private:
+    float                      mCellSize;
+    float                      mMinX;       ///< The corner of the first cell.
+    float                      mMinZ;
+    int                        mCellsX;
+    int                        mCellsZ;
+    int                        mNumDrivable;
+    std::vector<float>         mHeights;    ///< The height of the ground in each cell.
+    std::vector<unsigned char> mDrivable;
+    std::vector<unsigned char> mNearWall;
+};
+
+
+/**
+ *  @brief  The shortest way from every cell of a NavGrid to a goal, found once so any number of cars can
+ *          look up which way to go from wherever they are without searching.
+ */
+class FlowField
+{
+public:
+    FlowField (void);
+
+    void compute (const NavGrid &grid, const btVector3 &goal);
+    bool getWaypoint (const NavGrid &grid, const btVector3 &position, int lookahead, btVector3 &waypoint) const;
+
+    /// @brief  Gets the goal the field was computed for.
+    const btVector3& getGoal (void) const { return mGoal; }
+    /// @brief  Gets whether the goal could be put on the grid. If not, every cell is unreachable.
+    bool  isValid (void) const { return mGoalCell >= 0; }
+    /// @brief  Gets how far it is to the goal from a cell (weighted by NAV_WALL_COST), or NAV_UNREACHABLE.
+    float getDistance (int cell) const { return mDistances[cell]; }
+
+private:
+    btVector3                mGoal;
+    int                      mGoalCell;
+    std::vector<float>       mDistances;
+    std::vector<signed char> mNext;         ///< The direction of the next cell towards the goal, or -1.
+};
+
+#endif // #ifndef NAVGRID_H
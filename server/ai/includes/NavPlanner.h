@@ -0,0 +1,103 @@
+/**
+ * @file    NavPlanner.h
+ * @brief   Keeps flow fields leading to where the AI players are heading, computing them in the background.
+ */
+#ifndef NAVPLANNER_H
+#define NAVPLANNER_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "NavGrid.h"
+#include "RakThread.h"
+#include "SimpleMutex.h"
+#include "SignaledEvent.h"
+#include <deque>
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define NAV_MAX_FIELDS          32          // Flow fields kept at once. The one used longest ago is replaced by a new one.
+#define NAV_REUSE_DISTANCE      6.0f        // A field leading to within this of a goal leads there too (m).
+#define NAV_DIRECT_DISTANCE     12.0f       // Cars this close to their goal drive straight at it (m).
+#define NAV_LOOKAHEAD_CELLS     4           // How far along a field cars look for where to head.
+#define NAV_IDLE_WAIT_MS        50          // How long the thread sleeps before checking for work again, in case a wake up was missed.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  What the NavPlanner has done.
+struct NavPlannerStats
+{
+    int    cells;                   // Cells in the arena's grid.
+    int    drivableCells;
+    int    fields;                  // Fields ready to use.
+    int    pending;                 // Fields waiting to be computed.
+    int    computed;                // Fields computed since the arena was loaded.
+    double computeMicroseconds;     // Average time to compute a field, on the background thread.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Builds a NavGrid over each arena as it is loaded, then keeps flow fields across it leading to
+ *          the goals AI players ask for (powerups and other players).
+ *
+ *          A goal near one already asked for shares its field. A new goal's field is computed on the
+ *          planner's own thread, so a tick never waits for one; until it is ready the AI player drives
+ *          straight at its goal, as it used to. Finished fields are swapped in at the start of a tick by
+ *          update(), so they never change while the AI players are thinking.
+ */
+class NavPlanner
+{
+public:
+    NavPlanner (void);
+    ~NavPlanner (void);
+
+    void loadArena (btCollisionWorld *world, const btVector3 &aabbMin, const btVector3 &aabbMax);
+    void unloadArena (void);
+    void update (void);
+
+    int  request (const btVector3 &goal);
+    bool steer (int field, const btVector3 &position, const btVector3 &goal, btVector3 &waypoint) const;
+
+    void getStats (NavPlannerStats &stats);
+
+private:
+    /// @brief  A field which is ready, or being computed.
+    struct Slot
+    {
+        FlowField   *field;         // NULL until it has been computed.
+        btVector3    goal;          // The goal it is, or will be, leading to.
+        bool         pending;
+        unsigned int lastUsed;      // The tick it was last asked for.
+        unsigned int generation;    // Changed whenever the slot is given a new goal, so late results are thrown away.
+    };
+    /// @brief  A field for the thread to compute, or one it has computed.
+    struct Job
+    {
+        int          slot;
+        unsigned int generation;
+        btVector3    goal;
+        FlowField   *field;
+    };
+
+    void finish (void);
+    FlowField* takeSpare (void);
+    static RAK_THREAD_DECLARATION(plannerThread);
+
+    NavGrid                   mGrid;        ///< Only changed while the thread is idle (see finish()).
+    Slot                      mSlots[NAV_MAX_FIELDS];
+    unsigned int              mTick;
+    int                       mComputed;
+    double                    mComputeMicroseconds;
+
+    std::deque<Job>           mJobs;        ///< Waiting for the thread.
+    std::vector<Job>          mDone;        ///< Computed by the thread, waiting for update().
+    std::vector<FlowField*>   mSpare;       ///< Fields no longer used, to be computed into again.
+    RakNet::SimpleMutex       mMutex;       ///< Guards mJobs, mDone, mSpare, mBusy and the compute stats.
+    RakNet::SignaledEvent     mJobEvent;
+    bool                      mBusy;        ///< The thread is computing a job.
+    volatile bool             mStopping;
+    volatile bool             mRunning;
+};
+
+#endif // #ifndef NAVPLANNER_H
@@ -30,6 +30,15 @@ enum behaviour_type
 	    offset_pursuit     = 0x10000,
 	};
 
+/// @brief  Something one of an AI player's feelers ran into this tick (see AiPlayer::FindWalls).
+struct FeelerContact
+{
+	bool found;
+	Vector3 feeler;		// The end of the feeler.
+	Vector3 hit;		// Where it hit.
+	Vector3 normal;		// The surface there, flattened onto the ground and facing the car.
+};
+
 class SteeringBehaviour
 {
 public:
@@ -42,6 +51,9 @@ public:
 	void SetSeekTarget(Player *agent)   {mSeekTarget = agent;}
 	void SetPowerupTarget(Ogre::Vector3 pos)  {mPowerup = pos;};
 	void SetTarget(const Ogre::Vector3 t){mTarget = t;}
+	void SetWallContact(const FeelerContact &contact)     {mWall = contact;}
+	void SetObstacleContact(const FeelerContact &contact) {mObstacle = contact;}
+	void SetNavField(int field) {mNavField = field;}
 	Player* GetFleeTarget() { return mFleeTarget; }
 	Player* GetSeekTarget() { return mSeekTarget; }
 	Ogre::Vector3 GetPowerup() { return mPowerup;};
@@ -59,8 +71,8 @@ public:
 	void PursuitOff()  {if(On(pursuit)) m_iFlags ^= pursuit;}
 	void EvadeOff()    {if(On(evade))   m_iFlags ^= evade;}
 	void WanderOff()   {if(On(wander))  m_iFlags ^= wander;}
-	void ObstacleOff() {if(On(wander))  m_iFlags ^= obstacle_avoidance;}
-	void WallAvoidanceOff() {if(On(wander))  m_iFlags ^= wall_avoidance;}
+	void ObstacleOff() {if(On(obstacle_avoidance))  m_iFlags ^= obstacle_avoidance;}
+	void WallAvoidanceOff() {if(On(wall_avoidance))  m_iFlags ^= wall_avoidance;}
 	bool isPowerupOn() { return On(powerup);};
 	bool isFleeOn(){return On(flee);}
 	bool isSeekOn(){return On(seek);}
@@ -82,6 +94,9 @@ private:
 	double mWanderDistance;
 	double mWanderJitter;
 	Vector3 mWanderTarget;
+	FeelerContact mWall;
+	FeelerContact mObstacle;
+	int mNavField;	//the NavPlanner field leading to the seek or powerup target, or -1
 	//multipliers to modify effect of each behaviour
 	double mWeightSeek;
 	double mWeightFlee;
@@ -7,9 +7,7 @@
 #include "stdafx.h"
 #include "Player.h"
 #include "GameCore.h"
-#include "SimpleCoupeCar.h"
-#include "TruckCar.h"
-#include "SmallCar.h"
+#include "CarPool.h"
 
 
 
@@ -25,7 +23,9 @@ Player::Player (void)
     mIsVIP(false),
     mTeam(0),
     mCarSnapshot(NULL),
-    newInput(NULL),
+    lastCollisionWith(RakNet::UNASSIGNED_RAKNET_GUID),
+    lastCollisionTime(0),
+    viewTick(-1),
     mCar(NULL),
     roundScore(0)
 {
@@ -38,9 +38,16 @@ Player::Player (void)
 /// @brief   Deconstructor.
 Player::~Player (void)
 {
-	if( mCar )
+    delCar();
+}
+
+
+/// @brief  Gives the player's car back to the CarPool.
+void Player::delCar (void)
+{
+    if( mCar )
     {
-		delete( mCar );
+        GameCore::mPhysicsCore->mCarPool->releaseCar( mCar );
         mCar = NULL;
     }
 }
@@ -58,21 +65,8 @@ void Player::createPlayer (CarType carType, TeamID tid, ArenaID aid)
 
     mCarType = carType;
 
-    switch (carType)
-    {
-    case CAR_BANGER:
-        mCar = (Car*) new SimpleCoupeCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
-        break;
-    case CAR_SMALL:
-        mCar = (Car*) new SmallCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
-        break;
-    case CAR_TRUCK:
-        mCar = (Car*) new TruckCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
-        break;
-    default:
-        throw Ogre::Exception::ERR_INVALIDPARAMS;
-        break;
-    }
+    // A spare car of the same type is reset and moved rather than built again.
+    mCar = GameCore::mPhysicsCore->mCarPool->takeCar(carType, tid, aid);
 	
     mCar->attachCollisionTickCallback(this);
 	//Set HP. More clever damage might be implemented in the future
@@ -144,6 +138,13 @@ void Player::createPlayer (CarType carType, TeamID tid, ArenaID aid)
             break;
     }
 
+    // Remembered so the two cars are kept up to date on each other's screens (see SnapshotFrameBuilder).
+    if( causedByPlayer != NULL && causedByPlayer != this )
+    {
+        lastCollisionWith = causedByPlayer->getPlayerGUID();
+        lastCollisionTime = RakNet::GetTimeMS();
+    }
+
 	if((GameCore::mGameplay->mGameActive && mAlive)) {
 		hp = recalculateDamage();
 		GameCore::mGameplay->notifyDamage(this);
@@ -297,6 +298,7 @@ void Player::killPlayer()
     setPlayerState( PLAYER_STATE_SPECTATE );
 	//GameCore::mNetworkCore->sendPlayerDeath(this);
 
+    mCar->wreck();
     mCar->applyForce(mCar->mBodyNode, Ogre::Vector3(0, 500.0f, 0)); 
 }
 
@@ -11,6 +11,7 @@
 #include "InputState.h"
 #include "Powerup.h"
 #include "RakNetTypes.h"
+#include "InputCommandBuffer.h"
 
 
 /*-------------------- CLASS DEFINITIONS --------------------*/
@@ -46,7 +47,7 @@ public:
     void createPlayer (CarType carType, TeamID tid, ArenaID aid);
     void processControlsFrameEvent (InputState *userInput, Ogre::Real secondsSinceLastFrame, float targetPhysicsFrameRate);
     Car* getCar (void);
-    void delCar() { if( mCar ) { delete mCar; mCar = NULL; } }
+    void delCar();
     //void collisionTickCallback (int damage, Player *causedByPlayer);
 #if _WIN32    
     void collisionTickCallback(Ogre::Vector3 &hitPoint, Ogre::Real damage, unsigned int damageSection, int crashType, Player *causedByPlayer);
@@ -72,7 +73,7 @@ public:
     void setSpawned (void); //Marks the car as spawned
     Ogre::OverlayElement* getOverlayElement (void);
 
-	InputState* newInput;
+	InputCommandBuffer inputCommands;  // Commands received from the client, waiting to be used.
 
 	RakNet::RakNetGUID getPlayerGUID();
 	void setPlayerGUID(RakNet::RakNetGUID playerGUID);
@@ -99,6 +100,9 @@ public:
     void setGameScore( int gs ) { this->gameScore = gs; }
 	void addToGameScore(int amount);
     int lastsenthp;
+    RakNet::RakNetGUID lastCollisionWith;  // The last player this player's car collided with.
+    RakNet::TimeMS     lastCollisionTime;  // When that collision happened.
+    double viewTick;  // The tick (fractional) this player's client is drawing other cars at, or -1 if unknown.
 	bool isReady() { return mSpawned && mCar;}
 
     void cameraLookLeft(void);
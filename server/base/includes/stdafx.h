@@ -8,6 +8,14 @@
 
 #include <string>
 
+// Define COLLISION_DOMAIN_HEADLESS (here or on the compiler command line) to build the dedicated server. This
+// runs the same game loop but never creates a render window, render system, CEGUI or OIS, with the console
+// read from stdin and written to stdout instead. Use this for servers which nobody is sat in front of. The
+// Server project's Headless configuration defines it, building ServerHeadless.exe as a console program,
+// and "Headless server instructions.txt" says how to build it on Linux. It needs neither OIS, CEGUI nor the
+// Ogre samples' SdkTrays, so none of them are included.
+//#define COLLISION_DOMAIN_HEADLESS
+
 // Standard includes (it is unlikely these will need changing)
 #include <OgreCamera.h>
 #include <OgreEntity.h>
@@ -18,22 +26,25 @@
 #include <OgreRenderWindow.h>
 #include <OgreConfigFile.h>
 
-// OIS includes (the OIS libraries handle I/O)
-#include <OISEvents.h>
-#include <OISInputManager.h>
-#include <OISKeyboard.h>
-#include <OISMouse.h>
-
 // Additional includes
 #include "OgrePrerequisites.h"
 #include "OgreCompositorLogic.h"
 #include "OgreCompositorInstance.h"
-#include <SdkTrays.h>
-#include <SdkCameraMan.h>
 
-// CEGUI includes
-#include <CEGUI.h>
-#include <RendererModules/Ogre/CEGUIOgreRenderer.h>
+#ifndef COLLISION_DOMAIN_HEADLESS
+    // OIS includes (the OIS libraries handle I/O)
+    #include <OISEvents.h>
+    #include <OISInputManager.h>
+    #include <OISKeyboard.h>
+    #include <OISMouse.h>
+
+    #include <SdkTrays.h>
+    #include <SdkCameraMan.h>
+
+    // CEGUI includes
+    #include <CEGUI.h>
+    #include <RendererModules/Ogre/CEGUIOgreRenderer.h>
+#endif
 
 #include "BtOgrePG.h"
 #include "BtOgreGP.h"
@@ -41,6 +52,16 @@
 
 #define COLLISION_DOMAIN_SERVER
 
+// Define COLLISION_DOMAIN_BULLET_NO_PROFILE (here or on the compiler command line) only when linking against a
+// Bullet which was itself built with BT_NO_PROFILE. Bullet's profiler isn't thread safe, and whether it is
+// compiled in is decided by how the Bullet libraries were built, which the game can't see from its own
+// headers, so this is what allows ParallelSolver (physics.cfg) to solve on more than one thread.
+//#define COLLISION_DOMAIN_BULLET_NO_PROFILE
+
+#ifdef COLLISION_DOMAIN_HEADLESS
+    #include <OgreDefaultHardwareBufferManager.h>
+#endif
+
 // Windows specific include
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 	#include "BulletCollision\NarrowPhaseCollision\btGjkConvexCast.h"
@@ -1,7 +1,13 @@
 #include "stdafx.h"
 #include "GameGUI.h"
 #include "GameCore.h"
+#include "CarPool.h"
+#include "PhysicsLod.h"
 #include <time.h>
+#ifdef COLLISION_DOMAIN_HEADLESS
+    #include <iostream>
+    #include "RakThread.h"
+#endif
 
 #ifdef _WIN32
 	#define strncasecmp strnicmp
@@ -11,6 +17,54 @@
 
 
 /*-------------------- DEV CONSOLE --------------------*/
+#ifdef COLLISION_DOMAIN_HEADLESS
+/// @brief  Reads lines from stdin until it closes, queueing them for processConsoleInput() on the main thread.
+RAK_THREAD_DECLARATION(consoleReaderThread)
+{
+    GameGUI*    gui = (GameGUI*) arguments;
+    std::string line;
+
+    while (std::getline(std::cin, line))
+    {
+        gui->mConsoleInputMutex.Lock();
+        gui->mConsoleInput.push(line);
+        gui->mConsoleInputMutex.Unlock();
+    }
+
+    return 0;
+}
+
+/// @brief  Starts the thread which reads the console from stdin. stdin is read on its own thread as
+///         there is no portable non-blocking way to read a line from it.
+void GameGUI::setupConsole (void)
+{
+    RakNet::RakThread::Create(&consoleReaderThread, this);
+    outputToConsole("Headless server started, type help for a list of commands.\n");
+}
+
+/// @brief  Executes any commands which have been read from stdin since this was last called.
+void GameGUI::processConsoleInput (void)
+{
+    std::queue<std::string> input;
+
+    // Swap the queue out so the lock isn't held while the commands execute.
+    mConsoleInputMutex.Lock();
+    std::swap(input, mConsoleInput);
+    mConsoleInputMutex.Unlock();
+
+    while (!input.empty())
+    {
+        const char* inputChars = input.front().c_str();
+        if (inputChars[0] != 0)
+        {
+            if (inputChars[0] != '@')
+                outputToConsole("> %s\n", inputChars);
+            executeCommand(inputChars);
+        }
+        input.pop();
+    }
+}
+#else
 void GameGUI::setupConsole (CEGUI::Window* guiWindow)
 {
 	CEGUI::WindowManager& winMgr = CEGUI::WindowManager::getSingleton();
@@ -51,6 +105,23 @@ bool GameGUI::receiveFromConsole (const CEGUI::EventArgs &args)
         outputToConsole("> %s\n", inputChars);
 	inputText->setText("");
 
+    executeCommand(inputChars);
+
+    // Add the input to the history and clear the history position (so you start from the most recent again).
+    consoleHistory.add(inputChars);
+    consoleHistoryLocation = 0xFF;
+
+    // Scroll to the bottom of the pane.
+    scrollConsoleToBottom();
+
+	return true;
+}
+#endif
+
+/// @brief  Parses a line of console input and executes the required action.
+/// @param  inputChars  The line of input, which must not be blank.
+void GameGUI::executeCommand (const char* inputChars)
+{
     // Parse the string and execute the required action
     if ( inputChars[0] == '@' )
     {
@@ -70,9 +141,22 @@ bool GameGUI::receiveFromConsole (const CEGUI::EventArgs &args)
         outputToConsole("spawn easy [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10']  Spawns [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] AI players with easy difficulty.\n");
         outputToConsole("spawn normal [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10']    Spawns [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] AI players with the normal difficulty.\n");
         outputToConsole("spawn hard [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10']    Spawns [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] AI players with the flee hard difficulty.\n");
-        outputToConsole("get server fps  Returns the server's average fps.\n");
+        outputToConsole("get server fps  Returns the server's average fps and tick time.\n");
+        outputToConsole("get ai          Returns what the AI players cost per tick.\n");
+        outputToConsole("ai [font='DejaVuMonoItalic-10']X Y[font='DejaVuMono-10']         AI players decide every [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] ticks, spending at most [font='DejaVuMonoItalic-10']Y[font='DejaVuMono-10']us a tick deciding.\n");
+#ifndef COLLISION_DOMAIN_HEADLESS
         outputToConsole("get gfx fps     Returns the server's graphics fps.\n");
+#endif
         outputToConsole("newround        Forces the next round to start.\n");
+        outputToConsole("bench snapshot [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] Round trips [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] random cars through the snapshot codec.\n");
+        outputToConsole("bench lagcomp [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10']  Times lag compensation history with [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] cars.\n");
+        outputToConsole("bench broadphase [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] Times each broadphase with [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] cars and their debris.\n");
+        outputToConsole("broadphase sap|dbvt Switches the physics world's broadphase.\n");
+        outputToConsole("bench solver [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10']   Times solving [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] cars' pile ups on each number of threads.\n");
+        outputToConsole("debris [font='DejaVuMonoItalic-10']X Y[font='DejaVuMono-10']     Keeps debris for [font='DejaVuMonoItalic-10']X[font='DejaVuMono-10'] seconds, and at most [font='DejaVuMonoItalic-10']Y[font='DejaVuMono-10'] pieces.\n");
+#ifdef COLLISION_DOMAIN_HEADLESS
+        outputToConsole("quit            Shuts the server down.\n");
+#endif
     }
 	else if( !strcasecmp( inputChars,  "prep" ) )
     {
@@ -114,8 +198,36 @@ bool GameGUI::receiveFromConsole (const CEGUI::EventArgs &args)
     }
     else if( !strcasecmp( inputChars, "get server fps" ) )
     {
+        const SERVER_INFO_DATA &info = NetworkCore::getServerInfo();
         outputToConsole("Server's average fps: %.2f.\n", GameCore::mServerGraphics->mAverageFrameRate);
+        outputToConsole("  %.1f ticks per second, %.2fus per tick (peak frame %.2fus).\n",
+            info.ticksPerSecond, info.tickMicroseconds, info.peakFrameMicroseconds);
     }
+    else if( !strcasecmp( inputChars, "get ai" ) )
+    {
+        const AiStats &stats = GameCore::mAiCore->getStats();
+        outputToConsole("AI, %d players: %.2fus per tick (peak %.2fus).\n", stats.agents, stats.totalMicroseconds, stats.peakMicroseconds);
+        outputToConsole("  Feelers %.2fus, deciding %.2fus, thinking %.2fus, acting %.2fus.\n",
+            stats.senseMicroseconds, stats.decideMicroseconds, stats.thinkMicroseconds, stats.actMicroseconds);
+        outputToConsole("  %.2f decisions and %.2f deferred per tick.\n", stats.decisionsPerTick, stats.deferredPerTick);
+        NavPlannerStats nav;
+        GameCore::mAiCore->getNavPlanner()->getStats(nav);
+        outputToConsole("  Navigation: %d of %d cells drivable, %d fields ready, %d pending, %d computed (%.2fus each).\n",
+            nav.drivableCells, nav.cells, nav.fields, nav.pending, nav.computed, nav.computeMicroseconds);
+        GameCore::mAiCore->resetPeak();
+    }
+    else if( !strncasecmp( inputChars, "ai ", 3) )
+    {
+        int ticks, budget;
+        if( sscanf(inputChars+3, "%d %d", &ticks, &budget) == 2 )
+        {
+            GameCore::mAiCore->setDecisionTicks(ticks);
+            GameCore::mAiCore->setDecisionBudget(budget);
+        }
+        outputToConsole("AI players decide every %d ticks, spending at most %dus a tick.\n",
+            GameCore::mAiCore->getDecisionTicks(), GameCore::mAiCore->getDecisionBudget());
+    }
+#ifndef COLLISION_DOMAIN_HEADLESS
     else if( !strcasecmp( inputChars, "get gfx fps" ) )
     {
         outputToConsole("Server's graphics average fps: %.2f.\n", GameCore::mServerGraphics->mWindow->getAverageFPS());
@@ -125,6 +237,12 @@ bool GameGUI::receiveFromConsole (const CEGUI::EventArgs &args)
 		openAdminWindow();
 		outputToConsole("Admin window opened.\n");
 	}
+#else
+    else if( !strcasecmp(inputChars, "quit"))
+    {
+        GameCore::mServerGraphics->shutdown();
+    }
+#endif
     else if( !strcasecmp(inputChars, "powerups"))
     {
         GameCore::mPowerupPool->replaceCurrentPowerups();
@@ -133,19 +251,108 @@ bool GameGUI::receiveFromConsole (const CEGUI::EventArgs &args)
     {
         GameCore::mGameplay->forceRoundEnd();
     }
+    else if( !strncasecmp(inputChars, "bench snapshot", 14) )
+    {
+        int iterations = atoi((inputChars+14));
+        if (iterations <= 0)
+            iterations = 10000;
+
+        SnapshotCodecBenchmark results;
+        SnapshotCodec::benchmark(iterations, results);
+        outputToConsole("Snapshot codec, %d cars:\n", results.iterations);
+        outputToConsole("  Max error: pos %.4fm, rot %.4frad, vel %.4fm/s, ang vel %.4frad/s.\n",
+            results.maxPositionError, results.maxRotationError, results.maxLinearVelError, results.maxAngularVelError);
+        outputToConsole("  Bits per car: %.1f full, %.1f delta, %.1f unchanged (was %d).\n",
+            results.averageFullBits, results.averageDeltaBits, results.averageIdleBits, (int) (sizeof(PLAYER_SYNC_DATA) * 8));
+        outputToConsole("  %.3fus per round trip, %s.\n", results.microsecondsPerSnapshot, results.exact ? "decoded exactly" : "DECODE MISMATCH");
+    }
+    else if( !strncasecmp(inputChars, "bench lagcomp", 13) )
+    {
+        int cars = atoi((inputChars+13));
+        if (cars <= 0)
+            cars = 100;
+
+        TransformHistoryBenchmark results;
+        TransformHistory::benchmark(cars, 10 * SIMULATION_TICK_RATE, results);
+        outputToConsole("Lag compensation, %d cars, %d ticks of history:\n", results.cars, TRANSFORM_HISTORY_TICKS);
+        outputToConsole("  Memory: %.1fKB.\n", results.bytes / 1024.0);
+        outputToConsole("  %.2fus recording per tick, %.3fus per rewound query (%.2f hits).\n",
+            results.recordMicroseconds, results.queryMicroseconds, results.hitsPerQuery);
+        outputToConsole("  %.2fus per tick with every car lagged.\n", results.recordMicroseconds + results.queryMicroseconds * results.cars);
+    }
+    else if( !strncasecmp(inputChars, "bench broadphase", 16) )
+    {
+        int cars = atoi((inputChars+16));
+        if (cars <= 0)
+            cars = 100;
+
+        // The bounds the world used to have, against ones fitted to a ~370m arena, against a dbvt.
+        btVector3 arenaMin(-185, -5, -185), arenaMax(185, 30, 185), worldMin, worldMax;
+        Broadphase::getArenaBounds(arenaMin, arenaMax, worldMin, worldMax);
+        btBroadphaseInterface *broadphases[3] = {
+            new btAxisSweep3(btVector3(-10000, -10000, -10000), btVector3(1000, 1000, 1000)),
+            Broadphase::create(BROADPHASE_SWEEP_AND_PRUNE, worldMin, worldMax),
+            Broadphase::create(BROADPHASE_DBVT, worldMin, worldMax) };
+        const char *names[3] = { "old sweep and prune", "arena sweep and prune", "dbvt" };
+
+        outputToConsole("Broadphase, %d cars and %d pieces of debris:\n", cars, cars * 6);
+        for (int i = 0; i < 3; i++)
+        {
+            BroadphaseBenchmark results;
+            Broadphase::benchmark(broadphases[i], cars, cars * 6, 10 * SIMULATION_TICK_RATE, results);
+            outputToConsole("  %-22s %.2fus per tick, %.1f pairs.\n", names[i], results.updateMicroseconds, results.pairsPerTick);
+            delete broadphases[i];
+        }
+    }
+    else if( !strncasecmp(inputChars, "bench solver", 12) )
+    {
+        int cars = atoi((inputChars+12));
+        if (cars <= 0)
+            cars = 100;
+
+        std::vector<ParallelWorldBenchmark> results;
+        ParallelDynamicsWorld::benchmark(cars, 5 * SIMULATION_TICK_RATE, results);
+        outputToConsole("Solver, %d cars in pile ups of 4 with their doors and debris:\n", cars);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (results[i].threads == 0)
+            {
+                outputToConsole("  ordinary world %.2fus per tick.\n", results[i].tickMicroseconds);
+                continue;
+            }
+            outputToConsole("  %2d thread(s)   %.2fus per tick (x%.2f), %.1f islands, %s (%.4fm).\n",
+                results[i].threads, results[i].tickMicroseconds, results[0].tickMicroseconds / results[i].tickMicroseconds,
+                results[i].islandsPerTick, results[i].maxDivergence == 0 ? "identical" : "DIVERGED", results[i].maxDivergence);
+        }
+        if (!ParallelDynamicsWorld::isAvailable())
+            outputToConsole("  Parallel solving needs COLLISION_DOMAIN_BULLET_NO_PROFILE (see stdafx.h).\n");
+        outputToConsole("  The game's world solves on %d thread(s).\n", GameCore::mPhysicsCore->getSolverThreads());
+    }
+    else if( !strncasecmp(inputChars, "broadphase", 10) )
+    {
+        if( !strcasecmp(inputChars+10, " dbvt") )
+            GameCore::mPhysicsCore->setBroadphase(BROADPHASE_DBVT);
+        else if( !strcasecmp(inputChars+10, " sap") )
+            GameCore::mPhysicsCore->setBroadphase(BROADPHASE_SWEEP_AND_PRUNE);
+        outputToConsole("Broadphase: %s.\n", Broadphase::getName(GameCore::mPhysicsCore->getBroadphaseType()));
+    }
+    else if( !strncasecmp(inputChars, "debris", 6) )
+    {
+        PhysicsLod *lod = GameCore::mPhysicsCore->mPhysicsLod;
+        float lifetime;
+        int budget;
+        if( sscanf(inputChars+6, "%f %d", &lifetime, &budget) == 2 )
+        {
+            lod->setDebrisLifetime(lifetime);
+            lod->setDebrisBudget(budget);
+        }
+        outputToConsole("Debris kept for %.1fs, at most %d pieces (%d now).\n",
+            lod->getDebrisLifetime(), lod->getDebrisBudget(), GameCore::mPhysicsCore->mCarPool->getNumDebris());
+    }
     else
     {
         outputToConsole("Unrecognised command.\n");
     }
-
-    // Add the input to the history and clear the history position (so you start from the most recent again).
-    consoleHistory.add(inputChars);
-    consoleHistoryLocation = 0xFF;
-
-    // Scroll to the bottom of the pane.
-    scrollConsoleToBottom();
-
-	return true;
 }
 
 void GameGUI::outputToConsole (const char* str, ...)
@@ -164,9 +371,14 @@ void GameGUI::outputToConsole (const char* str, ...)
         va_end(ap);
     }
 
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Strip out the CEGUI markup, which means nothing to a terminal.
+    stripMarkup(buffer);
+#else
     // Get the references.
 	CEGUI::WindowManager& winMgr        = CEGUI::WindowManager::getSingleton();
 	CEGUI::DefaultWindow* consoleBuffer = static_cast<CEGUI::DefaultWindow*>(winMgr.getWindow("/Server/buffer"));
+#endif
 
 #ifdef TIMESTAMP_CONSOLE
     // Get the time.
@@ -188,16 +400,53 @@ void GameGUI::outputToConsole (const char* str, ...)
     timeString[12] = 0;
     
     // Output to console
+#ifdef COLLISION_DOMAIN_HEADLESS
+    printf("%s%s", timeString + 1, buffer);     // +1 skips the CEGUI escape character.
+#else
     consoleBuffer->appendText(CEGUI::String(timeString) + CEGUI::String(buffer));
+#endif
+#else
+#ifdef COLLISION_DOMAIN_HEADLESS
+    printf("%s", buffer);
 #else
     consoleBuffer->appendText(CEGUI::String(buffer));
 #endif
+#endif
 
-
+#ifdef COLLISION_DOMAIN_HEADLESS
+    fflush(stdout);
+#else
     // Scroll to the bottom of the console.
     scrollConsoleToBottom();
+#endif
 }
 
+#ifdef COLLISION_DOMAIN_HEADLESS
+/// @brief  Removes any CEGUI markup tags (i.e. [colour='FFFFFFFF'] or [font='DejaVuMono-10']) from the
+///         given string in place.
+/// @param  str  The string to strip.
+void GameGUI::stripMarkup (char* str)
+{
+    char* readPtr  = str;
+    char* writePtr = str;
+
+    while (*readPtr)
+    {
+        if (*readPtr == '[' && (!strncmp(readPtr, "[colour=", 8) || !strncmp(readPtr, "[font=", 6)))
+        {
+            char* tagEnd = strchr(readPtr, ']');
+            if (tagEnd != NULL)
+            {
+                readPtr = tagEnd + 1;
+                continue;
+            }
+        }
+        *(writePtr++) = *(readPtr++);
+    }
+    *writePtr = 0;
+}
+#else
+
 void GameGUI::loadConsoleHistory (bool reverseLoading)
 {
     // Check there is history
@@ -387,4 +636,5 @@ bool GameGUI::adminWindow_btnNudge (const CEGUI::EventArgs &args)
     player->getCar()->moveTo(newpos);
 
     return true;
-}
\ No newline at end of file
+}
+#endif
@@ -20,10 +20,9 @@
 // graphics fps, causing it to run at the same speed as the SERVER_FPS (which can also be unlocked - though note that in this case the 
 // bottle neck is the graphics card and will put a very heavy load on it).
 // 
-// PHYSICS_FPS defines the rate at which the physics updates at.
+// The physics (and everything else which affects the simulation) updates at SIMULATION_TICK_RATE, see SimulationClock.h.
 #define SERVER_FPS 100
 #define GRAPHICS_FPS 30
-#define PHYSICS_FPS 60
 
 
 
@@ -36,7 +35,9 @@ ServerGraphics::ServerGraphics (void) : SceneSetup(),
                                         mCamera(0),
                                         mResourcesCfg(Ogre::StringUtil::BLANK),
                                         mPluginsCfg(Ogre::StringUtil::BLANK),
-                                        mCameraMan(0),
+                                        #ifndef COLLISION_DOMAIN_HEADLESS
+                                            mCameraMan(0),
+                                        #endif
                                         mCursorWasVisible(false),
                                         mShutDown(false)
 {
@@ -44,6 +45,10 @@ ServerGraphics::ServerGraphics (void) : SceneSetup(),
 
 ServerGraphics::~ServerGraphics (void)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    delete mRoot;
+    delete mHardwareBufferManager;
+#else
     // Destroy camera manager.
     if (mCameraMan)
         delete mCameraMan;
@@ -52,6 +57,7 @@ ServerGraphics::~ServerGraphics (void)
     Ogre::WindowEventUtilities::removeWindowEventListener(mWindow, this);
     windowClosed(mWindow);
     delete mRoot;
+#endif
 }
 
 /// @brief  Entry point for the application
@@ -73,12 +79,14 @@ void ServerGraphics::go (void)
     unsigned long usNextStateStep = 0;
     const unsigned long usStateStepSize    = 1000000 / SERVER_FPS;
 #endif
-#if GRAPHICS_FPS > 0
+#if GRAPHICS_FPS > 0 && !defined(COLLISION_DOMAIN_HEADLESS)
     unsigned long usNextGraphicsStep = 0;
     const unsigned long usGraphicsStepSize = 1000000 / GRAPHICS_FPS;
 #endif
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     mRoot->getRenderSystem()->_initRenderTargets();
+#endif
 
     // Run the server at the server FPS, making the assumption that the graphics are both 
     // non-critical and update at a sufficiently lower rate than the state update rate,
@@ -86,7 +94,7 @@ void ServerGraphics::go (void)
 #if SERVER_FPS > 0
     usNextStateStep    = mRoot->getTimer()->getMicroseconds() + usStateStepSize;
 #endif
-#if GRAPHICS_FPS > 0
+#if GRAPHICS_FPS > 0 && !defined(COLLISION_DOMAIN_HEADLESS)
     usNextGraphicsStep = mRoot->getTimer()->getMicroseconds() + usGraphicsStepSize;
 #endif
     while (1)
@@ -115,6 +123,11 @@ void ServerGraphics::go (void)
         // Update the gamestate
         updateState(sTimeSinceLastFrame);
         
+#ifdef COLLISION_DOMAIN_HEADLESS
+        // There is nothing to render, so the only exit condition is being told to shut down.
+        if (mShutDown)
+            break;
+#else
         // Update the graphics, if this state step coincides with a graphics step.
 #if GRAPHICS_FPS > 0
         if (usCurrentFrame > usNextGraphicsStep)
@@ -128,6 +141,7 @@ void ServerGraphics::go (void)
 #if GRAPHICS_FPS > 0
             usNextGraphicsStep += usGraphicsStepSize;
         }
+#endif
 #endif
 
         // Try to sleep for the remaining time.
@@ -157,6 +171,17 @@ bool ServerGraphics::initApplication (void)
 #else
     mPluginsCfg = "plugins.cfg";
 #endif
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // With no render system there is nothing for the plugins to do, so none are loaded. The default (software)
+    // buffer manager stands in for the render system's one so the collision meshes can still be loaded.
+    mRoot = new Ogre::Root("", "", "");
+    mHardwareBufferManager = new Ogre::DefaultHardwareBufferManager();
+    setupResources();
+    GameCore::mSceneMgr = mRoot->createSceneManager(Ogre::ST_GENERIC);
+
+    // The splash screen just reports progress to stdout.
+    SplashScreen splashScreen(mRoot);
+#else
     mRoot = new Ogre::Root(mPluginsCfg, "ogre.cfg", "");
     setupResources();
     
@@ -180,6 +205,7 @@ bool ServerGraphics::initApplication (void)
     splashScreen.draw();
     //Ogre::TextureManager::getSingleton().setDefaultNumMipmaps(5);   // Set default mipmap level
     //loadResources();                    // Load resources
+#endif
 
     GameCore::initialise(this); // Initialise other game elements
     GameCore::load(&splashScreen, 0);
@@ -234,7 +260,9 @@ void ServerGraphics::createCamera (void)
     // Create the camera
     mCamera = GameCore::mSceneMgr->createCamera("PlayerCam");
     mCamera->setNearClipDistance(5);
+#ifndef COLLISION_DOMAIN_HEADLESS
     mCameraMan = new OgreBites::SdkCameraMan(mCamera);   // create a default camera controller
+#endif
 }
 
 void ServerGraphics::createViewports (void)
@@ -293,15 +321,23 @@ void ServerGraphics::createScene (void)
 ///         adds the FPS counter to it.
 void ServerGraphics::setupGUI (void)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Start reading the console from stdin.
+    GameCore::mGui->setupConsole();
+#else
     // Initialise the GUI renderer if it hasn't already been.
     SceneSetup::setupGUI();
 
     // Attach the GUI components
     GameCore::mGui->setupConsole(mGUIWindow);
+#endif
 }
 
 void ServerGraphics::setupUserInput (void)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // There is no window to capture input from.
+#else
     OIS::ParamList     pl;
     size_t             windowHnd = 0;
     std::ostringstream windowHndStr;
@@ -317,10 +353,16 @@ void ServerGraphics::setupUserInput (void)
 
     // Force the mouse clipping area to be recalculated.
     windowResized(mWindow);
+#endif
 }
 
 void ServerGraphics::createFrameListener (void)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // No frames are ever rendered.
+    return;
+#endif
+
     // Listener registration
     Ogre::WindowEventUtilities::addWindowEventListener(mWindow, this);  // Register as a Window listener.
     mRoot->addFrameListener(this);                                      // Register as a Frame listener.
@@ -339,8 +381,10 @@ bool ServerGraphics::frameRenderingQueued (const Ogre::FrameEvent& evt)
     if (mShutDown)
         return false;
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     // Update the GUI.
     CEGUI::System::getSingleton().injectTimePulse(evt.timeSinceLastFrame);
+#endif
     
     return true;
 }
@@ -353,40 +397,64 @@ bool ServerGraphics::frameEnded (const Ogre::FrameEvent& evt)
 
 void ServerGraphics::updateState (const float timeSinceLastFrame)
 {
-    static const float physicsTimeStep = 1.0f / PHYSICS_FPS;
-    
     // Check if the network core is online
     if (!NetworkCore::bConnected)
         return;
+    RakNet::TimeUS startTime = RakNet::GetTimeUS();
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     // Capture the user input
     mUserInput.capture();
+#endif
     
-    // Process the networking. Sends client's input and receives data.
+    // Process the networking. Receives the clients' input, then starts sending them an update, which
+    // carries on across the task pool while the ticks below are simulated.
     GameCore::mNetworkCore->frameEvent();
 
-    // Process the player pool. Perform updates on players.
-    GameCore::mPlayerPool->frameEvent(timeSinceLastFrame);
+    // Run the simulation in whole ticks, so it doesn't depend on the frame rate. Below 20 FPS
+    // (SIMULATION_MAX_TICKS) the simulation falls behind real time.
+    int ticks = GameCore::mSimulationClock->advance(timeSinceLastFrame);
+    for (int i = 0; i < ticks; i++)
+    {
+        GameCore::mSimulationClock->step();
+
+        // Process the player pool. Applies each player's input for this tick.
+        GameCore::mPlayerPool->frameEvent(SIMULATION_TICK_SECONDS);
+
+        // Index where the cars and powerups are, for the AI players to look around.
+        GameCore::mPlayerPool->updateProximity();
+        GameCore::mPowerupPool->updateProximity();
     
-    // Perform updates on AI players.
-    GameCore::mAiCore->frameEvent(timeSinceLastFrame);
+        // Perform updates on AI players. They think in parallel, then act in turn.
+        GameCore::mAiCore->frameEvent(SIMULATION_TICK_SECONDS);
 
-    // Perform update on the powerups (basically manage spawning/deleting).
-    GameCore::mPowerupPool->frameEvent(timeSinceLastFrame);
+        // Perform update on the powerups (basically manage spawning/deleting).
+        GameCore::mPowerupPool->frameEvent(SIMULATION_TICK_SECONDS);
 
-    // There was a giant ass comment here about client interpolation, see r409 and sooner to find it.
-    // Step physics. Minimum of 20 FPS (maxSubsteps=3) before physics becomes wrong.
-    GameCore::mPhysicsCore->stepSimulation(timeSinceLastFrame, 3, physicsTimeStep);
+        // There was a giant ass comment here about client interpolation, see r409 and sooner to find it.
+        GameCore::mPhysicsCore->stepSimulation(SIMULATION_TICK_SECONDS, 1, SIMULATION_TICK_SECONDS);
+
+        // Remember where everyone is, and judge crashes lagged players saw but the physics didn't.
+        GameCore::mPlayerPool->recordHistory(GameCore::mSimulationClock->getTick());
+    }
 
 	// Process info items (Don't worry about the draw comment)
 	// This ensures gameplay events happen
     GameCore::mGameplay->drawInfo();
 
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Execute any commands which have been typed into stdin since the last frame.
+    GameCore::mGui->processConsoleInput();
+#else
 	GameCore::mGui->updatePlayerComboBox();
-    
+#endif
+
+    // Published to anyone pinging the server, such as the bot swarm.
+    GameCore::mNetworkCore->recordUpdate(ticks, RakNet::GetTimeUS() - startTime);
 }
 
 
+#ifndef COLLISION_DOMAIN_HEADLESS
 /// @brief  Called if the window is moved to give the console correct focus again.
 /// @param  rw  The window that has been moved.
 void ServerGraphics::windowMoved (Ogre::RenderWindow* rw)
@@ -434,6 +502,7 @@ void ServerGraphics::windowClosed (Ogre::RenderWindow* rw)
     if (rw == mWindow)
         mUserInput.destroyInputSystem();
 }
+#endif
 
 
 // Main function (entry point).
@@ -441,7 +510,8 @@ void ServerGraphics::windowClosed (Ogre::RenderWindow* rw)
 extern "C" {
 #endif
 
-#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+// The headless server is a console program everywhere, as its console is stdin and stdout.
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32 && !defined(COLLISION_DOMAIN_HEADLESS)
     INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR strCmdLine, INT )
 #else
     int main(int argc, char *argv[])
@@ -455,7 +525,7 @@ extern "C" {
         }
         catch (Ogre::Exception& e)
         {
-#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32 && !defined(COLLISION_DOMAIN_HEADLESS)
             MessageBox( NULL, e.getFullDescription().c_str(), "An exception has occured!", MB_OK | MB_ICONERROR | MB_TASKMODAL);
 #else
             std::cerr << "An exception has occured: " << e.getFullDescription().c_str() << std::endl;
@@ -476,6 +546,10 @@ extern "C" {
 /*------------------------------ SPLASH SCREEN CLASS ------------------------------*/
 SplashScreen::SplashScreen (Ogre::Root* root) : mRoot(root)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    return;
+#endif
+
     // Preload resources (for the splash screen)
     Ogre::ResourceGroupManager::getSingleton().initialiseResourceGroup("ServerSplash");
 
@@ -538,14 +612,22 @@ void SplashScreen::clear (void)
 
 void SplashScreen::updateProgressBar (int percent, const Ogre::DisplayString& text)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    printf("[%3d%%] %s\n", percent, std::string(text).c_str());
+#else
     loadingText->setCaption(text);
     updateProgressBar(percent);
+#endif
 }
 
 void SplashScreen::updateProgressBar (int percent)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    printf("[%3d%%]\n", percent);
+#else
     loadingBar->setDimensions(percent*5, 20);
     forceRedraw();
+#endif
 }
 
 void SplashScreen::forceRedraw (void)
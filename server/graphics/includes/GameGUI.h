@@ -9,9 +9,14 @@
 #include "stdafx.h"
 #include "CircularBuffer.h"
 #include "NetworkCore.h"
-#include "CEGUI.h"
 #include <stdio.h>
 #include <stdarg.h>
+#ifdef COLLISION_DOMAIN_HEADLESS
+    #include <queue>
+    #include "SimpleMutex.h"
+#else
+    #include "CEGUI.h"
+#endif
 
 #define COLLISION_DOMAIN_SERVER
 #define TIMESTAMP_CONSOLE
@@ -55,9 +60,16 @@ public:
     GameGUI (void) : consoleHistory(16), consoleHistoryLocation(0xFF) {}
     ~GameGUI (void) {}
     
+#ifdef COLLISION_DOMAIN_HEADLESS
+	void setupConsole (void);
+    void processConsoleInput (void);
+#else
 	void setupConsole (CEGUI::Window* guiWindow);
+#endif
     void outputToConsole (const char* str, ...);
+    void executeCommand (const char* inputChars);
     
+#ifndef COLLISION_DOMAIN_HEADLESS
     // These two methods are called in ServerGraphics.cpp
 	void updatePlayerComboBox (void);
     void giveConsoleFocus (void);
@@ -72,7 +84,17 @@ private:
     bool adminWindow_btnNudge (const CEGUI::EventArgs &args);
 	void openAdminWindow (void);
 	bool closeAdminWindow (const CEGUI::EventArgs &args);
+#else
+private:
+    void stripMarkup (char* str);
 
+public:
+    // Lines read from stdin by the console reader thread, waiting to be executed on the main thread.
+    std::queue<std::string> mConsoleInput;
+    RakNet::SimpleMutex     mConsoleInputMutex;
+
+private:
+#endif
     StringCircularBuffer consoleHistory;
     uint8_t              consoleHistoryLocation;
 	//CEGUI::Combobox* playerComboBox;
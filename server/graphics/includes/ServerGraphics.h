@@ -8,7 +8,9 @@
 /*-------------------- INCLUDES --------------------*/
 #include "stdafx.h"
 #include "SceneSetup.h"
-#include "Input.h"
+#ifndef COLLISION_DOMAIN_HEADLESS
+    #include "Input.h"
+#endif
 
 #ifdef _WIN32
 #include "Winsock2.h"
@@ -23,7 +25,11 @@ class SceneSetup;
 /**
  *  @brief  Manages the server's graphics (a console).
  */
+#ifdef COLLISION_DOMAIN_HEADLESS
+class ServerGraphics : public Ogre::FrameListener, public Ogre::WindowEventListener, public SceneSetup
+#else
 class ServerGraphics : public Ogre::FrameListener, public Ogre::WindowEventListener, OgreBites::SdkTrayListener, public SceneSetup
+#endif
 {
 public:
     ServerGraphics (void);
@@ -34,7 +40,9 @@ public:
 
     float               mAverageFrameRate;
     Ogre::Camera*       mCamera;
+#ifndef COLLISION_DOMAIN_HEADLESS
 	CEGUI::Window* getGUIWindow() { return mGUIWindow;};
+#endif
 
 #ifdef _WIN32
 	HINSTANCE getHInstance() { return mHInstance;};
@@ -61,11 +69,13 @@ protected:
     virtual bool frameStarted (const Ogre::FrameEvent& evt);
     virtual bool frameEnded (const Ogre::FrameEvent& evt);
     
+#ifndef COLLISION_DOMAIN_HEADLESS
     // Ogre::WindowEventListener overrides.
     virtual void windowMoved (Ogre::RenderWindow* rw);
     virtual void windowFocusChange (Ogre::RenderWindow* rw);
     virtual void windowResized (Ogre::RenderWindow* rw);
     virtual void windowClosed (Ogre::RenderWindow* rw);
+#endif
 
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
     int usleep (long usec)
@@ -83,20 +93,27 @@ protected:
 	HINSTANCE mHInstance;
 #endif
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     // OIS Input device elements
     Input mUserInput;
     
     // GUI Elements
 	CEGUI::Window* mSheet;
     CEGUI::OgreRenderer* mGUIRenderer;
+#endif
 
     // Ogre elements
     Ogre::Root*  mRoot;
     Ogre::String mResourcesCfg;
     Ogre::String mPluginsCfg;
+#ifndef COLLISION_DOMAIN_HEADLESS
     OgreBites::SdkCameraMan* mCameraMan;     // basic camera controller
+#endif
     bool mCursorWasVisible;                  // Was the cursor visible before dialog appeared
     bool mShutDown;
+#ifdef COLLISION_DOMAIN_HEADLESS
+    Ogre::DefaultHardwareBufferManager* mHardwareBufferManager; // Stands in for the render system's buffer manager.
+#endif
 };
 
 class SplashScreen
@@ -0,0 +1,111 @@
+/**
+ * @file    InputCommandBuffer.cpp
+ * @brief   A jitter buffer of the input commands received from one client.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "InputCommandBuffer.h"
+#include "SnapshotCodec.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+InputCommandBuffer::InputCommandBuffer (void)
+{
+    clear();
+}
+
+
+/// @brief  Stores commands from an input packet. Commands which have already been used, or which are
+///         already stored, are ignored.
+/// @param  commands  The commands.
+/// @param  count     The number of commands.
+void InputCommandBuffer::receive (const InputCommand *commands, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        unsigned short tick = commands[i].tick;
+        if (mStarted && SnapshotCodec::sequenceGreaterThan(mNextTick, tick))
+            continue;
+        if (mHasNewest && (unsigned short) (mNewestTick - tick) < 0x8000 && (unsigned short) (mNewestTick - tick) >= INPUT_BUFFER_SIZE)
+            continue;
+
+        int slot = tick & (INPUT_BUFFER_SIZE - 1);
+        mTicks[slot]   = tick;
+        mButtons[slot] = commands[i].buttons;
+        mValid[slot]   = true;
+
+        if (!mHasNewest || SnapshotCodec::sequenceGreaterThan(tick, mNewestTick))
+        {
+            mNewestTick = tick;
+            mHasNewest  = true;
+        }
+    }
+}
+
+
+/// @brief  Gets the command for this physics tick.
+/// @param  buttons  Set to the buttons held.
+/// @return False if no commands have been received yet, in which case buttons is unchanged.
+bool InputCommandBuffer::consume (unsigned char &buttons)
+{
+    if (!mHasNewest)
+        return false;
+
+    if (!mStarted)
+    {
+        mNextTick = mNewestTick - (INPUT_JITTER_TICKS - 1);
+        mStarted  = true;
+    }
+
+    // Skip ahead if too many commands are waiting.
+    unsigned short waiting = mNewestTick - mNextTick;
+    if (waiting < 0x8000 && waiting >= INPUT_MAX_WAITING_TICKS)
+    {
+        mSkipped += waiting - (INPUT_JITTER_TICKS - 1);
+        mNextTick = mNewestTick - (INPUT_JITTER_TICKS - 1);
+    }
+
+    // The client is behind, so hold on to what we have until it catches up.
+    if (SnapshotCodec::sequenceGreaterThan(mNextTick, mNewestTick))
+    {
+        mRepeated++;
+        buttons = mLastButtons;
+        return true;
+    }
+
+    int slot = mNextTick & (INPUT_BUFFER_SIZE - 1);
+    if (mValid[slot] && mTicks[slot] == mNextTick)
+    {
+        mLastButtons = mButtons[slot];
+        mValid[slot] = false;
+    }
+    else
+    {
+        mRepeated++;
+    }
+
+    buttons = mLastButtons;
+    mLastConsumed = mNextTick;
+    mNextTick++;
+    return true;
+}
+
+
+/// @brief  Throws away every command.
+void InputCommandBuffer::clear (void)
+{
+    for (int i = 0; i < INPUT_BUFFER_SIZE; i++)
+        mValid[i] = false;
+
+    mStarted      = false;
+    mHasNewest    = false;
+    mNewestTick   = 0;
+    mNextTick     = 0;
+    mLastButtons  = 0;
+    mLastConsumed = -1;
+    mRepeated     = 0;
+    mSkipped      = 0;
+}
@@ -23,6 +23,13 @@ RakNet::RPC4* NetworkCore::m_RPC;
 bool NetworkCore::bConnected = false;
 RakNet::TimeMS NetworkCore::timeLastUpdate = 0;
 SERVER_INFO_DATA NetworkCore::serverInfo;
+RakNet::TimeMS NetworkCore::timeLastInfo = 0;
+RakNet::TimeUS NetworkCore::infoUpdateTime = 0;
+RakNet::TimeUS NetworkCore::infoPeakTime = 0;
+int NetworkCore::infoTicks = 0;
+SnapshotFrameBuilder NetworkCore::mFrameBuilder;
+TaskGroup NetworkCore::mBroadcastTasks;
+std::vector< std::pair<RakNet::RakNetGUID, unsigned short> > NetworkCore::mPendingAcks;
 
 /// @brief  Constructor, initialising all resources.
 NetworkCore::NetworkCore()
@@ -43,6 +50,10 @@ NetworkCore::NetworkCore()
     log( "Server seed sent: %u", GameCore::uPublicSeed );
     serverInfo.publicSeed = GameCore::uPublicSeed;
     serverInfo.curMap = 0;
+    serverInfo.players = 0;
+    serverInfo.ticksPerSecond = 0;
+    serverInfo.tickMicroseconds = 0;
+    serverInfo.peakFrameMicroseconds = 0;
     m_pRak->SetOfflinePingResponse( (char*)&serverInfo, sizeof( SERVER_INFO_DATA ) );
 }
 
@@ -76,6 +87,7 @@ RakNet::RakPeerInterface* NetworkCore::getRakInterface()
 /// @brief  Deconstructor.
 NetworkCore::~NetworkCore()
 {
+    finishBroadcast();
     m_pRak->Shutdown( 100, 0 );
 	RakNet::RakPeerInterface::DestroyInstance( m_pRak );
 }
@@ -90,14 +102,7 @@ void NetworkCore::frameEvent()
 	if( !bConnected )
 		return;
 
-	RakNet::TimeMS timeNow = RakNet::GetTimeMS();
-	if( RakNet::GreaterThan( timeNow, timeLastUpdate + UPDATE_INTERVAL ) )
-	{
-		BroadcastUpdates();
-		timeLastUpdate = RakNet::GetTimeMS();
-		
-	}
-
+	// Packets are received while the last update may still be going out on the task pool.
 	RakNet::Packet *pkt;
 
 	for( pkt = m_pRak->Receive(); pkt; m_pRak->DeallocatePacket(pkt), pkt=m_pRak->Receive() )
@@ -138,6 +143,44 @@ void NetworkCore::frameEvent()
 				break;
 		}
 	}
+
+	finishBroadcast();
+
+	RakNet::TimeMS timeNow = RakNet::GetTimeMS();
+	if( RakNet::GreaterThan( timeNow, timeLastUpdate + UPDATE_INTERVAL ) )
+	{
+		BroadcastUpdates();
+		timeLastUpdate = RakNet::GetTimeMS();
+	}
+}
+
+/// @brief  Records how long a frame's update took, publishing the totals in the offline ping response
+///         once every SERVER_INFO_INTERVAL.
+/// @param  ticks       The simulation ticks run in the frame.
+/// @param  updateTime  How long the whole update took, in microseconds.
+void NetworkCore::recordUpdate( int ticks, RakNet::TimeUS updateTime )
+{
+	infoTicks += ticks;
+	infoUpdateTime += updateTime;
+	if( updateTime > infoPeakTime )
+		infoPeakTime = updateTime;
+
+	RakNet::TimeMS timeNow = RakNet::GetTimeMS();
+	if( timeLastInfo == 0 )
+		timeLastInfo = timeNow;
+	if( !RakNet::GreaterThan( timeNow, timeLastInfo + SERVER_INFO_INTERVAL ) )
+		return;
+
+	serverInfo.players = m_pRak->NumberOfConnections();
+	serverInfo.ticksPerSecond = infoTicks * 1000.0f / (timeNow - timeLastInfo);
+	serverInfo.tickMicroseconds = infoTicks > 0 ? (float) infoUpdateTime / infoTicks : 0;
+	serverInfo.peakFrameMicroseconds = (float) infoPeakTime;
+	m_pRak->SetOfflinePingResponse( (char*)&serverInfo, sizeof( SERVER_INFO_DATA ) );
+
+	timeLastInfo = timeNow;
+	infoUpdateTime = 0;
+	infoPeakTime = 0;
+	infoTicks = 0;
 }
 
 /// @brief Process a new snapshot of a player's user input
@@ -147,140 +190,130 @@ void NetworkCore::ProcessPlayerState( RakNet::Packet *pkt )
 // UNUSED VARIABLE	unsigned char bHasTime;
 // UNUSED VARIABLE	RakNet::Time timestamp;
 	unsigned char bPacketID;
-	PLAYER_INPUT_DATA playerInput;
+	InputCommand commands[INPUT_REDUNDANCY];
 
 	RakNet::BitStream bitStream( pkt->data, pkt->length, false );
 
 	//bitStream.Read( bHasTime );
 	//bitStream.Read( timestamp );
 	bitStream.Read( bPacketID );
-	bitStream.Read( (char*)&playerInput, sizeof( PLAYER_INPUT_DATA ) );
 
-	// Create a new InputState object from received data
-	InputState *inputState = new InputState( playerInput.frwdPressed, 
-		playerInput.backPressed, playerInput.leftPressed, playerInput.rghtPressed, playerInput.hndbPressed );
-
-	// Delete any old unused input state
-	if( GameCore::mPlayerPool->getPlayer( pkt->guid )->newInput != NULL )
-		delete( GameCore::mPlayerPool->getPlayer( pkt->guid )->newInput );
-
-	// Store the new state in the player's object
-	GameCore::mPlayerPool->getPlayer( pkt->guid )->newInput = inputState;
+	Player *pPlayer = GameCore::mPlayerPool->getPlayer( pkt->guid );
+	if( pPlayer == NULL )
+		return;
 
+	// Each packet carries the client's last few input commands, one per tick. They are buffered
+	// and used one per physics tick, so a lost packet is covered by the ones after it.
+	int numCommands = InputCommandCodec::read( &bitStream, commands );
+	if( numCommands == 0 )
+		return;
+	pPlayer->inputCommands.receive( commands, numCommands );
+
+	// The client acknowledges the latest snapshot frame it has received, which can then be
+	// used as the baseline for the cars which were in it.
+	bool hasAck;
+	unsigned short ackSequence;
+	if( bitStream.Read( hasAck ) && hasAck && bitStream.Read( ackSequence ) )
+		mPendingAcks.push_back( std::make_pair( pkt->guid, ackSequence ) );
+
+	// The tick the client is drawing other cars at, so its crashes can be judged against what it saw
+	bool hasViewTick;
+	unsigned int viewTick;
+	unsigned char viewFraction;
+	if( bitStream.Read( hasViewTick ) && hasViewTick && bitStream.Read( viewTick ) && bitStream.Read( viewFraction ) )
+		pPlayer->viewTick = viewTick + viewFraction / 256.0;
 }
 
 /// @brief Broadcase all player snapshots to connected clients
 void NetworkCore::BroadcastUpdates()
 {
-	// For now, this just sends updates on everyone after a certain time elapse
-	// Once snapshots have timestamps in, only send client x's new position if
-	// client x's position hasn't been sent for n ms.
+	// Every car is quantized once into a new frame. Each client is then sent the cars most relevant
+	// to it, within a fixed budget, so distant cars are updated less often.
+	finishBroadcast();
+	mFrameBuilder.buildFrame();
 
 	Player *sendPlayer;
 	int size = GameCore::mPlayerPool->getNumberOfPlayers();
 
-	// should really package multiple updates into one packet also though
-	// RakNet does tend to do that a bit by itself to stop UDP breaking
-
 	int j = 0;
 	for( j = 0; j < size; j ++ )
 	{
-
 		sendPlayer = GameCore::mPlayerPool->getPlayer( j );
 		if( sendPlayer == NULL )
 			continue;
 
-		if( sendPlayer->getCar() == NULL )
+		// AI players are in the pool too, but there's nobody to send to
+		if( m_pRak->GetConnectionState( sendPlayer->getPlayerGUID() ) != RakNet::IS_CONNECTED )
 			continue;
 
-		RakNet::BitStream bitSend;
-		unsigned char packetid = ID_PLAYER_SNAPSHOT;
-		RakNet::Time curTime = RakNet::GetTime();
-
-		bitSend.Write( packetid );
-		bitSend.Write( GameCore::mPlayerPool->getPlayerGUID( j ) );
-		
-		PLAYER_SYNC_DATA playerState;
-		CarSnapshot *playerSnap = sendPlayer->getCar()->getCarSnapshot();
+		mFrameBuilder.addTarget( sendPlayer );
+	}
 
-		playerState.timestamp = curTime;
-		playerState.playerid = GameCore::mPlayerPool->getPlayerGUID( j );	
-		playerState.vPosition = playerSnap->mPosition;
-		playerState.fWheelPos = playerSnap->mWheelPosition;
-		playerState.qRotation = playerSnap->mRotation;
-		playerState.vAngVel = playerSnap->mAngularVelocity;
-		playerState.vLinVel = playerSnap->mLinearVelocity;
+	// The frame has everything it needs from the players, so it is serialized and sent on the task
+	// pool while the next ticks are simulated. Without any workers it may as well be done now.
+	GameCore::mTaskPool->submit( mBroadcastTasks, &NetworkCore::broadcastTask, NULL );
+	if( GameCore::mTaskPool->getNumThreads() == 0 )
+		finishBroadcast();
 
-		bitSend.Write( (char*)&playerState, sizeof( PLAYER_SYNC_DATA ) );
+	// Everyone has now been sent any changes in health, so send the damage updates
+	for( j = 0; j < size; j ++ )
+	{
+		sendPlayer = GameCore::mPlayerPool->getPlayer( j );
+		if( sendPlayer == NULL || sendPlayer->getCar() == NULL )
+			continue;
 
         if( sendPlayer->lastsenthp != sendPlayer->getHP() )
         {
-            bitSend.Write( true );
-            bitSend.Write( sendPlayer->getHP() );
             sendPlayer->lastsenthp = sendPlayer->getHP();
             RakNet::BitStream bitDmgUpdate;
             bitDmgUpdate.Write( (unsigned char) ID_PLAYER_DAMAGE );
             bitDmgUpdate.Write( (char*)&(sendPlayer->damageLoc), sizeof( PLAYER_DAMAGE_LOC ) );
             m_pRak->Send( &bitDmgUpdate, HIGH_PRIORITY, RELIABLE_ORDERED, 0, sendPlayer->getPlayerGUID(), false );
         }
-        else
-        {
-            bitSend.Write( false );
-        }
-        bitSend.Write( true );
-		m_pRak->Send( &bitSend, HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, m_pRak->GetMyGUID(), true );
-
-		delete( playerSnap );
 	}
 }
 
-/// @brief	Send an update of the entire gamestate to a particular player
-///			Includes all player positions, any other important stuff in the future
-///			Might not actually be needed..
-/// @params	playerid  unique GUID of player to update
-void NetworkCore::GamestateUpdatePlayer( RakNet::RakNetGUID playerid )
+/// @brief  Serializes the frame for every client and sends it. Run on the task pool.
+void NetworkCore::broadcastTask( void *context, int index )
 {
-	Player *sendPlayer;
-	int size = GameCore::mPlayerPool->getNumberOfPlayers();
+	mFrameBuilder.serialize( GameCore::mTaskPool );
 
-	for( int j = 0; j < size; j ++ )
+	for( int i = 0; i < mFrameBuilder.getNumTargets(); i ++ )
 	{
-		sendPlayer = GameCore::mPlayerPool->getPlayer( j );
-		if( sendPlayer == NULL )
-			continue;
-
-		if( sendPlayer->getCar() == NULL )
-			continue;
-
-		RakNet::BitStream bitSend;
-		unsigned char packetid = ID_PLAYER_SNAPSHOT;
-		RakNet::Time curTime = RakNet::GetTime();
-
-		bitSend.Write( packetid );
-		bitSend.Write( GameCore::mPlayerPool->getPlayerGUID( j ) );
-		
-		PLAYER_SYNC_DATA playerState;
-		CarSnapshot *playerSnap = sendPlayer->getCar()->getCarSnapshot();
-
-		playerState.timestamp = curTime;
-		playerState.playerid = GameCore::mPlayerPool->getPlayerGUID( j );		
-		playerState.fWheelPos = playerSnap->mWheelPosition;
-		playerState.qRotation = playerSnap->mRotation;
-		playerState.vAngVel = playerSnap->mAngularVelocity;
-		playerState.vLinVel = playerSnap->mLinearVelocity;
+		const std::vector<RakNet::BitStream*> &packets = mFrameBuilder.getTargetPackets( i );
+		for( unsigned int k = 0; k < packets.size(); k ++ )
+			m_pRak->Send( packets[k], HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, mFrameBuilder.getTargetGUID( i ), false );
+	}
+}
 
-		bitSend.Write( (char*)&playerState, sizeof( PLAYER_SYNC_DATA ) );
+/// @brief  Waits for the update being sent on the task pool, then applies the acknowledgements which
+///         arrived meanwhile. Must be called before anything else uses mFrameBuilder.
+void NetworkCore::finishBroadcast()
+{
+	if( GameCore::mTaskPool == NULL )
+		return;
 
-        bitSend.Write( true );
-        bitSend.Write( sendPlayer->getHP() );
-        sendPlayer->lastsenthp = sendPlayer->getHP();
+	GameCore::mTaskPool->wait( mBroadcastTasks );
 
-        bitSend.Write( sendPlayer->getAlive() );
+	for( unsigned int i = 0; i < mPendingAcks.size(); i ++ )
+		mFrameBuilder.acknowledge( mPendingAcks[i].first, mPendingAcks[i].second );
+	mPendingAcks.clear();
+}
 
-		m_pRak->Send( &bitSend, HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, playerid, false );
+/// @brief	Send an update of the entire gamestate to a particular player
+///			Includes all player positions, any other important stuff in the future
+///			Might not actually be needed..
+/// @params	playerid  unique GUID of player to update
+void NetworkCore::GamestateUpdatePlayer( RakNet::RakNetGUID playerid )
+{
+	Player *pPlayer = GameCore::mPlayerPool->getPlayer( playerid );
+	if( pPlayer == NULL )
+		return;
 
-		delete( playerSnap );
-	}
+	finishBroadcast();
+	const std::vector<RakNet::BitStream*> &packets = mFrameBuilder.getPackets( pPlayer, true );
+	for( unsigned int k = 0; k < packets.size(); k ++ )
+		m_pRak->Send( packets[k], HIGH_PRIORITY, UNRELIABLE_SEQUENCED, 0, playerid, false );
 }
 
 /// @brief	Set up the game for a particular player. Sends PlayerJoin for each 
@@ -344,6 +377,9 @@ void NetworkCore::HandlePlayerQuit( RakNet::RakNetGUID playerid, unsigned char r
     if( pPlayer )
         GameCore::mGui->outputToConsole( "Player '%s' disconnected.\n", pPlayer->getNickname() );
 
+    finishBroadcast();
+    mFrameBuilder.removePlayer( playerid );
+
     if( GameCore::mPlayerPool->delPlayer( playerid ) == false )
         return;
 
@@ -396,6 +432,7 @@ void NetworkCore::PlayerJoin( RakNet::BitStream *bitStream, RakNet::Packet *pkt
     bsSend.Write( GameCore::mGameplay->getGameMode() );
     bsSend.Write( GameCore::mGameplay->getArenaID() );
 	RakNet::StringCompressor().EncodeString( szNickname, 128, &bsSend );
+	SnapshotCodec::writeArenaBounds( &bsSend );
 	m_RPC->Signal( "GameJoin", &bsSend, HIGH_PRIORITY, RELIABLE_ORDERED, 0, pkt->guid, false, false );
 
 	SetupGameForPlayer( pkt->guid );
@@ -679,11 +716,13 @@ void NetworkCore::sendSyncScores()
     m_RPC->Signal( "SyncScores", &bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, m_pRak->GetMyGUID(), true, false);
 }
 
-void NetworkCore::sendGameSync( GameMode gameMode, ArenaID arenaID )
+void NetworkCore::sendGameSync( GameMode gameMode, ArenaID arenaID, ArenaID nextArenaID )
 {
     RakNet::BitStream bs;
     bs.Write(gameMode);
     bs.Write(arenaID);
+    bs.Write(nextArenaID);
+    SnapshotCodec::writeArenaBounds(&bs);
     m_RPC->Signal( "GameSync", &bs, HIGH_PRIORITY, RELIABLE_ORDERED, 0, m_pRak->GetMyGUID(), true, false);
 }
 
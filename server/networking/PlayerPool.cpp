@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "PlayerPool.h"
 #include "GameCore.h"
+#include "CarPool.h"
 #include <limits>
 
 PlayerPool::PlayerPool() : mLocalPlayer(0)
@@ -49,6 +50,7 @@ bool PlayerPool::delPlayer( RakNet::RakNetGUID playerid )
         }
 
         delete pPlayer;
+        updateProximity();
         return true;
     }
     return false;
@@ -74,29 +76,66 @@ Player* PlayerPool::getRandomPlayer()
 	return mPlayers[i];
 }
 
+/// @brief Gets the nearest player on another team, as of the start of the tick.
+/// @param player  The player to search around. Must have a car.
+/// @return The nearest player, or NULL if there are none.
 Player* PlayerPool::getClosestPlayer(Player* player)
 {
-	double minDist = numeric_limits<double>::infinity(), dist;
-	Player* closest = NULL;
-	for(std::vector<Player*>::iterator it = mPlayers.begin();it != mPlayers.end();it++)
-	{
-		//closet player will be ourselves, therefore ignore
-		if(player->getTeam() == (*it)->getTeam())
-			continue;
+	if( !player->isReady() )
+		return NULL;
+
+	int slot = player->getCar()->getTransformSlot();
+	int nearest;
+	const btVector3 &pos = GameCore::mPhysicsCore->mTransformStore->getPosition( slot );
+	if( mCarGrid.queryNearest( pos, 1, &nearest, PROXIMITY_OTHER_TEAMS, player->getTeam(), slot ) == 0 )
+		return NULL;
 
-		if((*it)->isReady())
-			dist = (player->getCar()->GetPos()).distance((*it)->getCar()->GetPos());
-		else
+	return getPlayerInSlot( nearest );
+}
+
+/// @brief Picks a player at random from the few nearest to another, as of the start of the tick.
+///        Safe to call from AI players thinking on the task pool.
+/// @param player       The player to search around.
+/// @param enemiesOnly  Whether to only pick players on other teams (otherwise anyone but the player).
+/// @return The player picked, or NULL if there are none (or the player has no car).
+Player* PlayerPool::getRandomNearPlayer(Player* player, bool enemiesOnly)
+{
+	if( !player->isReady() )
+		return NULL;
+
+	int slot = player->getCar()->getTransformSlot();
+	int nearest[PLAYER_POOL_NEAR_CANDIDATES];
+	const btVector3 &pos = GameCore::mPhysicsCore->mTransformStore->getPosition( slot );
+	int found = mCarGrid.queryNearest( pos, PLAYER_POOL_NEAR_CANDIDATES, nearest,
+		enemiesOnly ? PROXIMITY_OTHER_TEAMS : PROXIMITY_ANY_TEAM, player->getTeam(), slot );
+	if( found == 0 )
+		return NULL;
+
+	return getPlayerInSlot( nearest[rand() % found] );
+}
+
+/// @brief Indexes where every car is for this tick's proximity queries. Called at the start of each tick,
+///        before the AI thinks, and whenever a player leaves.
+void PlayerPool::updateProximity()
+{
+	TransformStore *store = GameCore::mPhysicsCore->mTransformStore;
+	mSlotPlayers.assign( store->getCapacity(), NULL );
+	mVips.clear();
+	mCarGrid.clear();
+
+	for( size_t i = 0; i < mPlayers.size(); i++ )
+	{
+		if( mPlayers[i]->getVIP() )
+			mVips.push_back( mPlayers[i] );
+		if( !mPlayers[i]->isReady() )
 			continue;
 
-		if(dist < minDist)
-		{
-			minDist = dist;
-			closest = (Player*)(*it);
-		}
+		int slot = mPlayers[i]->getCar()->getTransformSlot();
+		mCarGrid.add( store->getPosition( slot ), mPlayers[i]->getTeam(), slot );
+		mSlotPlayers[slot] = mPlayers[i];
 	}
 
-	return closest;
+	mCarGrid.build();
 }
 
 bool PlayerPool::cmpRound(Player* a, Player* b)
@@ -165,16 +204,40 @@ Player* PlayerPool::getPlayer( const char* nickname)
 	return NULL;
 }
 
+/// @brief Called once per simulation tick. Applies each player's input command for the tick.
 void PlayerPool::frameEvent( const float timeSinceLastFrame )
 {
 	for( int i = 0; i < GameCore::mPlayerPool->getNumberOfPlayers(); i ++ )
 	{
 		if( mPlayers[i] == NULL )
 			return;
-		if( mPlayers[i]->newInput != NULL )
-			mPlayers[i]->processControlsFrameEvent( mPlayers[i]->newInput, timeSinceLastFrame, (1.0f / 60.0f));
+
+		unsigned char buttons;
+		if( !mPlayers[i]->inputCommands.consume( buttons ) )
+			continue;
+
+		InputState input = InputCommandCodec::toInputState( buttons );
+		mPlayers[i]->processControlsFrameEvent( &input, timeSinceLastFrame, SIMULATION_TICK_SECONDS );
+	}
+
+}
+
+/// @brief Called after each tick's physics step. Remembers where every car is for lag compensation,
+///        then lets lagged players hit cars where they saw them.
+/// @param tick  The tick just simulated.
+void PlayerPool::recordHistory( unsigned int tick )
+{
+	TransformHistory *history = GameCore::mPhysicsCore->mTransformHistory;
+
+	history->beginTick( tick );
+	for( int i = 0; i < GameCore::mPlayerPool->getNumberOfPlayers(); i ++ )
+	{
+		Car *pCar = mPlayers[i]->getCar();
+		if( pCar != NULL )
+			history->record( pCar->getTransformSlot(), mPlayers[i], pCar->getVehicle()->getRigidBody() );
 	}
 
+	GameCore::mPhysicsCore->mPlayerCollisions->addRewoundCollisions( history, tick );
 }
 
 void PlayerPool::roundEnd()
@@ -188,15 +251,19 @@ void PlayerPool::roundEnd()
         // Just want this for game end
         mPlayers[i]->setPlayerState( PLAYER_STATE_SPAWN_SEL );
 	}
+
+    // Every car is gone, so the parts which fell off them can go too.
+    GameCore::mPhysicsCore->mCarPool->releaseDebris();
+    updateProximity();
 }
 
 Player* PlayerPool::getEnemyVip(int team)
 {
-	//cycle through the players until we get the enemy vip
-	for( int i = 0; i < GameCore::mPlayerPool->getNumberOfPlayers(); i ++ )
+	//cycle through the vips (as of the start of the tick) until we get the enemy one
+	for( size_t i = 0; i < mVips.size(); i ++ )
 	{
-		if(mPlayers[i]->getTeam() != team && mPlayers[i]->getVIP())
-			return mPlayers[i];
+		if(mVips[i]->getTeam() != team)
+			return mVips[i];
 	}
     OutputDebugString("Lolz no enemy team could be found, returning a NULL pointer for shiggles - almost certainly gonna crash now.");
     return NULL;
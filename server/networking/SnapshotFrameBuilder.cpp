@@ -0,0 +1,487 @@
+/**
+ * @file    SnapshotFrameBuilder.cpp
+ * @brief   Builds the world state snapshot frame which is sent to the clients each update.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SnapshotFrameBuilder.h"
+#include "NetworkCore.h"
+#include "GameCore.h"
+#include "Player.h"
+#include "PlayerPool.h"
+#include <algorithm>
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Orders candidates by descending priority.
+static bool candidateHigherPriority (const std::pair<float, int> &a, const std::pair<float, int> &b)
+{
+    return a.first > b.first;
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+SnapshotFrameBuilder::SnapshotFrameBuilder (void) : mSequence(0), mFrameTick(0), mNumTargets(0), mFrameTime(0)
+{
+}
+
+
+/// @brief  Deconstructor.
+SnapshotFrameBuilder::~SnapshotFrameBuilder (void)
+{
+    std::map<RakNet::RakNetGUID, Client>::iterator it;
+    for (it = mClients.begin(); it != mClients.end(); it++)
+        for (unsigned int i = 0; i < it->second.packetPool.size(); i++)
+            delete it->second.packetPool[i];
+
+    for (unsigned int i = 0; i < mStreamPool.size(); i++)
+        delete mStreamPool[i];
+}
+
+
+/// @brief  Starts a new frame, quantizing every car into the snapshot history and copying what the
+///         clients are sent about each player. Encodings made for the previous frame are thrown away,
+///         as are the previous frame's targets.
+void SnapshotFrameBuilder::buildFrame (void)
+{
+    mSubjects.clear();
+    mNumTargets = 0;
+
+    mSequence++;
+    mFrameTick = GameCore::mSimulationClock->getTick();
+    mFrameTime = RakNet::GetTimeMS();
+    mHistory.beginFrame(mSequence);
+
+    int size = GameCore::mPlayerPool->getNumberOfPlayers();
+    for (int j = 0; j < size; j++)
+    {
+        Player *sendPlayer = GameCore::mPlayerPool->getPlayer(j);
+        if (sendPlayer == NULL || sendPlayer->getCar() == NULL)
+            continue;
+
+        QuantizedCarState playerState;
+        CarSnapshot *playerSnap = sendPlayer->getCar()->getCarSnapshot();
+        SnapshotCodec::quantize(*playerSnap, playerState);
+        delete playerSnap;
+
+        mHistory.store(mSequence, sendPlayer->getPlayerGUID(), playerState);
+
+        if (mSubjects.size() == mStreamPool.size())
+            mStreamPool.push_back(new RakNet::BitStream());
+
+        Subject subject;
+        subject.playerid          = sendPlayer->getPlayerGUID();
+        subject.position          = sendPlayer->getCar()->GetPos();
+        subject.direction         = sendPlayer->getCar()->GetHeading() * Ogre::Vector3::UNIT_Z;
+        subject.hp                = sendPlayer->getHP();
+        subject.alive             = sendPlayer->getAlive();
+        subject.lastCollisionWith = sendPlayer->lastCollisionWith;
+        subject.lastCollisionTime = sendPlayer->lastCollisionTime;
+        subject.stream            = mStreamPool[mSubjects.size()];
+        subject.stream->Reset();
+        mSubjects.push_back(subject);
+    }
+
+    indexSubjects();
+}
+
+
+/// @brief  Adds a client to be sent the current frame by serialize().
+/// @param  target      The client's player.
+/// @param  fullUpdate  If true every car is sent without a baseline, along with its health, ignoring
+///                     the client's priorities and budget. Used when the client joins.
+void SnapshotFrameBuilder::addTarget (Player *target, bool fullUpdate)
+{
+    if (mNumTargets == (int) mTargets.size())
+        mTargets.push_back(Target());
+
+    Target &t = mTargets[mNumTargets++];
+    t.playerid   = target->getPlayerGUID();
+    t.client     = &mClients[t.playerid];
+    t.inputAck   = target->inputCommands.getLastConsumed();
+    t.fullUpdate = fullUpdate;
+
+    std::map<RakNet::RakNetGUID, int>::iterator it = mSubjectIndices.find(t.playerid);
+    t.subject = (it != mSubjectIndices.end() && target->getCar() != NULL) ? it->second : -1;
+}
+
+
+/// @brief  Serializes the current frame for every target. Each target's cars are chosen, then each car
+///         which was chosen is written once against each baseline it is needed with, and finally each
+///         target's packets are put together from those. The targets, and the cars, are independent of
+///         each other so each step is spread across the task pool.
+/// @param  pool  The task pool, or NULL to do everything on this thread.
+void SnapshotFrameBuilder::serialize (TaskPool *pool)
+{
+    if (pool != NULL)
+        pool->parallelFor(mNumTargets, &SnapshotFrameBuilder::chooseCarsTask, this);
+    else
+        for (int i = 0; i < mNumTargets; i++)
+            chooseCars(mTargets[i]);
+
+    // Only the encodings which are actually needed are written.
+    for (int i = 0; i < mNumTargets; i++)
+    {
+        const std::vector< std::pair<int, int> > &chosen = mTargets[i].chosen;
+        for (unsigned int j = 0; j < chosen.size(); j++)
+            mSubjects[chosen[j].first].encodings.insert(std::make_pair(chosen[j].second, std::make_pair((BitSize_t) 0, (BitSize_t) 0)));
+    }
+
+    if (pool != NULL)
+    {
+        pool->parallelFor((int) mSubjects.size(), &SnapshotFrameBuilder::encodeCarsTask, this);
+        pool->parallelFor(mNumTargets, &SnapshotFrameBuilder::writePacketsTask, this);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < mSubjects.size(); i++)
+            encodeCars(mSubjects[i]);
+        for (int i = 0; i < mNumTargets; i++)
+            writePackets(mTargets[i]);
+    }
+}
+
+
+/// @brief  Serializes the current frame for one client, on this thread.
+/// @param  target      The player the frame is going to.
+/// @param  fullUpdate  See addTarget().
+/// @return The packets, which should all be sent to the client. They remain owned by the builder and
+///         are valid until the next frame is built.
+const std::vector<RakNet::BitStream*>& SnapshotFrameBuilder::getPackets (Player *target, bool fullUpdate)
+{
+    mNumTargets = 0;
+    addTarget(target, fullUpdate);
+    serialize(NULL);
+    return mTargets[0].client->packets;
+}
+
+
+/// @brief  Called when a client acknowledges a frame. Every car which was in the frame can now be delta
+///         encoded against it.
+/// @param  clientid  The client.
+/// @param  sequence  The frame.
+void SnapshotFrameBuilder::acknowledge (const RakNet::RakNetGUID &clientid, unsigned short sequence)
+{
+    std::map<RakNet::RakNetGUID, Client>::iterator it = mClients.find(clientid);
+    if (it == mClients.end())
+        return;
+
+    // Full updates aren't recorded, so acknowledgements of them are ignored here.
+    Client &client = it->second;
+    unsigned short slot = sequence & (SNAPSHOT_HISTORY_SIZE - 1);
+    if (!client.sentValid[slot] || client.sentSequence[slot] != sequence)
+        return;
+
+    std::vector<RakNet::RakNetGUID> &sent = client.sent[slot];
+    for (unsigned int i = 0; i < sent.size(); i++)
+    {
+        std::map<RakNet::RakNetGUID, SubjectRelevance>::iterator subject = client.subjects.find(sent[i]);
+        if (subject == client.subjects.end())
+            continue;
+
+        if (subject->second.baseline < 0 || SnapshotCodec::sequenceGreaterThan(sequence, (unsigned short) subject->second.baseline))
+            subject->second.baseline = sequence;
+    }
+}
+
+
+/// @brief  Forgets a player, both as a client and as a car. Must be called before the player is deleted.
+/// @param  playerid  The player.
+void SnapshotFrameBuilder::removePlayer (const RakNet::RakNetGUID &playerid)
+{
+    // The targets point at the clients, so start them again.
+    mNumTargets = 0;
+
+    std::map<RakNet::RakNetGUID, Client>::iterator it = mClients.find(playerid);
+    if (it != mClients.end())
+    {
+        for (unsigned int i = 0; i < it->second.packetPool.size(); i++)
+            delete it->second.packetPool[i];
+        mClients.erase(it);
+    }
+
+    for (it = mClients.begin(); it != mClients.end(); it++)
+        it->second.subjects.erase(playerid);
+
+    for (unsigned int i = 0; i < mSubjects.size(); i++)
+    {
+        if (mSubjects[i].playerid == playerid)
+        {
+            mSubjects.erase(mSubjects.begin() + i);
+            break;
+        }
+    }
+    indexSubjects();
+}
+
+
+/// @brief  Runs chooseCars() for a target on the task pool.
+void SnapshotFrameBuilder::chooseCarsTask (void *context, int index)
+{
+    SnapshotFrameBuilder *builder = (SnapshotFrameBuilder*) context;
+    builder->chooseCars(builder->mTargets[index]);
+}
+
+
+/// @brief  Runs encodeCars() for a subject on the task pool.
+void SnapshotFrameBuilder::encodeCarsTask (void *context, int index)
+{
+    SnapshotFrameBuilder *builder = (SnapshotFrameBuilder*) context;
+    builder->encodeCars(builder->mSubjects[index]);
+}
+
+
+/// @brief  Runs writePackets() for a target on the task pool.
+void SnapshotFrameBuilder::writePacketsTask (void *context, int index)
+{
+    SnapshotFrameBuilder *builder = (SnapshotFrameBuilder*) context;
+    builder->writePackets(builder->mTargets[index]);
+}
+
+
+/// @brief  Chooses the cars to send to a client this frame, and the baseline each is written against.
+///         The client's own car always goes first, then the others in order of priority. Only touches
+///         the target and its client.
+/// @param  target  The client.
+void SnapshotFrameBuilder::chooseCars (Target &target)
+{
+    Client &client = *target.client;
+
+    target.chosen.clear();
+    target.candidates.clear();
+    if (target.fullUpdate)
+    {
+        for (unsigned int i = 0; i < mSubjects.size(); i++)
+            target.chosen.push_back(std::make_pair((int) i, (int) SNAPSHOT_BASELINE_NONE));
+        return;
+    }
+
+    const Subject *targetSubject = target.subject >= 0 ? &mSubjects[target.subject] : NULL;
+    for (unsigned int i = 0; i < mSubjects.size(); i++)
+    {
+        if ((int) i == target.subject)
+        {
+            target.chosen.push_back(std::make_pair((int) i, getBaseline(client.subjects[mSubjects[i].playerid], mSubjects[i].playerid)));
+            continue;
+        }
+
+        SubjectRelevance &relevance = client.subjects[mSubjects[i].playerid];
+        relevance.priority += getRelevance(targetSubject, mSubjects[i], mFrameTime);
+        target.candidates.push_back(std::make_pair(relevance.priority, (int) i));
+    }
+
+    int numCandidates = std::min((int) target.candidates.size(), SNAPSHOT_RELEVANCE_MAX_CARS);
+    std::partial_sort(target.candidates.begin(), target.candidates.begin() + numCandidates, target.candidates.end(), candidateHigherPriority);
+    for (int i = 0; i < numCandidates; i++)
+    {
+        const Subject &subject = mSubjects[target.candidates[i].second];
+        target.chosen.push_back(std::make_pair(target.candidates[i].second, getBaseline(client.subjects[subject.playerid], subject.playerid)));
+    }
+}
+
+
+/// @brief  Writes a car against every baseline it was chosen with which hasn't been written yet. Each
+///         encoding starts on a byte so it can be copied out by several threads at once. Only touches
+///         the subject.
+/// @param  subject  The car.
+void SnapshotFrameBuilder::encodeCars (Subject &subject)
+{
+    const QuantizedCarState *playerState = mHistory.find(mSequence, subject.playerid);
+
+    std::map< int, std::pair<BitSize_t, BitSize_t> >::iterator it;
+    for (it = subject.encodings.begin(); it != subject.encodings.end(); it++)
+    {
+        if (it->second.second != 0)
+            continue;
+
+        int baseline = it->first;
+        const QuantizedCarState *baselineState = NULL;
+        if (baseline >= 0)
+            baselineState = mHistory.find((unsigned short) baseline, subject.playerid);
+
+        // Each car is preceded by a bit saying there is another one to read, and says which
+        // frame it is delta encoded against as the client's cars don't all share a baseline.
+        RakNet::BitStream *stream = subject.stream;
+        stream->AlignWriteToByteBoundary();
+        BitSize_t offset = stream->GetNumberOfBitsUsed();
+        stream->Write(true);
+        stream->Write(subject.playerid);
+        stream->Write(baselineState != NULL);
+        if (baselineState != NULL)
+            stream->WriteBitsFromIntegerRange((unsigned int) (unsigned short) (mSequence - baseline), 0u, SNAPSHOT_HISTORY_SIZE - 1u, SNAPSHOT_BASELINE_BITS);
+        SnapshotCodec::write(stream, *playerState, baselineState);
+
+        it->second = std::make_pair(offset, stream->GetNumberOfBitsUsed() - offset);
+    }
+}
+
+
+/// @brief  Puts together a client's packets from the encodings of its chosen cars. Cars are appended to
+///         a packet until the next one would take it over SNAPSHOT_PACKET_MAX_BYTES, at which point a
+///         new packet (or part) is started. Each part can be decoded on its own, and the client
+///         acknowledges the frame once it has every part. Only touches the target and its client.
+/// @param  target  The client.
+void SnapshotFrameBuilder::writePackets (Target &target)
+{
+    const BitSize_t maxBits    = SNAPSHOT_PACKET_MAX_BYTES * 8;
+    const BitSize_t budgetBits = SNAPSHOT_CLIENT_BYTES_PER_TICK * 8;
+    Client &client = *target.client;
+
+    unsigned short slot = mSequence & (SNAPSHOT_HISTORY_SIZE - 1);
+    std::vector<RakNet::RakNetGUID> &sent = client.sent[slot];
+    if (!target.fullUpdate)
+    {
+        sent.clear();
+        client.sentValid[slot]    = true;
+        client.sentSequence[slot] = mSequence;
+    }
+
+    client.packets.clear();
+    unsigned char part = 0;
+    bool packetEmpty = true;
+    BitSize_t budgetUsed = 0;
+    RakNet::BitStream *packet = beginPacket(target, part);
+
+    for (unsigned int i = 0; i < target.chosen.size(); i++)
+    {
+        const Subject &subject = mSubjects[target.chosen[i].first];
+        SubjectRelevance &relevance = client.subjects[subject.playerid];
+
+        const std::pair<BitSize_t, BitSize_t> &encoding = subject.encodings.find(target.chosen[i].second)->second;
+        BitSize_t offset = encoding.first;
+        BitSize_t length = encoding.second;
+
+        // Health is only sent when it differs from what the client was last told.
+        bool sendHP = target.fullUpdate || subject.hp != relevance.sentHP;
+        BitSize_t bits = length + 2 + (sendHP ? sizeof(int) * 8 : 0);
+
+        if (!target.fullUpdate && target.chosen[i].first != target.subject)
+        {
+            if (budgetUsed + bits > budgetBits)
+                continue;
+            budgetUsed += bits;
+        }
+
+        // Two bits are kept spare to close the packet.
+        if (!packetEmpty && packet->GetNumberOfBitsUsed() + bits + 2 > maxBits)
+        {
+            packet->Write(false);   // No more cars in this part.
+            packet->Write(false);   // Not the last part.
+            client.packets.push_back(packet);
+
+            packet = beginPacket(target, ++part);
+            packetEmpty = true;
+        }
+
+        packet->WriteBits(subject.stream->GetData() + (offset >> 3), length, false);
+        packet->Write(sendHP);
+        if (sendHP)
+            packet->Write(subject.hp);
+        packet->Write(target.fullUpdate ? subject.alive : true);
+        packetEmpty = false;
+
+        relevance.priority = 0;
+        relevance.sentHP   = subject.hp;
+        if (!target.fullUpdate)
+            sent.push_back(subject.playerid);
+    }
+
+    packet->Write(false);           // No more cars in this part.
+    packet->Write(true);            // The last part.
+    client.packets.push_back(packet);
+}
+
+
+/// @brief  Works out how much a car matters to a client this update. Nearby cars matter most, more so if
+///         they are in front of the client's car, and any car the client has just collided with matters
+///         a lot whatever else it is doing.
+/// @param  targetSubject  The client's car, or NULL if it has none.
+/// @param  subject        The car.
+/// @param  now            The current time.
+/// @return The amount to add to the car's priority.
+float SnapshotFrameBuilder::getRelevance (const Subject *targetSubject, const Subject &subject, RakNet::TimeMS now) const
+{
+    // Without a car (e.g. while spectating) everything is equally relevant, so cars are sent round robin.
+    if (targetSubject == NULL)
+        return 1.0f;
+
+    Ogre::Vector3 toSubject = subject.position - targetSubject->position;
+    float distance = toSubject.length();
+    float relevance = SNAPSHOT_RELEVANCE_NEAR_DISTANCE / std::max(distance, SNAPSHOT_RELEVANCE_NEAR_DISTANCE);
+
+    if (distance > 0.0f && targetSubject->direction.dotProduct(toSubject) >= SNAPSHOT_RELEVANCE_VIEW_COS * distance)
+        relevance *= SNAPSHOT_RELEVANCE_VIEW_BOOST;
+
+    if ((targetSubject->lastCollisionWith == subject.playerid && now - targetSubject->lastCollisionTime < SNAPSHOT_RELEVANCE_COLLISION_MS)
+        || (subject.lastCollisionWith == targetSubject->playerid && now - subject.lastCollisionTime < SNAPSHOT_RELEVANCE_COLLISION_MS))
+        relevance *= SNAPSHOT_RELEVANCE_COLLISION_BOOST;
+
+    return relevance;
+}
+
+
+/// @brief  Chooses the baseline to encode a car against for a client.
+/// @param  relevance  The client's record of the car.
+/// @param  playerid   The car's player.
+/// @return The latest frame the client acknowledged which had the car in it, if it is still in the history,
+///         otherwise SNAPSHOT_BASELINE_NONE.
+int SnapshotFrameBuilder::getBaseline (const SubjectRelevance &relevance, const RakNet::RakNetGUID &playerid) const
+{
+    if (relevance.baseline < 0)
+        return SNAPSHOT_BASELINE_NONE;
+
+    // The client overwrites a frame in its own history once it has one SNAPSHOT_HISTORY_SIZE newer.
+    unsigned short baselineSequence = (unsigned short) relevance.baseline;
+    unsigned short age = mSequence - baselineSequence;
+    if (age == 0 || age >= SNAPSHOT_HISTORY_SIZE || mHistory.find(baselineSequence, playerid) == NULL)
+        return SNAPSHOT_BASELINE_NONE;
+
+    return baselineSequence;
+}
+
+
+/// @brief  Starts the next packet of a target's frame and writes its header.
+/// @param  target  The client.
+/// @param  part    The index of this part within the frame.
+/// @return The packet.
+RakNet::BitStream* SnapshotFrameBuilder::beginPacket (Target &target, unsigned char part)
+{
+    Client &client = *target.client;
+    RakNet::BitStream *packet;
+    if (client.packets.size() < client.packetPool.size())
+    {
+        packet = client.packetPool[client.packets.size()];
+        packet->Reset();
+    }
+    else
+    {
+        packet = new RakNet::BitStream();
+        client.packetPool.push_back(packet);
+    }
+
+    unsigned char packetid = ID_PLAYER_SNAPSHOT;
+    packet->Write(packetid);
+    packet->Write(mSequence);
+    packet->Write(mFrameTick);
+    packet->Write(part);
+
+    // The latest input the client's car has been simulated with, so the client can replay the rest.
+    packet->Write(target.inputAck >= 0);
+    if (target.inputAck >= 0)
+        packet->Write((unsigned short) target.inputAck);
+
+    return packet;
+}
+
+
+/// @brief  Rebuilds the lookup from player to subject.
+void SnapshotFrameBuilder::indexSubjects (void)
+{
+    mSubjectIndices.clear();
+    for (unsigned int i = 0; i < mSubjects.size(); i++)
+        mSubjectIndices[mSubjects[i].playerid] = i;
+}
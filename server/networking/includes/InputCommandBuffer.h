@@ -0,0 +1,54 @@
+/**
+ * @file    InputCommandBuffer.h
+ * @brief   A jitter buffer of the input commands received from one client.
+ */
+#ifndef INPUTCOMMANDBUFFER_H
+#define INPUTCOMMANDBUFFER_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "InputCommand.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define INPUT_BUFFER_SIZE       32      // Commands which can be waiting. Must be a power of two.
+#define INPUT_JITTER_TICKS      2       // Commands kept waiting to absorb variation in when packets arrive.
+#define INPUT_MAX_WAITING_TICKS 8       // If more commands than this are waiting the oldest are skipped, so input lag can't build up.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Holds the commands received from a client until the physics tick they are used in. Exactly one
+ *          command is used per tick. Commands arrive several times over (see INPUT_REDUNDANCY), so one
+ *          is only missing if several packets in a row were lost, in which case the last is repeated.
+ *          If the client falls behind the buffer waits for it rather than running on ahead.
+ */
+class InputCommandBuffer
+{
+public:
+    InputCommandBuffer (void);
+
+    void receive (const InputCommand *commands, int count);
+    bool consume (unsigned char &buttons);
+    void clear (void);
+
+    /// @brief  Gets the tick of the latest command used, or -1 if none have been.
+    int getLastConsumed (void) const { return mLastConsumed; }
+
+    unsigned int mRepeated;     ///< Ticks which had no command (lost or late) so the last was repeated.
+    unsigned int mSkipped;      ///< Commands thrown away to cut down the number waiting.
+
+private:
+    unsigned short mTicks[INPUT_BUFFER_SIZE];
+    unsigned char  mButtons[INPUT_BUFFER_SIZE];
+    bool           mValid[INPUT_BUFFER_SIZE];
+
+    bool           mStarted;
+    bool           mHasNewest;
+    unsigned short mNewestTick;     ///< The newest command received.
+    unsigned short mNextTick;       ///< The command to use on the next tick.
+    unsigned char  mLastButtons;
+    int            mLastConsumed;
+};
+
+#endif // #ifndef INPUTCOMMANDBUFFER_H
@@ -12,6 +12,7 @@
 #define SERVER_PASS 0
 #define ENCRYPT_DATA 0
 #define UPDATE_INTERVAL 20
+#define SERVER_INFO_INTERVAL 1000
 #define LOG_FILENAME "cdomain.txt"
 
 // Game includes
@@ -19,6 +20,7 @@
 #include "Powerup.h"
 #include "CarSnapshot.h"
 #include "SceneSetup.h"
+#include "SnapshotFrameBuilder.h"
 
 // RakNet includes
 #include "BitStream.h"
@@ -54,19 +56,15 @@ enum
     ID_SPAWN_WAIT_NEXT_GAME,
 };
 
+// Returned to unconnected pings, so how the server is coping can be watched from outside (see the bot swarm)
 struct SERVER_INFO_DATA
 {
     unsigned int publicSeed;
     int curMap;
-};
-
-struct PLAYER_INPUT_DATA
-{
-	bool frwdPressed;
-	bool backPressed;
-	bool leftPressed;
-	bool rghtPressed;
-    bool hndbPressed;
+    int players;                    // Clients connected.
+    float ticksPerSecond;           // Ticks simulated over the last second. Below SIMULATION_TICK_RATE the server is falling behind.
+    float tickMicroseconds;         // Average time taken per tick over the last second, including the networking.
+    float peakFrameMicroseconds;    // Longest time taken by one frame's update over the last second.
 };
 
 struct PLAYER_SYNC_DATA
@@ -90,6 +88,17 @@ private:
 	static RakNet::TimeMS timeLastUpdate;
 
     static SERVER_INFO_DATA serverInfo;
+    static RakNet::TimeMS timeLastInfo;
+    static RakNet::TimeUS infoUpdateTime;      // Time spent updating since serverInfo was last published.
+    static RakNet::TimeUS infoPeakTime;
+    static int infoTicks;
+
+    static SnapshotFrameBuilder mFrameBuilder;
+    static TaskGroup mBroadcastTasks;
+    static std::vector< std::pair<RakNet::RakNetGUID, unsigned short> > mPendingAcks;   // Acknowledgements which arrived while a frame was being sent.
+
+    static void broadcastTask( void *context, int index );
+    static void finishBroadcast();
 
 public:
     NetworkCore();
@@ -103,6 +112,8 @@ public:
 	void ProcessPlayerState( RakNet::Packet *pkt );
 	void BroadcastUpdates();
 	void BroadcastRPC( char *rpcName, RakNet::BitStream *bsData );
+	void recordUpdate( int ticks, RakNet::TimeUS updateTime );
+	static const SERVER_INFO_DATA& getServerInfo() { return serverInfo; }
 	static void GamestateUpdatePlayer( RakNet::RakNetGUID playerid );
 	static void SetupGameForPlayer( RakNet::RakNetGUID playerid );
     static void HandlePlayerQuit( RakNet::RakNetGUID playerid, unsigned char reason );
@@ -116,7 +127,7 @@ public:
     void sendPowerupCollect( int pwrID, Player *player, float extraData );
     void sendChatMessage( const char *szMessage );
     void sendSyncScores();
-    void sendGameSync(GameMode gameMode, ArenaID arenaID);
+    void sendGameSync(GameMode gameMode, ArenaID arenaID, ArenaID nextArenaID);
     void sendTimeSinceRoundStart(time_t startTime);
     void sendNicknameChange( Player *pPlayer);
 
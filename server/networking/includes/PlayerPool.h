@@ -2,9 +2,11 @@
 #define PLAYERPOOL_H
 
 #define MAX_PLAYERS 100
+#define PLAYER_POOL_NEAR_CANDIDATES 4   // How many of the nearest players getRandomNearPlayer() picks between.
 
 #include "stdafx.h"
 #include "Player.h"
+#include "ProximityGrid.h"
 
 // RakNet includes
 #include "RakNetTypes.h"
@@ -21,6 +23,10 @@ private:
 	RakNet::RakNetGUID mLocalGUID;
 	int getPlayerIndex( RakNet::RakNetGUID playerid );
 
+	ProximityGrid mCarGrid;             // Where every car was at the start of the tick, by TransformStore slot.
+	std::vector<Player*> mSlotPlayers;  // Whose car is in each TransformStore slot, as of the start of the tick.
+	std::vector<Player*> mVips;
+
 public:
 	PlayerPool();
 	~PlayerPool();
@@ -31,6 +37,11 @@ public:
 	int getNumberOfPlayers();
 	Player* getRandomPlayer();
 	Player* getClosestPlayer(Player* player);
+	Player* getRandomNearPlayer(Player* player, bool enemiesOnly);
+	void updateProximity();
+	/// @brief Gets the grid of where every car was at the start of the tick. Its ids are TransformStore slots.
+	const ProximityGrid& getCarGrid() { return mCarGrid; }
+	Player* getPlayerInSlot( int slot ) { return slot >= 0 && slot < (int) mSlotPlayers.size() ? mSlotPlayers[slot] : NULL; }
 	std::vector<Player*> getPlayers() { return mPlayers;};
 	static bool cmpRound(Player* a, Player* b); //Sorts the players based on their round score
     static bool cmpGame(Player* a, Player* b); //Sorts the players based on their game score
@@ -46,6 +57,7 @@ public:
 	Player *getEnemyVip(int team);
 
 	void frameEvent( const float timeSinceLastFrame );
+	void recordHistory( unsigned int tick );
     void roundEnd();
 };
 
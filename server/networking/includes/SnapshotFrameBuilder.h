@@ -0,0 +1,154 @@
+/**
+ * @file    SnapshotFrameBuilder.h
+ * @brief   Builds the world state snapshot frame which is sent to the clients each update. Each client
+            only gets the cars which are most relevant to it, and each car is serialized once per
+            baseline no matter how many clients it is sent to.
+ */
+#ifndef SNAPSHOTFRAMEBUILDER_H
+#define SNAPSHOTFRAMEBUILDER_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SnapshotCodec.h"
+#include "TaskPool.h"
+#include "BitStream.h"
+#include "MTUSize.h"
+#include <vector>
+#include <map>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+// Largest snapshot packet in bytes. Room is left for the UDP and RakNet headers so RakNet never has to split one.
+#define SNAPSHOT_PACKET_MAX_BYTES          (MAXIMUM_MTU_SIZE - 28 - 64)
+#define SNAPSHOT_BASELINE_NONE             -1      // A car written without a baseline.
+
+// Interest management. Every update each client's priority for every other car grows by that car's
+// relevance to it, and the highest priority cars are sent until the budget runs out.
+#define SNAPSHOT_CLIENT_BYTES_PER_TICK     800     // Budget for the cars sent to one client each update (the client's own car is free).
+#define SNAPSHOT_RELEVANCE_MAX_CARS        24      // Most other cars sent to one client each update.
+#define SNAPSHOT_RELEVANCE_NEAR_DISTANCE   20.0f   // Cars closer than this (metres) are as relevant as they can be. Relevance falls off with distance beyond it.
+#define SNAPSHOT_RELEVANCE_VIEW_COS        0.5f    // Cosine of half the angle of the cone in front of a car which counts as its view.
+#define SNAPSHOT_RELEVANCE_VIEW_BOOST      2.0f    // Multiplier for cars in view.
+#define SNAPSHOT_RELEVANCE_COLLISION_MS    1500    // How long after a collision the two cars involved stay of interest to each other.
+#define SNAPSHOT_RELEVANCE_COLLISION_BOOST 4.0f    // Multiplier for cars recently collided with.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+class Player;
+
+/**
+ *  @brief  Quantizes every car into a new frame of the snapshot history each update, and serializes it
+ *          into MTU sized ID_PLAYER_SNAPSHOT packets for each client.
+ *
+ *          Each client has a priority accumulator for every car, so distant cars are still sent, just
+ *          less often. As the number of cars sent to a client is capped, the bandwidth used by each
+ *          client stays flat as more players join. The encoding of a car against a particular baseline
+ *          is cached for the frame and copied into the packet of every client which needs it, so the
+ *          cost of serialization doesn't grow with the number of clients either.
+ *
+ *          Each car is delta encoded against the latest frame the client has acknowledged which
+ *          contained that car, so the builder remembers which cars went into each client's last
+ *          SNAPSHOT_HISTORY_SIZE frames.
+ *
+ *          Everything serialization needs from the players is copied when the frame is built, so
+ *          serialize() can run on other threads while the game carries on. Nothing else may be called
+ *          until it has finished.
+ */
+class SnapshotFrameBuilder
+{
+public:
+    SnapshotFrameBuilder (void);
+    ~SnapshotFrameBuilder (void);
+
+    void buildFrame (void);
+    void addTarget (Player *target, bool fullUpdate = false);
+    void serialize (TaskPool *pool);
+    const std::vector<RakNet::BitStream*>& getPackets (Player *target, bool fullUpdate = false);
+    void acknowledge (const RakNet::RakNetGUID &clientid, unsigned short sequence);
+    void removePlayer (const RakNet::RakNetGUID &playerid);
+
+    unsigned short getSequence (void) const { return mSequence; }
+    unsigned int getFrameTick (void) const { return mFrameTick; }
+    /// @brief  Gets the number of clients added with addTarget() since the frame was built.
+    int getNumTargets (void) const { return mNumTargets; }
+    /// @brief  Gets the player a target is.
+    const RakNet::RakNetGUID& getTargetGUID (int target) const { return mTargets[target].playerid; }
+    /// @brief  Gets the packets serialize() made for a target. They are valid until the next frame is built.
+    const std::vector<RakNet::BitStream*>& getTargetPackets (int target) const { return mTargets[target].client->packets; }
+
+private:
+    /// @brief  A car in the current frame, and what is known about its player when the frame was built.
+    struct Subject
+    {
+        RakNet::RakNetGUID           playerid;
+        Ogre::Vector3                position;
+        Ogre::Vector3                direction;
+        int                          hp;
+        bool                         alive;
+        RakNet::RakNetGUID           lastCollisionWith;
+        RakNet::TimeMS               lastCollisionTime;
+        RakNet::BitStream           *stream;                            // This car written against each baseline, each starting on a byte.
+        std::map< int, std::pair<BitSize_t, BitSize_t> > encodings;     // Offset into stream and length of this car written against each baseline. A length of 0 is yet to be written.
+    };
+
+    /// @brief  What a client knows about one car.
+    struct SubjectRelevance
+    {
+        float priority;     // Grows each update the car isn't sent, and is reset when it is.
+        int   baseline;     // The latest acknowledged frame which contained the car, or SNAPSHOT_BASELINE_NONE.
+        int   sentHP;       // The last health value sent, or -1.
+
+        // Cars the client has never been sent start with a high priority so they jump the queue.
+        SubjectRelevance (void) : priority(1000.0f), baseline(SNAPSHOT_BASELINE_NONE), sentHP(-1) {}
+    };
+
+    /// @brief  The interest management state of one client.
+    struct Client
+    {
+        std::map<RakNet::RakNetGUID, SubjectRelevance> subjects;
+        bool                                           sentValid[SNAPSHOT_HISTORY_SIZE];
+        unsigned short                                 sentSequence[SNAPSHOT_HISTORY_SIZE];
+        std::vector<RakNet::RakNetGUID>                sent[SNAPSHOT_HISTORY_SIZE];   // The cars in each frame sent.
+        std::vector<RakNet::BitStream*>                packets;                       // The packets most recently serialized.
+        std::vector<RakNet::BitStream*>                packetPool;                    // Every packet allocated so far, reused each frame.
+
+        Client (void) { for (int i = 0; i < SNAPSHOT_HISTORY_SIZE; i++) sentValid[i] = false; }
+    };
+
+    /// @brief  A client being serialized for this frame.
+    struct Target
+    {
+        RakNet::RakNetGUID                    playerid;
+        Client                               *client;
+        int                                   subject;      // The client's own car in mSubjects, or -1.
+        int                                   inputAck;     // The latest input command used, to write in the header of its packets.
+        bool                                  fullUpdate;
+        std::vector< std::pair<float, int> >  candidates;
+        std::vector< std::pair<int, int> >    chosen;       // The cars to send, and the baseline for each.
+    };
+
+    static void chooseCarsTask (void *context, int index);
+    static void encodeCarsTask (void *context, int index);
+    static void writePacketsTask (void *context, int index);
+
+    void       chooseCars (Target &target);
+    void       encodeCars (Subject &subject);
+    void       writePackets (Target &target);
+    float      getRelevance (const Subject *targetSubject, const Subject &subject, RakNet::TimeMS now) const;
+    int        getBaseline (const SubjectRelevance &relevance, const RakNet::RakNetGUID &playerid) const;
+    RakNet::BitStream* beginPacket (Target &target, unsigned char part);
+    void       indexSubjects (void);
+
+    SnapshotHistory                             mHistory;
+    unsigned short                              mSequence;
+    unsigned int                                mFrameTick;     // The simulation tick the current frame was built on.
+    std::vector<Subject>                        mSubjects;      // Players with a car in the current frame.
+    std::map<RakNet::RakNetGUID, int>           mSubjectIndices;
+    std::map<RakNet::RakNetGUID, Client>        mClients;
+    std::vector<Target>                         mTargets;       // The clients being sent the current frame. Only the first mNumTargets are in use, the rest are kept for their memory.
+    int                                         mNumTargets;
+    std::vector<RakNet::BitStream*>             mStreamPool;    // A stream for each subject, reused each frame.
+    RakNet::TimeMS                              mFrameTime;     // When the frame was built.
+};
+
+#endif // #ifndef SNAPSHOTFRAMEBUILDER_H
@@ -18,8 +18,10 @@ AudioCore*				GameCore::mAudioCore			= NULL;
 ServerGraphics*         GameCore::mServerGraphics       = NULL;
 AiCore*					GameCore::mAiCore				= NULL;
 #endif
+TaskPool*				GameCore::mTaskPool				= NULL;
 NetworkCore*			GameCore::mNetworkCore			= NULL;
 PhysicsCore*			GameCore::mPhysicsCore			= NULL;
+SimulationClock*		GameCore::mSimulationClock		= NULL;
 GameGUI*				GameCore::mGui					= NULL;
 PowerupPool*			GameCore::mPowerupPool			= NULL;
 Gameplay*				GameCore::mGameplay				= NULL;
@@ -51,6 +53,9 @@ void GameCore::load (SplashScreen* ss, int progress)
 #endif
     const int progressStep = (float) (endProgress - progress) / (float) numberOfSteps;
 
+    // The physics, AI and networking all spread their work across this pool, so it comes first.
+    GameCore::mTaskPool = new TaskPool();
+
 #ifdef COLLISION_DOMAIN_SERVER
     ss->updateProgressBar(progress += progressStep, "Loading AI...");       // -/1
 	GameCore::mAiCore = new AiCore();
@@ -64,6 +69,7 @@ void GameCore::load (SplashScreen* ss, int progress)
 
     ss->updateProgressBar(progress += progressStep, "Loading Physics...");  // 3/4
     GameCore::mPhysicsCore = new PhysicsCore();
+    GameCore::mSimulationClock = new SimulationClock();
 
 #ifdef COLLISION_DOMAIN_CLIENT
     ss->updateProgressBar(progress += progressStep, "Loading Audio...");    // 4/-
@@ -84,5 +90,17 @@ void GameCore::destroy()
     // TODO: DESTROY THE OTHERS? (also sceneManager doesn't exist by the
     //       time this method is called, which could really mess up physics
 
+    // The network's destructor waits for the last update to go out on the task pool.
     delete GameCore::mNetworkCore;
+    GameCore::mNetworkCore = NULL;
+
+#ifdef COLLISION_DOMAIN_SERVER
+    // Stops the NavPlanner's thread.
+    delete GameCore::mAiCore;
+    GameCore::mAiCore = NULL;
+#endif
+
+    // Nothing is left to run on the pool, so its threads can be stopped.
+    delete GameCore::mTaskPool;
+    GameCore::mTaskPool = NULL;
 }
@@ -165,29 +165,29 @@ Ogre::Vector3 PowerupPool::randomPointInArena(int arenaXRadius, int arenaZRadius
     return Ogre::Vector3(x, y, z);
 }
 
+/// @brief  Indexes where the powerups are for this tick's proximity queries. Called at the start of each tick.
+void PowerupPool::updateProximity()
+{
+    mGrid.clear();
+    for (int i = 0; i < MAX_POWERUPS; i++)
+        if (mPowerups[i])
+            mGrid.add(BtOgre::Convert::toBullet(mPowerups[i]->getPosition()), 0, i);
+    mGrid.build();
+}
+
 // THIS WILL RETURN 0,0,0 IF THERE ARE NO POWERUPS
+/// @brief  Gets the nearest powerup to a point, as of the start of the tick (see updateProximity).
 Ogre::Vector3 PowerupPool::getNearestPowerUp(Ogre::Vector3 pos)
 {
-    float minDist = std::numeric_limits<float>::infinity();
-    float distance;
-
-    Ogre::Vector3 ret(0,0,0);
+    int nearest[MAX_POWERUPS];
+    int found = mGrid.queryNearest(BtOgre::Convert::toBullet(pos), MAX_POWERUPS, nearest);
 
-    for(int i = 0; i < MAX_POWERUPS; i++)
-    {
-        if(mPowerups[i])
-            distance = mPowerups[i]->getPosition().distance(pos);
-        else
-            distance = std::numeric_limits<float>::infinity();
-
-        if(distance < minDist)
-        {
-            minDist = distance;
-            ret = mPowerups[i]->getPosition();
-        }
-    }
+    // Skip any collected since the grid was built.
+    for (int i = 0; i < found; i++)
+        if (mPowerups[nearest[i]])
+            return mPowerups[nearest[i]]->getPosition();
 
-    return ret;
+    return Ogre::Vector3(0,0,0);
 }
 
 std::vector<Powerup *> PowerupPool::getPowerups()
@@ -0,0 +1,47 @@
+/**
+ * @file    SimulationClock.cpp
+ * @brief   Divides up frame time into fixed simulation ticks.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SimulationClock.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+SimulationClock::SimulationClock (void)
+{
+    reset();
+}
+
+
+/// @brief  Adds a frame's time to the clock.
+/// @param  seconds  The time since the last frame.
+/// @return The number of ticks which should be simulated this frame, from 0 to SIMULATION_MAX_TICKS.
+int SimulationClock::advance (float seconds)
+{
+    mAccumulator += seconds;
+    int ticks = (int) (mAccumulator / SIMULATION_TICK_SECONDS);
+    mAccumulator -= ticks * SIMULATION_TICK_SECONDS;
+
+    // Rather than trying to catch up after a long frame (which would make the next frame longer still),
+    // drop the time and let the simulation run slow.
+    if (ticks > SIMULATION_MAX_TICKS)
+    {
+        mDroppedTicks += ticks - SIMULATION_MAX_TICKS;
+        ticks = SIMULATION_MAX_TICKS;
+    }
+
+    return ticks;
+}
+
+
+/// @brief  Goes back to tick 0.
+void SimulationClock::reset (void)
+{
+    mTick         = 0;
+    mAccumulator  = 0;
+    mDroppedTicks = 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file    TaskPool.cpp
+ * @brief   A fixed set of worker threads which each tick (physics, AI and networking) is spread across.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "TaskPool.h"
+#include "RakSleep.h"
+#ifndef _WIN32
+    #include <unistd.h>
+#endif
+#include <vector>
+#include <algorithm>
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  A run of indices handed out as one task by TaskPool::parallelFor().
+struct ParallelForChunk
+{
+    TaskFunction function;
+    void        *context;
+    int          begin;
+    int          end;
+};
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Runs a ParallelForChunk.
+static void runParallelForChunk (void *context, int index)
+{
+    ParallelForChunk *chunk = ((ParallelForChunk*) context) + index;
+    for (int i = chunk->begin; i < chunk->end; i++)
+        chunk->function(chunk->context, i);
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor, starting the worker threads.
+/// @param  numThreads  The number of workers, or -1 for one fewer than the number of cores (the main
+///                     thread being the last one).
+TaskPool::TaskPool (int numThreads) : mStopping(false)
+{
+    if (numThreads < 0)
+        numThreads = getNumCores() - 1;
+    if (numThreads > TASK_POOL_MAX_THREADS)
+        numThreads = TASK_POOL_MAX_THREADS;
+    mNumThreads = numThreads;
+
+    mTaskEvent.InitEvent();
+    for (int i = 0; i < mNumThreads; i++)
+    {
+        mRunningThreads.Increment();
+        if (RakNet::RakThread::Create(&TaskPool::workerThread, this) != 0)
+        {
+            mRunningThreads.Decrement();
+            mNumThreads = i;
+            break;
+        }
+    }
+}
+
+
+/// @brief  Deconstructor. Any tasks still queued are run before the workers stop.
+TaskPool::~TaskPool (void)
+{
+    mStopping = true;
+    while (mRunningThreads.GetValue() > 0)
+    {
+        mTaskEvent.SetEvent();
+        RakSleep(1);
+    }
+    mTaskEvent.CloseEvent();
+}
+
+
+/// @brief  Queues a task.
+/// @param  group     The group to add the task to. Must outlive the task.
+/// @param  function  The task.
+/// @param  context   Passed to the task.
+/// @param  index     Passed to the task.
+void TaskPool::submit (TaskGroup &group, TaskFunction function, void *context, int index)
+{
+    Task task;
+    task.function = function;
+    task.context  = context;
+    task.index    = index;
+    task.group    = &group;
+
+    group.pending.Increment();
+    mTasksMutex.Lock();
+    mTasks.push_back(task);
+    mTasksMutex.Unlock();
+    mTaskEvent.SetEvent();
+}
+
+
+/// @brief  Returns once every task in a group has finished, running queued tasks (from any group) while
+///         it waits.
+/// @param  group  The group.
+void TaskPool::wait (TaskGroup &group)
+{
+    while (group.pending.GetValue() > 0)
+    {
+        if (!runTask())
+            RakSleep(0);
+    }
+}
+
+
+/// @brief  Calls a function for every index from 0 to count - 1, split across the workers and the
+///         calling thread, returning once they have all been called. The calls may happen in any order.
+/// @param  count     The number of indices.
+/// @param  function  The function.
+/// @param  context   Passed to the function.
+void TaskPool::parallelFor (int count, TaskFunction function, void *context)
+{
+    if (count <= 0)
+        return;
+
+    // One chunk per thread is the least overhead, but uneven work would leave threads idle at the
+    // end, so the indices are cut up a little finer than that.
+    int numChunks = std::min(count, (mNumThreads + 1) * 4);
+    if (numChunks <= 1)
+    {
+        for (int i = 0; i < count; i++)
+            function(context, i);
+        return;
+    }
+
+    std::vector<ParallelForChunk> chunks(numChunks);
+    TaskGroup group;
+    for (int i = 0; i < numChunks; i++)
+    {
+        chunks[i].function = function;
+        chunks[i].context  = context;
+        chunks[i].begin    = (int) (((long long) count * i) / numChunks);
+        chunks[i].end      = (int) (((long long) count * (i + 1)) / numChunks);
+        submit(group, &runParallelForChunk, &chunks[0], i);
+    }
+    wait(group);
+}
+
+
+/// @brief  Gets the number of cores the machine has.
+/// @return The number of cores, at least 1.
+int TaskPool::getNumCores (void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int cores = (int) info.dwNumberOfProcessors;
+#else
+    int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return cores > 0 ? cores : 1;
+}
+
+
+/// @brief  Takes the next task off the queue and runs it.
+/// @return False if the queue was empty.
+bool TaskPool::runTask (void)
+{
+    mTasksMutex.Lock();
+    if (mTasks.empty())
+    {
+        mTasksMutex.Unlock();
+        return false;
+    }
+    Task task = mTasks.front();
+    mTasks.pop_front();
+    bool more = !mTasks.empty();
+    mTasksMutex.Unlock();
+
+    // The event may only wake one worker per set, so pass it on while there is still work.
+    if (more)
+        mTaskEvent.SetEvent();
+
+    task.function(task.context, task.index);
+    task.group->pending.Decrement();
+    return true;
+}
+
+
+/// @brief  A worker, running tasks until the pool is destroyed.
+RAK_THREAD_DECLARATION(TaskPool::workerThread)
+{
+    TaskPool *pool = (TaskPool*) arguments;
+
+    for (;;)
+    {
+        if (pool->runTask())
+            continue;
+        if (pool->mStopping)
+            break;
+        pool->mTaskEvent.WaitOnEvent(TASK_POOL_IDLE_WAIT_MS);
+    }
+
+    pool->mRunningThreads.Decrement();
+    return 0;
+}
@@ -10,6 +10,8 @@
 #include "PowerupPool.h"
 #include "GameGUI.h"
 #include "PhysicsCore.h"
+#include "SimulationClock.h"
+#include "TaskPool.h"
 
 #ifdef COLLISION_DOMAIN_CLIENT
 #include "ClientGraphics.h"
@@ -30,6 +32,7 @@ class ClientGraphics;
 class AiCore;
 class ServerGraphics;
 #endif
+class TaskPool;
 class SplashScreen;
 class GameGUI;
 class PowerupPool;
@@ -55,8 +58,10 @@ public:
 	static AiCore* mAiCore;
     static ServerGraphics* mServerGraphics;
 #endif
+    static TaskPool* mTaskPool;
     static NetworkCore* mNetworkCore;
     static PhysicsCore* mPhysicsCore;
+    static SimulationClock* mSimulationClock;
 	static GameGUI* mGui;
     static PowerupPool* mPowerupPool;
 	static Gameplay* mGameplay;
@@ -8,6 +8,7 @@
 #include "stdafx.h"
 
 #include "Powerup.h"
+#include "ProximityGrid.h"
 
 #define MAX_POWERUPS 4
 
@@ -22,6 +23,7 @@ public:
     void replaceCurrentPowerups();
 
     Ogre::Vector3 getNearestPowerUp(Ogre::Vector3 pos);
+    void updateProximity();
     Powerup *getPowerup( int id );
     std::vector<Powerup *> getPowerups();
     
@@ -32,6 +34,7 @@ private:
     Powerup *mPowerups[MAX_POWERUPS];
     float    mPowerupsLifetime[MAX_POWERUPS];
     float secondsTilNextSpawn;
+    ProximityGrid mGrid;    // Where the powerups were at the start of the tick, by index.
 };
 
 #endif // #ifndef POWERUPPOOL_H
@@ -0,0 +1,19 @@
+/**
+ * @file    RandomRange.h
+ * @brief   Random numbers for the benchmarks, which scatter cars etc. around an arena.
+ */
+#ifndef RANDOMRANGE_H
+#define RANDOMRANGE_H
+
+/*-------------------- INCLUDES --------------------*/
+#include <stdlib.h>
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+/// @brief  A random float in the range [lo, hi], from rand() (so seeded with srand()).
+inline float randomRange (float lo, float hi)
+{
+    return lo + (hi - lo) * ((float) rand() / (float) RAND_MAX);
+}
+
+#endif // #ifndef RANDOMRANGE_H
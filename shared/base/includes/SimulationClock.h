@@ -0,0 +1,56 @@
+/**
+ * @file    SimulationClock.h
+ * @brief   Divides up frame time into fixed simulation ticks.
+ */
+#ifndef SIMULATIONCLOCK_H
+#define SIMULATIONCLOCK_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define SIMULATION_TICK_RATE        60                                  // Ticks per second.
+#define SIMULATION_TICK_SECONDS     (1.0f / SIMULATION_TICK_RATE)
+#define SIMULATION_TICK_MS          (1000.0 / SIMULATION_TICK_RATE)
+#define SIMULATION_MAX_TICKS        3                                   // Ticks run in one frame before the simulation is allowed to fall behind real time.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Turns variable frame times into a whole number of fixed length ticks. Everything which affects
+ *          the simulation (input, AI, physics) is run once per tick rather than once per frame, so given the
+ *          same input each tick always comes out the same regardless of frame rate. Ticks are numbered so
+ *          the server and clients can talk about exactly which one a snapshot or input belongs to.
+ *
+ *          Usage, each frame:
+ *              int ticks = clock->advance(timeSinceLastFrame);
+ *              for (int i = 0; i < ticks; i++)
+ *              {
+ *                  clock->step();
+ *                  // Simulate one tick of SIMULATION_TICK_SECONDS.
+ *              }
+ */
+class SimulationClock
+{
+public:
+    SimulationClock (void);
+
+    int  advance (float seconds);
+    void step (void) { mTick++; }
+    void reset (void);
+
+    /// @brief  Gets the number of the latest tick simulated (or being simulated).
+    unsigned int getTick (void) const { return mTick; }
+    /// @brief  Gets how far (0 to 1) real time is through the next tick.
+    float getAlpha (void) const { return mAccumulator / SIMULATION_TICK_SECONDS; }
+    /// @brief  Gets the number of ticks dropped because frames were too slow to keep up.
+    unsigned int getDroppedTicks (void) const { return mDroppedTicks; }
+
+private:
+    unsigned int mTick;
+    float        mAccumulator;      ///< Frame time not yet used by a tick.
+    unsigned int mDroppedTicks;
+};
+
+#endif // #ifndef SIMULATIONCLOCK_H
@@ -0,0 +1,76 @@
+/**
+ * @file    TaskPool.h
+ * @brief   A fixed set of worker threads which each tick (physics, AI and networking) is spread across.
+ */
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "RakThread.h"
+#include "SimpleMutex.h"
+#include "SignaledEvent.h"
+#include "LocklessTypes.h"
+#include <deque>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define TASK_POOL_MAX_THREADS   15      // Most worker threads started, whatever the number of cores.
+#define TASK_POOL_IDLE_WAIT_MS  5       // How long an idle worker sleeps before checking for tasks again, in case a wake up was missed.
+
+/// @brief  A task. Called with the context it was submitted with and its index.
+typedef void (*TaskFunction) (void *context, int index);
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  A set of tasks which can be waited on together.
+struct TaskGroup
+{
+    RakNet::LocklessUint32_t pending;       // Tasks submitted which haven't finished yet.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Runs tasks on a worker thread per spare core. Tasks are taken in the order they were submitted.
+ *
+ *          A thread waiting on a group runs queued tasks itself until the group is done rather than
+ *          blocking, so tasks may submit and wait on their own groups (e.g. a parallelFor inside a task)
+ *          without starving the pool. With a single core there are no workers and everything runs on
+ *          the thread which waits, in order.
+ */
+class TaskPool
+{
+public:
+    TaskPool (int numThreads = -1);
+    ~TaskPool (void);
+
+    void submit (TaskGroup &group, TaskFunction function, void *context, int index = 0);
+    void wait (TaskGroup &group);
+    void parallelFor (int count, TaskFunction function, void *context);
+
+    /// @brief  Gets the number of worker threads (not counting the threads which wait on groups).
+    int getNumThreads (void) const { return mNumThreads; }
+    static int getNumCores (void);
+
+private:
+    struct Task
+    {
+        TaskFunction function;
+        void        *context;
+        int          index;
+        TaskGroup   *group;
+    };
+
+    bool runTask (void);
+    static RAK_THREAD_DECLARATION(workerThread);
+
+    std::deque<Task>            mTasks;
+    RakNet::SimpleMutex         mTasksMutex;
+    RakNet::SignaledEvent       mTaskEvent;         ///< Set when a task is queued.
+    int                         mNumThreads;
+    volatile bool               mStopping;
+    RakNet::LocklessUint32_t    mRunningThreads;
+};
+
+#endif // #ifndef TASKPOOL_H
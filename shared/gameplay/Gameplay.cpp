@@ -118,7 +118,10 @@ void Gameplay::cycleGame( bool unload )
     
     // Get the next arena.
     if(unload == true /*&& roundNumber > 0*/)
+    {
+        GameCore::mAiCore->unloadArena();
         GameCore::mServerGraphics->unloadArena(mArenaOrder[roundNumber-1]);
+    }
 
     if(roundNumber > 2)
     {
@@ -136,9 +139,14 @@ void Gameplay::cycleGame( bool unload )
     this->setArenaID(mArenaOrder[roundNumber]);
 
     GameCore::mServerGraphics->loadArena(mArenaOrder[roundNumber]);
+    GameCore::mAiCore->loadArena(GameCore::mServerGraphics->mArenaBody);
+
+    // Load the next round's arena while this one is played.
+    ArenaID nextArena = mArenaOrder[(roundNumber + 1) % 3];
+    GameCore::mServerGraphics->prefetchArena(nextArena);
 
     // Sync those bad boiz up
-    GameCore::mNetworkCore->sendGameSync(mGamemodeOrder[roundNumber], mArenaOrder[roundNumber]);
+    GameCore::mNetworkCore->sendGameSync(mGamemodeOrder[roundNumber], mArenaOrder[roundNumber], nextArena);
 #endif
 }
 
@@ -0,0 +1,166 @@
+/**
+ * @file    ArenaStreamer.cpp
+ * @brief   Loads the next arena in the background while the current round is played, so that changing
+            arena between rounds only has to swap it in.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "ArenaStreamer.h"
+#include "CookedTrimesh.h"
+#include "GameCore.h"
+#include "SuperFastHash.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+ArenaStreamer::ArenaStreamer (void) : mArena(ARENA_COUNT), mCooked(NULL), mStarted(false), mFinished(true)
+{
+    mFinishedEvent.InitEvent();
+}
+
+
+/// @brief  Destructor. Waits for a prefetch which is still running.
+ArenaStreamer::~ArenaStreamer (void)
+{
+    finish();
+    delete mCooked;
+    mFinishedEvent.CloseEvent();
+}
+
+
+/// @brief  Starts prefetching an arena, throwing away one prefetched before which hasn't been taken.
+/// @param  aid  The arena.
+void ArenaStreamer::prefetch (ArenaID aid)
+{
+    if (mStarted && mArena == aid)
+        return;
+
+    finish();
+    delete mCooked;
+    mCooked = NULL;
+
+    // Everything which touches Ogre's resources is done here, on the main thread. The thread only reads the stream.
+    mArena    = aid;
+    mPath     = getCookedPath(aid);
+    mSource   = Ogre::ResourceGroupManager::getSingleton().openResource(getCollisionMeshName(aid));
+    mStarted  = true;
+    mFinished = false;
+
+#ifdef COLLISION_DOMAIN_CLIENT
+    // These are read in the background if Ogre was built with threads, otherwise they are read now.
+    std::vector<std::string> meshNames;
+    getMeshNames(aid, meshNames);
+    for (size_t i = 0; i < meshNames.size(); i++)
+    {
+        const std::string &group = Ogre::ResourceGroupManager::getSingleton().findGroupContainingResource(meshNames[i]);
+        Ogre::ResourceBackgroundQueue::getSingleton().prepare(Ogre::MeshManager::getSingleton().getResourceType(), meshNames[i], group);
+    }
+#endif
+
+    if (RakNet::RakThread::Create(&ArenaStreamer::prefetchThread, this) != 0)
+        prefetchThread(this);
+}
+
+
+/// @brief  Takes an arena's collision mesh from the prefetch, waiting for it to finish first if need be.
+/// @param  aid  The arena.
+/// @return The collision mesh, or NULL if the arena wasn't prefetched or couldn't be. It belongs to the caller.
+CookedTrimesh* ArenaStreamer::take (ArenaID aid)
+{
+    if (!mStarted || mArena != aid)
+        return NULL;
+
+    finish();
+    mStarted = false;
+    mSource.setNull();
+
+    CookedTrimesh *cooked = mCooked;
+    mCooked = NULL;
+    return cooked;
+}
+
+
+/// @brief  Gets the name of the mesh an arena's collision shape is built from.
+std::string ArenaStreamer::getCollisionMeshName (ArenaID aid)
+{
+    return "arena" + boost::lexical_cast<std::string>(aid + 1) + "_collision.mesh";
+}
+
+
+/// @brief  Gets the file an arena's collision shape is cooked to.
+std::string ArenaStreamer::getCookedPath (ArenaID aid)
+{
+    return COOKED_TRIMESH_PATH "arena" + boost::lexical_cast<std::string>(aid + 1) + "_collision.bvh";
+}
+
+
+/// @brief  Gets the hash of the mesh an arena's collision shape is built from, which its cooked file must match.
+unsigned int ArenaStreamer::getCollisionMeshHash (ArenaID aid)
+{
+    Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(getCollisionMeshName(aid));
+    return hashCollisionMesh(stream.get());
+}
+
+
+/// @brief  Hashes a collision mesh file's contents, so that a cooked file is rebuilt whenever the mesh is
+///         re-exported, even if it comes out the same size. Reads from wherever the stream is up to.
+/// @param  stream  The mesh file.
+/// @return The hash.
+unsigned int ArenaStreamer::hashCollisionMesh (Ogre::DataStream *stream)
+{
+    std::vector<char> block(ARENA_STREAMER_HASH_BLOCK);
+    unsigned int hash = (unsigned int) stream->size();
+    size_t read;
+    while ((read = stream->read(&block[0], block.size())) > 0)
+        hash = SuperFastHashIncremental(&block[0], (int) read, hash);
+    return hash;
+}
+
+
+/// @brief  Gets the meshes SceneSetup::loadArenaGraphics() draws an arena with.
+/// @param  aid        The arena.
+/// @param  meshNames  Filled with the names of the meshes.
+void ArenaStreamer::getMeshNames (ArenaID aid, std::vector<std::string> &meshNames)
+{
+    meshNames.clear();
+    meshNames.push_back("arena" + boost::lexical_cast<std::string>(aid + 1) + ".mesh");
+
+    if (aid == FOREST_ARENA)
+    {
+        for (int i = 1; i <= 5; i++)
+        {
+            meshNames.push_back("birch" + boost::lexical_cast<std::string>(i) + "_lp.mesh");
+            meshNames.push_back("birch" + boost::lexical_cast<std::string>(i) + "_slp.mesh");
+        }
+    }
+    else
+    {
+        meshNames.push_back("arena" + boost::lexical_cast<std::string>(aid + 1) + "_props.mesh");
+    }
+}
+
+
+/// @brief  Waits for the prefetch thread to be done.
+void ArenaStreamer::finish (void)
+{
+    while (!mFinished)
+        mFinishedEvent.WaitOnEvent(ARENA_STREAMER_WAIT_MS);
+}
+
+
+/// @brief  Maps an arena's cooked collision mesh and reads it in.
+RAK_THREAD_DECLARATION(ArenaStreamer::prefetchThread)
+{
+    ArenaStreamer *streamer = (ArenaStreamer*) arguments;
+
+    unsigned int sourceHash = hashCollisionMesh(streamer->mSource.get());
+    streamer->mCooked = CookedTrimesh::load(streamer->mPath, sourceHash, MESH_SCALING_CONSTANT);
+    if (streamer->mCooked != NULL)
+        streamer->mCooked->touch();
+
+    streamer->mFinished = true;
+    streamer->mFinishedEvent.SetEvent();
+    return 0;
+}
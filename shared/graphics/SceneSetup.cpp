@@ -7,6 +7,9 @@
 #include "SceneSetup.h"
 #include "GameCore.h"
 #include "MeshDeformer.h"
+#include "SnapshotCodec.h"
+#include "CookedTrimesh.h"
+#include "ArenaStreamer.h"
 
 bool SceneSetup::guiSetup = false;
 
@@ -23,13 +26,18 @@ SceneSetup::SceneSetup (void) : mWindow(0),
                                 #ifdef COMPOSITOR_MOTION_BLUR
                                     mGfxSettingMotionBlur(1.0f),
                                 #endif
-                                mArenaBody(NULL)
+                                mArenaBody(NULL),
+                                mArenaShape(NULL),
+                                mCookedArena(NULL)
 {
+    mArenaStreamer = new ArenaStreamer();
 }
 
 
 SceneSetup::~SceneSetup (void)
 {
+    delete mArenaStreamer;
+    delete mCookedArena;
 }
 
 
@@ -268,41 +276,25 @@ void SceneSetup::setupParticleSystem (void)
 ///         once during the initialisation of the 3D graphics.
 void SceneSetup::setupArenaNodes (void)
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Nothing is drawn on the headless server, so the arena is only its body.
+    arenaNode = NULL;
+#else
     // First create the arena node
     arenaNode = GameCore::mSceneMgr->getRootSceneNode()->createChildSceneNode("ArenaNode");
     GameCore::mPhysicsCore->auto_scale_scenenode(arenaNode);
+#endif
     GameCore::mPhysicsCore->createCollisionShapes();
     log( "done the collision shapes" );
 }
 
-void SceneSetup::createArenaCollisionShapes (void)
-{
-    for( int i = 0; i < ARENA_COUNT; i ++ )
-    {
-        std::string strMesh;
-        strMesh = "arena" + boost::lexical_cast<std::string>(i + 1) + "_collision.mesh";
-
-        Ogre::Entity* collisionEntity = GameCore::mSceneMgr->createEntity(strMesh, strMesh);
-
-        Ogre::Matrix4 collisionScaling(MESH_SCALING_CONSTANT, 0,                     0,                     0,
-                                       0,                     MESH_SCALING_CONSTANT, 0,                     0,
-                                       0,                     0,                     MESH_SCALING_CONSTANT, 0,
-                                       0,                     0,                     0,                     1);
-    
-        BtOgre::StaticMeshToShapeConverter collisionShapeConverter(collisionEntity, collisionScaling);
-        btCollisionShape *collisionShape = collisionShapeConverter.createTrimesh();
-
-        GameCore::mPhysicsCore->setCollisionShape( (PHYS_SHAPE)((int)PHYS_SHAPE_COLOSSEUM + i), collisionShape );
-    }
-}
-
 /// @brief  Loads the given arena.
 /// @param  aid     The ArenaID of the arena to load.
 /// @param  server  Whether it is the server loading the arena (if false the graphics will also be loaded).
 void SceneSetup::loadArena (ArenaID aid)
 {
     // Check we have been legitimately called
-    if (arenaNode->numAttachedObjects() != 0)
+    if (arenaNode != NULL && arenaNode->numAttachedObjects() != 0)
     {
         OutputDebugString("OH SHEESH YA'LL LOADARENA CALLED WHILE AN ARENA WAS LOADED - gonna go crash now lol.\n");
         throw Ogre::Exception::ERR_INVALID_STATE;
@@ -331,6 +323,14 @@ void SceneSetup::unloadArena (ArenaID aid)
 }
 
 
+/// @brief  Starts loading an arena in the background, to be swapped in by loadArena() later.
+/// @param  aid  The arena which will be loaded next.
+void SceneSetup::prefetchArena (ArenaID aid)
+{
+    mArenaStreamer->prefetch(aid);
+}
+
+
 /// @brief  Loads the graphics for the supplied arena.
 /// @param  aid The ArenaID of the arena to load.
 void SceneSetup::loadArenaGraphics (ArenaID aid)
@@ -481,11 +481,16 @@ void SceneSetup::unloadArenaGraphics (ArenaID aid)
 /// @param  aid The ArenaID of the arena to load.
 void SceneSetup::loadArenaPhysics (ArenaID aid)
 {
-    // Load the arena node
-    Ogre::SceneNode* arenaNode = GameCore::mSceneMgr->getSceneNode("ArenaNode");
+    loadArenaCollisionShape(aid);
 
     // Construct the collision body (mArenaBody is filled with a nice, firm, rigid body)
     mArenaBody = GameCore::mPhysicsCore->createArenaBody(arenaNode, aid);
+
+    // Car positions are sent over the network relative to the arena's bounds.
+    btVector3 aabbMin, aabbMax;
+    mArenaBody->getCollisionShape()->getAabb(mArenaBody->getWorldTransform(), aabbMin, aabbMax);
+    SnapshotCodec::setArenaBounds(aabbMin, aabbMax);
+    GameCore::mPhysicsCore->fitBroadphase(aabbMin, aabbMax);
 }
 
 
@@ -494,6 +499,80 @@ void SceneSetup::loadArenaPhysics (ArenaID aid)
 void SceneSetup::unloadArenaPhysics (ArenaID aid)
 {
     GameCore::mPhysicsCore->removeBody( mArenaBody );
+    delete mArenaBody;
+    mArenaBody = NULL;
+
+    unloadArenaCollisionShape(aid);
+}
+
+
+/// @brief  Gets an arena's collision shape ready. A prefetched arena only has to be swapped in; one which
+///         wasn't is mapped from its cooked file, or built from its mesh and cooked if there is no such file.
+/// @param  aid The ArenaID of the arena.
+void SceneSetup::loadArenaCollisionShape (ArenaID aid)
+{
+    std::string strCooked = ArenaStreamer::getCookedPath(aid);
+
+    mCookedArena = mArenaStreamer->take(aid);
+    if (mCookedArena == NULL)
+    {
+        unsigned int sourceHash = ArenaStreamer::getCollisionMeshHash(aid);
+        mCookedArena = CookedTrimesh::load(strCooked, sourceHash, MESH_SCALING_CONSTANT);
+
+        if (mCookedArena == NULL)
+        {
+            // Only the mesh's geometry is needed. An entity would compile its materials, which needs a render system.
+            std::string strMesh = ArenaStreamer::getCollisionMeshName(aid);
+            Ogre::MeshPtr collisionMesh = Ogre::MeshManager::getSingleton().load(strMesh, Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+
+            Ogre::Matrix4 collisionScaling(MESH_SCALING_CONSTANT, 0,                     0,                     0,
+                                           0,                     MESH_SCALING_CONSTANT, 0,                     0,
+                                           0,                     0,                     MESH_SCALING_CONSTANT, 0,
+                                           0,                     0,                     0,                     1);
+
+            BtOgre::StaticMeshToShapeConverter collisionShapeConverter;
+            collisionShapeConverter.addMesh(collisionMesh, collisionScaling);
+            mArenaShape = collisionShapeConverter.createTrimesh();
+            Ogre::MeshManager::getSingleton().remove(collisionMesh->getHandle());
+
+            // Use the cooked file from now on if it could be written, so every arena's shape is held the same way.
+            if (CookedTrimesh::cook(mArenaShape, strCooked, sourceHash, MESH_SCALING_CONSTANT))
+                mCookedArena = CookedTrimesh::load(strCooked, sourceHash, MESH_SCALING_CONSTANT);
+            else
+                OutputDebugString(("Couldn't cook " + strCooked + ".\n").c_str());
+
+            if (mCookedArena != NULL)
+            {
+                delete mArenaShape->getMeshInterface();
+                delete mArenaShape;
+                mArenaShape = NULL;
+            }
+        }
+    }
+
+    if (mCookedArena != NULL)
+        GameCore::mPhysicsCore->setCollisionShape( (PHYS_SHAPE)((int)PHYS_SHAPE_COLOSSEUM + aid), mCookedArena->getShape() );
+    else
+        GameCore::mPhysicsCore->setCollisionShape( (PHYS_SHAPE)((int)PHYS_SHAPE_COLOSSEUM + aid), mArenaShape );
+}
+
+
+/// @brief  Frees an arena's collision shape. Nothing may be using it.
+/// @param  aid The ArenaID of the arena.
+void SceneSetup::unloadArenaCollisionShape (ArenaID aid)
+{
+    GameCore::mPhysicsCore->setCollisionShape( (PHYS_SHAPE)((int)PHYS_SHAPE_COLOSSEUM + aid), NULL );
+
+    delete mCookedArena;
+    mCookedArena = NULL;
+
+    if (mArenaShape != NULL)
+    {
+        btStridingMeshInterface *mesh = mArenaShape->getMeshInterface();
+        delete mArenaShape;
+        delete mesh;
+        mArenaShape = NULL;
+    }
 }
 
 
@@ -626,6 +705,7 @@ void SceneSetup::setupMeshDeformer (void)
 }
 
 
+#ifndef COLLISION_DOMAIN_HEADLESS
 void SceneSetup::setupGUI (void)
 {
     if (!guiSetup)
@@ -675,6 +755,7 @@ void SceneSetup::setupGUI (void)
         guiSetup = true;
     }
 }
+#endif
 
 
 /// @brief  Builds the compositor chain which adds post filters to the rendered image before being displayed.
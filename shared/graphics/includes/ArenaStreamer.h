@@ -0,0 +1,63 @@
+/**
+ * @file    ArenaStreamer.h
+ * @brief   Loads the next arena in the background while the current round is played, so that changing
+            arena between rounds only has to swap it in.
+ */
+#ifndef ARENASTREAMER_H
+#define ARENASTREAMER_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SceneSetup.h"
+#include "RakThread.h"
+#include "SignaledEvent.h"
+#include <string>
+#include <vector>
+
+class CookedTrimesh;
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define ARENA_STREAMER_WAIT_MS      10      // How long take() sleeps between checks on an unfinished prefetch.
+#define ARENA_STREAMER_HASH_BLOCK   65536   // How much of a collision mesh is read at a time to hash it.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Prefetches one arena at a time on its own thread (rather than the TaskPool, so that a slow
+ *          disk never holds up a tick waiting on the pool).
+ *
+ *          The thread hashes the arena's collision mesh, then maps its cooked collision mesh (if it was
+ *          cooked from that mesh) and reads every page of it in. On the
+ *          client the arena's meshes are also queued with Ogre's ResourceBackgroundQueue to be read.
+ *          An arena which has never been cooked can't be prefetched, and is built when it is loaded.
+ */
+class ArenaStreamer
+{
+public:
+    ArenaStreamer (void);
+    ~ArenaStreamer (void);
+
+    void prefetch (ArenaID aid);
+    CookedTrimesh* take (ArenaID aid);
+
+    static std::string getCollisionMeshName (ArenaID aid);
+    static std::string getCookedPath (ArenaID aid);
+    static unsigned int getCollisionMeshHash (ArenaID aid);
+    static unsigned int hashCollisionMesh (Ogre::DataStream *stream);
+    static void getMeshNames (ArenaID aid, std::vector<std::string> &meshNames);
+
+private:
+    void finish (void);
+    static RAK_THREAD_DECLARATION(prefetchThread);
+
+    ArenaID                 mArena;         ///< The arena being prefetched.
+    std::string             mPath;
+    Ogre::DataStreamPtr     mSource;        ///< The collision mesh, opened on the main thread for the thread to hash.
+    CookedTrimesh          *mCooked;        ///< Set by the thread. NULL if the arena couldn't be prefetched.
+    bool                    mStarted;       ///< A prefetch has been started and not yet taken.
+    volatile bool           mFinished;      ///< Set by the thread when it is done.
+    RakNet::SignaledEvent   mFinishedEvent;
+};
+
+#endif // #ifndef ARENASTREAMER_H
@@ -64,6 +64,8 @@
 
 //------------------------------ CLASSES ------------------------------//
 class MeshDeformer;
+class CookedTrimesh;
+class ArenaStreamer;
 /**
  *  @brief     Will contain PlayerPool, PhysicsCore, AudioCore etc.
  */
@@ -96,9 +98,9 @@ public:
     void setRadialBlur (Ogre::Viewport* vp, float blur);
 #endif
 
-    void createArenaCollisionShapes();
     void loadArena (ArenaID aid);
     void unloadArena (ArenaID aid);
+    void prefetchArena (ArenaID aid);
 
     // Graphical effect settings. Adjusts the scale of the effect - default is 1.
 #ifdef COMPOSITOR_HDR
@@ -135,7 +137,9 @@ public:
 
     MeshDeformer*  mMeshDeformer;
     Ogre::RenderWindow* mWindow;
+#ifndef COLLISION_DOMAIN_HEADLESS
 	CEGUI::Window* mGUIWindow;
+#endif
 
     btRigidBody *mArenaBody;
 
@@ -152,21 +156,30 @@ protected:
     void unloadArenaGraphics (ArenaID aid);
     void loadArenaPhysics (ArenaID aid);
     void unloadArenaPhysics (ArenaID aid);
+    void loadArenaCollisionShape (ArenaID aid);
+    void unloadArenaCollisionShape (ArenaID aid);
     void loadArenaLighting (ArenaID aid);
     
     void setupMeshDeformer (void);
+#ifndef COLLISION_DOMAIN_HEADLESS
     virtual void setupGUI (void);
+#endif
     virtual void setupUserInput (void) = 0;
 
 #ifdef COMPOSITOR_MOTION_BLUR
     void createMotionBlurCompositor (void);
 #endif
     
+#ifndef COLLISION_DOMAIN_HEADLESS
     // GUI elements which are setup.
     CEGUI::OgreRenderer* mGUIRenderer;
+#endif
 
     // Scene elements which are setup.
     Ogre::SceneNode* arenaNode;
+    btBvhTriangleMeshShape* mArenaShape;    ///< The arena's collision shape when it couldn't be cooked.
+    CookedTrimesh*   mCookedArena;          ///< The arena's collision shape, mapped from its cooked file.
+    ArenaStreamer*   mArenaStreamer;
     Ogre::Light*     mWorldSun;
     Ogre::SceneNode* mVIPIcon[2]; ///< This is completely not the place for this but I'm waiting
                                   //   for a better place (in the team class for example) to be 
@@ -0,0 +1,73 @@
+/**
+ * @file    InputCommand.cpp
+ * @brief   The compact per-tick input commands clients send to the server.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "InputCommand.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Packs the buttons of an input state into INPUT_BUTTON flags.
+/// @param  input  The input state.
+/// @return The flags.
+unsigned char InputCommandCodec::toButtons (InputState *input)
+{
+    unsigned char buttons = 0;
+    if (input->isForward())   buttons |= INPUT_FORWARD;
+    if (input->isBack())      buttons |= INPUT_BACK;
+    if (input->isLeft())      buttons |= INPUT_LEFT;
+    if (input->isRight())     buttons |= INPUT_RIGHT;
+    if (input->isHandbrake()) buttons |= INPUT_HANDBRAKE;
+    return buttons;
+}
+
+
+/// @brief  Unpacks INPUT_BUTTON flags into an input state.
+/// @param  buttons  The flags.
+/// @return The input state.
+InputState InputCommandCodec::toInputState (unsigned char buttons)
+{
+    return InputState((buttons & INPUT_FORWARD) != 0, (buttons & INPUT_BACK) != 0, (buttons & INPUT_LEFT) != 0,
+                      (buttons & INPUT_RIGHT) != 0, (buttons & INPUT_HANDBRAKE) != 0);
+}
+
+
+/// @brief  Writes a run of consecutive commands to a BitStream.
+/// @param  bitStream  The stream to write to.
+/// @param  commands   The commands, newest first.
+/// @param  count      The number of commands, from 1 to INPUT_REDUNDANCY.
+void InputCommandCodec::write (RakNet::BitStream *bitStream, const InputCommand *commands, int count)
+{
+    bitStream->Write(commands[0].tick);
+    bitStream->WriteBitsFromIntegerRange((unsigned int) count, 1u, (unsigned int) INPUT_REDUNDANCY, INPUT_COUNT_BITS);
+    for (int i = 0; i < count; i++)
+        bitStream->WriteBitsFromIntegerRange((unsigned int) commands[i].buttons, 0u, (1u << INPUT_BUTTON_BITS) - 1u, INPUT_BUTTON_BITS);
+}
+
+
+/// @brief  Reads a run of consecutive commands from a BitStream.
+/// @param  bitStream  The stream to read from.
+/// @param  commands   Filled with the commands, newest first. Must have room for INPUT_REDUNDANCY.
+/// @return The number of commands read, or 0 if the stream was too short.
+int InputCommandCodec::read (RakNet::BitStream *bitStream, InputCommand *commands)
+{
+    unsigned short newestTick;
+    unsigned int count;
+    if (!bitStream->Read(newestTick) || !bitStream->ReadBitsFromIntegerRange(count, 1u, (unsigned int) INPUT_REDUNDANCY, INPUT_COUNT_BITS))
+        return 0;
+    if (count < 1 || count > INPUT_REDUNDANCY)
+        return 0;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int buttons;
+        if (!bitStream->ReadBitsFromIntegerRange(buttons, 0u, (1u << INPUT_BUTTON_BITS) - 1u, INPUT_BUTTON_BITS))
+            return 0;
+        commands[i].tick    = (unsigned short) (newestTick - i);
+        commands[i].buttons = (unsigned char) buttons;
+    }
+    return (int) count;
+}
@@ -0,0 +1,653 @@
+/**
+ * @file    SnapshotCodec.cpp
+ * @brief   Packs car snapshots into as few bits as possible before they are sent over the network.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SnapshotCodec.h"
+#include "GetTime.h"
+#include "RandomRange.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define SQRT_HALF 0.707106781f  // The largest value the three smallest components of a unit quaternion can take.
+
+// Default bounds, used until an arena is loaded.
+btVector3 SnapshotCodec::mBoundsMin(-256.0f, -64.0f, -256.0f);
+btVector3 SnapshotCodec::mBoundsMax( 256.0f, 192.0f, 256.0f);
+int       SnapshotCodec::mPositionBits[3] = { 19, 18, 19 };
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Maps a value in the range [-maxValue, maxValue] onto an unsigned integer of the given number
+///         of bits. Zero maps exactly onto the middle of the range so stationary cars don't jitter.
+static unsigned int quantizeSigned (float value, float maxValue, int bits)
+{
+    int halfRange = (1 << (bits - 1)) - 1;
+    float scaled = value / maxValue;
+    if (scaled > 1.0f)
+        scaled = 1.0f;
+    else if (scaled < -1.0f)
+        scaled = -1.0f;
+
+    return (unsigned int) ((halfRange + 1) + (int) floorf(scaled * halfRange + 0.5f));
+}
+
+/// @brief  Reverses quantizeSigned().
+static float dequantizeSigned (unsigned int value, float maxValue, int bits)
+{
+    int halfRange = (1 << (bits - 1)) - 1;
+    return ((int) value - (halfRange + 1)) * maxValue / halfRange;
+}
+
+/// @brief  Reads an unsigned value of the given number of bits.
+static bool readBits (RakNet::BitStream *bitStream, unsigned int &value, int bits)
+{
+    return bitStream->ReadBitsFromIntegerRange(value, 0u, (1u << bits) - 1, bits);
+}
+
+/// @brief  Writes an unsigned value of the given number of bits.
+static void writeBits (RakNet::BitStream *bitStream, unsigned int value, int bits)
+{
+    bitStream->WriteBitsFromIntegerRange(value, 0u, (1u << bits) - 1, bits);
+}
+
+/// @brief  Compares two quantized states field by field (memcmp would also compare the struct padding).
+static bool statesEqual (const QuantizedCarState &a, const QuantizedCarState &b)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (a.position[i]        != b.position[i]        ||
+            a.rotation[i]        != b.rotation[i]        ||
+            a.linearVelocity[i]  != b.linearVelocity[i]  ||
+            a.angularVelocity[i] != b.angularVelocity[i])
+            return false;
+    }
+    return a.rotationLargest == b.rotationLargest && a.wheelPosition == b.wheelPosition;
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Sets the volume which positions are quantized within. Called whenever an arena is loaded.
+///         Client and server must agree on this, so the bounds are rounded out to whole metres in case
+///         their copies of the arena's AABB differ by a floating point hair.
+/// @param  aabbMin  The minimum corner of the arena's AABB.
+/// @param  aabbMax  The maximum corner of the arena's AABB.
+void SnapshotCodec::setArenaBounds (const btVector3 &aabbMin, const btVector3 &aabbMax)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        btScalar lo = floorf(aabbMin[axis] - SNAPSHOT_ARENA_MARGIN);
+        btScalar hi = ceilf(aabbMax[axis] + SNAPSHOT_ARENA_MARGIN);
+        unsigned int steps = (unsigned int) ((hi - lo) / SNAPSHOT_POSITION_PRECISION);
+
+        int bits = 1;
+        while (bits < SNAPSHOT_POSITION_MAX_BITS && (1u << bits) <= steps)
+            bits++;
+
+        mBoundsMin[axis]    = lo;
+        mBoundsMax[axis]    = lo + ((1u << bits) - 1) * SNAPSHOT_POSITION_PRECISION;
+        mPositionBits[axis] = bits;
+    }
+}
+
+
+/// @brief  Writes the volume positions are quantized within, for a client which hasn't loaded the arena's
+///         collision mesh to work it out for itself (such as a bot in the bot swarm).
+/// @param  bitStream  The stream to write to.
+void SnapshotCodec::writeArenaBounds (RakNet::BitStream *bitStream)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        bitStream->Write((float) mBoundsMin[axis]);
+        bitStream->Write((unsigned char) mPositionBits[axis]);
+    }
+}
+
+
+/// @brief  Reads the volume positions are quantized within, as written by writeArenaBounds().
+/// @param  bitStream  The stream to read from.
+/// @return False if the stream was too short, in which case the bounds are unchanged.
+bool SnapshotCodec::readArenaBounds (RakNet::BitStream *bitStream)
+{
+    float         lo[3];
+    unsigned char bits[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (!bitStream->Read(lo[axis]) || !bitStream->Read(bits[axis]) || bits[axis] < 1 || bits[axis] > SNAPSHOT_POSITION_MAX_BITS)
+            return false;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        mBoundsMin[axis]    = lo[axis];
+        mBoundsMax[axis]    = lo[axis] + ((1u << bits[axis]) - 1) * SNAPSHOT_POSITION_PRECISION;
+        mPositionBits[axis] = bits[axis];
+    }
+    return true;
+}
+
+
+/// @brief  Quantizes a snapshot. Values outside of the representable range are clamped.
+/// @param  snapshot  The snapshot to quantize.
+/// @param  state     Filled with the quantized snapshot.
+void SnapshotCodec::quantize (const CarSnapshot &snapshot, QuantizedCarState &state)
+{
+    // Position, as fixed point within the arena bounds.
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float steps = floorf((snapshot.mPosition[axis] - mBoundsMin[axis]) / SNAPSHOT_POSITION_PRECISION + 0.5f);
+        unsigned int maxSteps = (1u << mPositionBits[axis]) - 1;
+        if (steps < 0.0f)
+            state.position[axis] = 0;
+        else if (steps > maxSteps)
+            state.position[axis] = maxSteps;
+        else
+            state.position[axis] = (unsigned int) steps;
+    }
+
+    // Rotation, using the smallest three components. The largest is dropped and rebuilt from the
+    // others on the other end, after flipping the quaternion (which is the same rotation) so it is positive.
+    btQuaternion q = snapshot.mRotation.normalized();
+    float components[4] = { q.x(), q.y(), q.z(), q.w() };
+    int largest = 0;
+    for (int i = 1; i < 4; i++)
+        if (fabs(components[i]) > fabs(components[largest]))
+            largest = i;
+    float sign = (components[largest] < 0.0f) ? -1.0f : 1.0f;
+
+    state.rotationLargest = (unsigned char) largest;
+    for (int i = 0, j = 0; i < 4; i++)
+        if (i != largest)
+            state.rotation[j++] = (unsigned short) quantizeSigned(components[i] * sign, SQRT_HALF, SNAPSHOT_ROTATION_BITS);
+
+    // Velocities and steering.
+    for (int axis = 0; axis < 3; axis++)
+    {
+        state.linearVelocity[axis]  = (unsigned short) quantizeSigned(snapshot.mLinearVelocity[axis],  SNAPSHOT_LINEAR_VEL_MAX,  SNAPSHOT_LINEAR_VEL_BITS);
+        state.angularVelocity[axis] = (unsigned short) quantizeSigned(snapshot.mAngularVelocity[axis], SNAPSHOT_ANGULAR_VEL_MAX, SNAPSHOT_ANGULAR_VEL_BITS);
+    }
+    state.wheelPosition = (unsigned char) quantizeSigned(snapshot.mWheelPosition, 1.0f, SNAPSHOT_WHEEL_BITS);
+}
+
+
+/// @brief  Turns a quantized state back into a snapshot which can be applied to a car.
+/// @param  state  The quantized state.
+/// @return A new CarSnapshot, which the caller is responsible for deleting.
+CarSnapshot* SnapshotCodec::dequantize (const QuantizedCarState &state)
+{
+    CarSnapshot *snapshot = new CarSnapshot();
+    dequantize(state, *snapshot);
+    return snapshot;
+}
+
+
+/// @brief  Turns a quantized state back into a snapshot which can be applied to a car.
+/// @param  state     The quantized state.
+/// @param  snapshot  The snapshot to fill in.
+void SnapshotCodec::dequantize (const QuantizedCarState &state, CarSnapshot &snapshot)
+{
+    btVector3 position;
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        position[axis]        = mBoundsMin[axis] + state.position[axis] * SNAPSHOT_POSITION_PRECISION;
+        linearVelocity[axis]  = dequantizeSigned(state.linearVelocity[axis],  SNAPSHOT_LINEAR_VEL_MAX,  SNAPSHOT_LINEAR_VEL_BITS);
+        angularVelocity[axis] = dequantizeSigned(state.angularVelocity[axis], SNAPSHOT_ANGULAR_VEL_MAX, SNAPSHOT_ANGULAR_VEL_BITS);
+    }
+
+    float components[4];
+    float sumSquares = 0.0f;
+    for (int i = 0, j = 0; i < 4; i++)
+    {
+        if (i == state.rotationLargest)
+            continue;
+        components[i] = dequantizeSigned(state.rotation[j++], SQRT_HALF, SNAPSHOT_ROTATION_BITS);
+        sumSquares += components[i] * components[i];
+    }
+    components[state.rotationLargest] = (sumSquares < 1.0f) ? sqrtf(1.0f - sumSquares) : 0.0f;
+    btQuaternion rotation(components[0], components[1], components[2], components[3]);
+    rotation.normalize();
+
+    snapshot.mPosition        = position;
+    snapshot.mRotation        = rotation;
+    snapshot.mAngularVelocity = angularVelocity;
+    snapshot.mLinearVelocity  = linearVelocity;
+    snapshot.mWheelPosition   = dequantizeSigned(state.wheelPosition, 1.0f, SNAPSHOT_WHEEL_BITS);
+}
+
+
+/// @brief  Writes a quantized state to a BitStream.
+/// @param  bitStream  The stream to write to.
+/// @param  state      The state to write.
+/// @param  baseline   A state the receiver already has, which state will be delta encoded against. If
+///                    this is NULL the state is written in full.
+void SnapshotCodec::write (RakNet::BitStream *bitStream, const QuantizedCarState &state, const QuantizedCarState *baseline)
+{
+    bitStream->Write(baseline != NULL);
+
+    if (baseline == NULL)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            writeBits(bitStream, state.position[axis], mPositionBits[axis]);
+        writeBits(bitStream, state.rotationLargest, 2);
+        for (int i = 0; i < 3; i++)
+            writeBits(bitStream, state.rotation[i], SNAPSHOT_ROTATION_BITS);
+        for (int axis = 0; axis < 3; axis++)
+            writeBits(bitStream, state.linearVelocity[axis], SNAPSHOT_LINEAR_VEL_BITS);
+        for (int axis = 0; axis < 3; axis++)
+            writeBits(bitStream, state.angularVelocity[axis], SNAPSHOT_ANGULAR_VEL_BITS);
+        writeBits(bitStream, state.wheelPosition, SNAPSHOT_WHEEL_BITS);
+        return;
+    }
+
+    // Each group of fields is preceded by a bit saying whether it has changed at all, so a car which
+    // is sat still costs a handful of bits.
+    bool changed = state.position[0] != baseline->position[0] || state.position[1] != baseline->position[1] || state.position[2] != baseline->position[2];
+    bitStream->Write(changed);
+    if (changed)
+        for (int axis = 0; axis < 3; axis++)
+            writeComponent(bitStream, state.position[axis], baseline->position[axis], mPositionBits[axis], SNAPSHOT_POSITION_DELTA_BITS);
+
+    changed = state.rotationLargest != baseline->rotationLargest || state.rotation[0] != baseline->rotation[0]
+           || state.rotation[1] != baseline->rotation[1] || state.rotation[2] != baseline->rotation[2];
+    bitStream->Write(changed);
+    if (changed)
+    {
+        // The components can only be delta encoded if the same one was dropped in the baseline.
+        bool sameLargest = state.rotationLargest == baseline->rotationLargest;
+        bitStream->Write(sameLargest);
+        if (sameLargest)
+        {
+            for (int i = 0; i < 3; i++)
+                writeComponent(bitStream, state.rotation[i], baseline->rotation[i], SNAPSHOT_ROTATION_BITS, SNAPSHOT_VELOCITY_DELTA_BITS);
+        }
+        else
+        {
+            writeBits(bitStream, state.rotationLargest, 2);
+            for (int i = 0; i < 3; i++)
+                writeBits(bitStream, state.rotation[i], SNAPSHOT_ROTATION_BITS);
+        }
+    }
+
+    changed = state.linearVelocity[0] != baseline->linearVelocity[0] || state.linearVelocity[1] != baseline->linearVelocity[1]
+           || state.linearVelocity[2] != baseline->linearVelocity[2];
+    bitStream->Write(changed);
+    if (changed)
+        for (int axis = 0; axis < 3; axis++)
+            writeComponent(bitStream, state.linearVelocity[axis], baseline->linearVelocity[axis], SNAPSHOT_LINEAR_VEL_BITS, SNAPSHOT_VELOCITY_DELTA_BITS);
+
+    changed = state.angularVelocity[0] != baseline->angularVelocity[0] || state.angularVelocity[1] != baseline->angularVelocity[1]
+           || state.angularVelocity[2] != baseline->angularVelocity[2];
+    bitStream->Write(changed);
+    if (changed)
+        for (int axis = 0; axis < 3; axis++)
+            writeComponent(bitStream, state.angularVelocity[axis], baseline->angularVelocity[axis], SNAPSHOT_ANGULAR_VEL_BITS, SNAPSHOT_VELOCITY_DELTA_BITS);
+
+    changed = state.wheelPosition != baseline->wheelPosition;
+    bitStream->Write(changed);
+    if (changed)
+        writeBits(bitStream, state.wheelPosition, SNAPSHOT_WHEEL_BITS);
+}
+
+
+/// @brief  Reads a quantized state written by write().
+/// @param  bitStream  The stream to read from.
+/// @param  state      Filled with the state which was read.
+/// @param  baseline   The state which the sender delta encoded against, or NULL if it is unknown.
+/// @return false if the stream ran out or the state was delta encoded and no baseline was supplied.
+bool SnapshotCodec::read (RakNet::BitStream *bitStream, QuantizedCarState &state, const QuantizedCarState *baseline)
+{
+    unsigned int value;
+    bool isDelta;
+    if (!bitStream->Read(isDelta))
+        return false;
+
+    if (!isDelta)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            if (!readBits(bitStream, state.position[axis], mPositionBits[axis]))
+                return false;
+        if (!readBits(bitStream, value, 2))
+            return false;
+        state.rotationLargest = (unsigned char) value;
+        for (int i = 0; i < 3; i++)
+        {
+            if (!readBits(bitStream, value, SNAPSHOT_ROTATION_BITS))
+                return false;
+            state.rotation[i] = (unsigned short) value;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (!readBits(bitStream, value, SNAPSHOT_LINEAR_VEL_BITS))
+                return false;
+            state.linearVelocity[axis] = (unsigned short) value;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (!readBits(bitStream, value, SNAPSHOT_ANGULAR_VEL_BITS))
+                return false;
+            state.angularVelocity[axis] = (unsigned short) value;
+        }
+        if (!readBits(bitStream, value, SNAPSHOT_WHEEL_BITS))
+            return false;
+        state.wheelPosition = (unsigned char) value;
+        return true;
+    }
+
+    if (baseline == NULL)
+        return false;
+    state = *baseline;
+
+    bool changed;
+    if (!bitStream->Read(changed))
+        return false;
+    if (changed)
+        for (int axis = 0; axis < 3; axis++)
+            if (!readComponent(bitStream, state.position[axis], baseline->position[axis], mPositionBits[axis], SNAPSHOT_POSITION_DELTA_BITS))
+                return false;
+
+    if (!bitStream->Read(changed))
+        return false;
+    if (changed)
+    {
+        bool sameLargest;
+        if (!bitStream->Read(sameLargest))
+            return false;
+        if (sameLargest)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                if (!readComponent(bitStream, value, baseline->rotation[i], SNAPSHOT_ROTATION_BITS, SNAPSHOT_VELOCITY_DELTA_BITS))
+                    return false;
+                state.rotation[i] = (unsigned short) value;
+            }
+        }
+        else
+        {
+            if (!readBits(bitStream, value, 2))
+                return false;
+            state.rotationLargest = (unsigned char) value;
+            for (int i = 0; i < 3; i++)
+            {
+                if (!readBits(bitStream, value, SNAPSHOT_ROTATION_BITS))
+                    return false;
+                state.rotation[i] = (unsigned short) value;
+            }
+        }
+    }
+
+    if (!bitStream->Read(changed))
+        return false;
+    if (changed)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (!readComponent(bitStream, value, baseline->linearVelocity[axis], SNAPSHOT_LINEAR_VEL_BITS, SNAPSHOT_VELOCITY_DELTA_BITS))
+                return false;
+            state.linearVelocity[axis] = (unsigned short) value;
+        }
+    }
+
+    if (!bitStream->Read(changed))
+        return false;
+    if (changed)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (!readComponent(bitStream, value, baseline->angularVelocity[axis], SNAPSHOT_ANGULAR_VEL_BITS, SNAPSHOT_VELOCITY_DELTA_BITS))
+                return false;
+            state.angularVelocity[axis] = (unsigned short) value;
+        }
+    }
+
+    if (!bitStream->Read(changed))
+        return false;
+    if (changed)
+    {
+        if (!readBits(bitStream, value, SNAPSHOT_WHEEL_BITS))
+            return false;
+        state.wheelPosition = (unsigned char) value;
+    }
+
+    return true;
+}
+
+
+/// @brief  Writes one component of a delta encoded state. Unchanged components cost a single bit, small
+///         changes are written as a signed offset from the baseline and anything else is written in full.
+/// @param  bitStream  The stream to write to.
+/// @param  value      The value to write.
+/// @param  base       The baseline's value of this component.
+/// @param  bits       The number of bits needed to write the value in full.
+/// @param  deltaBits  The number of bits a small change is written with.
+void SnapshotCodec::writeComponent (RakNet::BitStream *bitStream, unsigned int value, unsigned int base, int bits, int deltaBits)
+{
+    if (value == base)
+    {
+        bitStream->Write(false);
+        return;
+    }
+    bitStream->Write(true);
+
+    int delta = (int) value - (int) base;
+    int limit = 1 << (deltaBits - 1);
+    if (delta >= -limit && delta < limit)
+    {
+        bitStream->Write(true);
+        writeBits(bitStream, (unsigned int) (delta + limit), deltaBits);
+    }
+    else
+    {
+        bitStream->Write(false);
+        writeBits(bitStream, value, bits);
+    }
+}
+
+
+/// @brief  Reads one component written by writeComponent().
+/// @return false if the stream ran out.
+bool SnapshotCodec::readComponent (RakNet::BitStream *bitStream, unsigned int &value, unsigned int base, int bits, int deltaBits)
+{
+    bool changed;
+    if (!bitStream->Read(changed))
+        return false;
+    if (!changed)
+    {
+        value = base;
+        return true;
+    }
+
+    bool isSmall;
+    if (!bitStream->Read(isSmall))
+        return false;
+    if (!isSmall)
+        return readBits(bitStream, value, bits);
+
+    unsigned int offset;
+    if (!readBits(bitStream, offset, deltaBits))
+        return false;
+    value = (unsigned int) ((int) base + (int) offset - (1 << (deltaBits - 1)));
+    return true;
+}
+
+
+/// @brief  Compares two sequence numbers, allowing for them wrapping around.
+/// @return true if s1 is more recent than s2.
+bool SnapshotCodec::sequenceGreaterThan (unsigned short s1, unsigned short s2)
+{
+    return ((s1 > s2) && (s1 - s2 <= 32768)) ||
+           ((s1 < s2) && (s2 - s1 >  32768));
+}
+
+
+/// @brief  Round trips a set of randomly generated cars through the codec, measuring the error introduced
+///         by quantization, the size of the encoded snapshots and the time taken. Each car is also given a
+///         baseline from a few frames earlier, as though it had been driving since then.
+/// @param  iterations  The number of cars to generate.
+/// @param  results     Filled with the results.
+void SnapshotCodec::benchmark (int iterations, SnapshotCodecBenchmark &results)
+{
+    const float frameTime = 0.02f;
+
+    memset(&results, 0, sizeof(SnapshotCodecBenchmark));
+    results.iterations = iterations;
+    results.exact = true;
+    if (iterations <= 0)
+        return;
+
+    // Generate the test data.
+    std::vector<CarSnapshot> current;
+    std::vector<CarSnapshot> previous;
+    current.reserve(iterations);
+    previous.reserve(iterations);
+    for (int i = 0; i < iterations; i++)
+    {
+        btVector3 position;
+        for (int axis = 0; axis < 3; axis++)
+            position[axis] = randomRange(mBoundsMin[axis] + SNAPSHOT_ARENA_MARGIN, mBoundsMax[axis] - SNAPSHOT_ARENA_MARGIN);
+        btVector3 axis(randomRange(-1, 1), randomRange(-1, 1), randomRange(-1, 1));
+        if (axis.length2() < 0.0001f)
+            axis.setValue(0, 1, 0);
+        btQuaternion rotation(axis.normalized(), randomRange(-SIMD_PI, SIMD_PI));
+        btVector3 linearVelocity(randomRange(-40, 40), randomRange(-5, 5), randomRange(-40, 40));
+        btVector3 angularVelocity(randomRange(-2, 2), randomRange(-8, 8), randomRange(-2, 2));
+        float wheelPosition = randomRange(-0.75f, 0.75f);
+        current.push_back(CarSnapshot(position, rotation, angularVelocity, linearVelocity, wheelPosition));
+
+        // Wind the car back between one and six frames to make its baseline.
+        float age = frameTime * (1 + rand() % 6);
+        btQuaternion spin(btVector3(0, 1, 0), -angularVelocity.y() * age);
+        btVector3 acceleration(randomRange(-10, 10), randomRange(-2, 2), randomRange(-10, 10));
+        previous.push_back(CarSnapshot(position - linearVelocity * age, spin * rotation,
+            angularVelocity, linearVelocity - acceleration * age, wheelPosition + randomRange(-0.1f, 0.1f)));
+    }
+
+    // Time the round trip which is made by every delta encoded snapshot.
+    std::vector<QuantizedCarState> encoded(iterations);
+    std::vector<QuantizedCarState> baselines(iterations);
+    std::vector<QuantizedCarState> decoded(iterations);
+    std::vector<CarSnapshot*>      output(iterations);
+    RakNet::BitStream bitStream;
+    RakNet::TimeUS startTime = RakNet::GetTimeUS();
+    for (int i = 0; i < iterations; i++)
+    {
+        quantize(previous[i], baselines[i]);
+        quantize(current[i],  encoded[i]);
+        bitStream.Reset();
+        write(&bitStream, encoded[i], &baselines[i]);
+        read(&bitStream, decoded[i], &baselines[i]);
+        output[i] = dequantize(decoded[i]);
+    }
+    results.microsecondsPerSnapshot = (double) (RakNet::GetTimeUS() - startTime) / iterations;
+
+    // Measure the accuracy and sizes.
+    double fullBits  = 0;
+    double deltaBits = 0;
+    double idleBits  = 0;
+    QuantizedCarState check;
+    for (int i = 0; i < iterations; i++)
+    {
+        if (!statesEqual(encoded[i], decoded[i]))
+            results.exact = false;
+
+        CarSnapshot *in  = &current[i];
+        CarSnapshot *out = output[i];
+        float dot = fabs(in->mRotation.normalized().dot(out->mRotation));
+        float rotationError = 2.0f * acosf(dot > 1.0f ? 1.0f : dot);
+        results.maxPositionError   = std::max(results.maxPositionError,   (float) (in->mPosition        - out->mPosition).length());
+        results.maxRotationError   = std::max(results.maxRotationError,   rotationError);
+        results.maxLinearVelError  = std::max(results.maxLinearVelError,  (float) (in->mLinearVelocity  - out->mLinearVelocity).length());
+        results.maxAngularVelError = std::max(results.maxAngularVelError, (float) (in->mAngularVelocity - out->mAngularVelocity).length());
+        delete out;
+
+        bitStream.Reset();
+        write(&bitStream, encoded[i], &baselines[i]);
+        deltaBits += bitStream.GetNumberOfBitsUsed();
+
+        bitStream.Reset();
+        write(&bitStream, encoded[i], NULL);
+        fullBits += bitStream.GetNumberOfBitsUsed();
+        if (!read(&bitStream, check, NULL) || !statesEqual(encoded[i], check))
+            results.exact = false;
+
+        bitStream.Reset();
+        write(&bitStream, encoded[i], &encoded[i]);
+        idleBits += bitStream.GetNumberOfBitsUsed();
+    }
+
+    results.averageFullBits  = (float) (fullBits  / iterations);
+    results.averageDeltaBits = (float) (deltaBits / iterations);
+    results.averageIdleBits  = (float) (idleBits  / iterations);
+}
+
+
+/// @brief  Constructor.
+SnapshotHistory::SnapshotHistory (void)
+{
+    clear();
+}
+
+
+/// @brief  Starts a new frame, throwing away the frame which previously occupied its slot.
+/// @param  sequence  The sequence number of the new frame.
+void SnapshotHistory::beginFrame (unsigned short sequence)
+{
+    Frame &frame = mFrames[sequence & (SNAPSHOT_HISTORY_SIZE - 1)];
+    frame.valid    = true;
+    frame.sequence = sequence;
+    frame.states.clear();
+}
+
+
+/// @brief  Records the state of a car in a frame, starting the frame if it hasn't been already.
+/// @param  sequence  The sequence number of the frame.
+/// @param  playerid  The player who owns the car.
+/// @param  state     The car's quantized state.
+void SnapshotHistory::store (unsigned short sequence, const RakNet::RakNetGUID &playerid, const QuantizedCarState &state)
+{
+    if (!hasFrame(sequence))
+        beginFrame(sequence);
+    mFrames[sequence & (SNAPSHOT_HISTORY_SIZE - 1)].states[playerid] = state;
+}
+
+
+/// @brief  Finds the state of a player's car in a frame.
+/// @return The state, or NULL if the frame has been forgotten or the player didn't have a car in it.
+const QuantizedCarState* SnapshotHistory::find (unsigned short sequence, const RakNet::RakNetGUID &playerid) const
+{
+    if (!hasFrame(sequence))
+        return NULL;
+
+    const Frame &frame = mFrames[sequence & (SNAPSHOT_HISTORY_SIZE - 1)];
+    std::map<RakNet::RakNetGUID, QuantizedCarState>::const_iterator it = frame.states.find(playerid);
+    if (it == frame.states.end())
+        return NULL;
+
+    return &it->second;
+}
+
+
+/// @brief  Checks whether a frame is still remembered.
+bool SnapshotHistory::hasFrame (unsigned short sequence) const
+{
+    const Frame &frame = mFrames[sequence & (SNAPSHOT_HISTORY_SIZE - 1)];
+    return frame.valid && frame.sequence == sequence;
+}
+
+
+/// @brief  Forgets every frame.
+void SnapshotHistory::clear (void)
+{
+    for (int i = 0; i < SNAPSHOT_HISTORY_SIZE; i++)
+    {
+        mFrames[i].valid = false;
+        mFrames[i].sequence = 0;
+        mFrames[i].states.clear();
+    }
+}
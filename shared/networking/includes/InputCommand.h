@@ -0,0 +1,55 @@
+/**
+ * @file    InputCommand.h
+ * @brief   The compact per-tick input commands clients send to the server. Each input packet carries
+            the newest few commands, so any one packet being lost doesn't lose any input.
+ */
+#ifndef INPUTCOMMAND_H
+#define INPUTCOMMAND_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "InputState.h"
+#include "BitStream.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define INPUT_REDUNDANCY    6       // Commands sent in each input packet: the newest, and the ones before it.
+#define INPUT_COUNT_BITS    3       // Bits needed to say how many commands are in a packet (1 to INPUT_REDUNDANCY).
+#define INPUT_BUTTON_BITS   5
+
+enum INPUT_BUTTON
+{
+    INPUT_FORWARD   = 1 << 0,
+    INPUT_BACK      = 1 << 1,
+    INPUT_LEFT      = 1 << 2,
+    INPUT_RIGHT     = 1 << 3,
+    INPUT_HANDBRAKE = 1 << 4,
+};
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  The buttons held during one input tick.
+struct InputCommand
+{
+    unsigned short tick;
+    unsigned char  buttons;     // INPUT_BUTTON flags.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Converts input commands to and from InputStates, and reads/writes them to and from BitStreams.
+ *          Commands are written newest first. Only the newest tick is written as the others follow on
+ *          from it, so each additional command costs INPUT_BUTTON_BITS.
+ */
+class InputCommandCodec
+{
+public:
+    static unsigned char toButtons (InputState *input);
+    static InputState    toInputState (unsigned char buttons);
+
+    static void write (RakNet::BitStream *bitStream, const InputCommand *commands, int count);
+    static int  read (RakNet::BitStream *bitStream, InputCommand *commands);
+};
+
+#endif // #ifndef INPUTCOMMAND_H
@@ -0,0 +1,120 @@
+/**
+ * @file    SnapshotCodec.h
+ * @brief   Packs car snapshots into as few bits as possible before they are sent over the network.
+            Each snapshot is quantized and then delta encoded against a baseline the receiver is
+            known to already have.
+ */
+#ifndef SNAPSHOTCODEC_H
+#define SNAPSHOTCODEC_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "CarSnapshot.h"
+#include "BitStream.h"
+#include "RakNetTypes.h"
+#include <map>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define SNAPSHOT_HISTORY_SIZE        32              // Number of past frames kept as baselines. Must be a power of two.
+#define SNAPSHOT_BASELINE_BITS       5               // Bits needed to say how many frames old a baseline is (log2 of the above).
+#define SNAPSHOT_POSITION_PRECISION  (1.0f / 512.0f) // Size of one position step, in metres.
+#define SNAPSHOT_POSITION_MAX_BITS   20              // Upper limit on the bits used by one position component.
+#define SNAPSHOT_ARENA_MARGIN        16.0f           // Distance outside of the arena AABB which can still be represented.
+#define SNAPSHOT_ROTATION_BITS       11              // Bits per smallest-three quaternion component.
+#define SNAPSHOT_LINEAR_VEL_MAX      64.0f           // Largest linear velocity component which can be represented (m/s).
+#define SNAPSHOT_LINEAR_VEL_BITS     14
+#define SNAPSHOT_ANGULAR_VEL_MAX     16.0f           // Largest angular velocity component which can be represented (rad/s).
+#define SNAPSHOT_ANGULAR_VEL_BITS    12
+#define SNAPSHOT_WHEEL_BITS          8
+#define SNAPSHOT_POSITION_DELTA_BITS 11              // Bits used by a position component which has only moved a little.
+#define SNAPSHOT_VELOCITY_DELTA_BITS 8               // Bits used by any other component which has only changed a little.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  A CarSnapshot after quantization. Both ends of the connection keep these (rather than the
+///         floating point originals) as baselines so that deltas between them are exact.
+struct QuantizedCarState
+{
+    unsigned int   position[3];
+    unsigned short rotation[3];         // The three smallest quaternion components.
+    unsigned char  rotationLargest;     // The index of the component which was dropped.
+    unsigned short linearVelocity[3];
+    unsigned short angularVelocity[3];
+    unsigned char  wheelPosition;
+};
+
+/// @brief  The results of SnapshotCodec::benchmark().
+struct SnapshotCodecBenchmark
+{
+    int    iterations;
+    float  maxPositionError;        // metres
+    float  maxRotationError;        // radians
+    float  maxLinearVelError;       // m/s
+    float  maxAngularVelError;      // rad/s
+    float  averageFullBits;         // Average size of a snapshot encoded without a baseline.
+    float  averageDeltaBits;        // Average size of a snapshot encoded against a recent baseline.
+    float  averageIdleBits;         // Average size of a snapshot which has not changed since its baseline.
+    double microsecondsPerSnapshot; // Time taken to quantize, encode, decode and dequantize one snapshot.
+    bool   exact;                   // Whether every decoded state matched the encoded state bit for bit.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Quantizes car snapshots and reads/writes them to and from BitStreams.
+ */
+class SnapshotCodec
+{
+public:
+    static void setArenaBounds (const btVector3 &aabbMin, const btVector3 &aabbMax);
+    static void writeArenaBounds (RakNet::BitStream *bitStream);
+    static bool readArenaBounds (RakNet::BitStream *bitStream);
+
+    static void         quantize (const CarSnapshot &snapshot, QuantizedCarState &state);
+    static CarSnapshot* dequantize (const QuantizedCarState &state);
+    static void         dequantize (const QuantizedCarState &state, CarSnapshot &snapshot);
+
+    static void write (RakNet::BitStream *bitStream, const QuantizedCarState &state, const QuantizedCarState *baseline);
+    static bool read (RakNet::BitStream *bitStream, QuantizedCarState &state, const QuantizedCarState *baseline);
+
+    static bool sequenceGreaterThan (unsigned short s1, unsigned short s2);
+    static void benchmark (int iterations, SnapshotCodecBenchmark &results);
+
+private:
+    static void writeComponent (RakNet::BitStream *bitStream, unsigned int value, unsigned int base, int bits, int deltaBits);
+    static bool readComponent (RakNet::BitStream *bitStream, unsigned int &value, unsigned int base, int bits, int deltaBits);
+
+    static btVector3 mBoundsMin;
+    static btVector3 mBoundsMax;
+    static int       mPositionBits[3];
+};
+
+
+/**
+ *  @brief  The quantized state of every car at each of the last SNAPSHOT_HISTORY_SIZE frames, used to
+ *          find the baseline which a delta was encoded against.
+ */
+class SnapshotHistory
+{
+public:
+    SnapshotHistory (void);
+
+    void beginFrame (unsigned short sequence);
+    void store (unsigned short sequence, const RakNet::RakNetGUID &playerid, const QuantizedCarState &state);
+    const QuantizedCarState* find (unsigned short sequence, const RakNet::RakNetGUID &playerid) const;
+    bool hasFrame (unsigned short sequence) const;
+    void clear (void);
+
+private:
+    struct Frame
+    {
+        bool valid;
+        unsigned short sequence;
+        std::map<RakNet::RakNetGUID, QuantizedCarState> states;
+    };
+
+    Frame mFrames[SNAPSHOT_HISTORY_SIZE];
+};
+
+#endif // #ifndef SNAPSHOTCODEC_H
@@ -0,0 +1,142 @@
+/**
+ * @file    Broadphase.cpp
+ * @brief   Chooses and builds the broadphase which PhysicsCore's world finds overlapping pairs with.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "Broadphase.h"
+#include "SimulationClock.h"
+#include "GetTime.h"
+#include "RandomRange.h"
+#include <vector>
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Builds a broadphase.
+/// @param  type      The broadphase.
+/// @param  worldMin  The minimum corner of the space bodies will be in. Only used by sweep and prune.
+/// @param  worldMax  The maximum corner of the space bodies will be in. Only used by sweep and prune.
+/// @return The broadphase. Delete it once the world using it is done with it.
+btBroadphaseInterface* Broadphase::create (BroadphaseType type, const btVector3 &worldMin, const btVector3 &worldMax)
+{
+    if (type == BROADPHASE_DBVT)
+        return new btDbvtBroadphase();
+
+    return new btAxisSweep3(worldMin, worldMax, BROADPHASE_MAX_HANDLES);
+}
+
+
+/// @brief  Gets the space a sweep and prune broadphase should cover for an arena.
+/// @param  arenaMin  The minimum corner of the arena's bounds.
+/// @param  arenaMax  The maximum corner of the arena's bounds.
+/// @param  worldMin  Set to the minimum corner of the space.
+/// @param  worldMax  Set to the maximum corner of the space.
+void Broadphase::getArenaBounds (const btVector3 &arenaMin, const btVector3 &arenaMax, btVector3 &worldMin, btVector3 &worldMax)
+{
+    worldMin = arenaMin - btVector3(BROADPHASE_ARENA_MARGIN, BROADPHASE_ARENA_MARGIN, BROADPHASE_ARENA_MARGIN);
+    worldMax = arenaMax + btVector3(BROADPHASE_ARENA_MARGIN, BROADPHASE_ARENA_HEADROOM, BROADPHASE_ARENA_MARGIN);
+}
+
+
+/// @brief  Gets a broadphase's name, for the console.
+const char* Broadphase::getName (BroadphaseType type)
+{
+    switch (type)
+    {
+    case BROADPHASE_SWEEP_AND_PRUNE:
+        return "sweep and prune";
+    case BROADPHASE_DBVT:
+        return "dbvt";
+    default:
+        return "unknown";
+    }
+}
+
+
+/// @brief  Measures the time a broadphase takes to update the overlapping pairs with a number of cars
+///         driving around an arena and debris scattered around them, as in a busy round.
+/// @param  broadphase  The broadphase. It must be empty, and is left empty.
+/// @param  cars        The number of cars.
+/// @param  debris      The number of pieces of debris.
+/// @param  ticks       The number of ticks to run for.
+/// @param  results     Filled with the results.
+void Broadphase::benchmark (btBroadphaseInterface *broadphase, int cars, int debris, int ticks, BroadphaseBenchmark &results)
+{
+    const float arenaSize = 185.0f;
+
+    memset(&results, 0, sizeof(BroadphaseBenchmark));
+    results.bodies = cars + debris + 1;
+    results.ticks  = ticks;
+    if (ticks <= 0)
+        return;
+
+    btDefaultCollisionConfiguration config;
+    btCollisionDispatcher           dispatcher(&config);
+    btCollisionWorld                world(&dispatcher, broadphase, &config);
+
+    btBoxShape carShape(btVector3(1.0f, 0.8f, 2.2f));
+    btBoxShape debrisShape(btVector3(0.4f, 0.2f, 0.6f));
+    btBoxShape groundShape(btVector3(arenaSize, 1.0f, arenaSize));
+
+    std::vector<btCollisionObject*> objects(cars + debris + 1);
+    std::vector<btVector3>          velocities(cars + debris + 1);
+    for (int i = 0; i < (int) objects.size(); i++)
+    {
+        btCollisionObject *object = new btCollisionObject();
+        btVector3 position;
+        if (i == 0)
+        {
+            object->setCollisionShape(&groundShape);
+            position      = btVector3(0, -1.0f, 0);
+            velocities[i] = btVector3(0, 0, 0);
+        }
+        else if (i <= cars)
+        {
+            object->setCollisionShape(&carShape);
+            position      = btVector3(randomRange(-arenaSize, arenaSize), 0.8f, randomRange(-arenaSize, arenaSize));
+            velocities[i] = btVector3(randomRange(-25, 25), 0, randomRange(-25, 25));
+        }
+        else
+        {
+            // Debris lies around where the cars are, some of it still moving.
+            btVector3 nearCar = cars > 0 ? objects[1 + rand() % cars]->getWorldTransform().getOrigin() : btVector3(0, 0, 0);
+            object->setCollisionShape(&debrisShape);
+            position      = nearCar + btVector3(randomRange(-5, 5), 0.2f, randomRange(-5, 5));
+            velocities[i] = rand() % 4 == 0 ? btVector3(randomRange(-5, 5), 0, randomRange(-5, 5)) : btVector3(0, 0, 0);
+        }
+        object->setWorldTransform(btTransform(btQuaternion::getIdentity(), position));
+        world.addCollisionObject(object);
+        objects[i] = object;
+    }
+
+    double updateTime = 0;
+    double pairs      = 0;
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        for (int i = 1; i < (int) objects.size(); i++)
+        {
+            btVector3 position = objects[i]->getWorldTransform().getOrigin() + velocities[i] * SIMULATION_TICK_SECONDS;
+            for (int axis = 0; axis < 3; axis += 2)
+                if (btFabs(position[axis]) > arenaSize)
+                    velocities[i][axis] = -velocities[i][axis];
+            objects[i]->getWorldTransform().setOrigin(position);
+        }
+
+        RakNet::TimeUS startTime = RakNet::GetTimeUS();
+        world.updateAabbs();
+        broadphase->calculateOverlappingPairs(&dispatcher);
+        updateTime += (double) (RakNet::GetTimeUS() - startTime);
+        pairs += broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+    }
+
+    for (int i = 0; i < (int) objects.size(); i++)
+    {
+        world.removeCollisionObject(objects[i]);
+        delete objects[i];
+    }
+
+    results.updateMicroseconds = updateTime / ticks;
+    results.pairsPerTick       = pairs / ticks;
+}
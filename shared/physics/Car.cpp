@@ -11,6 +11,8 @@
 #include "Car.h"
 #include "GameCore.h"
 #include "Gameplay.h"
+#include "CarPool.h"
+#include "PhysicsLod.h"
 #include "boost/algorithm/string.hpp"
 
 #define WHEEL_FRICTION_CFM 0.1f
@@ -18,11 +20,16 @@
 std::list<Ogre::Entity*>* Car::mClonedEntities = new std::list<Ogre::Entity*>;
 std::list<Ogre::ResourceHandle>* Car::mMeshObjects = new std::list<Ogre::ResourceHandle>;
 
-Car::Car (int uniqueID)
+Car::Car (int uniqueID, CarType carType)
   : mGearSound(NULL),
+    mCarType(carType),
+    mWrecked(false),
+    mChassisShape(NULL),
     mBigScreenOverlayElement(NULL),
     mUniqueID(uniqueID)
 {
+    mTransformSlot = GameCore::mPhysicsCore->mTransformStore->allocateSlot();
+
     #ifdef COLLISION_DOMAIN_CLIENT
         mCrashSound = GameCore::mAudioCore->getSoundInstance(CAR_CRASH, uniqueID, NULL);
     
@@ -50,6 +57,12 @@ Car::~Car()
         //GameCore::mSceneMgr->destroySceneNode( mRemovedNodes.front() );
         mRemovedNodes.pop();
     }
+
+    GameCore::mPhysicsCore->mTransformStore->releaseSlot( mTransformSlot );
+    GameCore::mPhysicsCore->mPlayerCollisions->clearSlot( mTransformSlot );
+#ifdef COLLISION_DOMAIN_SERVER
+    GameCore::mPhysicsCore->mTransformHistory->clearSlot( mTransformSlot );
+#endif
 }
 
 // Call with the location of the crash and the intensity between 0 and 1, ideally between 0 and 0.8
@@ -73,6 +86,10 @@ void Car::triggerCrashSoundAt(Ogre::Vector3 location, float intensity)
 /// @param  carSnapshot  The CarSnapshot specifying where and how to place the car.
 void Car::restoreSnapshot(CarSnapshot *carSnapshot)
 {
+    // A wreck may have fallen asleep, and a sleeping body's node isn't moved.
+    if (mWrecked)
+        mCarChassis->activate();
+
     moveTo(carSnapshot->mPosition, carSnapshot->mRotation);
 
     // After this the car will be moved and rotated as specified, but the current velocity
@@ -90,7 +107,7 @@ void Car::restoreSnapshot(CarSnapshot *carSnapshot)
 CarSnapshot *Car::getCarSnapshot()
 {
     return new CarSnapshot(
-        btVector3(mBodyNode->getPosition().x, mBodyNode->getPosition().y, mBodyNode->getPosition().z),
+        GameCore::mPhysicsCore->mTransformStore->getPosition(mTransformSlot),
         mCarChassis->getOrientation(),
         mCarChassis->getAngularVelocity(),
         mCarChassis->getLinearVelocity(),
@@ -138,6 +155,94 @@ void Car::moveTo(const btVector3 &position, const btQuaternion &rotation)
 }
 
 
+/// @brief  Takes the car out of the world so it can be kept in the CarPool. Everything the car was built
+///         with (nodes, chassis, vehicle, constraint and its TransformStore slot) is kept for recycle().
+void Car::park()
+{
+    GameCore::mPhysicsCore->removeVehicle( mVehicle );
+    GameCore::mPhysicsCore->getWorld()->removeConstraint( fricConst );
+    GameCore::mPhysicsCore->parkBody( mCarChassis );
+    mCarChassis->setUserPointer( NULL );
+
+#ifndef COLLISION_DOMAIN_HEADLESS
+    if( mPlayerNode->getParentSceneNode() )
+        mPlayerNode->getParentSceneNode()->removeChild( mPlayerNode );
+#endif
+
+    GameCore::mPhysicsCore->mPlayerCollisions->clearSlot( mTransformSlot );
+#ifdef COLLISION_DOMAIN_SERVER
+    GameCore::mPhysicsCore->mTransformHistory->clearSlot( mTransformSlot );
+#endif
+}
+
+
+/// @brief  Puts a parked car back into the world as if it had just been built. Move it to where it
+///         should spawn afterwards.
+/// @param  tid  The team the car is painted for.
+/// @param  aid  The arena the car is in.
+void Car::recycle(TeamID tid, ArenaID aid)
+{
+#ifndef COLLISION_DOMAIN_HEADLESS
+    GameCore::mSceneMgr->getRootSceneNode()->addChild( mPlayerNode );
+#endif
+
+    // Undo anything driving or power-ups have done to the car.
+    mSteer         = 0;
+    mEngineForce   = 0;
+    mBrakingForce  = 0;
+    mMaxAccelForce = mMaxAccelForceBuf;
+    mCarChassis->setRestitution( mChassisRestitution );
+
+    for( int i = 0; i < mVehicle->getNumWheels(); i ++ )
+    {
+        mVehicle->applyEngineForce( 0, i );
+        mVehicle->setBrake( 0, i );
+        mVehicle->setSteeringValue( 0, i );
+        mVehicle->getWheelInfo( i ).m_rotation      = 0;
+        mVehicle->getWheelInfo( i ).m_deltaRotation = 0;
+    }
+    mVehicle->mHandbrake = false;
+    mVehicle->resetSuspension();
+
+    if( mWrecked )
+    {
+        PhysicsLod::setShape( mCarChassis, mChassisShape );
+        mCarChassis->forceActivationState( DISABLE_DEACTIVATION );
+        mWrecked = false;
+    }
+
+    mCarChassis->setLinearVelocity( btVector3( 0, 0, 0 ) );
+    mCarChassis->setAngularVelocity( btVector3( 0, 0, 0 ) );
+    mCarChassis->clearForces();
+
+    GameCore::mPhysicsCore->addRigidBody( mCarChassis, COL_CAR, COL_CAR | COL_ARENA | COL_POWERUP );
+    GameCore::mPhysicsCore->getWorld()->addConstraint( fricConst );
+    GameCore::mPhysicsCore->addVehicle( mVehicle );
+
+#ifdef COLLISION_DOMAIN_CLIENT
+    updateTeam( tid );
+    updateArena( aid );
+#endif
+}
+
+
+/// @brief  Makes the car cheaper to simulate once its driver is dead. Its wheels stop being simulated, its
+///         chassis is swapped for a box around it and it may fall asleep. Undone by recycle().
+void Car::wreck()
+{
+    if( mWrecked )
+        return;
+    mWrecked = true;
+
+    GameCore::mPhysicsCore->removeVehicle( mVehicle );
+    GameCore::mPhysicsCore->getWorld()->removeConstraint( fricConst );
+
+    mChassisShape = mCarChassis->getCollisionShape();
+    PhysicsLod::setShape( mCarChassis, GameCore::mPhysicsCore->mPhysicsLod->getProxyShape( mChassisShape ) );
+    PhysicsLod::allowSleeping( mCarChassis );
+}
+
+
 /// @brief  Called once every frame with new user input and updates steering from this.
 /// @param  isLeft                  User input specifying if the left control is pressed.
 /// @param  isRight                 User input specifying if the right control is pressed.
@@ -506,7 +611,9 @@ void Car::attachCollisionTickCallback(Player* player)
 void Car::applyForce(Ogre::SceneNode* node, Ogre::Vector3 force)
 {
     btVector3 btForce(force.x, force.y, force.z);
-    btVector3 btPos(node->getPosition().x, node->getPosition().y, node->getPosition().z);
+    // The headless server never moves the body node, so the chassis says where it is instead.
+    btVector3 btPos = node == mBodyNode ? mCarChassis->getWorldTransform().getOrigin()
+                                        : btVector3(node->getPosition().x, node->getPosition().y, node->getPosition().z);
     mCarChassis->applyImpulse(btForce, btPos);
 }
 
@@ -620,18 +727,12 @@ void Car::removePiece( Ogre::SceneNode *node, btRigidBody *body, PHYS_SHAPE shap
     GameCore::mSceneMgr->getRootSceneNode()->addChild( node );
     node->setPosition( mBodyNode->getPosition() );
 
+    // The node now belongs to the debris, which the pool destroys at the end of the round.
     btTransform ltrans( btQuaternion::getIdentity(), offset );
-    btMotionState *lstate = new BtOgre::RigidBodyState( node, mCarChassis->getWorldTransform() * ltrans, ltrans.inverse() );
-    btVector3 linertia;
-    GameCore::mPhysicsCore->getCollisionShape( shape )->calculateLocalInertia( 30.f, linertia );
-
-    body = new btRigidBody( 30.f, lstate, GameCore::mPhysicsCore->getCollisionShape( shape ), linertia );
+    body = GameCore::mPhysicsCore->mCarPool->takeDebris( shape, node, mCarChassis->getWorldTransform() * ltrans, ltrans.inverse() );
 
     //body->setActivationState( ISLAND_SLEEPING );
-    GameCore::mPhysicsCore->addRigidBody( body, COL_CAR, COL_ARENA | COL_CAR );
-    body->setDamping( 0.2f, 0.5f );
     //body->setDamping( 100.2f, 100.5f );
-    body->setActivationState( DISABLE_DEACTIVATION );
 
     mRemovedNodes.push( node );
     //body->setWorldTransform( mVehicle->getChassisWorldTransform() );
@@ -654,6 +755,9 @@ void WheelFrictionConstraint::getInfo1( btTypedConstraint::btConstraintInfo1* in
 {
     // Add two constraint rows for each wheel on the ground
     
+    // The contacts are shared with getInfo2() and the vehicle's own update, so are only cast once per substep.
+    mVehicle->updateWheelContacts();
+
     info->m_numConstraintRows = 0;
     for (int i = 0; i < mVehicle->getNumWheels(); ++i)
     {
@@ -663,7 +767,6 @@ void WheelFrictionConstraint::getInfo1( btTypedConstraint::btConstraintInfo1* in
         //      std::cout << "No wheel info" << std::endl;
         //      exit(3);
         //}
-        mVehicle->rayCast( wheel_info );
         info->m_numConstraintRows += 2 * ( wheel_info.m_raycastInfo.m_isInContact );
     }
 }
@@ -677,9 +780,8 @@ void WheelFrictionConstraint::getInfo2( btTypedConstraint::btConstraintInfo2* in
     for( int i = 0; i < mVehicle->getNumWheels(); ++i )
     {
         btWheelInfo& wheel_info = mVehicle->getWheelInfo(i);
-        mVehicle->rayCast( wheel_info );
 
-        // Only if the wheel is on the ground:
+        // Only if the wheel is on the ground (cast in getInfo1):
         if( wheel_info.m_raycastInfo.m_isInContact == false )
             continue;
 
@@ -916,13 +1018,14 @@ Ogre::Vector3 Car::GetPos()
 {
         //return mPlayerNode->_getDerivedPosition() + mPlayerNode->_getDerivedOrientation() *
         //      mPlayerNode->_getDerivedScale() * mBodyNode->_getDerivedPosition();
-        return mBodyNode->getPosition();
+        // Read from the transform store rather than mBodyNode so this works on the headless server.
+        return BtOgre::Convert::toOgre( GameCore::mPhysicsCore->mTransformStore->getPosition(mTransformSlot) );
 }
 
 //get the car's current heading
 Ogre::Quaternion Car::GetHeading()
 {
-        return mBodyNode->getOrientation();
+        return BtOgre::Convert::toOgre( GameCore::mPhysicsCore->mTransformStore->getRotation(mTransformSlot) );
 }
 
 
@@ -930,8 +1033,8 @@ Ogre::Quaternion Car::GetHeading()
  *  Car State Class
  *  - move graphical car body and wheels with physics
  ********************************************************/
-CarState::CarState( Ogre::SceneNode *node )
-    : RigidBodyState( node )
+CarState::CarState( Ogre::SceneNode *node, int transformSlot )
+    : RigidBodyState( node ), mTransformSlot( transformSlot )
 {
     mVehicle = NULL;
     for( int i = 0; i < 4; i ++ )
@@ -940,6 +1043,12 @@ CarState::CarState( Ogre::SceneNode *node )
 
 void CarState::setWorldTransform(const btTransform &in)
 {
+    GameCore::mPhysicsCore->mTransformStore->setTransform( mTransformSlot, in );
+
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // There are no nodes to move (and the wheel transforms are only used for drawing).
+    mTransform = in;
+#else
     RigidBodyState::setWorldTransform( in );
     if( mVehicle )
     {
@@ -954,6 +1063,7 @@ void CarState::setWorldTransform(const btTransform &in)
             mWheelNode[i]->setOrientation( BtOgre::Convert::toOgre( wt.getRotation() ) );
         }
     }
+#endif
 }
 
 void CarState::setVehicle( btRaycastVehicle *v )
@@ -964,7 +1074,8 @@ void CarState::setVehicle( btRaycastVehicle *v )
 void CarState::setWheel( int wheelnum, Ogre::SceneNode *node, const Ogre::Vector3 &connectionPoint )
 {
     mWheelNode[wheelnum] = node;
-    node->setPosition( connectionPoint );
+    if( node )
+        node->setPosition( connectionPoint );
 }
 
 Ogre::OverlayElement* Car::getBigScreenOverlayElement()
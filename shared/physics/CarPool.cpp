@@ -0,0 +1,186 @@
+/**
+ * @file    CarPool.cpp
+ * @brief   Keeps cars and the bodies of parts which have fallen off them, so they can be used again
+            rather than being built from scratch each time a player spawns or a car breaks up.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "CarPool.h"
+#include "PhysicsCore.h"
+#include "PhysicsLod.h"
+#include "GameCore.h"
+#include "SimpleCoupeCar.h"
+#include "SmallCar.h"
+#include "TruckCar.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+CarPool::CarPool (void) : mStep(0)
+{
+}
+
+
+/// @brief  Destructor. Deletes the spare cars. Debris still in the world is left to the world.
+CarPool::~CarPool (void)
+{
+    for (int i = 0; i < CAR_COUNT; i++)
+        for (size_t j = 0; j < mSpareCars[i].size(); j++)
+            delete mSpareCars[i][j];
+
+    for (int i = 0; i < PHYS_SHAPE_COUNT; i++)
+    {
+        for (size_t j = 0; j < mSpareDebris[i].size(); j++)
+        {
+            delete mSpareDebris[i][j]->getMotionState();
+            delete mSpareDebris[i][j];
+        }
+    }
+}
+
+
+/// @brief  Gets a car for a player, reusing a spare one of the same type if there is one.
+/// @param  carType  The type of car.
+/// @param  tid      The team the car is painted for.
+/// @param  aid      The arena the car is in.
+/// @return The car, in the world. Move it to where it should spawn.
+Car* CarPool::takeCar (CarType carType, TeamID tid, ArenaID aid)
+{
+    if (!mSpareCars[carType].empty())
+    {
+        Car *car = mSpareCars[carType].back();
+        mSpareCars[carType].pop_back();
+        car->recycle(tid, aid);
+        return car;
+    }
+
+    switch (carType)
+    {
+    case CAR_BANGER:
+        return new SimpleCoupeCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
+    case CAR_SMALL:
+        return new SmallCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
+    case CAR_TRUCK:
+        return new TruckCar(GameCore::mPhysicsCore->getUniqueEntityID(), tid, aid);
+    default:
+        throw Ogre::Exception::ERR_INVALIDPARAMS;
+    }
+}
+
+
+/// @brief  Gives back a car which a player has finished with. The caller must forget the car.
+/// @param  car  The car.
+void CarPool::releaseCar (Car *car)
+{
+    if (car == NULL)
+        return;
+
+#ifdef COLLISION_DOMAIN_SERVER
+    std::vector<Car*> &spares = mSpareCars[car->getCarType()];
+    if (spares.size() < CAR_POOL_MAX_SPARE_CARS)
+    {
+        car->park();
+        spares.push_back(car);
+        return;
+    }
+#endif
+
+    delete car;
+}
+
+
+/// @brief  Gets a body for a part which has fallen off a car, and adds it to the world.
+/// @param  shape               The part's shape.
+/// @param  node                The part's node, which the body will move. Given up by the car.
+/// @param  transform           Where the body starts.
+/// @param  centerOfMassOffset  Where the node is relative to the body.
+/// @return The body.
+btRigidBody* CarPool::takeDebris (PHYS_SHAPE shape, Ogre::SceneNode *node, const btTransform &transform, const btTransform &centerOfMassOffset)
+{
+    btCollisionShape *collisionShape = GameCore::mPhysicsCore->getCollisionShape( shape );
+    btVector3 inertia;
+    collisionShape->calculateLocalInertia( DEBRIS_MASS, inertia );
+
+    btRigidBody *body;
+    std::vector<btRigidBody*> &spares = mSpareDebris[shape];
+    if (spares.empty())
+    {
+        btMotionState *state = new BtOgre::RigidBodyState( node, transform, centerOfMassOffset );
+        body = new btRigidBody( DEBRIS_MASS, state, collisionShape, inertia );
+    }
+    else
+    {
+        body = spares.back();
+        spares.pop_back();
+
+        // The motion state is only ever a RigidBodyState, so it can be overwritten in place.
+        *((BtOgre::RigidBodyState*) body->getMotionState()) = BtOgre::RigidBodyState( node, transform, centerOfMassOffset );
+        body->setCollisionShape( collisionShape );
+        body->setMassProps( DEBRIS_MASS, inertia );
+        body->updateInertiaTensor();
+        body->setWorldTransform( transform );
+        body->setInterpolationWorldTransform( transform );
+        body->setLinearVelocity( btVector3( 0, 0, 0 ) );
+        body->setAngularVelocity( btVector3( 0, 0, 0 ) );
+        body->setInterpolationLinearVelocity( btVector3( 0, 0, 0 ) );
+        body->setInterpolationAngularVelocity( btVector3( 0, 0, 0 ) );
+        body->clearForces();
+    }
+
+    GameCore::mPhysicsCore->addRigidBody( body, COL_CAR, COL_ARENA | COL_CAR );
+    body->setDamping( 0.2f, 0.5f );
+    PhysicsLod::allowSleeping( body );
+
+    Debris debris = { body, shape, node, mStep };
+    mDebris.push_back( debris );
+    return body;
+}
+
+
+/// @brief  Called after each step. Culls debris which is older than PhysicsLod's lifetime, and the oldest
+///         debris while there is more than PhysicsLod's budget.
+void CarPool::updateDebris (void)
+{
+    PhysicsLod *lod = GameCore::mPhysicsCore->mPhysicsLod;
+    unsigned int lifetime = (unsigned int) (lod->getDebrisLifetime() * SIMULATION_TICK_RATE);
+    size_t budget = lod->getDebrisBudget() > 0 ? (size_t) lod->getDebrisBudget() : 0;
+
+    mStep++;
+    size_t culled = 0;
+    while (culled < mDebris.size() && (mDebris.size() - culled > budget || mStep - mDebris[culled].step >= lifetime))
+        cullDebris( mDebris[culled++] );
+
+    if (culled > 0)
+        mDebris.erase( mDebris.begin(), mDebris.begin() + culled );
+}
+
+
+/// @brief  Takes all of the debris out of the world, destroying the parts' nodes and keeping their
+///         bodies for later. Only call once the cars the parts came from are gone.
+void CarPool::releaseDebris (void)
+{
+    for (size_t i = 0; i < mDebris.size(); i++)
+        cullDebris( mDebris[i] );
+    mDebris.clear();
+
+    for (size_t i = 0; i < mCulledNodes.size(); i++)
+        GameCore::mSceneMgr->destroySceneNode( mCulledNodes[i] );
+    mCulledNodes.clear();
+}
+
+
+/// @brief  Takes a piece of debris out of the world, keeping its body for later and hiding its node.
+/// @param  debris  The debris. The caller must forget it.
+void CarPool::cullDebris (Debris &debris)
+{
+    GameCore::mPhysicsCore->parkBody( debris.body );
+    ((BtOgre::RigidBodyState*) debris.body->getMotionState())->setNode( NULL );
+    mSpareDebris[debris.shape].push_back( debris.body );
+
+    // The car the part came from may still look at the node, so it can't be destroyed yet.
+    if (debris.node->getParentSceneNode())
+        debris.node->getParentSceneNode()->removeChild( debris.node );
+    mCulledNodes.push_back( debris.node );
+}
@@ -0,0 +1,56 @@
+/**
+ * @file    ContactEventQueue.cpp
+ * @brief   Contacts worth telling gameplay about, queued as Bullet finds them and handled once per step.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "ContactEventQueue.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+ContactEventQueue::ContactEventQueue (void) : mReadIndex(0)
+{
+    mEvents = new ContactEvent[CONTACT_EVENT_QUEUE_SIZE];
+}
+
+
+/// @brief  Destructor.
+ContactEventQueue::~ContactEventQueue (void)
+{
+    delete[] mEvents;
+}
+
+
+/// @brief  Queues an event. Can be called from any thread.
+/// @param  contactEvent  The event.
+/// @return False if the queue was full and the event was dropped.
+bool ContactEventQueue::push (const ContactEvent &contactEvent)
+{
+    uint32_t index = mWriteIndex.Increment() - 1;
+    if (index - mReadIndex >= CONTACT_EVENT_QUEUE_SIZE)
+    {
+        mDropped.Increment();
+        return false;
+    }
+
+    mEvents[index & (CONTACT_EVENT_QUEUE_SIZE - 1)] = contactEvent;
+    return true;
+}
+
+
+/// @brief  Forgets every queued event. Only call when nothing is pushing.
+void ContactEventQueue::clear (void)
+{
+    mReadIndex = mWriteIndex.GetValue();
+}
+
+
+/// @brief  Gets the number of events queued. Only valid when nothing is pushing.
+int ContactEventQueue::getNumEvents (void) const
+{
+    uint32_t count = mWriteIndex.GetValue() - mReadIndex;
+    return count > CONTACT_EVENT_QUEUE_SIZE ? CONTACT_EVENT_QUEUE_SIZE : (int) count;
+}
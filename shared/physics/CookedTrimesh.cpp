@@ -0,0 +1,288 @@
+/**
+ * @file    CookedTrimesh.cpp
+ * @brief   Triangle mesh collision shapes whose triangles and BVH are cooked to a file once, then memory
+            mapped by every server and client which loads them rather than being built again.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "CookedTrimesh.h"
+#include <vector>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define COOKED_TRIMESH_BYTE_ORDER 0x01020304
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+static inline unsigned int align16 (unsigned int offset)
+{
+    return (offset + 15) & ~15u;
+}
+
+
+/// @brief  Writes a whole file under a name of its own, then moves it over the target in one go. Another
+///         process may have the target mapped (or be writing it too), so it must never be truncated in place.
+/// @param  path   The file.
+/// @param  data   What to write.
+/// @param  bytes  How much to write.
+/// @return False if the file couldn't be written, in which case the target is left as it was.
+static bool writeFileAtomically (const std::string &path, const char *data, size_t bytes)
+{
+    char suffix[32];
+#ifdef _WIN32
+    sprintf(suffix, ".%lu.tmp", (unsigned long) GetCurrentProcessId());
+#else
+    sprintf(suffix, ".%lu.tmp", (unsigned long) getpid());
+#endif
+    std::string tempPath = path + suffix;
+
+    FILE *f = fopen(tempPath.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    bool written = fwrite(data, 1, bytes, f) == bytes;
+    written = fclose(f) == 0 && written;
+
+    // Windows won't replace a file which is mapped, but then the file there is already a cooked one.
+#ifdef _WIN32
+    if (written)
+        written = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    if (written)
+        written = rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+    if (!written)
+        remove(tempPath.c_str());
+    return written;
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor. Use load().
+CookedTrimesh::CookedTrimesh (void) : mData(NULL), mBytes(0), mMesh(NULL), mShape(NULL)
+{
+}
+
+
+/// @brief  Destructor. The shape must no longer be in use.
+CookedTrimesh::~CookedTrimesh (void)
+{
+    delete mShape;
+    delete mMesh;
+    unmap();
+}
+
+
+/// @brief  Writes a shape's triangles and BVH to a file, for load() to map.
+/// @param  shape        The shape. Its mesh must be a single part.
+/// @param  path         The file.
+/// @param  sourceHash   The hash of the mesh file the shape was built from (see ArenaStreamer::hashCollisionMesh()).
+/// @param  scale        The scale the shape was built at.
+/// @return False if the shape couldn't be cooked or the file couldn't be written.
+bool CookedTrimesh::cook (btBvhTriangleMeshShape *shape, const std::string &path, unsigned int sourceHash, float scale)
+{
+    btStridingMeshInterface *meshInterface = shape->getMeshInterface();
+    btOptimizedBvh *bvh = shape->getOptimizedBvh();
+    if (bvh == NULL || meshInterface->getNumSubParts() != 1)
+        return false;
+
+    // The BVH refers to triangles by their index, so they are kept in the same order.
+    const unsigned char *vertexBase, *indexBase;
+    int numVertices, vertexStride, indexStride, numTriangles;
+    PHY_ScalarType vertexType, indexType;
+    meshInterface->getLockedReadOnlyVertexIndexBase(&vertexBase, numVertices, vertexType, vertexStride,
+                                                    &indexBase, indexStride, numTriangles, indexType, 0);
+
+    std::vector<float> vertices(numVertices * 3);
+    for (int i = 0; i < numVertices; i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (vertexType == PHY_DOUBLE)
+                vertices[i * 3 + axis] = (float) ((const double*) (vertexBase + i * vertexStride))[axis];
+            else
+                vertices[i * 3 + axis] = ((const float*) (vertexBase + i * vertexStride))[axis];
+        }
+    }
+
+    std::vector<unsigned int> indices(numTriangles * 3);
+    for (int i = 0; i < numTriangles; i++)
+    {
+        for (int corner = 0; corner < 3; corner++)
+        {
+            if (indexType == PHY_SHORT)
+                indices[i * 3 + corner] = ((const unsigned short*) (indexBase + i * indexStride))[corner];
+            else
+                indices[i * 3 + corner] = ((const unsigned int*) (indexBase + i * indexStride))[corner];
+        }
+    }
+    meshInterface->unLockReadOnlyVertexBase(0);
+
+    CookedTrimeshHeader header;
+    memset(&header, 0, sizeof(CookedTrimeshHeader));
+    memcpy(header.magic, "CDTM", 4);
+    header.version      = COOKED_TRIMESH_VERSION;
+    header.byteOrder    = COOKED_TRIMESH_BYTE_ORDER;
+    header.sourceHash   = sourceHash;
+    header.scale        = scale;
+    header.numTriangles = numTriangles;
+    header.numVertices  = numVertices;
+    header.indexOffset  = align16(sizeof(CookedTrimeshHeader));
+    header.vertexOffset = align16(header.indexOffset  + indices.size()  * sizeof(unsigned int));
+    header.bvhOffset    = align16(header.vertexOffset + vertices.size() * sizeof(float));
+    header.bvhBytes     = bvh->calculateSerializeBufferSize();
+    header.fileBytes    = header.bvhOffset + header.bvhBytes;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.aabbMin[axis]      = shape->getLocalAabbMin()[axis];
+        header.aabbMax[axis]      = shape->getLocalAabbMax()[axis];
+        header.localScaling[axis] = shape->getLocalScaling()[axis];
+    }
+
+    // The BVH has to be written from a 16 byte aligned buffer.
+    char *file = (char*) btAlignedAlloc(header.fileBytes, 16);
+    memset(file, 0, header.fileBytes);
+    memcpy(file, &header, sizeof(CookedTrimeshHeader));
+    memcpy(file + header.indexOffset,  &indices[0],  indices.size()  * sizeof(unsigned int));
+    memcpy(file + header.vertexOffset, &vertices[0], vertices.size() * sizeof(float));
+    bool cooked = bvh->serializeInPlace(file + header.bvhOffset, header.bvhBytes, false);
+
+    if (cooked)
+        cooked = writeFileAtomically(path, file, header.fileBytes);
+
+    btAlignedFree(file);
+    return cooked;
+}
+
+
+/// @brief  Maps a file written by cook() and makes a shape from it.
+/// @param  path         The file.
+/// @param  sourceHash   The hash of the mesh the shape is wanted from. The file is rejected if it was cooked from another.
+/// @param  scale        The scale the shape is wanted at. The file is rejected if it was cooked at another.
+/// @return The shape, or NULL if there is no file or it's out of date. Delete it once the shape is no longer used.
+CookedTrimesh* CookedTrimesh::load (const std::string &path, unsigned int sourceHash, float scale)
+{
+    CookedTrimesh *cooked = new CookedTrimesh();
+    if (!cooked->map(path) || cooked->mBytes < sizeof(CookedTrimeshHeader))
+    {
+        delete cooked;
+        return NULL;
+    }
+
+    const CookedTrimeshHeader *header = (const CookedTrimeshHeader*) cooked->mData;
+    if (memcmp(header->magic, "CDTM", 4) != 0
+        || header->version     != COOKED_TRIMESH_VERSION
+        || header->byteOrder   != COOKED_TRIMESH_BYTE_ORDER
+        || header->sourceHash  != sourceHash
+        || header->scale       != scale
+        || header->fileBytes   != cooked->mBytes
+        || header->indexOffset  + header->numTriangles * 3 * sizeof(unsigned int) > header->vertexOffset
+        || header->vertexOffset + header->numVertices  * 3 * sizeof(float)        > header->bvhOffset
+        || header->bvhOffset    + header->bvhBytes                                > header->fileBytes
+        || (header->bvhOffset & 15) != 0)
+    {
+        delete cooked;
+        return NULL;
+    }
+
+    btIndexedMesh part;
+    part.m_numTriangles        = header->numTriangles;
+    part.m_triangleIndexBase   = (const unsigned char*) (cooked->mData + header->indexOffset);
+    part.m_triangleIndexStride = 3 * sizeof(unsigned int);
+    part.m_indexType           = PHY_INTEGER;
+    part.m_numVertices         = header->numVertices;
+    part.m_vertexBase          = (const unsigned char*) (cooked->mData + header->vertexOffset);
+    part.m_vertexStride        = 3 * sizeof(float);
+    part.m_vertexType          = PHY_FLOAT;
+
+    cooked->mMesh = new btTriangleIndexVertexArray();
+    cooked->mMesh->addIndexedMesh(part, PHY_INTEGER);
+    cooked->mMesh->setPremadeAabb(btVector3(header->aabbMin[0], header->aabbMin[1], header->aabbMin[2]),
+                                  btVector3(header->aabbMax[0], header->aabbMax[1], header->aabbMax[2]));
+
+    btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(cooked->mData + header->bvhOffset, header->bvhBytes, false);
+    if (bvh == NULL)
+    {
+        delete cooked;
+        return NULL;
+    }
+
+    cooked->mShape = new btBvhTriangleMeshShape(cooked->mMesh, true, false);
+    cooked->mShape->setOptimizedBvh(bvh, btVector3(header->localScaling[0], header->localScaling[1], header->localScaling[2]));
+    return cooked;
+}
+
+
+/// @brief  Reads every page of the file in, so the shape's first collisions don't wait on the disk.
+void CookedTrimesh::touch (void) const
+{
+    volatile char sum = 0;
+    for (size_t i = 0; i < mBytes; i += 4096)
+        sum += mData[i];
+}
+
+
+/// @brief  Maps a file copy-on-write.
+/// @param  path  The file.
+/// @return False if the file couldn't be mapped.
+bool CookedTrimesh::map (const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    DWORD bytes = GetFileSize(file, NULL);
+    HANDLE mapping = bytes == INVALID_FILE_SIZE || bytes == 0 ? NULL : CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return false;
+
+    // The view keeps the mapping open.
+    mData = (char*) MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (mData == NULL)
+        return false;
+    mBytes = bytes;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    mData  = (char*) data;
+    mBytes = info.st_size;
+#endif
+    return true;
+}
+
+
+/// @brief  Unmaps the file.
+void CookedTrimesh::unmap (void)
+{
+    if (mData == NULL)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+#else
+    munmap(mData, mBytes);
+#endif
+    mData  = NULL;
+    mBytes = 0;
+}
@@ -0,0 +1,418 @@
+/**
+ * @file    ParallelDynamicsWorld.cpp
+ * @brief   A dynamics world which solves its simulation islands on several threads at once.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "ParallelDynamicsWorld.h"
+#include "GameCore.h"
+#include "SimulationClock.h"
+#include "GetTime.h"
+#include "BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "BulletDynamics/ConstraintSolver/btHingeConstraint.h"
+#include <algorithm>
+
+#define BENCHMARK_CARS_PER_PILE     4           // Cars thrown together into each pile up (and island).
+#define BENCHMARK_DEBRIS_PER_CAR    6
+#define BENCHMARK_PILE_SPACING      15.0f       // Far enough apart that pile ups never touch.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  Orders constraints by the island they are in.
+struct ConstraintIslandPredicate
+{
+    bool operator() (const btTypedConstraint *lhs, const btTypedConstraint *rhs) const;
+};
+
+
+/// @brief  The bodies and shapes of the scene ParallelDynamicsWorld::benchmark() steps.
+struct BenchmarkScene
+{
+    btCollisionShape               *groundShape;
+    btCollisionShape               *chassisBox;
+    btCompoundShape                *chassisShape;
+    btCollisionShape               *doorShape;
+    btCollisionShape               *debrisShape;
+    btRigidBody                    *ground;
+    std::vector<btRigidBody*>       bodies;         // The moving bodies, in the order they were made.
+    std::vector<btTypedConstraint*> constraints;
+};
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+/// @brief  Gets the island a constraint is in, as btDiscreteDynamicsWorld does.
+static int getConstraintIslandId (const btTypedConstraint *constraint)
+{
+    const btCollisionObject &body0 = constraint->getRigidBodyA();
+    const btCollisionObject &body1 = constraint->getRigidBodyB();
+    return body0.getIslandTag() >= 0 ? body0.getIslandTag() : body1.getIslandTag();
+}
+
+
+bool ConstraintIslandPredicate::operator() (const btTypedConstraint *lhs, const btTypedConstraint *rhs) const
+{
+    return getConstraintIslandId(lhs) < getConstraintIslandId(rhs);
+}
+
+
+static btRigidBody* addBenchmarkBody (btDiscreteDynamicsWorld *world, btCollisionShape *shape, btScalar mass,
+                                      const btVector3 &position, const btVector3 &velocity)
+{
+    btVector3 inertia(0, 0, 0);
+    if (mass > 0)
+        shape->calculateLocalInertia(mass, inertia);
+
+    btTransform transform(btQuaternion::getIdentity(), position);
+    btRigidBody *body = new btRigidBody(mass, new btDefaultMotionState(transform), shape, inertia);
+    body->setLinearVelocity(velocity);
+    world->addRigidBody(body);
+    return body;
+}
+
+
+/// @brief  Builds pile ups of cars, each with a hinged door and some debris, which all crash into each
+///         other at the same time. The same scene is built every time.
+/// @param  world  The world to build the scene in.
+/// @param  cars   The number of cars.
+/// @param  scene  Filled with what was built.
+static void buildBenchmarkScene (btDiscreteDynamicsWorld *world, int cars, BenchmarkScene &scene)
+{
+    scene.groundShape  = new btBoxShape(btVector3(500, 1, 500));
+    scene.chassisBox   = new btBoxShape(btVector3(1.0f, 0.5f, 2.2f));
+    scene.chassisShape = new btCompoundShape();
+    scene.chassisShape->addChildShape(btTransform(btQuaternion::getIdentity(), btVector3(0, 0.3f, 0)), scene.chassisBox);
+    scene.doorShape    = new btBoxShape(btVector3(0.05f, 0.4f, 0.6f));
+    scene.debrisShape  = new btBoxShape(btVector3(0.3f, 0.1f, 0.3f));
+    scene.ground       = addBenchmarkBody(world, scene.groundShape, 0, btVector3(0, -1, 0), btVector3(0, 0, 0));
+
+    int piles = (cars + BENCHMARK_CARS_PER_PILE - 1) / BENCHMARK_CARS_PER_PILE;
+    int side  = (int) ceil(sqrt((double) piles));
+    for (int i = 0; i < cars; i++)
+    {
+        int pile   = i / BENCHMARK_CARS_PER_PILE;
+        int inPile = i % BENCHMARK_CARS_PER_PILE;
+        btVector3 centre((pile % side - side * 0.5f) * BENCHMARK_PILE_SPACING, 0, (pile / side - side * 0.5f) * BENCHMARK_PILE_SPACING);
+
+        // The cars drive into the middle of the pile from around it, each a little higher than the last.
+        btScalar  angle    = inPile * SIMD_2_PI / BENCHMARK_CARS_PER_PILE;
+        btVector3 out(btCos(angle), 0, btSin(angle));
+        btVector3 position = centre + out * 4.0f + btVector3(0, 1.0f + inPile * 0.8f, 0);
+        btVector3 velocity = out * -8.0f;
+
+        btRigidBody *chassis = addBenchmarkBody(world, scene.chassisShape, 1200, position, velocity);
+        btRigidBody *door    = addBenchmarkBody(world, scene.doorShape, 20, position + btVector3(1.05f, 0.3f, 0), velocity);
+        scene.bodies.push_back(chassis);
+        scene.bodies.push_back(door);
+
+        btHingeConstraint *hinge = new btHingeConstraint(*chassis, *door, btVector3(1.05f, 0.3f, 0.6f), btVector3(0, 0, 0.6f),
+                                                         btVector3(0, 1, 0), btVector3(0, 1, 0));
+        hinge->setLimit(0, SIMD_HALF_PI);
+        world->addConstraint(hinge, true);
+        scene.constraints.push_back(hinge);
+
+        for (int j = 0; j < BENCHMARK_DEBRIS_PER_CAR; j++)
+        {
+            btVector3 offset((j % 3 - 1) * 0.7f, 1.5f + (j / 3) * 0.3f, 0);
+            scene.bodies.push_back(addBenchmarkBody(world, scene.debrisShape, 30, position + offset, velocity));
+        }
+    }
+}
+
+
+static void destroyBenchmarkScene (btDiscreteDynamicsWorld *world, BenchmarkScene &scene)
+{
+    for (size_t i = 0; i < scene.constraints.size(); i++)
+    {
+        world->removeConstraint(scene.constraints[i]);
+        delete scene.constraints[i];
+    }
+
+    scene.bodies.push_back(scene.ground);
+    for (size_t i = 0; i < scene.bodies.size(); i++)
+    {
+        world->removeRigidBody(scene.bodies[i]);
+        delete scene.bodies[i]->getMotionState();
+        delete scene.bodies[i];
+    }
+
+    delete scene.groundShape;
+    delete scene.chassisShape;
+    delete scene.chassisBox;
+    delete scene.doorShape;
+    delete scene.debrisShape;
+}
+
+
+/// @brief  Steps the benchmark's scene in a new world.
+/// @param  threads    The threads the world solves with, or 0 for an ordinary btDiscreteDynamicsWorld.
+/// @param  cars       The number of cars.
+/// @param  ticks      The number of ticks to step.
+/// @param  positions  Set to where each moving body ended up.
+/// @param  results    Filled with the timings.
+static void runBenchmark (int threads, int cars, int ticks, std::vector<btVector3> &positions, ParallelWorldBenchmark &results)
+{
+    btDefaultCollisionConfiguration     collisionConfig;
+    btCollisionDispatcher               dispatcher(&collisionConfig);
+    btDbvtBroadphase                    broadphase;
+    btSequentialImpulseConstraintSolver solver;
+    ParallelDynamicsWorld              *parallelWorld = NULL;
+    btDiscreteDynamicsWorld            *world;
+    if (threads > 0)
+        world = parallelWorld = new ParallelDynamicsWorld(&dispatcher, &broadphase, &solver, &collisionConfig, threads);
+    else
+        world = new btDiscreteDynamicsWorld(&dispatcher, &broadphase, &solver, &collisionConfig);
+    world->setGravity(btVector3(0, -9.81f, 0));
+
+    BenchmarkScene scene;
+    buildBenchmarkScene(world, cars, scene);
+
+    double stepTime = 0;
+    double islands  = 0;
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        RakNet::TimeUS startTime = RakNet::GetTimeUS();
+        world->stepSimulation(SIMULATION_TICK_SECONDS, 1, SIMULATION_TICK_SECONDS);
+        stepTime += (double) (RakNet::GetTimeUS() - startTime);
+
+        if (parallelWorld)
+            islands += parallelWorld->getNumIslands();
+    }
+
+    positions.resize(scene.bodies.size());
+    for (size_t i = 0; i < scene.bodies.size(); i++)
+        positions[i] = scene.bodies[i]->getCenterOfMassPosition();
+
+    results.threads          = threads;
+    results.ticks            = ticks;
+    results.tickMicroseconds = stepTime / ticks;
+    results.islandsPerTick   = islands / ticks;
+
+    destroyBenchmarkScene(world, scene);
+    delete world;
+}
+
+
+/*-------------------- ISLAND GATHERER --------------------*/
+/// @brief  Collects the islands Bullet builds into ParallelDynamicsWorld::mIslands, rather than solving
+///         each one as it is found.
+class ParallelDynamicsWorld::IslandGatherer : public btSimulationIslandManager::IslandCallback
+{
+public:
+    IslandGatherer (ParallelDynamicsWorld *world) : mWorld(world) {}
+
+    virtual void ProcessIsland (btCollisionObject **bodies, int numBodies, btPersistentManifold **manifolds, int numManifolds, int islandId)
+    {
+        btAlignedObjectArray<btTypedConstraint*> &constraints = mWorld->mSortedConstraints;
+        int numConstraints = constraints.size();
+
+        // Islands aren't being split, so everything arrives at once and is solved together here.
+        if (islandId < 0)
+        {
+            if (numManifolds + numConstraints > 0)
+                mWorld->m_constraintSolver->solveGroup(bodies, numBodies, manifolds, numManifolds,
+                    numConstraints > 0 ? &constraints[0] : NULL, numConstraints,
+                    *mWorld->mSolverInfo, mWorld->m_debugDrawer, mWorld->m_stackAlloc, mWorld->m_dispatcher1);
+            return;
+        }
+
+        // The island's constraints are next to each other in the sorted list.
+        int first = 0;
+        while (first < numConstraints && getConstraintIslandId(constraints[first]) != islandId)
+            first++;
+        int last = first;
+        while (last < numConstraints && getConstraintIslandId(constraints[last]) == islandId)
+            last++;
+
+        if (numManifolds + last - first == 0)
+            return;
+
+        Island island;
+        island.firstBody      = (int) mWorld->mIslandBodies.size();
+        island.numBodies      = numBodies;
+        island.manifolds      = manifolds;
+        island.numManifolds   = numManifolds;
+        island.constraints    = last > first ? &constraints[first] : NULL;
+        island.numConstraints = last - first;
+        island.batch          = 0;
+        mWorld->mIslandBodies.insert(mWorld->mIslandBodies.end(), bodies, bodies + numBodies);
+        mWorld->mIslands.push_back(island);
+    }
+
+private:
+    ParallelDynamicsWorld *mWorld;
+};
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  dispatcher       The world's dispatcher.
+/// @param  broadphase       The world's broadphase.
+/// @param  solver           The world's solver. The world makes more of its own for the other threads.
+/// @param  collisionConfig  The world's collision configuration.
+/// @param  numThreads       See setNumThreads().
+ParallelDynamicsWorld::ParallelDynamicsWorld (btDispatcher *dispatcher, btBroadphaseInterface *broadphase, btConstraintSolver *solver,
+                                              btCollisionConfiguration *collisionConfig, int numThreads)
+  : btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfig),
+    mNumThreads(1),
+    mVehicleSystem(NULL),
+    mSolverInfo(NULL)
+{
+    setNumThreads(numThreads);
+}
+
+
+/// @brief  Deconstructor.
+ParallelDynamicsWorld::~ParallelDynamicsWorld (void)
+{
+    for (size_t i = 0; i < mSolvers.size(); i++)
+        delete mSolvers[i];
+}
+
+
+/// @brief  Sets the most islands which are solved at once.
+/// @param  numThreads  The number of threads (including the one stepping the world), or -1 for one per core.
+///                     With 1 the world is solved exactly as an ordinary btDiscreteDynamicsWorld would be.
+void ParallelDynamicsWorld::setNumThreads (int numThreads)
+{
+    if (numThreads < 0)
+        numThreads = GameCore::mTaskPool ? GameCore::mTaskPool->getNumThreads() + 1 : 1;
+    if (numThreads < 1 || !isAvailable())
+        numThreads = 1;
+    mNumThreads = numThreads;
+
+    while ((int) mSolvers.size() < mNumThreads - 1)
+        mSolvers.push_back(new btSequentialImpulseConstraintSolver());
+}
+
+
+/// @brief  Checks whether islands can be solved in parallel. Bullet's profiler keeps a single global stack of
+///         the timers running (which solveGroup() pushes to), so it must be compiled out of the Bullet libraries
+///         with BT_NO_PROFILE. That can't be seen from here, so the build says so with COLLISION_DOMAIN_BULLET_NO_PROFILE.
+bool ParallelDynamicsWorld::isAvailable (void)
+{
+#ifdef COLLISION_DOMAIN_BULLET_NO_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+/// @brief  Solves the step's contacts and constraints. The islands are built as usual, then handed out in
+///         batches to GameCore::mTaskPool.
+/// @param  solverInfo  The solver's settings.
+void ParallelDynamicsWorld::solveConstraints (btContactSolverInfo &solverInfo)
+{
+    if (mNumThreads <= 1 || !GameCore::mTaskPool)
+    {
+        mIslands.clear();
+        btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+        return;
+    }
+
+    mSortedConstraints.resize(getNumConstraints());
+    for (int i = 0; i < getNumConstraints(); i++)
+        mSortedConstraints[i] = m_constraints[i];
+    mSortedConstraints.quickSort(ConstraintIslandPredicate());
+
+    // Done here rather than when each friction constraint's getInfo1() asks, which would be on the solver threads.
+    if (mVehicleSystem)
+        mVehicleSystem->updateWheelContacts();
+
+    mIslands.clear();
+    mIslandBodies.clear();
+    mSolverInfo = &solverInfo;
+    m_constraintSolver->prepareSolve(getNumCollisionObjects(), m_dispatcher1->getNumManifolds());
+
+    IslandGatherer gatherer(this);
+    m_islandManager->buildAndProcessIslands(m_dispatcher1, this, &gatherer);
+
+    int numBatches = std::min(mNumThreads, (int) mIslands.size());
+    assignBatches(numBatches);
+    if (numBatches > 1)
+        GameCore::mTaskPool->parallelFor(numBatches, &ParallelDynamicsWorld::solveBatchTask, this);
+    else if (numBatches == 1)
+        solveBatch(0);
+
+    m_constraintSolver->allSolved(solverInfo, m_debugDrawer, m_stackAlloc);
+    mSolverInfo = NULL;
+}
+
+
+/// @brief  Shares the islands out between the batches, giving each to the batch with the least work so far.
+/// @param  numBatches  The number of batches.
+void ParallelDynamicsWorld::assignBatches (int numBatches)
+{
+    mBatchWork.assign(std::max(numBatches, 1), 0);
+    for (size_t i = 0; i < mIslands.size(); i++)
+    {
+        int batch = 0;
+        for (int j = 1; j < numBatches; j++)
+            if (mBatchWork[j] < mBatchWork[batch])
+                batch = j;
+
+        // Each manifold or constraint is several rows for the solver, where a body is only read and written back.
+        Island &island = mIslands[i];
+        island.batch = batch;
+        mBatchWork[batch] += island.numBodies + 4 * (island.numManifolds + island.numConstraints);
+    }
+}
+
+
+/// @brief  Solves the islands in a batch, one after another.
+/// @param  batch  The batch.
+void ParallelDynamicsWorld::solveBatch (int batch)
+{
+    btConstraintSolver *solver = batch == 0 ? m_constraintSolver : mSolvers[batch - 1];
+    for (size_t i = 0; i < mIslands.size(); i++)
+    {
+        const Island &island = mIslands[i];
+        if (island.batch != batch)
+            continue;
+
+        // The stack allocator can't be shared between threads (the sequential impulse solver doesn't use it).
+        solver->solveGroup(&mIslandBodies[island.firstBody], island.numBodies, island.manifolds, island.numManifolds,
+                           island.constraints, island.numConstraints, *mSolverInfo, m_debugDrawer, NULL, m_dispatcher1);
+    }
+}
+
+
+/// @brief  A TaskPool task solving a batch.
+void ParallelDynamicsWorld::solveBatchTask (void *context, int index)
+{
+    ((ParallelDynamicsWorld*) context)->solveBatch(index);
+}
+
+
+/// @brief  Steps a scene of pile ups in an ordinary world, then in a parallel world with each number of
+///         threads up to one per core. Each parallel run is compared against the ordinary one, where every
+///         body should end up in exactly the same place.
+/// @param  cars     The number of cars.
+/// @param  ticks    The number of ticks to step.
+/// @param  results  Filled with the results, starting with the ordinary world.
+void ParallelDynamicsWorld::benchmark (int cars, int ticks, std::vector<ParallelWorldBenchmark> &results)
+{
+    results.clear();
+    if (cars <= 0 || ticks <= 0)
+        return;
+
+    std::vector<btVector3> reference;
+    std::vector<btVector3> positions;
+    ParallelWorldBenchmark run;
+    memset(&run, 0, sizeof(ParallelWorldBenchmark));
+    runBenchmark(0, cars, ticks, reference, run);
+    results.push_back(run);
+
+    int maxThreads = isAvailable() && GameCore::mTaskPool ? GameCore::mTaskPool->getNumThreads() + 1 : 1;
+    for (int threads = 1; threads <= maxThreads; threads++)
+    {
+        memset(&run, 0, sizeof(ParallelWorldBenchmark));
+        runBenchmark(threads, cars, ticks, positions, run);
+        for (size_t i = 0; i < positions.size(); i++)
+            run.maxDivergence = std::max(run.maxDivergence, (double) (positions[i] - reference[i]).length());
+        results.push_back(run);
+    }
+}
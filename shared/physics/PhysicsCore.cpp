@@ -9,6 +9,8 @@
 #include "SimpleCoupeCar.h"
 #include "SmallCar.h"
 #include "GameCore.h"
+#include "CarPool.h"
+#include "PhysicsLod.h"
 
 //#define DEBUG_FRAMES
 
@@ -22,14 +24,32 @@ PhysicsCore::PhysicsCore()
 
     mBulletAlignedBox = Ogre::AxisAlignedBox(Ogre::Vector3(-10000, -10000, -10000), Ogre::Vector3(10000,  10000,  10000));
     mNumEntitiesInstanced = 0; // how many shapes are created
+    mReplaying = false;
 
     // Start Bullet
-    mBroadphase         = new btAxisSweep3( btVector3( -10000, -10000, -10000 ), btVector3( 1000, 1000, 1000 ) );
+    // Sized to the arena once one is loaded (fitBroadphase).
+    mBroadphaseType     = BROADPHASE_DEFAULT;
+    mBroadphaseMin      = btVector3( -BROADPHASE_WORLD_EXTENT, -BROADPHASE_WORLD_EXTENT, -BROADPHASE_WORLD_EXTENT );
+    mBroadphaseMax      = btVector3(  BROADPHASE_WORLD_EXTENT,  BROADPHASE_WORLD_EXTENT,  BROADPHASE_WORLD_EXTENT );
+    mBroadphase         = Broadphase::create( mBroadphaseType, mBroadphaseMin, mBroadphaseMax );
     mCollisionConfig    = new btDefaultCollisionConfiguration();
     mDispatcher         = new btCollisionDispatcher( mCollisionConfig );
     mSolver             = new btSequentialImpulseConstraintSolver();
 
-    mBulletWorld        = new btDiscreteDynamicsWorld( mDispatcher, mBroadphase, mSolver, mCollisionConfig );
+    // Separate pile ups can be solved on separate threads, if physics.cfg asks for it.
+    bool parallelSolver;
+    int  solverThreads;
+    loadConfig( parallelSolver, solverThreads );
+    mParallelWorld      = NULL;
+    if( parallelSolver && !ParallelDynamicsWorld::isAvailable() )
+        Ogre::LogManager::getSingleton().logMessage( "ParallelSolver needs COLLISION_DOMAIN_BULLET_NO_PROFILE (see stdafx.h). Solving on one thread." );
+    else if( parallelSolver )
+        mParallelWorld  = new ParallelDynamicsWorld( mDispatcher, mBroadphase, mSolver, mCollisionConfig, solverThreads );
+
+    if( mParallelWorld )
+        mBulletWorld    = mParallelWorld;
+    else
+        mBulletWorld    = new btDiscreteDynamicsWorld( mDispatcher, mBroadphase, mSolver, mCollisionConfig );
 
     mBulletWorld->setGravity( btVector3( 0, -9.81f, 0 ) );
 
@@ -45,16 +65,43 @@ PhysicsCore::PhysicsCore()
 
     // lets get the callback for collisions every substep
     mPlayerCollisions = new PlayerCollisions();
+    mTransformStore   = new TransformStore();
+    mVehicleSystem    = new VehicleSystem();
+    mBulletWorld->addAction( mVehicleSystem );
+    if( mParallelWorld )
+        mParallelWorld->setVehicleSystem( mVehicleSystem );
+#ifdef COLLISION_DOMAIN_SERVER
+    mTransformHistory = new TransformHistory();
+#endif
     //mBulletWorld->setInternalTickCallback( preTickCallback, 0, true );
-    mBulletWorld->setInternalTickCallback( postTickCallback, 0, false );
+
+    // Bullet reports contacts involving cars (see addRigidBody) as it finds them.
+    mContactEvents = new ContactEventQueue();
+    gContactAddedCallback = contactAddedCallback;
+
+    mPhysicsLod = new PhysicsLod();
+    mCarPool    = new CarPool();
 }
 
 
 /// @brief  Destructor to clean up
 PhysicsCore::~PhysicsCore(void)
 {
+    // Spare cars aren't in the world, so they are deleted while the world is still whole.
+    delete mCarPool;
+    mCarPool = NULL;
+
     clearWorld();
+    delete mPhysicsLod;
     
+    mBulletWorld->removeAction( mVehicleSystem );
+    if( mParallelWorld )
+        mParallelWorld->setVehicleSystem( NULL );
+    delete mVehicleSystem;
+
+    gContactAddedCallback = NULL;
+    delete mContactEvents;
+
     delete mSolver;
     delete mDispatcher;
     delete mCollisionConfig;
@@ -62,6 +109,30 @@ PhysicsCore::~PhysicsCore(void)
 }
 
 
+/// @brief  Reads the physics settings from PHYSICS_CONFIG_PATH. Settings which are missing (or the whole
+///         file) are left at their defaults.
+/// @param  parallelSolver  Set to whether islands should be solved on several threads. Defaults to false.
+/// @param  solverThreads   Set to the most threads to solve with, or -1 for one per core. Defaults to -1.
+void PhysicsCore::loadConfig( bool &parallelSolver, int &solverThreads )
+{
+    parallelSolver = false;
+    solverThreads  = -1;
+
+    Ogre::ConfigFile cf;
+    try
+    {
+        cf.load( PHYSICS_CONFIG_PATH );
+    }
+    catch( Ogre::Exception& )
+    {
+        return;
+    }
+
+    parallelSolver = Ogre::StringConverter::parseBool( cf.getSetting( "ParallelSolver", Ogre::StringUtil::BLANK, "false" ) );
+    solverThreads  = Ogre::StringConverter::parseInt( cf.getSetting( "SolverThreads", Ogre::StringUtil::BLANK, "-1" ) );
+}
+
+
 /// @brief scale the given scenenode to the default scale
 /// @param n The scenenode to scale.
 void PhysicsCore::auto_scale_scenenode (Ogre::SceneNode* n)
@@ -75,6 +146,8 @@ void PhysicsCore::stepSimulation(const Ogre::Real elapsedTime, int maxSubSteps,
     //mWorld->stepSimulation(elapsedTime, maxSubSteps, fixedTimestep);
     mBulletWorld->stepSimulation( elapsedTime, maxSubSteps, fixedTimestep );
     mBulletWorld->debugDrawWorld();
+    dispatchContactEvents();
+    mCarPool->updateDebris();
 
 #ifdef DEBUG_FRAMES
     dbgDraw->setDebugMode( 1 );
@@ -85,61 +158,182 @@ void PhysicsCore::stepSimulation(const Ogre::Real elapsedTime, int maxSubSteps,
 }
 
 
+/// @brief  Steps one vehicle again over time which has already been simulated once, e.g. when the client
+///         replays its predicted input. Everything else is already at the present, so it is held where
+///         it is: the world is stepped as usual, but only the vehicle's own wheels are updated, and every
+///         other body is put back as it was afterwards. Collisions aren't reported, as they already were
+///         the first time.
+/// @param  vehicle  The vehicle to replay.
+void PhysicsCore::replaySimulation(Vehicle *vehicle, const Ogre::Real elapsedTime, int maxSubSteps, const Ogre::Real fixedTimestep)
+{
+    btRigidBody *chassis = vehicle->getRigidBody();
+
+    mReplayStates.clear();
+    btCollisionObjectArray &objects = mBulletWorld->getCollisionObjectArray();
+    for( int i = 0; i < objects.size(); i++ )
+    {
+        btRigidBody *body = btRigidBody::upcast( objects[i] );
+        if( !body || body == chassis || body->isStaticOrKinematicObject() )
+            continue;
+
+        ReplayBodyState state;
+        state.body                   = body;
+        state.transform              = body->getWorldTransform();
+        state.interpolationTransform = body->getInterpolationWorldTransform();
+        state.linearVelocity         = body->getLinearVelocity();
+        state.angularVelocity        = body->getAngularVelocity();
+        state.activationState        = body->getActivationState();
+        state.deactivationTime       = body->getDeactivationTime();
+        mReplayStates.push_back( state );
+    }
+
+    mReplaying = true;
+    mVehicleSystem->setReplayVehicle( vehicle );
+    mBulletWorld->stepSimulation( elapsedTime, maxSubSteps, fixedTimestep );
+    mVehicleSystem->setReplayVehicle( NULL );
+    mReplaying = false;
+
+    for( size_t i = 0; i < mReplayStates.size(); i++ )
+    {
+        const ReplayBodyState &state = mReplayStates[i];
+        btRigidBody *body = state.body;
+        body->setWorldTransform( state.transform );
+        body->setInterpolationWorldTransform( state.interpolationTransform );
+        body->setLinearVelocity( state.linearVelocity );
+        body->setAngularVelocity( state.angularVelocity );
+        body->setInterpolationLinearVelocity( state.linearVelocity );
+        body->setInterpolationAngularVelocity( state.angularVelocity );
+        body->forceActivationState( state.activationState );
+        body->setDeactivationTime( state.deactivationTime );
+
+        // The step moved the body's motion state (its scene node and TransformStore slot) too.
+        if( body->getMotionState() )
+            body->getMotionState()->setWorldTransform( state.transform );
+    }
+}
+
+
 void PhysicsCore::preTickCallback(btDynamicsWorld *world, btScalar timeStep) {
     //printf("The world just ticked by %f seconds\n", (float)timeStep);
     //OutputDebugString("Pre Tick\n");
 }
 
 
-/// timeStep is the number of seconds (float) which the world just ticked by (this substep only)
-void PhysicsCore::postTickCallback(btDynamicsWorld *world, btScalar timeStep) {
-    //OutputDebugString("Post Tick\n");
-    //defaultPlaneBody->getBulletObject()->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT | btCollisionObject::CF_NO_CONTACT_RESPONSE);
+/// @brief  Called by Bullet whenever it adds or refreshes a contact point involving a car. Queues the
+///         point for gameplay if the bodies have just started overlapping there, or if the contact has
+///         lasted but is still taking a large impulse (e.g. one car shoving another along). Resting
+///         contacts, which are most of them, are dropped here rather than being looked at every substep.
+///         Called from within stepSimulation, possibly on several threads at once.
+bool PhysicsCore::contactAddedCallback(btManifoldPoint& cp, const btCollisionObject* colObj0, int partId0, int index0,
+                                       const btCollisionObject* colObj1, int partId1, int index1)
+{
+    if (GameCore::mPhysicsCore->mReplaying)
+        return false;
 
-	// This function is called *within* stepSimulation. Let's build a list of the cars which collided so
-    // that once the stepSim finishes all its substeps (this multiple times) that list can be read off
-    
-	int numManifolds = world->getDispatcher()->getNumManifolds();
-	for (int i = 0; i < numManifolds; i++)
-	{
-		btPersistentManifold* contactManifold =  world->getDispatcher()->getManifoldByIndexInternal(i);
+    // m_userPersistentData survives the point being refreshed, so it marks the points already reported as overlapping.
+    bool overlapping = cp.getDistance() < 0.f;
+    bool started     = overlapping && cp.m_userPersistentData == NULL;
+    if (!started && (cp.getLifeTime() == 0 || cp.getAppliedImpulse() < CONTACT_EVENT_MIN_IMPULSE))
+        return false;
+    if (overlapping)
+        cp.m_userPersistentData = (void*) 1;
+
+    short groupA = colObj0->getBroadphaseHandle()->m_collisionFilterGroup;
+    short groupB = colObj1->getBroadphaseHandle()->m_collisionFilterGroup;
+    bool carIsA  = (groupA & COL_CAR) != 0;
+
+    ContactEvent contactEvent;
+    contactEvent.objectA  = carIsA ? colObj0 : colObj1;
+    contactEvent.objectB  = carIsA ? colObj1 : colObj0;
+    contactEvent.playerA  = static_cast<Player*>(contactEvent.objectA->getUserPointer());
+    contactEvent.playerB  = NULL;
+    contactEvent.powerup  = NULL;
+    contactEvent.pointOnA = carIsA ? cp.getPositionWorldOnA() : cp.getPositionWorldOnB();
+    contactEvent.pointOnB = carIsA ? cp.getPositionWorldOnB() : cp.getPositionWorldOnA();
+    contactEvent.distance = cp.getDistance();
+    if (contactEvent.playerA == NULL)
+        return false;
 
-		btCollisionObject* obA = static_cast<btCollisionObject*>(contactManifold->getBody0());
-		btCollisionObject* obB = static_cast<btCollisionObject*>(contactManifold->getBody1());
+    // group of the wheels is the chassis group (I think ...)
+    // mask of the wheels is always 00000001 (COL_CAR)
+    // Car to Car collision
+    if (groupA & COL_CAR && groupB & COL_CAR)
+    {
+        contactEvent.type    = CONTACT_CAR_CAR;
+        contactEvent.playerB = static_cast<Player*>(contactEvent.objectB->getUserPointer());
+        if (contactEvent.playerB == NULL)
+            return false;
+    }
+    // Car to Powerup collision
+#ifdef COLLISION_DOMAIN_SERVER
+    else if (groupA & COL_CAR && groupB & COL_POWERUP || groupA & COL_POWERUP && groupB & COL_CAR)
+    {
+        contactEvent.type    = CONTACT_CAR_POWERUP;
+        contactEvent.powerup = static_cast<Powerup*>(contactEvent.objectB->getUserPointer());
+        if (contactEvent.powerup == NULL)
+            return false;
+    }
+#endif
+    // Car to Arena collision
+    else if (groupA & COL_CAR && groupB & COL_ARENA || groupA & COL_ARENA && groupB & COL_CAR)
+    {
+        contactEvent.type    = CONTACT_CAR_ARENA;
+        contactEvent.playerB = contactEvent.playerA;
+    }
+    else
+    {
+        return false;
+    }
+
+    GameCore::mPhysicsCore->mContactEvents->push(contactEvent);
+    return false;
+}
 
-        short groupA = obA->getBroadphaseHandle()->m_collisionFilterGroup;
-        short groupB = obB->getBroadphaseHandle()->m_collisionFilterGroup;
 
-        // group of the wheels is the chassis group (I think ...)
-        // mask of the wheels is always 00000001 (COL_CAR)
-        // Car to Car collision
-        if (groupA & COL_CAR && groupB & COL_CAR)
-        {
-            Player* playerA = static_cast<Player*>(obA->getUserPointer());
-            Player* playerB = static_cast<Player*>(obB->getUserPointer());
-            if (playerA && playerB) GameCore::mPhysicsCore->mPlayerCollisions->addCollision(playerA, playerB, contactManifold);
-        }
-        // Car to Powerup collision
+/// @brief  Hands the contacts queued during the last step to gameplay, then empties the queue. The
+///         points of each pair of bodies come one after another, as Bullet finds them a pair at a
+///         time, so they are averaged into one collision.
+void PhysicsCore::dispatchContactEvents()
+{
+    int numEvents = mContactEvents->getNumEvents();
+    int i = 0;
+    while (i < numEvents)
+    {
+        const ContactEvent &first = mContactEvents->getEvent(i);
 #ifdef COLLISION_DOMAIN_SERVER
-        else if (groupA & COL_CAR && groupB & COL_POWERUP || groupA & COL_POWERUP && groupB & COL_CAR)
+        if (first.type == CONTACT_CAR_POWERUP)
         {
-            Player* player = static_cast<Player*>((groupA & COL_CAR ? obA : obB)->getUserPointer());
-            Powerup* powerup = static_cast<Powerup*>((groupA & COL_POWERUP ? obA : obB)->getUserPointer());
-            if (powerup && player)
-                powerup->playerCollision(player);
+            first.powerup->playerCollision(first.playerA);
+            i++;
+            continue;
         }
 #endif
-        // Car to Arena collision
-        else if (groupA & COL_CAR && groupB & COL_ARENA || groupA & COL_ARENA && groupB & COL_CAR)
-        {
-            Player* player = static_cast<Player*>((groupA & COL_CAR ? obA : obB)->getUserPointer());
-            if(player) GameCore::mPhysicsCore->mPlayerCollisions->addCollision(player, player, contactManifold);
-        }
-        else
+
+        // number of contact points usually > 1, so average all of the relevant values
+        btVector3 averageCollisionPointOnA(0, 0, 0);
+        btVector3 averageCollisionPointOnB(0, 0, 0);
+        btScalar  averageOverlapDistance = 0.f;
+        int       numContacts = 0;
+        for (; i < numEvents; i++, numContacts++)
         {
-            continue;
+            const ContactEvent &pt = mContactEvents->getEvent(i);
+            if (pt.objectA != first.objectA || pt.objectB != first.objectB)
+                break;
+            if (pt.distance < 0.f)
+            {
+                averageCollisionPointOnA += pt.pointOnA;
+                averageCollisionPointOnB += pt.pointOnB;
+                averageOverlapDistance   += pt.distance * 0.95f;
+            }
         }
-	}
+
+        averageCollisionPointOnA /= numContacts;
+        averageCollisionPointOnB /= numContacts;
+        averageOverlapDistance   /= numContacts;
+        mPlayerCollisions->addCollision(first.playerA, first.playerB, averageCollisionPointOnA, averageCollisionPointOnB, averageOverlapDistance);
+    }
+
+    mContactEvents->clear();
 }
 
 
@@ -171,11 +365,10 @@ btRigidBody* PhysicsCore::createArenaBody( Ogre::SceneNode *targetNode, ArenaID
 
 void PhysicsCore::createCollisionShapes()
 {
-#ifdef COLLISION_DOMAIN_SERVER
-    GameCore::mServerGraphics->createArenaCollisionShapes();
-#else
-    GameCore::mClientGraphics->createArenaCollisionShapes();
-#endif
+    // Arena shapes are loaded with their arenas (SceneSetup::loadArenaCollisionShape).
+    for( int i = 0; i < ARENA_COUNT; i ++ )
+        mShapes[PHYS_SHAPE_COLOSSEUM + i] = NULL;
+
     SimpleCoupeCar::createCollisionShapes();
     SmallCar::createCollisionShapes();
     TruckCar::createCollisionShapes();
@@ -187,10 +380,28 @@ void PhysicsCore::createCollisionShapes()
 
 void PhysicsCore::addRigidBody( btRigidBody *body, short colGroup, short colMask )
 {
+    // Only contacts involving cars are any use to gameplay, so only they are reported.
+    if( colGroup & COL_CAR )
+        body->setCollisionFlags( body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK );
+
     mBulletWorld->addRigidBody( body, colGroup, colMask );
     mBodies.push_back( body );
 }
 
+/// @brief  Adds a car's vehicle to the world, to be updated alongside every other car's.
+/// @param  vehicle  The vehicle.
+void PhysicsCore::addVehicle( Vehicle *vehicle )
+{
+    mVehicleSystem->addVehicle( vehicle );
+}
+
+/// @brief  Removes a car's vehicle from the world.
+/// @param  vehicle  The vehicle.
+void PhysicsCore::removeVehicle( Vehicle *vehicle )
+{
+    mVehicleSystem->removeVehicle( vehicle );
+}
+
 bool PhysicsCore::removeBody( btRigidBody *body )
 {
     std::deque<btRigidBody*>::iterator it = find( mBodies.begin(), mBodies.end(), body );
@@ -213,8 +424,29 @@ bool PhysicsCore::removeBody( btRigidBody *body )
 
 }
 
+/// @brief  Takes a body out of the world without deleting its motion state, so that it can be added again.
+/// @param  body  The body.
+/// @return False if the body wasn't in the world.
+bool PhysicsCore::parkBody( btRigidBody *body )
+{
+    std::deque<btRigidBody*>::iterator it = find( mBodies.begin(), mBodies.end(), body );
+
+    if ( it == mBodies.end() || body == NULL )
+        return false;
+
+    mBulletWorld->getBroadphase()->getOverlappingPairCache()->cleanProxyFromPairs( body->getBroadphaseHandle(), mBulletWorld->getDispatcher() );
+    mBulletWorld->removeRigidBody( body );
+    mBodies.erase( it );
+
+    return true;
+}
+
 void PhysicsCore::clearWorld()
 {
+    // Debris keeps its motion state for reuse, so it must be parked rather than removed.
+    if( mCarPool )
+        mCarPool->releaseDebris();
+
     for( int i = mBulletWorld->getNumCollisionObjects() - 1; i >= 0; i -- )
     {
         btCollisionObject *obj = mBulletWorld->getCollisionObjectArray()[i];
@@ -236,6 +468,67 @@ void PhysicsCore::clearWorld()
 #endif
 }
 
+/// @brief  Changes the broadphase the world uses. Everything in the world is kept.
+/// @param  type  The broadphase.
+void PhysicsCore::setBroadphase( BroadphaseType type )
+{
+    if( type == mBroadphaseType )
+        return;
+
+    mBroadphaseType = type;
+    rebuildBroadphase();
+}
+
+/// @brief  Sizes the broadphase to an arena. Called when an arena is loaded.
+/// @param  arenaMin  The minimum corner of the arena's bounds.
+/// @param  arenaMax  The maximum corner of the arena's bounds.
+void PhysicsCore::fitBroadphase( const btVector3 &arenaMin, const btVector3 &arenaMax )
+{
+    btVector3 worldMin, worldMax;
+    Broadphase::getArenaBounds( arenaMin, arenaMax, worldMin, worldMax );
+    if( worldMin == mBroadphaseMin && worldMax == mBroadphaseMax )
+        return;
+
+    mBroadphaseMin = worldMin;
+    mBroadphaseMax = worldMax;
+
+    // A dbvt isn't bounded, so it doesn't need building again.
+    if( mBroadphaseType == BROADPHASE_SWEEP_AND_PRUNE )
+        rebuildBroadphase();
+}
+
+/// @brief  Replaces the broadphase with a new one of mBroadphaseType covering mBroadphaseMin to mBroadphaseMax,
+///         taking everything out of the world and putting it back in with the same groups and masks.
+void PhysicsCore::rebuildBroadphase()
+{
+    btAlignedObjectArray<btCollisionObject*> objects;
+    btAlignedObjectArray<short>              groups;
+    btAlignedObjectArray<short>              masks;
+    for( int i = 0; i < mBulletWorld->getNumCollisionObjects(); i ++ )
+    {
+        btCollisionObject *obj = mBulletWorld->getCollisionObjectArray()[i];
+        objects.push_back( obj );
+        groups.push_back( obj->getBroadphaseHandle()->m_collisionFilterGroup );
+        masks.push_back( obj->getBroadphaseHandle()->m_collisionFilterMask );
+    }
+
+    for( int i = objects.size() - 1; i >= 0; i -- )
+        mBulletWorld->removeCollisionObject( objects[i] );
+
+    delete mBroadphase;
+    mBroadphase = Broadphase::create( mBroadphaseType, mBroadphaseMin, mBroadphaseMax );
+    mBulletWorld->setBroadphase( mBroadphase );
+
+    for( int i = 0; i < objects.size(); i ++ )
+    {
+        btRigidBody *body = btRigidBody::upcast( objects[i] );
+        if( body )
+            mBulletWorld->addRigidBody( body, groups[i], masks[i] );
+        else
+            mBulletWorld->addCollisionObject( objects[i], groups[i], masks[i] );
+    }
+}
+
 bool PhysicsCore::singleObjectRaytest(const btVector3& rayFrom, const btVector3& rayTo, btVector3& worldNormal, btVector3& worldHitPoint)
 {
         btScalar closestHitResults = 1.f;
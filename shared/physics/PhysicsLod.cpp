@@ -0,0 +1,91 @@
+/**
+ * @file    PhysicsLod.cpp
+ * @brief   Simulates wrecked cars and the parts which have fallen off cars more cheaply than live cars, and
+            limits how many parts are in the world at once.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "PhysicsLod.h"
+#include "PhysicsCore.h"
+#include "GameCore.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+PhysicsLod::PhysicsLod (void) : mDebrisLifetime(PHYSICS_LOD_DEBRIS_LIFETIME), mDebrisBudget(PHYSICS_LOD_DEBRIS_BUDGET)
+{
+}
+
+
+/// @brief  Destructor. Deletes the proxies, which nothing may still be using.
+PhysicsLod::~PhysicsLod (void)
+{
+    for (std::map<btCollisionShape*, btCompoundShape*>::iterator it = mProxyShapes.begin(); it != mProxyShapes.end(); it++)
+    {
+        delete it->second->getChildShape(0);
+        delete it->second;
+    }
+}
+
+
+/// @brief  Gets a box which fits around a shape, made the first time it is asked for.
+/// @param  shape  The shape.
+/// @return The box (in a compound, as the shape may not be centred on its origin).
+btCollisionShape* PhysicsLod::getProxyShape (btCollisionShape *shape)
+{
+    std::map<btCollisionShape*, btCompoundShape*>::iterator it = mProxyShapes.find(shape);
+    if (it != mProxyShapes.end())
+        return it->second;
+
+    btVector3 aabbMin, aabbMax;
+    shape->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+
+    btCompoundShape *proxy = new btCompoundShape();
+    proxy->addChildShape(btTransform(btQuaternion::getIdentity(), (aabbMin + aabbMax) * 0.5f), new btBoxShape((aabbMax - aabbMin) * 0.5f));
+    mProxyShapes[shape] = proxy;
+    return proxy;
+}
+
+
+/// @brief  Changes a body's shape, keeping its mass. A body in the world is taken out and put back in with
+///         the same group and mask, so that nothing is left holding contacts with the old shape.
+/// @param  body   The body.
+/// @param  shape  The new shape.
+void PhysicsLod::setShape (btRigidBody *body, btCollisionShape *shape)
+{
+    if (body->getCollisionShape() == shape)
+        return;
+
+    btDynamicsWorld *world = GameCore::mPhysicsCore->getWorld();
+    btBroadphaseProxy *handle = body->getBroadphaseHandle();
+    short group = 0, mask = 0;
+    if (handle != NULL)
+    {
+        group = handle->m_collisionFilterGroup;
+        mask  = handle->m_collisionFilterMask;
+        world->removeRigidBody(body);
+    }
+
+    btScalar mass = body->getInvMass() != 0 ? 1 / body->getInvMass() : 0;
+    btVector3 inertia(0, 0, 0);
+    shape->calculateLocalInertia(mass, inertia);
+    body->setCollisionShape(shape);
+    body->setMassProps(mass, inertia);
+    body->updateInertiaTensor();
+
+    if (handle != NULL)
+        world->addRigidBody(body, group, mask);
+}
+
+
+/// @brief  Lets a body fall asleep once it has settled, after which the solver leaves it alone until
+///         something hits it.
+/// @param  body  The body.
+void PhysicsLod::allowSleeping (btRigidBody *body)
+{
+    body->setSleepingThresholds(PHYSICS_LOD_SLEEP_LINEAR, PHYSICS_LOD_SLEEP_ANGULAR);
+    body->forceActivationState(ACTIVE_TAG);
+    body->setDeactivationTime(0);
+}
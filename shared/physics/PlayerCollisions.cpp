@@ -7,215 +7,275 @@
  */
 #include "stdafx.h"
 #include "PlayerCollisions.h"
-#include "boost/lexical_cast.hpp"
 
 #define MAX_DAMAGE 400
 #define BIG_CRASH_THRESHOLD 80
+#define LAG_COMPENSATION_MAX_HITS    16     // Cars one player can hit in a tick through lag compensation
+#define LAG_COMPENSATION_MAX_OVERLAP 0.01f  // Caps the overlap guessed from bounding boxes, which overstate it
 
-/// @brief  Constructor to create physics stuff
-/// @param  sceneMgr  The Ogre SceneManager which nodes can be attached to.
-PlayerCollisions::PlayerCollisions()
+/// @brief  Constructor.
+/// @param  capacity  The number of car slots to make room for up front. More are made if needed.
+PlayerCollisions::PlayerCollisions(int capacity) : mFrame(0)
 {
-    // any given Player pointer can only appear on one of the linkedlist nodes over the total list
-    // eventually alongside Player*, collision information such as force and locations will be stored
-    mCollisions = new std::list< std::list<Player*>* >;
+    grow(capacity);
 }
 
 
 /// @brief  Destructor to clean up
 PlayerCollisions::~PlayerCollisions()
 {
-    std::list<std::list<Player*>*>::iterator i = mCollisions->begin();
-    while (i != mCollisions->end())
-    {
-        std::list<Player*>* subList = *i;
-        delete subList;
-        ++i;
-    }
-
-    delete mCollisions;
 }
 
-static int numColls = 0;
-
 static float massPairs[3][3] = {
         { 1.0f, 0.8f, 1.2f },
         { 1.2f, 1.0f, 1.4f },
         { 1.0f, 0.8f, 1.0f }
     };
 
-void PlayerCollisions::addCollision(Player* p1, Player* p2, btPersistentManifold* contactManifold) {
+/// @brief  Converts a point in the world to where it is on a car. This goes by the chassis rather than the
+///         car's scene node, which the headless server never moves.
+/// @param  player      The car's player.
+/// @param  worldPoint  The point (world space).
+static Ogre::Vector3 toCarLocal(Player *player, const btVector3 &worldPoint)
+{
+    const btTransform &chassisTransform = player->getCar()->getVehicle()->getRigidBody()->getWorldTransform();
+    return BtOgre::Convert::toOgre(chassisTransform.invXform(worldPoint));
+}
+
+/// @brief  Works out how loud a crash is from the damage it did to one car.
+/// @param  damage     The damage.
+/// @param  crashType  1 for a scrape (which only makes sparks), 2 for a knock or 3 for a big crash.
+static float getCrashIntensity(Ogre::Real damage, int crashType)
+{
+    // 300 is a little louder than 400 :P (not perfect yet as it will need tuning with the final fps)
+    float intensity = crashType == 2 ? damage / 350.f : (crashType == 3 ? damage / 230.f : 0);
+    return intensity < 0 ? 0 : (intensity > 1 ? 1 : intensity);
+}
+
+/// @brief  Deals with a car's contact with another car or the arena, averaged over the contact's points
+///         (see PhysicsCore::dispatchContactEvents).
+/// @param  p1                        The player whose car is the first body.
+/// @param  p2                        The player whose car is the second body, or p1 again if it's the arena.
+/// @param  averageCollisionPointOnA  Where the contact was on the first body (world space).
+/// @param  averageCollisionPointOnB  Where the contact was on the second body (world space).
+/// @param  averageOverlapDistance    How far the bodies overlapped (negative).
+void PlayerCollisions::addCollision(Player* p1, Player* p2, const btVector3 &averageCollisionPointOnA, const btVector3 &averageCollisionPointOnB,
+    btScalar averageOverlapDistance) {
     if( p1 == NULL || p2 == NULL )
         return;
+
+    int slot1 = p1->getCar()->getTransformSlot();
+    int slot2 = p2->getCar()->getTransformSlot();
+    Ogre::Real p1MPH = abs(p1->getCar()->getCarMph());
+    Ogre::Real p2MPH = abs(p2->getCar()->getCarMph());
+
     if(p1 != p2) {
-	    // number of contact points usually > 1, so average all of the relevant values
-        btVector3 averageCollisionPointOnA(0, 0, 0);
-	    btVector3 averageCollisionPointOnB(0, 0, 0);
-	    //btVector3 averageNormOnB(0, 0, 0);
-
-	    btScalar averageOverlapDistance = 0.f;
-	    int numContacts = contactManifold->getNumContacts();
-
-	    Ogre::Real p1MPH = abs(p1->getCar()->getCarMph());
-        Ogre::Real p2MPH = abs(p2->getCar()->getCarMph());
-
-	    for (int j = 0; j < numContacts; j++) {
-		    btManifoldPoint& pt = contactManifold->getContactPoint(j);
-		    if (pt.getDistance() < 0.f) {
-			    averageCollisionPointOnA += pt.getPositionWorldOnA();
-			    averageCollisionPointOnB += pt.getPositionWorldOnB();
-			    averageOverlapDistance += pt.getDistance()*0.95f;
-			    //averageNormOnB +=  pt.m_normalWorldOnB;
-		    }
-	    }
-
-	    // some collisions dont have contact points (dickheads), ignore them
-	    if(numContacts > 0) {
-		    averageCollisionPointOnA /= numContacts;
-		    averageCollisionPointOnB /= numContacts;
-		    averageOverlapDistance /= numContacts;
-		    // dont want to be thinking about damage if neither car is going morethan 15mph, or if there is no penetration
-		    if ((p1MPH > 15 || p2MPH > 15) && averageOverlapDistance < 0) {
-			    // there is a collision
-			    /* 
-			         collisionDelays, keeps a counter of the number of frames since each player has been in a collision
-				     Cars are added to collisionDelays on first crash
-			    */
-			    if(collisionDelays[p1] == NULL) {
-				    collisionDelays[p1] = 100;
-			    }
-            
-			    if(collisionDelays[p2] == NULL) {
-				    collisionDelays[p2] = 100;
-			    }
-			    // if either player hasn't collided for more than 15 frames, let them collide again
-			    if(collisionDelays[p1] > 90 || collisionDelays[p2] > 90) {
-				    // reset frame counter
-                    if(p1 == NULL || p2 == NULL) return;
-				    collisionDelays[p1] = collisionDelays[p2] = 0;
-                    int crashType;
-                
-                    Ogre::Vector3 localOnA = p1->getCar()->mBodyNode->convertWorldToLocalPosition((Ogre::Vector3)averageCollisionPointOnA);
-                    Ogre::Vector3 localOnB = p2->getCar()->mBodyNode->convertWorldToLocalPosition((Ogre::Vector3)averageCollisionPointOnB);
-                    Ogre::Real combinedSpeed = p1MPH + p2MPH;
-                    Ogre::Real damageShareToA = p1MPH / combinedSpeed;
-                    Ogre::Real damageShareToB = p2MPH / combinedSpeed;
-
-                    Ogre::Real totalDamage = abs(averageOverlapDistance * 20000.f);
-                    totalDamage = totalDamage > MAX_DAMAGE ? (float)MAX_DAMAGE : totalDamage;
-
-                    Ogre::Real damageToA = totalDamage * damageShareToB;
-                    Ogre::Real damageToB = totalDamage * damageShareToA;
-
-                    int sectionOnA = getSectionOnCar(p1, localOnA);
-                    int sectionOnB = getSectionOnCar(p2, localOnB);
-
-                    int sectionTestA = sectionOnA < 2 ? 0 : sectionOnA < 4 && sectionOnA >=2 ? 1 : 2; 
-                    int sectionTestB = sectionOnB < 2 ? 0 : sectionOnB < 4 && sectionOnB >=2 ? 1 : 2; 
-
-                    damageToA *= massPairs[p1->getCarType()][p2->getCarType()];
-                    damageToB *= massPairs[p2->getCarType()][p1->getCarType()];
-
-                    if(sectionTestA < sectionTestB) {
-                        damageToA *= 0.8f;
-                        damageToB *= 1.2f;
-                    } else if(sectionTestB < sectionTestA) {
-                        damageToB *= 0.8f;
-                        damageToA *= 1.2f;
-                    }
-
-                    if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH > 40 || p2MPH > 40)) {
-		                crashType = 1;
-	                } else if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH < 40 && p2MPH < 40)) {
-		                crashType = 2;
-	                } else if(totalDamage >= BIG_CRASH_THRESHOLD) {
-                        crashType = 3;
-	                }
+        // dont want to be thinking about damage if neither car is going morethan 15mph, or if there is no penetration
+        if ((p1MPH > 15 || p2MPH > 15) && averageOverlapDistance < 0) {
+            // if either player hasn't collided for a while, let them collide again
+            if(!isCoolingDown(slot1) || !isCoolingDown(slot2)) {
+                startCooldown(slot1);
+                startCooldown(slot2);
+                joinCrashGroups(slot1, slot2);
+
+                Ogre::Vector3 localOnA = toCarLocal(p1, averageCollisionPointOnA);
+                Ogre::Vector3 localOnB = toCarLocal(p2, averageCollisionPointOnB);
+                applyCrash(p1, p2, BtOgre::Convert::toOgre(averageCollisionPointOnA), BtOgre::Convert::toOgre(averageCollisionPointOnB),
+                    localOnA, localOnB, averageOverlapDistance, p1MPH, p2MPH);
+            }
+        }
+    } else {
+        // dont want to be thinking about damage if the car isn't going morethan 15mph, or if there is no penetration
+        if ((p1MPH > 15) && averageOverlapDistance < 0 && !isCoolingDown(slot1)) {
+            startCooldown(slot1);
+            int crashType = 1;
+        
+            Ogre::Vector3 localOnA = toCarLocal(p1, averageCollisionPointOnA);
+            if(localOnA.y < 0.3f) return;
+            joinCrashGroups(slot1, slot1);
+
+            Ogre::Real totalDamage = abs(averageOverlapDistance * 20000.f);
+            totalDamage = totalDamage > MAX_DAMAGE ? (float)MAX_DAMAGE : totalDamage;
+
+            Ogre::Real damageToA = totalDamage * 0.8f;
+
+            int sectionOnA = getSectionOnCar(p1, localOnA);
+
+            if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH > 40 || p2MPH > 40)) {
+                crashType = 1;
+            } else if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH < 40 && p2MPH < 40)) {
+                crashType = 2;
+            } else if(totalDamage >= BIG_CRASH_THRESHOLD) {
+                crashType = 3;
+            }
+
+            Ogre::Vector3 pointOnA = BtOgre::Convert::toOgre(averageCollisionPointOnA);
+            addGroupCrash(slot1, p1, pointOnA, getCrashIntensity(damageToA, crashType));
+            p1->collisionTickCallback(pointOnA, damageToA, sectionOnA, crashType, p1);
+        }
+    }
+}
+
+/// @brief  Works out and applies the damage each car takes in a crash between two cars.
+/// @param  p1               The first car's player.
+/// @param  p2               The second car's player.
+/// @param  pointOnA         Where the crash was on the first car (world space).
+/// @param  pointOnB         Where the crash was on the second car (world space).
+/// @param  localOnA         Where the crash was on the first car (relative to the car).
+/// @param  localOnB         Where the crash was on the second car (relative to the car).
+/// @param  overlapDistance  How far the cars overlapped (negative).
+/// @param  p1MPH            The first car's speed.
+/// @param  p2MPH            The second car's speed.
+void PlayerCollisions::applyCrash(Player *p1, Player *p2, Ogre::Vector3 pointOnA, Ogre::Vector3 pointOnB,
+    Ogre::Vector3 localOnA, Ogre::Vector3 localOnB, btScalar overlapDistance, Ogre::Real p1MPH, Ogre::Real p2MPH)
+{
+    int crashType = 1;
+
+    Ogre::Real combinedSpeed = p1MPH + p2MPH;
+    Ogre::Real damageShareToA = p1MPH / combinedSpeed;
+    Ogre::Real damageShareToB = p2MPH / combinedSpeed;
+
+    Ogre::Real totalDamage = abs(overlapDistance * 20000.f);
+    totalDamage = totalDamage > MAX_DAMAGE ? (float)MAX_DAMAGE : totalDamage;
+
+    Ogre::Real damageToA = totalDamage * damageShareToB;
+    Ogre::Real damageToB = totalDamage * damageShareToA;
+
+    int sectionOnA = getSectionOnCar(p1, localOnA);
+    int sectionOnB = getSectionOnCar(p2, localOnB);
+
+    int sectionTestA = sectionOnA < 2 ? 0 : sectionOnA < 4 && sectionOnA >=2 ? 1 : 2; 
+    int sectionTestB = sectionOnB < 2 ? 0 : sectionOnB < 4 && sectionOnB >=2 ? 1 : 2; 
+
+    damageToA *= massPairs[p1->getCarType()][p2->getCarType()];
+    damageToB *= massPairs[p2->getCarType()][p1->getCarType()];
+
+    if(sectionTestA < sectionTestB) {
+        damageToA *= 0.8f;
+        damageToB *= 1.2f;
+    } else if(sectionTestB < sectionTestA) {
+        damageToB *= 0.8f;
+        damageToA *= 1.2f;
+    }
+
+    if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH > 40 || p2MPH > 40)) {
+        crashType = 1;
+    } else if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH < 40 && p2MPH < 40)) {
+        crashType = 2;
+    } else if(totalDamage >= BIG_CRASH_THRESHOLD) {
+        crashType = 3;
+    }
 
 #ifdef COLLISION_DOMAIN_SERVER
-                    // getHeavyState() : 1 = heavy, 0 = normal, -1 = light
-                    if( p1->getHeavyState() == 1 && p2->getHeavyState() != 1 )
-                        damageToB *= 1.2f;
-                    if( p2->getHeavyState() == 1 && p1->getHeavyState() != 1 )
-                        damageToA *= 1.2f;
-
-                    if( p1->getHeavyState() == -1 && p2->getHeavyState() != -1 )
-                        damageToB *= 0.8f;
-                    if( p2->getHeavyState() == -1 && p1->getHeavyState() != -1 )
-                        damageToA *= 0.8f;
+    // getHeavyState() : 1 = heavy, 0 = normal, -1 = light
+    if( p1->getHeavyState() == 1 && p2->getHeavyState() != 1 )
+        damageToB *= 1.2f;
+    if( p2->getHeavyState() == 1 && p1->getHeavyState() != 1 )
+        damageToA *= 1.2f;
+
+    if( p1->getHeavyState() == -1 && p2->getHeavyState() != -1 )
+        damageToB *= 0.8f;
+    if( p2->getHeavyState() == -1 && p1->getHeavyState() != -1 )
+        damageToA *= 0.8f;
 #endif
 
-				    p1->collisionTickCallback((Ogre::Vector3)averageCollisionPointOnA, damageToA, sectionOnA, crashType, p2);
-				    p2->collisionTickCallback((Ogre::Vector3)averageCollisionPointOnB, damageToB, sectionOnB, crashType, p1);
+    // Each car's crash is heard from the car which hit it.
+    addGroupCrash(p1->getCar()->getTransformSlot(), p2, pointOnA, getCrashIntensity(damageToA, crashType));
+    addGroupCrash(p2->getCar()->getTransformSlot(), p1, pointOnB, getCrashIntensity(damageToB, crashType));
 
+    p1->collisionTickCallback(pointOnA, damageToA, sectionOnA, crashType, p2);
+    p2->collisionTickCallback(pointOnB, damageToB, sectionOnB, crashType, p1);
+}
 
-			    }
-		    }
+#ifdef COLLISION_DOMAIN_SERVER
+/// @brief  Lets lagged players hit cars where they saw them. A client draws other cars where they were a
+///         little while ago, so its player can drive into a car on their screen which the server has
+///         already moved on. Each tick every lagged player's car is checked against the other cars as
+///         they were at the time the player was seeing (their view tick), and a crash is applied if
+///         they overlapped there but not here. Damage is worked out as normal, using the overlap of the
+///         bounding boxes and the point hit on the rewound car.
+/// @param  history  Where every car has been, with this tick already recorded.
+/// @param  tick     The current tick.
+void PlayerCollisions::addRewoundCollisions(TransformHistory *history, unsigned int tick)
+{
+    int hits[LAG_COMPENSATION_MAX_HITS];
+    int capacity = history->getCapacity();
 
-	    } 
-    } else {
-         // number of contact points usually > 1, so average all of the relevant values
-        btVector3 averageCollisionPointOnA(0, 0, 0);
-	    btVector3 averageCollisionPointOnB(0, 0, 0);
-	    //btVector3 averageNormOnB(0, 0, 0);
-
-	    btScalar averageOverlapDistance = 0.f;
-	    int numContacts = contactManifold->getNumContacts();
-
-	    Ogre::Real p1MPH = abs(p1->getCar()->getCarMph());
-        Ogre::Real p2MPH = abs(p2->getCar()->getCarMph());
-
-	    for (int j = 0; j < numContacts; j++) {
-		    btManifoldPoint& pt = contactManifold->getContactPoint(j);
-		    if (pt.getDistance() < 0.f) {
-			    averageCollisionPointOnA += pt.getPositionWorldOnA();
-			    averageCollisionPointOnB += pt.getPositionWorldOnB();
-			    averageOverlapDistance += pt.getDistance()*0.95f;
-			    //averageNormOnB +=  pt.m_normalWorldOnB;
-		    }
-	    }
-
-	    // some collisions dont have contact points (dickheads), ignore them
-	    if(numContacts > 0) {
-		    averageCollisionPointOnA /= numContacts;
-		    averageCollisionPointOnB /= numContacts;
-		    averageOverlapDistance /= numContacts;
-		    // dont want to be thinking about damage if neither car is going morethan 15mph, or if there is no penetration
-		    if ((p1MPH > 15) && averageOverlapDistance < 0) {
-			    if(collisionDelays[p1] == NULL) {
-				    collisionDelays[p1] = 100;
-			    }
-			    if(collisionDelays[p1] > 90) {
-				    // reset frame counter
-                    if(p1 == NULL || p2 == NULL) return;
-				    collisionDelays[p1] = 0;
-                    int crashType;
-                
-                    Ogre::Vector3 localOnA = p1->getCar()->mBodyNode->convertWorldToLocalPosition((Ogre::Vector3)averageCollisionPointOnA);
-                    if(localOnA.y < 0.3f) return;
-                    Ogre::Real totalDamage = abs(averageOverlapDistance * 20000.f);
-                    totalDamage = totalDamage > MAX_DAMAGE ? (float)MAX_DAMAGE : totalDamage;
-
-                    Ogre::Real damageToA = totalDamage * 0.8f;
-
-                    int sectionOnA = getSectionOnCar(p1, localOnA);
-
-                    int sectionTestA = sectionOnA < 2 ? 0 : sectionOnA < 4 && sectionOnA >=2 ? 1 : 2;
-
-                    if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH > 40 || p2MPH > 40)) {
-		                crashType = 1;
-	                } else if(totalDamage < BIG_CRASH_THRESHOLD && (p1MPH < 40 && p2MPH < 40)) {
-		                crashType = 2;
-	                } else if(totalDamage >= BIG_CRASH_THRESHOLD) {
-                        crashType = 3;
-	                }
-
-				    p1->collisionTickCallback((Ogre::Vector3)averageCollisionPointOnA, damageToA, sectionOnA, crashType, p1);
-			    }
-		    }
-	    } 
+    for (int a = 0; a < capacity; a++)
+    {
+        Player *attacker = history->getOwner(a);
+        if (attacker == NULL || attacker->getCar() == NULL || !attacker->getAlive() || attacker->viewTick < 0)
+            continue;
+
+        // Players who aren't behind (i.e. AI players) see what the physics sees.
+        double now      = tick;
+        double viewTick = attacker->viewTick;
+        if (viewTick > now - 1)
+            continue;
+        if (viewTick < now - LAG_COMPENSATION_MAX_TICKS)
+            viewTick = now - LAG_COMPENSATION_MAX_TICKS;
+
+        // The attacker's own car is judged where it is now, as its client predicts it rather than rewinding it.
+        Ogre::Real attackerMPH = abs(attacker->getCar()->getCarMph());
+        btTransform attackerTransform;
+        btVector3 attackerVelocity, attackerMin, attackerMax;
+        if (attackerMPH <= 15 || !history->getAabb(a, tick, attackerMin, attackerMax) ||
+            !history->getTransform(a, tick, attackerTransform, attackerVelocity))
+            continue;
+
+        int numHits = history->queryAabb(viewTick, attackerMin, attackerMax, hits, LAG_COMPENSATION_MAX_HITS);
+        for (int i = 0; i < numHits; i++)
+        {
+            int v = hits[i];
+            Player *victim = history->getOwner(v);
+            if (v == a || victim == NULL || victim->getCar() == NULL || !victim->getAlive())
+                continue;
+
+            // If the cars overlap now as well, the physics deals with it.
+            btVector3 victimMin, victimMax;
+            if (history->getAabb(v, tick, victimMin, victimMax) &&
+                attackerMin.x() <= victimMax.x() && attackerMax.x() >= victimMin.x() &&
+                attackerMin.y() <= victimMax.y() && attackerMax.y() >= victimMin.y() &&
+                attackerMin.z() <= victimMax.z() && attackerMax.z() >= victimMin.z())
+                continue;
+
+            // Both cars must be clear of their last crash, so one isn't counted twice.
+            if (isCoolingDown(a) || isCoolingDown(v))
+                continue;
+
+            btTransform rewound;
+            btVector3 rewoundVelocity, rewoundMin, rewoundMax;
+            if (!history->getTransform(v, (unsigned int) viewTick, rewound, rewoundVelocity) ||
+                !history->getAabb(v, viewTick, rewoundMin, rewoundMax))
+                continue;
+
+            btVector3 overlapMin = attackerMin;
+            btVector3 overlapMax = attackerMax;
+            overlapMin.setMax(rewoundMin);
+            overlapMax.setMin(rewoundMax);
+            btVector3 overlap = overlapMax - overlapMin;
+            btScalar depth = btMin(overlap.x(), overlap.z());
+            if (depth <= 0)
+                continue;
+            if (depth > LAG_COMPENSATION_MAX_OVERLAP)
+                depth = LAG_COMPENSATION_MAX_OVERLAP;
+
+            startCooldown(a);
+            startCooldown(v);
+            joinCrashGroups(a, v);
+
+            // Each car's side of the hit is found from the same pose its box was taken from.
+            btVector3 hitPointWorld = (overlapMin + overlapMax) * 0.5f;
+            Ogre::Vector3 hitPoint = BtOgre::Convert::toOgre(hitPointWorld);
+            Ogre::Vector3 localOnA = BtOgre::Convert::toOgre(attackerTransform.invXform(hitPointWorld));
+            Ogre::Vector3 localOnB = BtOgre::Convert::toOgre(rewound.invXform(hitPointWorld));
+            Ogre::Real victimMPH = rewoundVelocity.length() * 3.6f * 0.621371192f;
+
+            applyCrash(attacker, victim, hitPoint, hitPoint, localOnA, localOnB, -depth, attackerMPH, victimMPH);
+        }
     }
 }
+#endif
 
 int PlayerCollisions::getSectionOnCar(Player *p, Ogre::Vector3 pos) {
     // FL,FR,ML,MR,RL,RR = 0,1,2,3,4,5
@@ -247,162 +307,147 @@ int PlayerCollisions::getSectionOnCar(Player *p, Ogre::Vector3 pos) {
 }
 
 
+/// @brief  Called after each step of the world. Plays one crash sound per group of cars which crashed
+///         into each other (p1+p2+p4+p99 etc.), then ends the frame's crash groups.
 void PlayerCollisions::frameEventEnd()
 {
-	collisionDelaysItr = collisionDelays.begin();
-	for(;collisionDelaysItr != collisionDelays.end(); collisionDelaysItr++) {
-		if(collisionDelaysItr->second < 100) {
-			collisionDelaysItr->second += 1;
-		}
-	}
-    
-    // apply damage and dispatch collision sounds
-    //// the sound will only be played per group of collisions i.e. p1+p2+p4+p99 etc.
-    /*int numCollisionGroups = getNumCollisionGroups();
-    for (int i=0; i < numCollisionGroups; i++)
+    mFrame++;
+
+    for (size_t i = 0; i < mGroupSlots.size(); i++)
     {
-        //OgreOggISound* sound = GameCore::mAudioCore->getSoundInstance(CAR_CRASH, GameCore::mPhysicsCore->getUniqueEntityID());
-        //GameCore::mAudioCore->playSoundOrRestart(sound);
-        //GameCore::mAudioCore->deleteSoundInstance(sound);
-    }*/
-    ////GameCore::mAudioCore->playCarCrash();
-    
-    // clear lists from previous frame
-    //emptyLists();
+        int slot = mGroupSlots[i];
+        if (findCrashGroup(slot) != slot)
+            continue;
+
+        // Only makes a sound on the client.
+        const GroupCrash &crash = mGroupCrashes[slot];
+        if (crash.player != NULL && crash.player->getCar() != NULL && crash.intensity > 0)
+            crash.player->getCar()->triggerCrashSoundAt(crash.point, crash.intensity);
+    }
 
+    emptyCrashGroups();
 }
 
 
-void PlayerCollisions::printLists()
+/// @brief  Forgets a car's crashes. Called when the car in a slot is destroyed, so that the next car to
+///         use the slot can crash straight away.
+/// @param  slot  The car's TransformStore slot.
+void PlayerCollisions::clearSlot(int slot)
 {
-    //OutputDebugString("___________________________\n");
-
-    std::list<std::list<Player*>*>::iterator i = mCollisions->begin();
-    while (i != mCollisions->end())
-    {
-        std::list<Player*>* subList = *i;
-
-        std::string size = boost::lexical_cast<std::string>(subList->size());
-        std::string output = "Size " + size + "\n";
-        
-        //OutputDebugString(output.c_str());
-
-        std::list<Player*>::iterator jj = subList->begin();
-        while (jj != subList->end())
-        {
-            Player* element = *jj;
-
-            std::string address = boost::lexical_cast<std::string>(element);
-            std::string output = "      " + address + "\n";
-        
-            //OutputDebugString(output.c_str());
+    if (slot < 0 || slot >= (int) mLastCrashFrames.size())
+        return;
+    mLastCrashFrames[slot] = mFrame - CRASH_COOLDOWN_FRAMES - 1;
+}
 
-            ++jj;
-        }
 
-        ++i;
-    }
+/// @brief  Checks whether a car crashed too recently to crash again.
+/// @param  slot  The car's slot.
+bool PlayerCollisions::isCoolingDown(int slot) const
+{
+    if (slot < 0 || slot >= (int) mLastCrashFrames.size())
+        return false;
+    return mFrame - mLastCrashFrames[slot] <= CRASH_COOLDOWN_FRAMES;
 }
 
 
-/// Does not clear the main list (of lists), only sublists, leaving the
-/// main list either empty or full with empty sublists.
-void PlayerCollisions::emptyLists()
+/// @brief  Stops a car from crashing again for a while.
+/// @param  slot  The car's slot.
+void PlayerCollisions::startCooldown(int slot)
 {
-    std::list<std::list<Player*>*>::iterator i = mCollisions->begin();
-    while (i != mCollisions->end())
-    {
-        std::list<Player*>* subList = *i;
-        subList->clear(); // sublist can never be null
-        ++i;
-    }
+    if (slot < 0)
+        return;
+    if (slot >= (int) mLastCrashFrames.size())
+        grow(slot + 1);
+    mLastCrashFrames[slot] = mFrame;
 }
 
 
-/// If both player1AlreadySeen and player2AlreadySeen are set to null by this method,
-/// it will attempt to also find an emptyList (so we don't have to keep making new ones)
-void PlayerCollisions::hasAlreadyBeenSeenThisFrame(
-    std::list<Player*> **player1AlreadySeen,
-    std::list<Player*> **player2AlreadySeen,
-    std::list<Player*> **emptyList,
-    Player *p1,
-    Player *p2)
+/// @brief  Puts two cars which crashed into each other in the same crash group (a car which hit the
+///         arena is joined with itself, so is a group of its own).
+/// @param  slotA  The first car's slot.
+/// @param  slotB  The second car's slot.
+void PlayerCollisions::joinCrashGroups(int slotA, int slotB)
 {
-    *player1AlreadySeen = NULL;
-    *player2AlreadySeen = NULL;
-    *emptyList = NULL;
+    if (slotA < 0 || slotB < 0)
+        return;
+    int highest = slotA > slotB ? slotA : slotB;
+    if (highest >= (int) mGroupParents.size())
+        grow(highest + 1);
 
-    std::list<std::list<Player*>*>::iterator i = mCollisions->begin();
-    while (i != mCollisions->end())
+    int slots[2] = { slotA, slotB };
+    for (int i = 0; i < 2; i++)
     {
-        std::list<Player*>* subList = *i;
-        //--------------------
-
-        // sublist can never be null
-        if (!*emptyList && subList->size() == 0)
+        if (mGroupParents[slots[i]] < 0)
         {
-            *emptyList = subList;
+            mGroupParents[slots[i]] = slots[i];
+            mGroupSlots.push_back(slots[i]);
+            mGroupCrashes[slots[i]].player    = NULL;
+            mGroupCrashes[slots[i]].intensity = 0;
         }
-        
-        // lets find the player pointer if they are here
-        std::list<Player*>::iterator jj = subList->begin();
-        while (jj != subList->end())
-        {
-            Player* element = *jj;
-            //--------------------
-            if (element == p1)
-            {
-                *player1AlreadySeen = subList;
-                if (*player2AlreadySeen) return;
-            }
-
-            if (element == p2)
-            {
-                *player2AlreadySeen = subList;
-                if (*player1AlreadySeen) return;
-            }
-
-            //--------------------
-            ++jj;
-        }
-
-        //--------------------
-        ++i;
     }
+
+    // The lower slot becomes the root, so the groups come out the same whatever order the crashes were in.
+    int rootA = findCrashGroup(slotA);
+    int rootB = findCrashGroup(slotB);
+    if (rootA == rootB)
+        return;
+    int root  = rootA < rootB ? rootA : rootB;
+    int other = rootA < rootB ? rootB : rootA;
+    mGroupParents[other] = root;
+    if (mGroupCrashes[other].intensity > mGroupCrashes[root].intensity)
+        mGroupCrashes[root] = mGroupCrashes[other];
 }
 
 
-void PlayerCollisions::mergeListsIntoFrom(
-    std::list<Player*> *intoListContainingP1,
-    std::list<Player*> *fromListContainingP2,
-    Player *p1,
-    Player *p2)
+/// @brief  Keeps a crash as its group's sound if it is the loudest in the group so far.
+/// @param  slot       The slot of a car in the group.
+/// @param  player     The player whose car the crash is heard from.
+/// @param  point      Where it is heard (world space).
+/// @param  intensity  How loud it is, from 0 to 1.
+void PlayerCollisions::addGroupCrash(int slot, Player *player, const Ogre::Vector3 &point, float intensity)
 {
-    std::list<Player*>::iterator i = fromListContainingP2->begin();
-    while (i != fromListContainingP2->end())
-    {
-        Player *element = *i;
-
-        // copy all the elements from this node into the target one
-        intoListContainingP1->insert(intoListContainingP1->end(), element);
+    int root = findCrashGroup(slot);
+    if (root < 0 || intensity <= mGroupCrashes[root].intensity)
+        return;
 
-        ++i;
-    }
+    mGroupCrashes[root].player    = player;
+    mGroupCrashes[root].point     = point;
+    mGroupCrashes[root].intensity = intensity;
 }
 
-int PlayerCollisions::getNumCollisionGroups()
+
+/// @brief  Finds the crash group a car is in this frame.
+/// @param  slot  The car's slot.
+/// @return The slot of the group's root, or -1 if the car hasn't crashed this frame.
+int PlayerCollisions::findCrashGroup(int slot)
 {
-    int count = 0;
+    if (slot < 0 || slot >= (int) mGroupParents.size() || mGroupParents[slot] < 0)
+        return -1;
 
-    std::list< std::list<Player*>* >::iterator i = mCollisions->begin();
-    while (i != mCollisions->end())
+    while (mGroupParents[slot] != slot)
     {
-        std::list<Player*> *subList = *i;
+        mGroupParents[slot] = mGroupParents[mGroupParents[slot]];
+        slot = mGroupParents[slot];
+    }
+    return slot;
+}
 
-        if (subList->size() > 0) count++;
 
-        ++i;
-    }
+/// @brief  Empties the crash groups, only touching the slots which were in one.
+void PlayerCollisions::emptyCrashGroups()
+{
+    for (size_t i = 0; i < mGroupSlots.size(); i++)
+        mGroupParents[mGroupSlots[i]] = -1;
+    mGroupSlots.clear();
+}
 
-    return count;
+
+/// @brief  Makes room for more slots. Nothing else here allocates, so the room is only made once.
+/// @param  capacity  The new number of slots.
+void PlayerCollisions::grow(int capacity)
+{
+    mLastCrashFrames.resize(capacity, mFrame - CRASH_COOLDOWN_FRAMES - 1);
+    mGroupParents.resize(capacity, -1);
+    mGroupSlots.reserve(capacity);
+    mGroupCrashes.resize(capacity);
 }
@@ -0,0 +1,255 @@
+/**
+ * @file    ProximityGrid.cpp
+ * @brief   A uniform grid over the arena which finds the cars (or powerups) near a point, rebuilt each tick.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "ProximityGrid.h"
+#include <algorithm>
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  cellSize  The width of each cell. Best at about the distance most queries look over.
+ProximityGrid::ProximityGrid (float cellSize)
+  : mCellSize(cellSize),
+    mBinSize(cellSize),
+    mMinX(0),
+    mMinZ(0),
+    mCellsX(0),
+    mCellsZ(0)
+{
+    mCellStarts.assign(1, 0);
+}
+
+
+/// @brief  Removes every entry. Queries find nothing until the grid is built again.
+void ProximityGrid::clear (void)
+{
+    mEntries.clear();
+    mSorted.clear();
+    mCellStarts.assign(1, 0);
+    mCellsX = 0;
+    mCellsZ = 0;
+}
+
+
+/// @brief  Adds an entry. It can't be found until build() is called.
+/// @param  position  Where it is.
+/// @param  team      Its team, for the team filters.
+/// @param  id        What queries report it as.
+void ProximityGrid::add (const btVector3 &position, int team, int id)
+{
+    Entry entry = { position, team, id };
+    mEntries.push_back(entry);
+}
+
+
+/// @brief  Sorts the entries into cells covering the space between them. Call once everything is added.
+void ProximityGrid::build (void)
+{
+    int numEntries = (int) mEntries.size();
+    if (numEntries == 0)
+    {
+        clear();
+        return;
+    }
+
+    float maxX = mMinX = mEntries[0].position.x();
+    float maxZ = mMinZ = mEntries[0].position.z();
+    for (int i = 1; i < numEntries; i++)
+    {
+        const btVector3 &position = mEntries[i].position;
+        mMinX = std::min(mMinX, (float) position.x());
+        mMinZ = std::min(mMinZ, (float) position.z());
+        maxX  = std::max(maxX, (float) position.x());
+        maxZ  = std::max(maxZ, (float) position.z());
+    }
+
+    // Things thrown far out of the arena would otherwise spread the grid over far too many cells.
+    mBinSize = mCellSize;
+    for (;;)
+    {
+        mCellsX = (int) ((maxX - mMinX) / mBinSize) + 1;
+        mCellsZ = (int) ((maxZ - mMinZ) / mBinSize) + 1;
+        if (mCellsX * mCellsZ <= PROXIMITY_GRID_MAX_CELLS)
+            break;
+        mBinSize *= 2;
+    }
+
+    // Counting sort: count each cell's entries, total them up to where each cell ends, then fill each
+    // cell from its end (going backwards so each cell keeps the order the entries were added in).
+    int numCells = mCellsX * mCellsZ;
+    mCellStarts.assign(numCells + 1, 0);
+    int x, z;
+    for (int i = 0; i < numEntries; i++)
+    {
+        getCell(mEntries[i].position, x, z);
+        mCellStarts[z * mCellsX + x]++;
+    }
+    for (int cell = 1; cell <= numCells; cell++)
+        mCellStarts[cell] += mCellStarts[cell - 1];
+
+    mSorted.resize(numEntries);
+    for (int i = numEntries - 1; i >= 0; i--)
+    {
+        getCell(mEntries[i].position, x, z);
+        mSorted[--mCellStarts[z * mCellsX + x]] = mEntries[i];
+    }
+}
+
+
+/// @brief  Finds the nearest entries to a point.
+/// @param  centre     The point.
+/// @param  k          The most entries to find (at most PROXIMITY_GRID_MAX_NEAREST).
+/// @param  ids        Filled with the ids of the entries found, nearest first. Must have room for k.
+/// @param  filter     Which teams to find.
+/// @param  team       The team the filter is relative to.
+/// @param  excludeId  An id to skip (e.g. the car asking), or -1.
+/// @return The number of entries found, fewer than k if there aren't k which match.
+int ProximityGrid::queryNearest (const btVector3 &centre, int k, int *ids, ProximityTeamFilter filter, int team, int excludeId) const
+{
+    k = std::min(k, PROXIMITY_GRID_MAX_NEAREST);
+    if (k <= 0 || mSorted.empty())
+        return 0;
+
+    btScalar distances2[PROXIMITY_GRID_MAX_NEAREST];
+    int found = 0;
+    int centreX, centreZ;
+    getCell(centre, centreX, centreZ);
+
+    // Search rings of cells outwards from the centre's cell, until everything in the next ring must
+    // be further away than the k-th nearest found so far.
+    for (int ring = 0; ; ring++)
+    {
+        for (int z = centreZ - ring; z <= centreZ + ring; z++)
+        {
+            if (z < 0 || z >= mCellsZ)
+                continue;
+
+            // Only the ends of the rows between the top and the bottom of the ring are on the ring.
+            int step = (z == centreZ - ring || z == centreZ + ring) ? 1 : std::max(2 * ring, 1);
+            for (int x = centreX - ring; x <= centreX + ring; x += step)
+                if (x >= 0 && x < mCellsX)
+                    scanNearest(x, z, centre, k, filter, team, excludeId, ids, distances2, found);
+        }
+
+        // The nearest anything outside the rings searched so far can be. Sides at the edge of the grid
+        // have nothing beyond them.
+        btScalar reach = SIMD_INFINITY;
+        if (centreX - ring > 0)
+            reach = std::min(reach, centre.x() - (mMinX + (centreX - ring) * mBinSize));
+        if (centreX + ring < mCellsX - 1)
+            reach = std::min(reach, mMinX + (centreX + ring + 1) * mBinSize - centre.x());
+        if (centreZ - ring > 0)
+            reach = std::min(reach, centre.z() - (mMinZ + (centreZ - ring) * mBinSize));
+        if (centreZ + ring < mCellsZ - 1)
+            reach = std::min(reach, mMinZ + (centreZ + ring + 1) * mBinSize - centre.z());
+
+        if (reach == SIMD_INFINITY || (found == k && distances2[k - 1] <= reach * reach))
+            break;
+    }
+
+    return found;
+}
+
+
+/// @brief  Finds the entries within a distance of a point.
+/// @param  centre     The point.
+/// @param  radius     The distance.
+/// @param  ids        Filled with the ids of the entries found, in no particular order.
+/// @param  maxIds     The room in ids. The search stops once it is full.
+/// @param  filter     Which teams to find.
+/// @param  team       The team the filter is relative to.
+/// @param  excludeId  An id to skip (e.g. the car asking), or -1.
+/// @return The number of entries found.
+int ProximityGrid::queryRadius (const btVector3 &centre, float radius, int *ids, int maxIds, ProximityTeamFilter filter,
+                                int team, int excludeId) const
+{
+    if (maxIds <= 0 || mSorted.empty())
+        return 0;
+
+    int minX, minZ, maxX, maxZ;
+    getCell(centre - btVector3(radius, 0, radius), minX, minZ);
+    getCell(centre + btVector3(radius, 0, radius), maxX, maxZ);
+
+    btScalar radius2 = radius * radius;
+    int found = 0;
+    for (int z = minZ; z <= maxZ; z++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            int cell = z * mCellsX + x;
+            for (int i = mCellStarts[cell]; i < mCellStarts[cell + 1]; i++)
+            {
+                const Entry &entry = mSorted[i];
+                if (!matches(entry, filter, team, excludeId) || entry.position.distance2(centre) > radius2)
+                    continue;
+
+                ids[found++] = entry.id;
+                if (found == maxIds)
+                    return found;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+/// @brief  Checks whether an entry passes a query's filters.
+bool ProximityGrid::matches (const Entry &entry, ProximityTeamFilter filter, int team, int excludeId) const
+{
+    if (entry.id == excludeId)
+        return false;
+
+    switch (filter)
+    {
+    case PROXIMITY_SAME_TEAM:
+        return entry.team == team;
+    case PROXIMITY_OTHER_TEAMS:
+        return entry.team != team;
+    default:
+        return true;
+    }
+}
+
+
+/// @brief  Gets the cell a position is in. Positions outside the grid are put in the nearest cell.
+void ProximityGrid::getCell (const btVector3 &position, int &x, int &z) const
+{
+    x = (int) ((position.x() - mMinX) / mBinSize);
+    z = (int) ((position.z() - mMinZ) / mBinSize);
+    x = std::max(0, std::min(x, mCellsX - 1));
+    z = std::max(0, std::min(z, mCellsZ - 1));
+}
+
+
+/// @brief  Adds a cell's entries to the nearest found by queryNearest(), if they are nearer.
+void ProximityGrid::scanNearest (int cellX, int cellZ, const btVector3 &centre, int k, ProximityTeamFilter filter, int team,
+                                 int excludeId, int *ids, btScalar *distances2, int &found) const
+{
+    int cell = cellZ * mCellsX + cellX;
+    for (int i = mCellStarts[cell]; i < mCellStarts[cell + 1]; i++)
+    {
+        const Entry &entry = mSorted[i];
+        if (!matches(entry, filter, team, excludeId))
+            continue;
+
+        btScalar distance2 = entry.position.distance2(centre);
+        if (found == k && distance2 >= distances2[k - 1])
+            continue;
+
+        // Insert it in order, dropping the furthest if the list is full.
+        int j = found < k ? found++ : k - 1;
+        for (; j > 0 && distances2[j - 1] > distance2; j--)
+        {
+            distances2[j] = distances2[j - 1];
+            ids[j]        = ids[j - 1];
+        }
+        distances2[j] = distance2;
+        ids[j]        = entry.id;
+    }
+}
@@ -0,0 +1,189 @@
+/**
+ * @file    RayBatch.cpp
+ * @brief   Casts a batch of rays against the world at once, such as every AI player's feelers.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "RayBatch.h"
+#include "GameCore.h"
+#include "LinearMath/btAabbUtil2.h"
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/// @brief  Copies out everything the broadphase finds which is in any of the batch's collision groups.
+class RayBatch::CandidateCollector : public btBroadphaseAabbCallback
+{
+public:
+    CandidateCollector (std::vector<Candidate> &candidates, short mask) : mCandidates(candidates), mMask(mask) {}
+
+    virtual bool process (const btBroadphaseProxy *proxy)
+    {
+        if (proxy->m_collisionFilterGroup & mMask)
+        {
+            // The root shape is never swapped out for one of its children, unlike getCollisionShape().
+            Candidate candidate;
+            candidate.aabbMin   = proxy->m_aabbMin;
+            candidate.aabbMax   = proxy->m_aabbMax;
+            candidate.group     = proxy->m_collisionFilterGroup;
+            candidate.object    = (btCollisionObject*) proxy->m_clientObject;
+            candidate.shape     = candidate.object->getRootCollisionShape();
+            candidate.transform = candidate.object->getWorldTransform();
+            mCandidates.push_back(candidate);
+        }
+        return true;
+    }
+
+private:
+    std::vector<Candidate> &mCandidates;
+    short                   mMask;
+};
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+RayBatch::RayBatch (void)
+{
+}
+
+
+/// @brief  Removes every ray, ready for the next batch.
+void RayBatch::clear (void)
+{
+    mRays.resize(0);
+    mHits.resize(0);
+}
+
+
+/// @brief  Adds a ray to the batch.
+/// @param  from    The start of the ray.
+/// @param  to      The end of the ray.
+/// @param  mask    The collision groups the ray hits (e.g. COL_ARENA | COL_CAR).
+/// @param  ignore  An object the ray passes straight through, such as the car casting it.
+/// @return The ray's index, to find its hit with after cast().
+int RayBatch::add (const btVector3 &from, const btVector3 &to, short mask, const btCollisionObject *ignore)
+{
+    Ray ray;
+    ray.from   = from;
+    ray.to     = to;
+    ray.mask   = mask;
+    ray.ignore = ignore;
+    mRays.push_back(ray);
+
+    return (int) mRays.size() - 1;
+}
+
+
+/// @brief  Finds the closest hit of every ray in the batch. Must be called on the main thread, while the
+///         world isn't being stepped.
+/// @param  world  The world to cast into.
+void RayBatch::cast (btCollisionWorld *world)
+{
+    int numRays = (int) mRays.size();
+    mHits.resize(numRays);
+    mCandidates.resize(0);
+    if (numRays == 0)
+        return;
+
+    btVector3 aabbMin( BT_LARGE_FLOAT,  BT_LARGE_FLOAT,  BT_LARGE_FLOAT);
+    btVector3 aabbMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    short mask = 0;
+    for (int i = 0; i < numRays; i++)
+    {
+        aabbMin.setMin(mRays[i].from);
+        aabbMax.setMax(mRays[i].from);
+        aabbMin.setMin(mRays[i].to);
+        aabbMax.setMax(mRays[i].to);
+        mask |= mRays[i].mask;
+    }
+
+    CandidateCollector collector(mCandidates, mask);
+    world->getBroadphase()->aabbTest(aabbMin, aabbMax, collector);
+
+    TaskPool *pool = GameCore::mTaskPool;
+    if (pool)
+        pool->parallelFor(numRays, &RayBatch::castTask, this);
+    else
+        for (int i = 0; i < numRays; i++)
+            castRay(i);
+}
+
+
+/// @brief  Tests a ray against one object, as btCollisionWorld::rayTestSingle() does, but without ever
+///         changing the object. Bullet tests a compound by swapping each child in as the object's shape,
+///         so another thread reading the object at the same time would test against the wrong shape, and
+///         might even leave the child there. Here the children are tested directly instead.
+/// @param  rayFromTrans    The start of the ray.
+/// @param  rayToTrans      The end of the ray.
+/// @param  object          The object, which hits are reported against.
+/// @param  shape           The object's shape, or a child of it.
+/// @param  worldTransform  Where that shape is.
+/// @param  resultCallback  Given any hits.
+void RayBatch::rayTestObject (const btTransform &rayFromTrans, const btTransform &rayToTrans, btCollisionObject *object,
+                              const btCollisionShape *shape, const btTransform &worldTransform,
+                              btCollisionWorld::RayResultCallback &resultCallback)
+{
+    if (!shape->isCompound())
+    {
+        btCollisionWorld::rayTestSingle(rayFromTrans, rayToTrans, object, shape, worldTransform, resultCallback);
+        return;
+    }
+
+    const btCompoundShape *compound = static_cast<const btCompoundShape*>(shape);
+    for (int i = 0; i < compound->getNumChildShapes(); i++)
+    {
+        btTransform childTransform = worldTransform * compound->getChildTransform(i);
+        rayTestObject(rayFromTrans, rayToTrans, object, compound->getChildShape(i), childTransform, resultCallback);
+    }
+}
+
+
+/// @brief  Finds the closest hit of one ray. Only reads the candidates, which were copied out of the world.
+/// @param  ray  The ray's index.
+void RayBatch::castRay (int ray)
+{
+    const Ray &r = mRays[ray];
+    btTransform rayFromTrans(btQuaternion::getIdentity(), r.from);
+    btTransform rayToTrans(btQuaternion::getIdentity(), r.to);
+    btCollisionWorld::ClosestRayResultCallback rayCallback(r.from, r.to);
+
+    for (size_t i = 0; i < mCandidates.size(); i++)
+    {
+        const Candidate &candidate = mCandidates[i];
+        if (!(candidate.group & r.mask) || candidate.object == r.ignore)
+            continue;
+
+        // Only bother with the narrowphase if the ray reaches the object's box before the closest hit so far.
+        btScalar hitLambda = rayCallback.m_closestHitFraction;
+        btVector3 hitNormal;
+        if (!btRayAabb(r.from, r.to, candidate.aabbMin, candidate.aabbMax, hitLambda, hitNormal))
+            continue;
+
+        rayTestObject(rayFromTrans, rayToTrans, candidate.object, candidate.shape, candidate.transform, rayCallback);
+    }
+
+    RayBatchHit &hit = mHits[ray];
+    if (rayCallback.hasHit())
+    {
+        hit.point    = rayCallback.m_hitPointWorld;
+        hit.normal   = rayCallback.m_hitNormalWorld.normalized();
+        hit.fraction = rayCallback.m_closestHitFraction;
+        hit.object   = rayCallback.m_collisionObject;
+    }
+    else
+    {
+        hit.point    = r.to;
+        hit.normal   = btVector3(0, 0, 0);
+        hit.fraction = 1;
+        hit.object   = NULL;
+    }
+}
+
+
+/// @brief  Casts one ray. Run on the task pool.
+void RayBatch::castTask (void *context, int index)
+{
+    ((RayBatch*) context)->castRay(index);
+}
+
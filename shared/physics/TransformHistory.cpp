@@ -0,0 +1,301 @@
+/**
+ * @file    TransformHistory.cpp
+ * @brief   Where every car has been over the last second, so the server can rewind cars to the time a
+            lagged player was seeing them (see PlayerCollisions::addRewoundCollisions).
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "TransformHistory.h"
+#include "GetTime.h"
+#include "RandomRange.h"
+
+#define SLOT_NOT_RECORDED 0xFFFFFFFF
+
+
+/*-------------------- FUNCTION DEFINITIONS --------------------*/
+
+static inline bool aabbOverlap (const btVector3 &minA, const btVector3 &maxA, const btVector3 &minB, const btVector3 &maxB)
+{
+    return minA.x() <= maxB.x() && maxA.x() >= minB.x()
+        && minA.y() <= maxB.y() && maxA.y() >= minB.y()
+        && minA.z() <= maxB.z() && maxA.z() >= minB.z();
+}
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  capacity  The number of slots to reserve up front. The history will grow if a higher slot is recorded.
+TransformHistory::TransformHistory (int capacity) : mNewestTick(0), mRow(0)
+{
+    for (int i = 0; i < TRANSFORM_HISTORY_TICKS; i++)
+    {
+        mTicks[i]    = 0;
+        mRowValid[i] = false;
+    }
+    grow(capacity);
+}
+
+
+/// @brief  Starts recording a new tick, overwriting the oldest one. Called after the tick's physics step.
+/// @param  tick  The tick.
+void TransformHistory::beginTick (unsigned int tick)
+{
+    mRow = tick & (TRANSFORM_HISTORY_TICKS - 1);
+    mTicks[mRow]    = tick;
+    mRowValid[mRow] = true;
+    mNewestTick     = tick;
+}
+
+
+/// @brief  Records where a car is this tick.
+/// @param  slot   The car's TransformStore slot.
+/// @param  owner  The player driving it.
+/// @param  body   The car's chassis.
+void TransformHistory::record (int slot, Player *owner, btRigidBody *body)
+{
+    btVector3 aabbMin, aabbMax;
+    body->getAabb(aabbMin, aabbMax);
+    record(slot, owner, body->getWorldTransform(), body->getLinearVelocity(), aabbMin, aabbMax);
+}
+
+
+/// @brief  Records where a car is this tick.
+/// @param  slot            The car's TransformStore slot.
+/// @param  owner           The player driving it.
+/// @param  transform       The car's transform.
+/// @param  linearVelocity  The car's velocity.
+/// @param  aabbMin         The minimum corner of the car's bounding box.
+/// @param  aabbMax         The maximum corner of the car's bounding box.
+void TransformHistory::record (int slot, Player *owner, const btTransform &transform, const btVector3 &linearVelocity,
+                               const btVector3 &aabbMin, const btVector3 &aabbMax)
+{
+    if (slot < 0)
+        return;
+    if (slot >= getCapacity())
+    {
+        int capacity = getCapacity();
+        while (capacity <= slot)
+            capacity *= 2;
+        grow(capacity);
+    }
+
+    mSlotTicks[mRow][slot]        = mTicks[mRow];
+    mPositions[mRow][slot]        = transform.getOrigin();
+    mRotations[mRow][slot]        = transform.getRotation();
+    mLinearVelocities[mRow][slot] = linearVelocity;
+    mAabbMins[mRow][slot]         = aabbMin;
+    mAabbMaxs[mRow][slot]         = aabbMax;
+    mOwners[slot]                 = owner;
+}
+
+
+/// @brief  Forgets everything about a slot. Called when the car in it is destroyed, so that the next car
+///         to use the slot isn't seen where the old one was.
+/// @param  slot  The slot.
+void TransformHistory::clearSlot (int slot)
+{
+    if (slot < 0 || slot >= getCapacity())
+        return;
+
+    for (int i = 0; i < TRANSFORM_HISTORY_TICKS; i++)
+        mSlotTicks[i][slot] = SLOT_NOT_RECORDED;
+    mOwners[slot] = NULL;
+}
+
+
+/// @brief  Gets where a car was on a tick.
+/// @param  slot            The car's slot.
+/// @param  tick            The tick.
+/// @param  transform       Set to the car's transform.
+/// @param  linearVelocity  Set to the car's velocity.
+/// @return False if the car wasn't recorded on that tick (or the tick is too old).
+bool TransformHistory::getTransform (int slot, unsigned int tick, btTransform &transform, btVector3 &linearVelocity) const
+{
+    int row = findRow(tick);
+    if (row < 0 || !isRecorded(row, slot, tick))
+        return false;
+
+    transform.setOrigin(mPositions[row][slot]);
+    transform.setRotation(mRotations[row][slot]);
+    linearVelocity = mLinearVelocities[row][slot];
+    return true;
+}
+
+
+/// @brief  Gets a car's bounding box at a time between two ticks, interpolating between them as the
+///         client does when it draws the car.
+/// @param  slot     The car's slot.
+/// @param  tick     The time, in ticks.
+/// @param  aabbMin  Set to the minimum corner of the box.
+/// @param  aabbMax  Set to the maximum corner of the box.
+/// @return False if the car wasn't recorded at that time.
+bool TransformHistory::getAabb (int slot, double tick, btVector3 &aabbMin, btVector3 &aabbMax) const
+{
+    // No tick is before 0 (and a negative time can't be converted to an unsigned tick).
+    if (tick < 0)
+        return false;
+    if (tick > mNewestTick)
+        tick = mNewestTick;
+    unsigned int tick0 = (unsigned int) tick;
+    int row0 = findRow(tick0);
+    if (row0 < 0 || !isRecorded(row0, slot, tick0))
+        return false;
+
+    aabbMin = mAabbMins[row0][slot];
+    aabbMax = mAabbMaxs[row0][slot];
+
+    int row1 = findRow(tick0 + 1);
+    if (row1 >= 0 && isRecorded(row1, slot, tick0 + 1))
+    {
+        btScalar t = (btScalar) (tick - tick0);
+        aabbMin = aabbMin.lerp(mAabbMins[row1][slot], t);
+        aabbMax = aabbMax.lerp(mAabbMaxs[row1][slot], t);
+    }
+    return true;
+}
+
+
+/// @brief  Finds the cars whose bounding boxes overlapped a box at a time in the past.
+/// @param  tick      The time, in ticks. Only the nearest tick at or before it is tested.
+/// @param  aabbMin   The minimum corner of the box.
+/// @param  aabbMax   The maximum corner of the box.
+/// @param  slots     Filled with the slots of the cars which overlapped.
+/// @param  maxSlots  The room in slots.
+/// @return The number of slots found.
+int TransformHistory::queryAabb (double tick, const btVector3 &aabbMin, const btVector3 &aabbMax, int *slots, int maxSlots) const
+{
+    if (tick < 0)
+        return 0;
+    if (tick > mNewestTick)
+        tick = mNewestTick;
+    unsigned int tick0 = (unsigned int) tick;
+    int row = findRow(tick0);
+    if (row < 0)
+        return 0;
+
+    const std::vector<unsigned int> &slotTicks = mSlotTicks[row];
+    const std::vector<btVector3>    &mins      = mAabbMins[row];
+    const std::vector<btVector3>    &maxs      = mAabbMaxs[row];
+    int capacity = getCapacity();
+    int found = 0;
+    for (int slot = 0; slot < capacity && found < maxSlots; slot++)
+        if (slotTicks[slot] == tick0 && aabbOverlap(aabbMin, aabbMax, mins[slot], maxs[slot]))
+            slots[found++] = slot;
+
+    return found;
+}
+
+
+/// @brief  Gets the memory used by the history.
+/// @return The memory (bytes).
+size_t TransformHistory::getMemoryUsage (void) const
+{
+    size_t perSlot = sizeof(unsigned int) + 4 * sizeof(btVector3) + sizeof(btQuaternion);
+    return sizeof(TransformHistory) + TRANSFORM_HISTORY_TICKS * perSlot * getCapacity() + sizeof(Player*) * getCapacity();
+}
+
+
+/// @brief  Gets the row holding a tick.
+/// @param  tick  The tick.
+/// @return The row, or -1 if the tick isn't held.
+int TransformHistory::findRow (unsigned int tick) const
+{
+    int row = tick & (TRANSFORM_HISTORY_TICKS - 1);
+    if (!mRowValid[row] || mTicks[row] != tick)
+        return -1;
+    return row;
+}
+
+
+/// @brief  Checks whether a slot was recorded on the tick held in a row.
+bool TransformHistory::isRecorded (int row, int slot, unsigned int tick) const
+{
+    return slot >= 0 && slot < getCapacity() && mSlotTicks[row][slot] == tick;
+}
+
+
+/// @brief  Makes room for more slots.
+/// @param  capacity  The new number of slots.
+void TransformHistory::grow (int capacity)
+{
+    for (int i = 0; i < TRANSFORM_HISTORY_TICKS; i++)
+    {
+        mSlotTicks[i].resize(capacity, SLOT_NOT_RECORDED);
+        mPositions[i].resize(capacity, btVector3(0, 0, 0));
+        mRotations[i].resize(capacity, btQuaternion::getIdentity());
+        mLinearVelocities[i].resize(capacity, btVector3(0, 0, 0));
+        mAabbMins[i].resize(capacity, btVector3(0, 0, 0));
+        mAabbMaxs[i].resize(capacity, btVector3(0, 0, 0));
+    }
+    mOwners.resize(capacity, NULL);
+}
+
+
+/// @brief  Measures the memory used and time taken by the history with a number of cars driving around
+///         an arena, each one being rewound to a random lag every tick as the server does.
+/// @param  cars     The number of cars.
+/// @param  ticks    The number of ticks to run for.
+/// @param  results  Filled with the results.
+void TransformHistory::benchmark (int cars, int ticks, TransformHistoryBenchmark &results)
+{
+    const btVector3 halfExtents(1.0f, 0.8f, 2.2f);
+
+    memset(&results, 0, sizeof(TransformHistoryBenchmark));
+    results.cars  = cars;
+    results.ticks = ticks;
+    if (cars <= 0 || ticks <= 0)
+        return;
+
+    std::vector<btVector3> positions(cars);
+    std::vector<btVector3> velocities(cars);
+    for (int i = 0; i < cars; i++)
+    {
+        positions[i]  = btVector3(randomRange(-100, 100), 0, randomRange(-70, 70));
+        velocities[i] = btVector3(randomRange(-20, 20), 0, randomRange(-20, 20));
+    }
+
+    TransformHistory history(cars);
+    std::vector<int> slots(cars);
+    double recordTime = 0;
+    double queryTime  = 0;
+    double hits       = 0;
+    int    queries    = 0;
+    for (unsigned int tick = 1; tick <= (unsigned int) ticks; tick++)
+    {
+        for (int i = 0; i < cars; i++)
+        {
+            positions[i] += velocities[i] * SIMULATION_TICK_SECONDS;
+            for (int axis = 0; axis < 3; axis += 2)
+                if (btFabs(positions[i][axis]) > 100)
+                    velocities[i][axis] = -velocities[i][axis];
+        }
+
+        RakNet::TimeUS startTime = RakNet::GetTimeUS();
+        history.beginTick(tick);
+        for (int i = 0; i < cars; i++)
+        {
+            btTransform transform(btQuaternion::getIdentity(), positions[i]);
+            history.record(i, NULL, transform, velocities[i], positions[i] - halfExtents, positions[i] + halfExtents);
+        }
+        recordTime += (double) (RakNet::GetTimeUS() - startTime);
+
+        startTime = RakNet::GetTimeUS();
+        for (int i = 0; i < cars; i++)
+        {
+            double viewTick = tick - randomRange(0, (float) LAG_COMPENSATION_MAX_TICKS);
+            btVector3 aabbMin, aabbMax;
+            if (!history.getAabb(i, tick, aabbMin, aabbMax))
+                continue;
+            hits += history.queryAabb(viewTick, aabbMin, aabbMax, &slots[0], cars);
+            queries++;
+        }
+        queryTime += (double) (RakNet::GetTimeUS() - startTime);
+    }
+
+    results.bytes              = history.getMemoryUsage();
+    results.recordMicroseconds = recordTime / ticks;
+    results.queryMicroseconds  = queries > 0 ? queryTime / queries : 0;
+    results.hitsPerQuery       = queries > 0 ? hits / queries : 0;
+}
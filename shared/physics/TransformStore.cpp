@@ -0,0 +1,68 @@
+/**
+ * @file    TransformStore.cpp
+ * @brief   A flat store of the world transforms of every car, written by the physics motion states.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "TransformStore.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+/// @param  capacity  The number of slots to reserve up front.
+TransformStore::TransformStore (int capacity)
+{
+    mPositions.resize(capacity, btVector3(0, 0, 0));
+    mRotations.resize(capacity, btQuaternion::getIdentity());
+    mActive.resize(capacity, false);
+
+    // Push the free slots in reverse so the lowest slots are handed out first.
+    mFreeSlots.reserve(capacity);
+    for (int i = capacity - 1; i >= 0; i--)
+        mFreeSlots.push_back(i);
+}
+
+
+/// @brief  Deconstructor.
+TransformStore::~TransformStore (void)
+{
+}
+
+
+/// @brief  Reserves a slot in the store, growing the store if there are none free.
+/// @return The index of the reserved slot.
+int TransformStore::allocateSlot (void)
+{
+    if (mFreeSlots.empty())
+    {
+        int oldCapacity = getCapacity();
+        int newCapacity = oldCapacity * 2;
+        mPositions.resize(newCapacity, btVector3(0, 0, 0));
+        mRotations.resize(newCapacity, btQuaternion::getIdentity());
+        mActive.resize(newCapacity, false);
+        for (int i = newCapacity - 1; i >= oldCapacity; i--)
+            mFreeSlots.push_back(i);
+    }
+
+    int slot = mFreeSlots.back();
+    mFreeSlots.pop_back();
+    mActive[slot] = true;
+    mPositions[slot] = btVector3(0, 0, 0);
+    mRotations[slot] = btQuaternion::getIdentity();
+
+    return slot;
+}
+
+
+/// @brief  Returns a slot to the store so it can be reused.
+/// @param  slot  The slot to release. Releasing an inactive or invalid slot does nothing.
+void TransformStore::releaseSlot (int slot)
+{
+    if (slot < 0 || slot >= getCapacity() || !mActive[slot])
+        return;
+
+    mActive[slot] = false;
+    mFreeSlots.push_back(slot);
+}
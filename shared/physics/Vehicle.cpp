@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "Vehicle.h"
+#include "RayBatch.h"
+#include "LinearMath/btAabbUtil2.h"
 
 struct btWheelContactPoint
 {
@@ -28,6 +30,96 @@ struct btWheelContactPoint
 btScalar calcContactFriction(btWheelContactPoint& contactPoint);
 
 
+/// @brief  Collects everything the broadphase finds for a WheelRaycaster batch.
+struct WheelRaycasterAabbCallback : public btBroadphaseAabbCallback
+{
+    btAlignedObjectArray<btCollisionObject*> *mCandidates;
+
+    virtual bool process( const btBroadphaseProxy *proxy )
+    {
+        mCandidates->push_back( (btCollisionObject*) proxy->m_clientObject );
+        return true;
+    }
+};
+
+
+/// @brief  Starts a batch of rays, searching the broadphase for everything which might be hit by them.
+/// @param  aabbMin  The minimum corner of a box around every ray in the batch.
+/// @param  aabbMax  The maximum corner of the box.
+void WheelRaycaster::beginBatch( const btVector3 &aabbMin, const btVector3 &aabbMax )
+{
+    mCandidates.resize( 0 );
+
+    WheelRaycasterAabbCallback callback;
+    callback.mCandidates = &mCandidates;
+    mWorld->getBroadphase()->aabbTest( aabbMin, aabbMax, callback );
+
+    mBatching = true;
+}
+
+
+/// @brief  Ends the batch. Rays cast after this search the broadphase again.
+void WheelRaycaster::endBatch()
+{
+    mBatching = false;
+}
+
+
+/// @brief  Casts a ray, finding the closest thing it hits which has contact response (as
+///         btDefaultVehicleRaycaster does).
+/// @param  from    The start of the ray.
+/// @param  to      The end of the ray.
+/// @param  result  Filled with where the ray hit.
+/// @return The body hit, or NULL.
+void* WheelRaycaster::castRay( const btVector3 &from, const btVector3 &to, btVehicleRaycasterResult &result )
+{
+    btCollisionWorld::ClosestRayResultCallback rayCallback( from, to );
+
+    if( !mBatching )
+    {
+        mWorld->rayTest( from, to, rayCallback );
+    }
+    else
+    {
+        btTransform rayFromTrans( btQuaternion::getIdentity(), from );
+        btTransform rayToTrans( btQuaternion::getIdentity(), to );
+
+        for( int i = 0; i < mCandidates.size(); i ++ )
+        {
+            btCollisionObject *object = mCandidates[i];
+            btBroadphaseProxy *proxy  = object->getBroadphaseHandle();
+            if( !rayCallback.needsCollision( proxy ) )
+                continue;
+
+            // Only bother with the narrowphase if the ray reaches the object's box before the closest hit so far.
+            btScalar hitLambda = rayCallback.m_closestHitFraction;
+            btVector3 hitNormal;
+            if( !btRayAabb( from, to, proxy->m_aabbMin, proxy->m_aabbMax, hitLambda, hitNormal ) )
+                continue;
+
+            // Batches are cast on the task pool, where Bullet's rayTestSingle() would swap a compound's children
+            // into the object. The root shape is the object's own, whatever another thread is doing with it.
+            RayBatch::rayTestObject( rayFromTrans, rayToTrans, object, object->getRootCollisionShape(), object->getWorldTransform(), rayCallback );
+        }
+    }
+
+    if( rayCallback.hasHit() )
+    {
+        btRigidBody *body = btRigidBody::upcast( rayCallback.m_collisionObject );
+        if( body && body->hasContactResponse() )
+        {
+            result.m_hitPointInWorld  = rayCallback.m_hitPointWorld;
+            result.m_hitNormalInWorld = rayCallback.m_hitNormalWorld;
+            result.m_hitNormalInWorld.normalize();
+            result.m_distFraction     = rayCallback.m_closestHitFraction;
+            return (void*) body;
+        }
+    }
+
+    return NULL;
+}
+
+
 /* Notes to self
 
     - Use engine force to rotate wheels
@@ -40,7 +132,18 @@ btScalar calcContactFriction(btWheelContactPoint& contactPoint);
     - Some crazy equation of linear / angular velocity * slipangle might work
 */
 
+/// @brief  Updates the vehicle for a substep. VehicleSystem does the same thing in two halves so that
+///         the wheel rays of every car can be cast before any car's forces are applied.
+/// @param  step  The length of the substep.
 void Vehicle::updateVehicle( btScalar step )
+{
+    prepareWheels();
+    applyWheelForces( step );
+}
+
+/// @brief  Works out the vehicle's speed and casts its wheel rays. Only reads the world, and writes
+///         nothing but this vehicle, so vehicles can be prepared in parallel.
+void Vehicle::prepareWheels()
 {
     int i = 0;
 
@@ -65,8 +168,21 @@ void Vehicle::updateVehicle( btScalar step )
 
 
     // SUSPENSION
-	for( i = 0; i < m_wheelInfo.size(); i ++ )
-		rayCast( m_wheelInfo[i] );
+	castWheelRays();
+}
+
+/// @brief  Applies the suspension and friction impulses for the wheels' contacts and turns the wheels.
+///         Writes only this vehicle's chassis, and reads nothing else but the ground under its wheels.
+/// @param  step  The length of the substep.
+void Vehicle::applyWheelForces( btScalar step )
+{
+    int i = 0;
+
+    const btTransform& chassisTrans = getChassisWorldTransform();
+    btVector3 forwardW (
+		chassisTrans.getBasis()[0][getForwardAxis()],
+		chassisTrans.getBasis()[1][getForwardAxis()],
+		chassisTrans.getBasis()[2][getForwardAxis()] );
 
 	updateSuspension( step );
 
@@ -303,6 +419,42 @@ void Vehicle::updateFriction( btScalar timeStep )
 }
 
 
+/// @brief  Casts every wheel's ray in one batch, leaving the contacts in each wheel's m_raycastInfo.
+void Vehicle::castWheelRays()
+{
+    btVector3 aabbMin(  BT_LARGE_FLOAT,  BT_LARGE_FLOAT,  BT_LARGE_FLOAT );
+    btVector3 aabbMax( -BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT );
+    for( int i = 0; i < m_wheelInfo.size(); i ++ )
+    {
+        btWheelInfo& wheel = m_wheelInfo[i];
+        updateWheelTransformsWS( wheel, false );
+
+        btScalar rayLength = wheel.getSuspensionRestLength() + wheel.m_wheelsRadius;
+        btVector3 rayEnd   = wheel.m_raycastInfo.m_hardPointWS + wheel.m_raycastInfo.m_wheelDirectionWS * rayLength;
+        aabbMin.setMin( wheel.m_raycastInfo.m_hardPointWS );
+        aabbMax.setMax( wheel.m_raycastInfo.m_hardPointWS );
+        aabbMin.setMin( rayEnd );
+        aabbMax.setMax( rayEnd );
+    }
+
+    mRaycaster->beginBatch( aabbMin, aabbMax );
+    for( int i = 0; i < m_wheelInfo.size(); i ++ )
+        rayCast( m_wheelInfo[i] );
+    mRaycaster->endBatch();
+
+    mContactsTransform = getRigidBody()->getCenterOfMassTransform();
+    mContactsValid     = true;
+}
+
+/// @brief  Makes sure the wheels' contacts are where the chassis is now. The rays cast at the end of
+///         the last substep (in updateVehicle) are still right unless the car has been moved since, as
+///         nothing moves between then and the next substep's constraints being solved.
+void Vehicle::updateWheelContacts()
+{
+    if( !mContactsValid || !( mContactsTransform == getRigidBody()->getCenterOfMassTransform() ) )
+        castWheelRays();
+}
+
 btScalar calcContactFriction(btWheelContactPoint& contactPoint)
 {
 
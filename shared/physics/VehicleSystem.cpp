@@ -0,0 +1,105 @@
+/**
+ * @file    VehicleSystem.cpp
+ * @brief   Updates every car's raycast vehicle each substep, spreading the cars across the task pool.
+ */
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "VehicleSystem.h"
+#include "GameCore.h"
+
+
+/*-------------------- METHOD DEFINITIONS --------------------*/
+
+/// @brief  Constructor.
+VehicleSystem::VehicleSystem (void) : mReplayVehicle(NULL), mStep(0)
+{
+}
+
+
+/// @brief  Adds a vehicle to be updated every substep.
+/// @param  vehicle  The vehicle.
+void VehicleSystem::addVehicle (Vehicle *vehicle)
+{
+    if (mVehicles.findLinearSearch(vehicle) == mVehicles.size())
+        mVehicles.push_back(vehicle);
+}
+
+
+/// @brief  Stops updating a vehicle. The others keep their order.
+/// @param  vehicle  The vehicle.
+void VehicleSystem::removeVehicle (Vehicle *vehicle)
+{
+    int index = mVehicles.findLinearSearch(vehicle);
+    if (index == mVehicles.size())
+        return;
+
+    for (int i = index + 1; i < mVehicles.size(); i++)
+        mVehicles[i - 1] = mVehicles[i];
+    mVehicles.pop_back();
+}
+
+
+/// @brief  Updates every vehicle for a substep. Called by the world after the substep's integration.
+/// @param  world  The world.
+/// @param  step   The length of the substep.
+void VehicleSystem::updateAction (btCollisionWorld *world, btScalar step)
+{
+    if (mReplayVehicle)
+    {
+        mReplayVehicle->updateVehicle(step);
+        return;
+    }
+
+    TaskPool *pool = GameCore::mTaskPool;
+    int numVehicles = mVehicles.size();
+    mStep = step;
+
+    // Casting the wheel rays only reads the world, so every vehicle can do it at once.
+    if (pool)
+        pool->parallelFor(numVehicles, &VehicleSystem::prepareTask, this);
+    else
+        for (int i = 0; i < numVehicles; i++)
+            mVehicles[i]->prepareWheels();
+
+    // The ground each wheel pushes back on is always the fixed body, so this only changes each vehicle's chassis.
+    if (pool)
+        pool->parallelFor(numVehicles, &VehicleSystem::applyTask, this);
+    else
+        for (int i = 0; i < numVehicles; i++)
+            mVehicles[i]->applyWheelForces(step);
+}
+
+
+/// @brief  Casts the wheel rays of any vehicle whose chassis has moved since they were last cast, so that
+///         the wheel friction constraints can be solved without casting any.
+void VehicleSystem::updateWheelContacts (void)
+{
+    for (int i = 0; i < mVehicles.size(); i++)
+        mVehicles[i]->updateWheelContacts();
+}
+
+
+/// @brief  Draws every vehicle's wheels.
+/// @param  debugDrawer  The drawer.
+void VehicleSystem::debugDraw (btIDebugDraw *debugDrawer)
+{
+    for (int i = 0; i < mVehicles.size(); i++)
+        mVehicles[i]->debugDraw(debugDrawer);
+}
+
+
+/// @brief  Casts one vehicle's wheel rays. Run on the task pool.
+void VehicleSystem::prepareTask (void *context, int index)
+{
+    VehicleSystem *system = (VehicleSystem*) context;
+    system->mVehicles[index]->prepareWheels();
+}
+
+
+/// @brief  Applies one vehicle's wheel forces. Run on the task pool.
+void VehicleSystem::applyTask (void *context, int index)
+{
+    VehicleSystem *system = (VehicleSystem*) context;
+    system->mVehicles[index]->applyWheelForces(system->mStep);
+}
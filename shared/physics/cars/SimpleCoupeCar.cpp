@@ -147,7 +147,7 @@ void SimpleCoupeCar::initTuning()
 /// @param  sceneMgr     The Ogre graphics world.
 /// @param  world        The bullet physics world.
 /// @param  uniqueCarID  A unique ID for the car so that generated nodes do not have (forbidden) name collisions.
-SimpleCoupeCar::SimpleCoupeCar(int uniqueCarID, TeamID tid, ArenaID aid) : Car(uniqueCarID),
+SimpleCoupeCar::SimpleCoupeCar(int uniqueCarID, TeamID tid, ArenaID aid) : Car(uniqueCarID, CAR_BANGER),
                                                                            mHasLocalSounds(false)
 {
     mUniqueCarID = uniqueCarID;
@@ -193,7 +193,7 @@ SimpleCoupeCar::~SimpleCoupeCar(void)
     GameCore::mPhysicsCore->removeBody( mFBumperBody );
     GameCore::mPhysicsCore->removeBody( mRBumperBody );
 
-    GameCore::mPhysicsCore->getWorld()->removeAction( mVehicle );
+    GameCore::mPhysicsCore->removeVehicle( mVehicle );
     
     // Destroy particle systems.
 #ifdef COLLISION_DOMAIN_CLIENT
@@ -211,11 +211,13 @@ SimpleCoupeCar::~SimpleCoupeCar(void)
 #endif
 #endif
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     mBodyNode->removeAndDestroyAllChildren();
     GameCore::mSceneMgr->destroySceneNode( mBodyNode );
 
     mWheelsNode->removeAndDestroyAllChildren();
     GameCore::mSceneMgr->destroySceneNode( mWheelsNode );
+#endif
 
     GameCore::mPhysicsCore->getWorld()->removeConstraint( fricConst );
 
@@ -347,6 +349,13 @@ void SimpleCoupeCar::playCarHorn()
 /// @brief  Initialises the node tree for this car.
 void SimpleCoupeCar::initNodes()
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Nothing is drawn on the headless server, so the car is only its bodies and the TransformStore
+    // says where it is.
+    mPlayerNode = mBodyNode = mWheelsNode = NULL;
+    mChassisNode = mFLDoorNode = mFRDoorNode = mRLDoorNode = mRRDoorNode = mFBumperNode = mRBumperNode = NULL;
+    mFLWheelNode = mFRWheelNode = mRLWheelNode = mRRWheelNode = NULL;
+#else
     // Player node.
     mPlayerNode  = GameCore::mSceneMgr->getRootSceneNode()->createChildSceneNode("PlayerNode" + boost::lexical_cast<std::string>(mUniqueCarID));
 
@@ -381,6 +390,7 @@ void SimpleCoupeCar::initNodes()
     PhysicsCore::auto_scale_scenenode(mFRWheelNode);
     PhysicsCore::auto_scale_scenenode(mRLWheelNode);
     PhysicsCore::auto_scale_scenenode(mRRWheelNode);
+#endif
 }
 
 
@@ -553,15 +563,11 @@ void SimpleCoupeCar::loadDestroyedModel (void)
 /// @brief  Creates a physics car using the nodes (with attached meshes) and adds it to the physics world
 void SimpleCoupeCar::initBody(Ogre::Vector3 carPosition)
 {
-    // Load the collision mesh and create a collision shape out of it
-    Ogre::Entity* entity = GameCore::mSceneMgr->createEntity("BangerCollisionMesh" + boost::lexical_cast<std::string>(mUniqueCarID), "banger_collision.mesh");
-    entity->setDebugDisplayEnabled( false );
-
     btVector3 inertia;
     btCompoundShape *compoundChassisShape = (btCompoundShape*) GameCore::mPhysicsCore->getCollisionShape( PHYS_SHAPE_BANGER );
     compoundChassisShape->calculateLocalInertia( mChassisMass, inertia );
 
-    mState = new CarState( mBodyNode );
+    mState = new CarState( mBodyNode, mTransformSlot );
 
     mCarChassis = new btRigidBody( mChassisMass, mState, compoundChassisShape, inertia );
     GameCore::mPhysicsCore->addRigidBody( mCarChassis, COL_CAR, COL_CAR | COL_ARENA | COL_POWERUP );
@@ -576,14 +582,14 @@ void SimpleCoupeCar::initBody(Ogre::Vector3 carPosition)
     mTuning.m_suspensionDamping        = mSuspensionDamping;
     mTuning.m_suspensionStiffness      = mSuspensionStiffness;
     
-    mVehicleRayCaster = new btDefaultVehicleRaycaster( GameCore::mPhysicsCore->getWorld() );
+    mVehicleRayCaster = new WheelRaycaster( GameCore::mPhysicsCore->getWorld() );
     mVehicle = new Vehicle( mTuning, mCarChassis, mVehicleRayCaster );
     mState->setVehicle( mVehicle );
 
     // This line is needed otherwise the model appears wrongly rotated.
     mVehicle->setCoordinateSystem(0, 1, 2); // rightIndex, upIndex, forwardIndex
 
-    GameCore::mPhysicsCore->getWorld()->addVehicle( mVehicle );
+    GameCore::mPhysicsCore->addVehicle( mVehicle );
 }
 
 
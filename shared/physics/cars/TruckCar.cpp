@@ -112,7 +112,7 @@ void TruckCar::initTuning()
 /// @param  sceneMgr     The Ogre graphics world.
 /// @param  world        The bullet physics world.
 /// @param  uniqueCarID  A unique ID for the car so that generated nodes do not have (forbidden) name collisions.
-TruckCar::TruckCar(int uniqueCarID, TeamID tid, ArenaID aid) : Car(uniqueCarID),
+TruckCar::TruckCar(int uniqueCarID, TeamID tid, ArenaID aid) : Car(uniqueCarID, CAR_TRUCK),
                                                                mHasLocalSounds(false)
 {
     mUniqueCarID = uniqueCarID;
@@ -160,7 +160,7 @@ TruckCar::~TruckCar(void)
     GameCore::mPhysicsCore->removeBody( mRDoorBody );
     GameCore::mPhysicsCore->removeBody( mRBumperBody );
     
-    GameCore::mPhysicsCore->getWorld()->removeAction( mVehicle );
+    GameCore::mPhysicsCore->removeVehicle( mVehicle );
     
     // Destroy particle systems.
 #ifdef COLLISION_DOMAIN_CLIENT
@@ -178,11 +178,13 @@ TruckCar::~TruckCar(void)
 #endif
 #endif
 
+#ifndef COLLISION_DOMAIN_HEADLESS
     mBodyNode->removeAndDestroyAllChildren();
     GameCore::mSceneMgr->destroySceneNode( mBodyNode );
 
     mWheelsNode->removeAndDestroyAllChildren();
     GameCore::mSceneMgr->destroySceneNode( mWheelsNode );
+#endif
 
     GameCore::mPhysicsCore->getWorld()->removeConstraint( fricConst );
 
@@ -309,6 +311,13 @@ void TruckCar::playCarHorn()
 /// @brief  Initialises the node tree for this car.
 void TruckCar::initNodes()
 {
+#ifdef COLLISION_DOMAIN_HEADLESS
+    // Nothing is drawn on the headless server, so the car is only its bodies and the TransformStore
+    // says where it is.
+    mPlayerNode = mBodyNode = mWheelsNode = NULL;
+    mChassisNode = mLDoorNode = mRDoorNode = mRBumperNode = mLWingmirrorNode = mRWingmirrorNode = NULL;
+    mFLWheelNode = mFRWheelNode = mRLWheelNode = mRRWheelNode = NULL;
+#else
     // Player node.
     mPlayerNode  = GameCore::mSceneMgr->getRootSceneNode()->createChildSceneNode("PlayerNode" + boost::lexical_cast<std::string>(mUniqueCarID));
     
@@ -341,6 +350,7 @@ void TruckCar::initNodes()
     PhysicsCore::auto_scale_scenenode(mFRWheelNode);
     PhysicsCore::auto_scale_scenenode(mRLWheelNode);
     PhysicsCore::auto_scale_scenenode(mRRWheelNode);
+#endif
 }
 
 
@@ -505,16 +515,12 @@ void TruckCar::loadDestroyedModel (void)
 /// @brief  Creates a physics car using the nodes (with attached meshes) and adds it to the physics world
 void TruckCar::initBody(Ogre::Vector3 carPosition)
 {
-    // Load the collision mesh and create a collision shape out of it
-    Ogre::Entity* entity = GameCore::mSceneMgr->createEntity("TruckCollisionMesh" + boost::lexical_cast<std::string>(mUniqueCarID), "truck_collision.mesh");
-    entity->setDebugDisplayEnabled( false );
-
     btVector3 inertia;
     btCompoundShape *compoundChassisShape = (btCompoundShape*) GameCore::mPhysicsCore->getCollisionShape( PHYS_SHAPE_TRUCK );
     compoundChassisShape->calculateLocalInertia( mChassisMass, inertia );
 
     //BtOgre::RigidBodyState *state = new BtOgre::RigidBodyState( mBodyNode );
-    mState = new CarState( mBodyNode );
+    mState = new CarState( mBodyNode, mTransformSlot );
 
     mCarChassis = new btRigidBody( mChassisMass, mState, compoundChassisShape, inertia );
     GameCore::mPhysicsCore->addRigidBody( mCarChassis, COL_CAR, COL_CAR | COL_ARENA | COL_POWERUP );
@@ -529,14 +535,14 @@ void TruckCar::initBody(Ogre::Vector3 carPosition)
     mTuning.m_suspensionDamping        = mSuspensionDamping;
     mTuning.m_suspensionStiffness      = mSuspensionStiffness;
     
-    mVehicleRayCaster = new btDefaultVehicleRaycaster( GameCore::mPhysicsCore->getWorld() );
+    mVehicleRayCaster = new WheelRaycaster( GameCore::mPhysicsCore->getWorld() );
     mVehicle = new Vehicle( mTuning, mCarChassis, mVehicleRayCaster );
     mState->setVehicle( mVehicle );
 
     // This line is needed otherwise the model appears wrongly rotated.
     mVehicle->setCoordinateSystem(0, 1, 2); // rightIndex, upIndex, forwardIndex
 
-    GameCore::mPhysicsCore->getWorld()->addVehicle( mVehicle );
+    GameCore::mPhysicsCore->addVehicle( mVehicle );
 }
 
 void TruckCar::initDoors( btTransform& chassisShift )
@@ -0,0 +1,56 @@
+/**
+ * @file    Broadphase.h
+ * @brief   Chooses and builds the broadphase which PhysicsCore's world finds overlapping pairs with.
+ */
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define BROADPHASE_MAX_HANDLES      8192        // Bodies a sweep and prune broadphase has room for (cars, debris, powerups and the arena).
+#define BROADPHASE_WORLD_EXTENT     1000.0f     // Half the size of the world before an arena has been loaded.
+#define BROADPHASE_ARENA_MARGIN     20.0f       // Room left around an arena's bounds for bodies which leave it.
+#define BROADPHASE_ARENA_HEADROOM   100.0f      // Room left above an arena for bodies which are thrown up.
+
+/// @brief  The broadphases which can be used.
+enum BroadphaseType
+{
+    BROADPHASE_SWEEP_AND_PRUNE,     // btAxisSweep3, sized to the arena. Bodies outside the bounds are all lumped together.
+    BROADPHASE_DBVT,                // btDbvtBroadphase. Unbounded, and cheap for bodies which are moving fast.
+
+    BROADPHASE_COUNT
+};
+
+#define BROADPHASE_DEFAULT  BROADPHASE_SWEEP_AND_PRUNE
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  The results of Broadphase::benchmark().
+struct BroadphaseBenchmark
+{
+    int    bodies;
+    int    ticks;
+    double updateMicroseconds;      // Time to update every body's bounds and the overlapping pairs, per tick.
+    double pairsPerTick;
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Builds broadphases. A sweep and prune broadphase quantizes bounds to the space it covers, so
+ *          it is sized to fit the arena tightly rather than the whole world.
+ */
+class Broadphase
+{
+public:
+    static btBroadphaseInterface* create (BroadphaseType type, const btVector3 &worldMin, const btVector3 &worldMax);
+    static void getArenaBounds (const btVector3 &arenaMin, const btVector3 &arenaMax, btVector3 &worldMin, btVector3 &worldMax);
+    static const char* getName (BroadphaseType type);
+
+    static void benchmark (btBroadphaseInterface *broadphase, int cars, int debris, int ticks, BroadphaseBenchmark &results);
+};
+
+#endif // #ifndef BROADPHASE_H
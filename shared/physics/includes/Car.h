@@ -44,10 +44,15 @@ public:
     static std::list<Ogre::Entity*> *mClonedEntities;
     static std::list<Ogre::ResourceHandle> *mMeshObjects;
 
-    Car(int uniqueID);
+    Car(int uniqueID, CarType carType);
     virtual ~Car();
 
     int getUniqueID() { return this->mUniqueID; }
+    CarType getCarType() { return mCarType; }
+    void park();
+    void recycle(TeamID tid, ArenaID aid);
+    void wreck();
+    bool isWrecked() { return mWrecked; }
 
     // = 0 methods not implemented by Car yet!
     virtual void playCarHorn() = 0;
@@ -72,7 +77,8 @@ public:
     virtual CarSnapshot *getCarSnapshot();
 	float getCarMph();
     float getGear() { return mCurrentGear; }
-    btRaycastVehicle *getVehicle() { return mVehicle; }
+    Vehicle *getVehicle() { return mVehicle; }
+    int getTransformSlot() { return mTransformSlot; }
     void attachCollisionTickCallback(Player* player);
     void applyForce(Ogre::SceneNode* node, Ogre::Vector3 force);
     void resetMass();
@@ -143,6 +149,10 @@ protected:
 
     // Data for whole class
     int mUniqueCarID;
+    int mTransformSlot;     ///< This car's slot in PhysicsCore::mTransformStore.
+    CarType mCarType;
+    bool mWrecked;
+    btCollisionShape *mChassisShape;    ///< The chassis' own shape while it is wrecked and using a proxy.
 
     // mTuning related values
     float mSteer;
@@ -200,7 +210,7 @@ protected:
     Vehicle                             *mVehicle;
     CarState                            *mState;
     btRaycastVehicle::btVehicleTuning    mTuning;
-    btDefaultVehicleRaycaster           *mVehicleRayCaster;
+    WheelRaycaster                      *mVehicleRayCaster;
 
     Car *testCar; 
 
@@ -264,7 +274,7 @@ class CarState : public BtOgre::RigidBodyState
 {
 public:
 
-    CarState( Ogre::SceneNode *node );
+    CarState( Ogre::SceneNode *node, int transformSlot );
 
     virtual void    setWorldTransform( const btTransform &in );
     void            setVehicle( btRaycastVehicle *v );
@@ -274,6 +284,7 @@ private:
 
     Ogre::SceneNode *mWheelNode[4];
     btRaycastVehicle *mVehicle;
+    int mTransformSlot;
 
 };
 
@@ -0,0 +1,72 @@
+/**
+ * @file    CarPool.h
+ * @brief   Keeps cars and the bodies of parts which have fallen off them, so they can be used again
+            rather than being built from scratch each time a player spawns or a car breaks up.
+ */
+#ifndef CARPOOL_H
+#define CARPOOL_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "SharedIncludes.h"
+#include "Car.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define CAR_POOL_MAX_SPARE_CARS 128     // Most spare cars kept of each type.
+#define DEBRIS_MASS             30.0f   // Mass of a part which has fallen off a car (kg).
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  A pool of cars for each CarType, and of debris bodies for each PHYS_SHAPE.
+ *
+ *          A car given back is taken out of the world and kept whole. Taking one of the same type
+ *          again puts it back and resets it (Car::recycle()), so a respawn is a reset and a move
+ *          rather than building the nodes, bodies, vehicle and constraints again. Only the server
+ *          keeps cars: the client's cars are dented, burnt out and lose parts, none of which can
+ *          be undone, so they are deleted as before.
+ *
+ *          Debris stays in the world until PhysicsLod's lifetime or budget culls it, or until
+ *          releaseDebris() (at the end of each round), after which its bodies are reused for parts
+ *          which fall off later.
+ */
+class CarPool
+{
+public:
+    CarPool (void);
+    ~CarPool (void);
+
+    Car* takeCar (CarType carType, TeamID tid, ArenaID aid);
+    void releaseCar (Car *car);
+
+    btRigidBody* takeDebris (PHYS_SHAPE shape, Ogre::SceneNode *node, const btTransform &transform, const btTransform &centerOfMassOffset);
+    void updateDebris (void);
+    void releaseDebris (void);
+
+    /// @brief  Gets the number of cars of a type waiting to be used again.
+    int getNumSpareCars (CarType carType) const { return (int) mSpareCars[carType].size(); }
+    /// @brief  Gets the number of debris bodies in the world.
+    int getNumDebris (void) const { return (int) mDebris.size(); }
+
+private:
+    /// @brief  A debris body in the world.
+    struct Debris
+    {
+        btRigidBody     *body;
+        PHYS_SHAPE       shape;
+        Ogre::SceneNode *node;      // The part's node, which the car gave up when the part fell off.
+        unsigned int     step;      // The step it fell off on.
+    };
+
+    void cullDebris (Debris &debris);
+
+    std::vector<Car*>             mSpareCars[CAR_COUNT];
+    std::vector<btRigidBody*>     mSpareDebris[PHYS_SHAPE_COUNT];
+    std::vector<Debris>           mDebris;          ///< Oldest first.
+    std::vector<Ogre::SceneNode*> mCulledNodes;     ///< Nodes of culled debris, hidden until releaseDebris().
+    unsigned int                  mStep;
+};
+
+#endif // #ifndef CARPOOL_H
@@ -21,6 +21,8 @@ public:
     // Car steering, engine and brake
     float mWheelPosition;
 
+    CarSnapshot() {};
+
     CarSnapshot(
         const btVector3 &position,
         const btQuaternion &rotation,
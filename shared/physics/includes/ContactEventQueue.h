@@ -0,0 +1,75 @@
+/**
+ * @file    ContactEventQueue.h
+ * @brief   Contacts worth telling gameplay about, queued as Bullet finds them and handled once per step.
+ */
+#ifndef CONTACTEVENTQUEUE_H
+#define CONTACTEVENTQUEUE_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "LocklessTypes.h"
+
+class Player;
+class Powerup;
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define CONTACT_EVENT_QUEUE_SIZE    4096        // Events held per step. Must be a power of two.
+#define CONTACT_EVENT_MIN_IMPULSE   500.0f      // Impulse (N s) a lasting contact must have taken in the last solve to be reported again.
+
+/// @brief  What a contact was between.
+enum ContactEventType
+{
+    CONTACT_CAR_CAR,
+    CONTACT_CAR_POWERUP,
+    CONTACT_CAR_ARENA
+};
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  One contact point. A car is always body A, except between two cars where the order is Bullet's.
+struct ContactEvent
+{
+    ContactEventType         type;
+    const btCollisionObject *objectA;       // Used to tell which events came from the same pair of bodies.
+    const btCollisionObject *objectB;
+    Player                  *playerA;
+    Player                  *playerB;       // The same as playerA for arena contacts, NULL for powerups.
+    Powerup                 *powerup;
+    btVector3                pointOnA;      // World space.
+    btVector3                pointOnB;
+    btScalar                 distance;      // Negative when the bodies overlap.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  A fixed size queue of contact events which any number of threads can push onto at once
+ *          without locking: each push takes the next index with an atomic increment and writes only
+ *          that entry. Events are read back with getEvent() once nothing is pushing any more (i.e.
+ *          between steps), then the queue is emptied with clear(). Events pushed while it is full are
+ *          dropped and counted.
+ */
+class ContactEventQueue
+{
+public:
+    ContactEventQueue (void);
+    ~ContactEventQueue (void);
+
+    bool push (const ContactEvent &contactEvent);
+    void clear (void);
+
+    int  getNumEvents (void) const;
+    /// @brief  Gets an event, where 0 is the oldest. Only valid when nothing is pushing.
+    const ContactEvent& getEvent (int index) const { return mEvents[(mReadIndex + index) & (CONTACT_EVENT_QUEUE_SIZE - 1)]; }
+    /// @brief  Gets the number of events dropped because the queue was full, since the queue was created.
+    uint32_t getNumDropped (void) const { return mDropped.GetValue(); }
+
+private:
+    ContactEvent             *mEvents;
+    RakNet::LocklessUint32_t  mWriteIndex;  ///< Incremented by every push, whether or not there was room.
+    uint32_t                  mReadIndex;   ///< Where the oldest event is. Only moved by clear().
+    RakNet::LocklessUint32_t  mDropped;
+};
+
+#endif // #ifndef CONTACTEVENTQUEUE_H
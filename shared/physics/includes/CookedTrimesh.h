@@ -0,0 +1,74 @@
+/**
+ * @file    CookedTrimesh.h
+ * @brief   Triangle mesh collision shapes whose triangles and BVH are cooked to a file once, then memory
+            mapped by every server and client which loads them rather than being built again.
+ */
+#ifndef COOKEDTRIMESH_H
+#define COOKEDTRIMESH_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <string>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define COOKED_TRIMESH_VERSION  2
+#define COOKED_TRIMESH_PATH     "../../media/models/"   // Where cooked meshes are kept, beside the meshes they are cooked from.
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  The start of a cooked mesh file. The indices, vertices and BVH follow, each 16 byte aligned.
+struct CookedTrimeshHeader
+{
+    char         magic[4];          // "CDTM".
+    unsigned int version;
+    unsigned int byteOrder;         // 0x01020304 as written, so a file cooked on a machine of the other endianness is rejected.
+    unsigned int sourceHash;        // A hash of the mesh file it was cooked from, to tell when the mesh has changed.
+    float        scale;             // The scale it was cooked at.
+    unsigned int numTriangles;
+    unsigned int numVertices;
+    unsigned int indexOffset;       // Offsets are from the start of the file.
+    unsigned int vertexOffset;
+    unsigned int bvhOffset;
+    unsigned int bvhBytes;
+    unsigned int fileBytes;
+    float        aabbMin[4];
+    float        aabbMax[4];
+    float        localScaling[4];
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  A btBvhTriangleMeshShape whose triangles and quantized BVH are read straight out of a
+ *          memory mapped file.
+ *
+ *          The file is mapped copy-on-write. Bullet rewrites the header of the BVH as it is loaded in
+ *          place, so the page it sits on becomes private to the process, but every other page is backed
+ *          by the file and shared with any other process which has it mapped.
+ */
+class CookedTrimesh
+{
+public:
+    ~CookedTrimesh (void);
+
+    static bool cook (btBvhTriangleMeshShape *shape, const std::string &path, unsigned int sourceHash, float scale);
+    static CookedTrimesh* load (const std::string &path, unsigned int sourceHash, float scale);
+    void touch (void) const;
+
+    /// @brief  Gets the shape. It belongs to the CookedTrimesh.
+    btBvhTriangleMeshShape* getShape (void) { return mShape; }
+
+private:
+    CookedTrimesh (void);
+
+    bool map (const std::string &path);
+    void unmap (void);
+
+    char                       *mData;
+    size_t                      mBytes;
+    btTriangleIndexVertexArray *mMesh;
+    btBvhTriangleMeshShape     *mShape;
+};
+
+#endif // #ifndef COOKEDTRIMESH_H
@@ -0,0 +1,94 @@
+/**
+ * @file    ParallelDynamicsWorld.h
+ * @brief   A dynamics world which solves its simulation islands on several threads at once.
+ */
+#ifndef PARALLELDYNAMICSWORLD_H
+#define PARALLELDYNAMICSWORLD_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "VehicleSystem.h"
+#include <vector>
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  The results of ParallelDynamicsWorld::benchmark(), for one number of threads.
+struct ParallelWorldBenchmark
+{
+    int    threads;                 // 0 for an ordinary btDiscreteDynamicsWorld.
+    int    ticks;
+    double tickMicroseconds;        // Time to step the world, per tick.
+    double islandsPerTick;          // Islands solved, per tick (not counted by the ordinary world).
+    double maxDivergence;           // Furthest any body ended up from where the ordinary world left it (m).
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  A btDiscreteDynamicsWorld which hands its islands (sets of bodies touching or jointed to each
+ *          other) out to GameCore::mTaskPool to be solved, rather than solving them one after another.
+ *
+ *          Islands share no bodies, and each batch of islands is solved by its own solver, so every
+ *          island gets exactly the same result as it would have in the ordinary world. Everything else
+ *          in the step (the broadphase, the narrowphase, integration and the vehicles) is unchanged.
+ *
+ *          Bullet's profiler isn't thread safe, so islands are only solved in parallel when the game
+ *          is built with COLLISION_DOMAIN_BULLET_NO_PROFILE, which promises that the Bullet libraries
+ *          were built with BT_NO_PROFILE (see isAvailable()). Otherwise this behaves as the ordinary
+ *          world. Nothing checks that promise, so only define it for a Bullet you built that way.
+ *
+ *          The cars' wheel friction constraints cast the wheel rays if the chassis has moved since they
+ *          were last cast, which mustn't happen on the solver threads. The world's VehicleSystem (see
+ *          setVehicleSystem()) brings every vehicle's wheel contacts up to date before solving.
+ */
+class ParallelDynamicsWorld : public btDiscreteDynamicsWorld
+{
+public:
+    ParallelDynamicsWorld (btDispatcher *dispatcher, btBroadphaseInterface *broadphase, btConstraintSolver *solver,
+                           btCollisionConfiguration *collisionConfig, int numThreads = -1);
+    virtual ~ParallelDynamicsWorld (void);
+
+    void setNumThreads (int numThreads);
+    /// @brief  Sets the vehicles whose wheel contacts are updated before each parallel solve.
+    void setVehicleSystem (VehicleSystem *vehicleSystem) { mVehicleSystem = vehicleSystem; }
+    /// @brief  Gets the most islands which are solved at once.
+    int  getNumThreads (void) const { return mNumThreads; }
+    /// @brief  Gets the number of islands solved in the last step.
+    int  getNumIslands (void) const { return (int) mIslands.size(); }
+
+    static bool isAvailable (void);
+    static void benchmark (int cars, int ticks, std::vector<ParallelWorldBenchmark> &results);
+
+protected:
+    virtual void solveConstraints (btContactSolverInfo &solverInfo);
+
+private:
+    /// @brief  An island's work, gathered while the islands are built.
+    struct Island
+    {
+        int                    firstBody;       // Index into mIslandBodies.
+        int                    numBodies;
+        btPersistentManifold **manifolds;
+        int                    numManifolds;
+        btTypedConstraint    **constraints;
+        int                    numConstraints;
+        int                    batch;           // The solver (and task) it is solved by.
+    };
+    class IslandGatherer;
+    friend class IslandGatherer;
+
+    void assignBatches (int numBatches);
+    void solveBatch (int batch);
+    static void solveBatchTask (void *context, int index);
+
+    int                                      mNumThreads;
+    VehicleSystem                           *mVehicleSystem;
+    std::vector<btConstraintSolver*>         mSolvers;          ///< Solvers for every batch but the first, which uses the world's own.
+    std::vector<Island>                      mIslands;
+    std::vector<btCollisionObject*>          mIslandBodies;
+    btAlignedObjectArray<btTypedConstraint*> mSortedConstraints; ///< The world's constraints, sorted by island.
+    std::vector<int>                         mBatchWork;        ///< Rough cost of each batch's islands.
+    btContactSolverInfo                     *mSolverInfo;       ///< The settings of the step being solved.
+};
+
+#endif // #ifndef PARALLELDYNAMICSWORLD_H
@@ -7,6 +7,15 @@
 
 #include "stdafx.h"
 #include "PlayerCollisions.h"
+#include "TransformStore.h"
+#include "VehicleSystem.h"
+#include "ContactEventQueue.h"
+#include "Broadphase.h"
+#include "ParallelDynamicsWorld.h"
+#include "RayBatch.h"
+#ifdef COLLISION_DOMAIN_SERVER
+#include "TransformHistory.h"
+#endif
 
 
 #ifdef _WIN32
@@ -15,6 +24,11 @@
 	#include "boost/lexical_cast.hpp"
 #endif
 
+class CarPool;
+class PhysicsLod;
+
+#define PHYSICS_CONFIG_PATH "../../media/physics.cfg"   // Settings read when the physics starts (see loadConfig).
+
 // This is used for physics collision masks
 enum QueryFlags
 {
@@ -35,6 +49,7 @@ public:
     btRigidBody* createArenaBody( Ogre::SceneNode *targetNode, ArenaID aid );
 
     void stepSimulation(const Ogre::Real elapsedTime, int maxSubSteps, const Ogre::Real fixedTimestep);
+    void replaySimulation(Vehicle *vehicle, const Ogre::Real elapsedTime, int maxSubSteps, const Ogre::Real fixedTimestep);
     
     btDynamicsWorld* getWorld() { return mBulletWorld; }
 
@@ -42,34 +57,75 @@ public:
     btCollisionShape *getCollisionShape( PHYS_SHAPE shape ) { return mShapes[shape]; }
     void setCollisionShape( PHYS_SHAPE shape, btCollisionShape *btshape ) { mShapes[shape] = btshape; }
     void addRigidBody( btRigidBody *body, short colGroup, short colMask );
+    void addVehicle( Vehicle *vehicle );
+    void removeVehicle( Vehicle *vehicle );
     bool removeBody( btRigidBody *body );
+    bool parkBody( btRigidBody *body );
     void clearWorld();
+    void setBroadphase( BroadphaseType type );
+    void fitBroadphase( const btVector3 &arenaMin, const btVector3 &arenaMax );
+    /// @brief  Gets the broadphase in use.
+    BroadphaseType getBroadphaseType() { return mBroadphaseType; }
+    /// @brief  Gets the most islands the world solves at once.
+    int getSolverThreads() { return mParallelWorld ? mParallelWorld->getNumThreads() : 1; }
 
     bool singleObjectRaytest(const btVector3& rayFrom, const btVector3& rayTo, btVector3& worldNormal, btVector3& worldHitPoint);
+    /// @brief  Finds where every ray in a batch hits the world, casting them in parallel.
+    void castRays( RayBatch &batch ) { batch.cast( mBulletWorld ); }
 
     //OgreBulletDynamics::DynamicsWorld *mWorld; // Collisions object
 
     PlayerCollisions* mPlayerCollisions;
+    TransformStore*   mTransformStore;
+    VehicleSystem*    mVehicleSystem;
+    ContactEventQueue* mContactEvents;
+    CarPool*          mCarPool;
+    PhysicsLod*       mPhysicsLod;
+#ifdef COLLISION_DOMAIN_SERVER
+    TransformHistory* mTransformHistory;
+#endif
 
 
 private:
+    /// @brief  A body's motion, put back after a replay (see replaySimulation).
+    struct ReplayBodyState
+    {
+        btRigidBody *body;
+        btTransform  transform;
+        btTransform  interpolationTransform;
+        btVector3    linearVelocity;
+        btVector3    angularVelocity;
+        int          activationState;
+        btScalar     deactivationTime;
+    };
+
     static void preTickCallback(btDynamicsWorld *world, btScalar timeStep);
-    static void postTickCallback(btDynamicsWorld *world, btScalar timeStep);
+    static bool contactAddedCallback(btManifoldPoint& cp, const btCollisionObject* colObj0, int partId0, int index0,
+                                     const btCollisionObject* colObj1, int partId1, int index1);
+    void dispatchContactEvents();
+    void rebuildBroadphase();
+    void loadConfig( bool &parallelSolver, int &solverThreads );
 
     //std::deque<OgreBulletDynamics::RigidBody *>        mBodies;
     //std::deque<OgreBulletCollisions::CollisionShape *> mShapes;
     Ogre::Vector3 mBulletGravity;
     Ogre::AxisAlignedBox mBulletAlignedBox;
     int mNumEntitiesInstanced;
+    bool mReplaying;    // True while steps which have already happened once are being replayed.
 
     btDynamicsWorld                     *mBulletWorld;
     btCollisionWorld                   *mCollisionWorld;
-    btAxisSweep3                        *mBroadphase;
+    btBroadphaseInterface               *mBroadphase;
+    BroadphaseType                       mBroadphaseType;
+    btVector3                            mBroadphaseMin;    // The space a sweep and prune broadphase covers.
+    btVector3                            mBroadphaseMax;
     btDefaultCollisionConfiguration     *mCollisionConfig;
     btCollisionDispatcher               *mDispatcher;
     btSequentialImpulseConstraintSolver *mSolver;
+    ParallelDynamicsWorld               *mParallelWorld;    // mBulletWorld, if it solves islands in parallel.
 
     std::deque<btRigidBody*>             mBodies;
+    std::vector<ReplayBodyState>         mReplayStates;     // Every other body's motion, while one car is replayed.
     //std::deque<btCollisionShape*>      mShapes;
     btCollisionShape                    *mShapes[PHYS_SHAPE_COUNT];
 
@@ -0,0 +1,55 @@
+/**
+ * @file    PhysicsLod.h
+ * @brief   Simulates wrecked cars and the parts which have fallen off cars more cheaply than live cars, and
+            limits how many parts are in the world at once.
+ */
+#ifndef PHYSICSLOD_H
+#define PHYSICSLOD_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <map>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define PHYSICS_LOD_DEBRIS_LIFETIME     20.0f   // Seconds a part stays in the world after falling off.
+#define PHYSICS_LOD_DEBRIS_BUDGET       150     // Most parts in the world at once. The oldest are culled first.
+#define PHYSICS_LOD_SLEEP_LINEAR        0.8f    // Speed (m/s) below which a wreck or part may fall asleep.
+#define PHYSICS_LOD_SLEEP_ANGULAR       1.0f    // Angular speed (rad/s) below which a wreck or part may fall asleep.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  The settings and shapes used for the cheap versions of bodies.
+ *
+ *          Wrecks and parts are allowed to sleep, so once they settle they drop out of the solver.
+ *          Wrecks lose their wheels and have their chassis swapped for a box around it (a proxy). Parts
+ *          are boxes already. Parts are culled by CarPool::updateDebris() once they are older than the
+ *          lifetime or there are more than the budget.
+ */
+class PhysicsLod
+{
+public:
+    PhysicsLod (void);
+    ~PhysicsLod (void);
+
+    btCollisionShape* getProxyShape (btCollisionShape *shape);
+    static void setShape (btRigidBody *body, btCollisionShape *shape);
+    static void allowSleeping (btRigidBody *body);
+
+    /// @brief  Sets how long (in seconds) parts stay in the world.
+    void  setDebrisLifetime (float seconds) { mDebrisLifetime = seconds; }
+    /// @brief  Gets how long (in seconds) parts stay in the world.
+    float getDebrisLifetime (void) const { return mDebrisLifetime; }
+    /// @brief  Sets the most parts which may be in the world at once.
+    void  setDebrisBudget (int budget) { mDebrisBudget = budget; }
+    /// @brief  Gets the most parts which may be in the world at once.
+    int   getDebrisBudget (void) const { return mDebrisBudget; }
+
+private:
+    std::map<btCollisionShape*, btCompoundShape*> mProxyShapes;    ///< The proxy made for each shape.
+    float mDebrisLifetime;
+    int   mDebrisBudget;
+};
+
+#endif // #ifndef PHYSICSLOD_H
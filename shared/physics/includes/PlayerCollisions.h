@@ -10,37 +10,59 @@
 
 #include "stdafx.h"
 #include "Player.h"
+#include "TransformStore.h"
+#ifdef COLLISION_DOMAIN_SERVER
+#include "TransformHistory.h"
+#endif
+#include <vector>
+
+#define CRASH_COOLDOWN_FRAMES 90    // Frames after a crash before a car can crash again.
+
+/**
+ *  @brief  Cars are kept track of by their TransformStore slot, so everything here is held in flat
+ *          arrays indexed by slot rather than looked up by Player. Cars which crash into each other
+ *          are joined into a group with a union-find, which is emptied at the end of every frame after
+ *          the loudest crash in each group has been played.
+ */
 class PlayerCollisions
 {
 public:
-    PlayerCollisions();
+    PlayerCollisions(int capacity = TRANSFORM_STORE_CAPACITY);
     virtual ~PlayerCollisions();
-    void addCollision(Player* p1, Player* p2, btPersistentManifold* contactManifold);
+    void addCollision(Player* p1, Player* p2, const btVector3 &averageCollisionPointOnA, const btVector3 &averageCollisionPointOnB,
+        btScalar averageOverlapDistance);
     void frameEventEnd();
+    void clearSlot(int slot);
+#ifdef COLLISION_DOMAIN_SERVER
+    void addRewoundCollisions(TransformHistory *history, unsigned int tick);
+#endif
     
 private:
-    void printLists();
-    void emptyLists();
-    void hasAlreadyBeenSeenThisFrame(
-        std::list<Player*> **player1AlreadySeen,
-        std::list<Player*> **player2AlreadySeen,
-        std::list<Player*> **emptyList,
-        Player* p1,
-        Player* p2);
-    void mergeListsIntoFrom(
-        std::list<Player*> *intoListContainingP1,
-        std::list<Player*> *fromListContainingP2,
-        Player *p1,
-        Player *p2);
-    int getNumCollisionGroups();
-    int getSectionOnCar(Player *p, Ogre::Vector3 pos);
+    /// @brief  The loudest crash in a crash group, which is the only one heard.
+    struct GroupCrash
+    {
+        Player        *player;      // The player whose car the crash is heard from.
+        Ogre::Vector3  point;       // Where it is heard (world space).
+        float          intensity;   // How loud it is, from 0 to 1.
+    };
 
-	std::map< Player*, int > collisionDelays;
-	std::map< Player*, int >::iterator collisionDelaysItr;
+    void applyCrash(Player *p1, Player *p2, Ogre::Vector3 pointOnA, Ogre::Vector3 pointOnB,
+        Ogre::Vector3 localOnA, Ogre::Vector3 localOnB, btScalar overlapDistance, Ogre::Real p1MPH, Ogre::Real p2MPH);
+    int getSectionOnCar(Player *p, Ogre::Vector3 pos);
 
-    
+    bool isCoolingDown(int slot) const;
+    void startCooldown(int slot);
+    void joinCrashGroups(int slotA, int slotB);
+    void addGroupCrash(int slot, Player *player, const Ogre::Vector3 &point, float intensity);
+    int  findCrashGroup(int slot);
+    void emptyCrashGroups();
+    void grow(int capacity);
 
-    std::list< std::list<Player*>* > *mCollisions;
+    std::vector<int> mLastCrashFrames;  ///< The frame each slot's car last crashed on.
+    std::vector<int> mGroupParents;     ///< Each slot's parent in its crash group, or -1 if it hasn't crashed this frame.
+    std::vector<int> mGroupSlots;       ///< The slots which have crashed this frame, so the groups can be emptied quickly.
+    std::vector<GroupCrash> mGroupCrashes;  ///< The loudest crash in each group, kept at the group's root slot.
+    int              mFrame;
 };
 
 #endif // #ifndef PLAYERCOLLISIONS_H
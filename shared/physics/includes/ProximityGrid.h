@@ -0,0 +1,80 @@
+/**
+ * @file    ProximityGrid.h
+ * @brief   A uniform grid over the arena which finds the cars (or powerups) near a point, rebuilt each tick.
+ */
+#ifndef PROXIMITYGRID_H
+#define PROXIMITYGRID_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define PROXIMITY_GRID_CELL_SIZE    16.0f       // Width of a cell (m). About as far as a car goes in half a second.
+#define PROXIMITY_GRID_MAX_CELLS    4096        // Most cells the grid is split into. Cells are widened to fit.
+#define PROXIMITY_GRID_MAX_NEAREST  32          // Most entries queryNearest() finds at once.
+
+/// @brief  Which teams a query finds.
+enum ProximityTeamFilter
+{
+    PROXIMITY_ANY_TEAM,             // Everything.
+    PROXIMITY_SAME_TEAM,            // Only things on the given team.
+    PROXIMITY_OTHER_TEAMS           // Only things not on the given team.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Entries are added (with a team and an id meaning something to the caller, such as an index
+ *          into its own array), then build() sorts them into cells across the ground (x and z) so each
+ *          cell's entries are next to each other. Queries only look at the cells near them, so everyone
+ *          finding their neighbours costs about the same per entry however many entries there are.
+ *
+ *          Distances are measured in 3D. Queries only read the grid, so any number may run at once
+ *          (e.g. from AI players thinking on the task pool), but not while it is being rebuilt.
+ */
+class ProximityGrid
+{
+public:
+    ProximityGrid (float cellSize = PROXIMITY_GRID_CELL_SIZE);
+
+    void clear (void);
+    void add (const btVector3 &position, int team, int id);
+    void build (void);
+
+    int  queryNearest (const btVector3 &centre, int k, int *ids, ProximityTeamFilter filter = PROXIMITY_ANY_TEAM,
+                       int team = 0, int excludeId = -1) const;
+    int  queryRadius (const btVector3 &centre, float radius, int *ids, int maxIds, ProximityTeamFilter filter = PROXIMITY_ANY_TEAM,
+                      int team = 0, int excludeId = -1) const;
+
+    /// @brief  Gets the number of entries added.
+    int  getNumEntries (void) const { return (int) mEntries.size(); }
+    /// @brief  Gets an entry's position, by its index in the order it was added.
+    const btVector3& getPosition (int index) const { return mEntries[index].position; }
+
+private:
+    struct Entry
+    {
+        btVector3 position;
+        int       team;
+        int       id;
+    };
+
+    bool matches (const Entry &entry, ProximityTeamFilter filter, int team, int excludeId) const;
+    void getCell (const btVector3 &position, int &x, int &z) const;
+    void scanNearest (int cellX, int cellZ, const btVector3 &centre, int k, ProximityTeamFilter filter, int team, int excludeId,
+                      int *ids, btScalar *distances2, int &found) const;
+
+    float              mCellSize;
+    float              mBinSize;        ///< The width of the cells last built, which may be wider than mCellSize.
+    float              mMinX;           ///< The corner of the first cell.
+    float              mMinZ;
+    int                mCellsX;
+    int                mCellsZ;
+    std::vector<Entry> mEntries;        ///< In the order they were added.
+    std::vector<Entry> mSorted;         ///< Sorted by cell.
+    std::vector<int>   mCellStarts;     ///< Where each cell's entries start in mSorted, and one past the end.
+};
+
+#endif // #ifndef PROXIMITYGRID_H
@@ -0,0 +1,85 @@
+/**
+ * @file    RayBatch.h
+ * @brief   Casts a batch of rays against the world at once, such as every AI player's feelers.
+ */
+#ifndef RAYBATCH_H
+#define RAYBATCH_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <vector>
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  Where a ray in a RayBatch hit.
+struct RayBatchHit
+{
+    btVector3                point;         // Where the ray hit.
+    btVector3                normal;        // The surface there, facing back along the ray (unit length).
+    btScalar                 fraction;      // How far along the ray the hit is, from 0 to 1 (1 if nothing was hit).
+    const btCollisionObject *object;        // What was hit, or NULL.
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Rays are added, then cast() finds the closest thing each one hits.
+ *
+ *          The broadphase is searched once for everything near any of the rays, then each ray is tested
+ *          against just those objects' boxes, and only the objects whose boxes it crosses are tested
+ *          properly (e.g. the arena's triangle BVH or a car's shape). Testing only reads the world, so
+ *          the rays are spread across GameCore::mTaskPool. This works with either broadphase, and none
+ *          of it touches the broadphase's own ray test, which isn't safe to run on several threads.
+ *
+ *          Nor is btCollisionWorld::rayTestSingle() for compound shapes (every car's chassis), which
+ *          swaps each child shape into the object while testing it. rayTestObject() tests compounds
+ *          without touching the object, and is what every ray cast on the task pool must use.
+ */
+class RayBatch
+{
+public:
+    RayBatch (void);
+
+    void clear (void);
+    int  add (const btVector3 &from, const btVector3 &to, short mask, const btCollisionObject *ignore = NULL);
+    void cast (btCollisionWorld *world);
+
+    /// @brief  Gets the number of rays added.
+    int  getNumRays (void) const { return (int) mRays.size(); }
+    /// @brief  Gets the number of objects the rays were tested against in the last cast().
+    int  getNumCandidates (void) const { return (int) mCandidates.size(); }
+    /// @brief  Gets where a ray hit in the last cast(), by the index add() gave it.
+    const RayBatchHit& getHit (int ray) const { return mHits[ray]; }
+
+    static void rayTestObject (const btTransform &rayFromTrans, const btTransform &rayToTrans, btCollisionObject *object,
+                               const btCollisionShape *shape, const btTransform &worldTransform,
+                               btCollisionWorld::RayResultCallback &resultCallback);
+
+private:
+    struct Ray
+    {
+        btVector3                from;
+        btVector3                to;
+        short                    mask;      // The collision groups the ray hits.
+        const btCollisionObject *ignore;    // An object the ray passes through (usually the one casting it).
+    };
+    struct Candidate
+    {
+        btVector3                aabbMin;
+        btVector3                aabbMax;
+        short                    group;
+        btCollisionObject       *object;
+        const btCollisionShape  *shape;     // The object's shape and transform, read before the rays are cast.
+        btTransform              transform;
+    };
+    class CandidateCollector;
+
+    void castRay (int ray);
+    static void castTask (void *context, int index);
+
+    std::vector<Ray>         mRays;
+    std::vector<RayBatchHit> mHits;
+    std::vector<Candidate>   mCandidates;   ///< Everything near the rays, copied out of the broadphase.
+};
+
+#endif // #ifndef RAYBATCH_H
@@ -0,0 +1,86 @@
+/**
+ * @file    TransformHistory.h
+ * @brief   Where every car has been over the last second, so the server can rewind cars to the time a
+            lagged player was seeing them (see PlayerCollisions::addRewoundCollisions).
+ */
+#ifndef TRANSFORMHISTORY_H
+#define TRANSFORMHISTORY_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "TransformStore.h"
+#include "SimulationClock.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define TRANSFORM_HISTORY_TICKS     64                      // Ticks remembered. Must be a power of two, and more than LAG_COMPENSATION_MAX_TICKS.
+#define LAG_COMPENSATION_MAX_TICKS  SIMULATION_TICK_RATE    // The furthest back (1 s) a player's view will be rewound to.
+
+class Player;
+
+
+/*-------------------- STRUCTURE DEFINITIONS --------------------*/
+/// @brief  The results of TransformHistory::benchmark().
+struct TransformHistoryBenchmark
+{
+    int    cars;
+    int    ticks;
+    size_t bytes;                   // Memory used by the history.
+    double recordMicroseconds;      // Time to record every car, per tick.
+    double queryMicroseconds;       // Time to rewind every car against one other car's view, per query.
+    double hitsPerQuery;
+};
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  A ring of the last TRANSFORM_HISTORY_TICKS ticks, each holding the transform, velocity and
+ *          bounding box of every car. Cars are indexed by their TransformStore slot. Each tick's values
+ *          are kept in their own contiguous arrays, so recording a tick or sweeping it in a query only
+ *          touches memory which is next to each other.
+ */
+class TransformHistory
+{
+public:
+    TransformHistory (int capacity = TRANSFORM_STORE_CAPACITY);
+
+    void beginTick (unsigned int tick);
+    void record (int slot, Player *owner, btRigidBody *body);
+    void record (int slot, Player *owner, const btTransform &transform, const btVector3 &linearVelocity,
+                 const btVector3 &aabbMin, const btVector3 &aabbMax);
+    void clearSlot (int slot);
+
+    bool getTransform (int slot, unsigned int tick, btTransform &transform, btVector3 &linearVelocity) const;
+    bool getAabb (int slot, double tick, btVector3 &aabbMin, btVector3 &aabbMax) const;
+    int  queryAabb (double tick, const btVector3 &aabbMin, const btVector3 &aabbMax, int *slots, int maxSlots) const;
+
+    /// @brief  Gets the player whose car is in a slot, or NULL.
+    Player*      getOwner (int slot) const { return slot < (int) mOwners.size() ? mOwners[slot] : NULL; }
+    /// @brief  Gets the newest tick recorded.
+    unsigned int getNewestTick (void) const { return mNewestTick; }
+    /// @brief  Gets the number of slots each tick has room for.
+    int          getCapacity (void) const { return (int) mOwners.size(); }
+    size_t       getMemoryUsage (void) const;
+
+    static void benchmark (int cars, int ticks, TransformHistoryBenchmark &results);
+
+private:
+    int  findRow (unsigned int tick) const;
+    bool isRecorded (int row, int slot, unsigned int tick) const;
+    void grow (int capacity);
+
+    unsigned int              mTicks[TRANSFORM_HISTORY_TICKS];          ///< The tick each row holds.
+    bool                      mRowValid[TRANSFORM_HISTORY_TICKS];
+    std::vector<unsigned int> mSlotTicks[TRANSFORM_HISTORY_TICKS];      ///< The tick each slot was last recorded in, per row.
+    std::vector<btVector3>    mPositions[TRANSFORM_HISTORY_TICKS];
+    std::vector<btQuaternion> mRotations[TRANSFORM_HISTORY_TICKS];
+    std::vector<btVector3>    mLinearVelocities[TRANSFORM_HISTORY_TICKS];
+    std::vector<btVector3>    mAabbMins[TRANSFORM_HISTORY_TICKS];
+    std::vector<btVector3>    mAabbMaxs[TRANSFORM_HISTORY_TICKS];
+    std::vector<Player*>      mOwners;                                  ///< Whose car each slot currently holds.
+    unsigned int              mNewestTick;
+    int                       mRow;                                     ///< The row being recorded.
+};
+
+#endif // #ifndef TRANSFORMHISTORY_H
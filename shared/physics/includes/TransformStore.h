@@ -0,0 +1,52 @@
+/**
+ * @file    TransformStore.h
+ * @brief   A flat store of the world transforms of every car, written by the physics motion states.
+            Gameplay code reads car positions from here rather than from Ogre scene nodes, which allows
+            the server to run without a scene graph at all (see COLLISION_DOMAIN_HEADLESS).
+ */
+#ifndef TRANSFORMSTORE_H
+#define TRANSFORMSTORE_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include <vector>
+
+
+/*-------------------- DEFINITIONS --------------------*/
+#define TRANSFORM_STORE_CAPACITY 128    // Initial number of slots. The store will grow if this is exceeded.
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  Slot based storage of positions and rotations. Positions and rotations are kept in
+ *          seperate contiguous arrays so they can be swept quickly by anything which needs all
+ *          of the car positions at once.
+ */
+class TransformStore
+{
+public:
+    TransformStore (int capacity = TRANSFORM_STORE_CAPACITY);
+    ~TransformStore (void);
+
+    int  allocateSlot (void);
+    void releaseSlot (int slot);
+
+    /// @brief  Stores the given transform in the given slot. Called every time the motion state is updated.
+    inline void setTransform (int slot, const btTransform& transform)
+    {
+        mPositions[slot] = transform.getOrigin();
+        mRotations[slot] = transform.getRotation();
+    }
+    inline const btVector3&    getPosition (int slot) const { return mPositions[slot]; }
+    inline const btQuaternion& getRotation (int slot) const { return mRotations[slot]; }
+    inline bool                isActive    (int slot) const { return mActive[slot]; }
+    inline int                 getCapacity (void)     const { return (int) mPositions.size(); }
+
+private:
+    std::vector<btVector3>    mPositions;
+    std::vector<btQuaternion> mRotations;
+    std::vector<bool>         mActive;
+    std::vector<int>          mFreeSlots;
+};
+
+#endif // #ifndef TRANSFORMSTORE_H
@@ -3,6 +3,27 @@
 
 #include "stdafx.h"
 
+/**
+ *  @brief  Casts the rays for a vehicle's wheels. A vehicle's wheel rays are short and close together,
+ *          so they are cast as a batch: the broadphase is searched once for anything near any of them
+ *          (beginBatch), and each ray is then only tested against what was found (castRay). Outside a
+ *          batch each ray searches the broadphase itself, as with btDefaultVehicleRaycaster.
+ */
+class WheelRaycaster : public btVehicleRaycaster
+{
+public:
+    WheelRaycaster( btDynamicsWorld *world ) : mWorld( world ), mBatching( false ) {}
+
+    void beginBatch( const btVector3 &aabbMin, const btVector3 &aabbMax );
+    void endBatch();
+    virtual void* castRay( const btVector3 &from, const btVector3 &to, btVehicleRaycasterResult &result );
+
+private:
+    btDynamicsWorld                          *mWorld;
+    bool                                      mBatching;
+    btAlignedObjectArray<btCollisionObject*>  mCandidates;  // Everything the batch's rays might hit.
+};
+
 class Vehicle : public btRaycastVehicle
 {
 private:
@@ -14,16 +35,26 @@ private:
 
     btScalar m_currentVehicleSpeedKmHour;
 
+    WheelRaycaster *mRaycaster;
+    bool            mContactsValid;
+    btTransform     mContactsTransform;    // Where the chassis was when the wheel rays were last cast.
+
 public:
 
-    Vehicle( const btVehicleTuning& tuning,btRigidBody* chassis,	btVehicleRaycaster* raycaster )
-        : btRaycastVehicle( tuning, chassis, raycaster ), mHandbrake( false )
+    Vehicle( const btVehicleTuning& tuning,btRigidBody* chassis,	WheelRaycaster* raycaster )
+        : btRaycastVehicle( tuning, chassis, raycaster ), mRaycaster( raycaster ), mContactsValid( false ), mHandbrake( false )
     {
     }
 
     virtual void    updateVehicle( btScalar step );
 	virtual void 	updateFriction( btScalar timeStep );
 
+    void prepareWheels();
+    void applyWheelForces( btScalar step );
+
+    void castWheelRays();
+    void updateWheelContacts();
+
     btScalar getCurrentSpeedKmHour() const
 	{
 		return m_currentVehicleSpeedKmHour;
@@ -0,0 +1,47 @@
+/**
+ * @file    VehicleSystem.h
+ * @brief   Updates every car's raycast vehicle each substep, spreading the cars across the task pool.
+ */
+#ifndef VEHICLESYSTEM_H
+#define VEHICLESYSTEM_H
+
+/*-------------------- INCLUDES --------------------*/
+#include "stdafx.h"
+#include "Vehicle.h"
+
+
+/*-------------------- CLASS DEFINITIONS --------------------*/
+/**
+ *  @brief  The one action the physics world holds for all of the vehicles, in place of an action per
+ *          vehicle. Each substep it casts every vehicle's wheel rays at once, then applies every
+ *          vehicle's wheel forces at once. btRaycastVehicle treats whatever a wheel is on as Bullet's
+ *          shared fixed body (which has no mass, so pushing on it does nothing), so each vehicle
+ *          only changes its own chassis.
+ */
+class VehicleSystem : public btActionInterface
+{
+public:
+    VehicleSystem (void);
+
+    void addVehicle (Vehicle *vehicle);
+    void removeVehicle (Vehicle *vehicle);
+    /// @brief  Gets the number of vehicles being updated.
+    int  getNumVehicles (void) const { return mVehicles.size(); }
+    /// @brief  Updates only this vehicle (while it is being replayed), or every vehicle if NULL.
+    void setReplayVehicle (Vehicle *vehicle) { mReplayVehicle = vehicle; }
+
+    void updateWheelContacts (void);
+
+    virtual void updateAction (btCollisionWorld *world, btScalar step);
+    virtual void debugDraw (btIDebugDraw *debugDrawer);
+
+private:
+    static void prepareTask (void *context, int index);
+    static void applyTask (void *context, int index);
+
+    btAlignedObjectArray<Vehicle*> mVehicles;
+    Vehicle                       *mReplayVehicle;  ///< The only vehicle to update, if not NULL.
+    btScalar                       mStep;
+};
+
+#endif // #ifndef VEHICLESYSTEM_H